@@ -40,6 +40,7 @@ ContextBase::ContextBase()
 	if (bindings.size() <= 0) {
 		//set up list with function pointers
 		bindings.push_back(Binding((void (GLAPIENTRYP*)(void))&glActiveTexture, "glActiveTexture"));
+		bindings.push_back(Binding((void (GLAPIENTRYP*)(void))&glCompressedTexImage2D, "glCompressedTexImage2D"));
 		bindings.push_back(Binding((void (GLAPIENTRYP*)(void))&glCreateShader, "glCreateShader"));
 		bindings.push_back(Binding((void (GLAPIENTRYP*)(void))&glShaderSource, "glShaderSource"));
 		bindings.push_back(Binding((void (GLAPIENTRYP*)(void))&glCompileShader, "glCompileShader"));
@@ -77,6 +77,7 @@ protected:
 public:
 	//Function pointers for stuff missing in OS OpenGL interface
 	void (GLAPIENTRYP glActiveTexture)(GLenum texture);                 /*!<Activate a specific texture unit*/
+	void (GLAPIENTRYP glCompressedTexImage2D)(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid * data); /*!<Upload compressed texture data*/
 	//Function pointers to OpenGL shader functions.
 	GLuint (GLAPIENTRYP glCreateShader)(GLenum shaderType);             /*!<Function prototype for shader creation.*/
 	void (GLAPIENTRYP glShaderSource)(GLuint shader, GLsizei count, const GLchar **string, const GLint *length); /*!<Function prototype for shader source creation.*/
@@ -1,10 +1,40 @@
 #include "GLTexture2D.h"
+#include "../image/KTXFile.h"
+#include "../image/ImageStatistics.h"
 
 #include <iostream>
 
+//GL_EXT_unpack_subimage on OpenGL ES 2.0 uses the same value as desktop OpenGL
+#ifndef GL_UNPACK_ROW_LENGTH
+    #define GL_UNPACK_ROW_LENGTH 0x0CF2
+#endif
+
+//GL_OES_compressed_ETC1_RGB8_texture
+#ifndef GL_ETC1_RGB8_OES
+    #define GL_ETC1_RGB8_OES 0x8D64
+#endif
+
+//GL_EXT_texture_compression_s3tc
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    #define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    #define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+//OpenGL 1.2 client formats. Old desktop headers do not define them
+#ifdef USE_OPENGL_DESKTOP
+    #ifndef GL_BGR
+        #define GL_BGR 0x80E0
+    #endif
+    #ifndef GL_UNSIGNED_INT_8_8_8_8
+        #define GL_UNSIGNED_INT_8_8_8_8 0x8035
+    #endif
+#endif
+
 
 GLTexture2D::GLTexture2D(std::shared_ptr<ContextBase> & c, int width, int height, const GLint internalFormat, const GLenum format, const GLenum type)
-    : IGLObject(c), glId(0), w(-1), h(-1), glInternalFormat(GL_NONE), glFormat(GL_NONE), glType(GL_NONE), glUnit(GL_NONE)
+    : IGLObject(c), glId(0), w(-1), h(-1), glInternalFormat(GL_NONE), glFormat(GL_NONE), glType(GL_NONE), glUnit(GL_NONE), glCompressedFormat(GL_NONE), uploadCompressedType(PixelInfo::BAD_FORMAT), uploadAutoFormat(false), uploadPremultiplied(false), premultiplied(false), autoMipMaps(false)
 {
     //make our context current
     glContext->makeCurrent();
@@ -102,6 +132,12 @@ GLenum GLTexture2D::getType() const
     return glType;
 }
 
+//True if the uploaded images were premultiplied with alpha. Blend with GL_ONE, GL_ONE_MINUS_SRC_ALPHA then instead of GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA.
+bool GLTexture2D::isPremultiplied() const
+{
+    return premultiplied;
+}
+
 bool GLTexture2D::setAutoMipMaps(const bool enable)
 {
     if (glId > 0) {
@@ -112,12 +148,14 @@ bool GLTexture2D::setAutoMipMaps(const bool enable)
         glEnable(GL_TEXTURE_2D);
 #endif
         glBindTexture(GL_TEXTURE_2D, glId);
-//		glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, enable ? GL_TRUE : GL_FALSE);
+        //mipmaps are generated on the CPU in setPixels(), because glGenerateMipmap stalls on some GLES2 drivers
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, enable ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
         glBindTexture(GL_TEXTURE_2D, 0);
 #ifdef USE_OPENGL_DESKTOP
         //restore enabled attributes
         glPopAttrib();
 #endif
+        autoMipMaps = enable;
         //mark as changed
         changed = true;
         return true;
@@ -173,18 +211,449 @@ bool GLTexture2D::setWrapST(const GLenum wraps, const GLenum wrapt)
     return false;
 }
 
+//Pixel format an image needs to have to be uploaded with the format and type of the texture.
+//Packed 16bit and luminance types need exactly one format. 8bit RGB(A) data needs R8G8B8 or R8G8B8A8, see hasReversedBytes().
+static PixelInfo::FormatType uploadFormat(PixelInfo::FormatType formatType, GLenum format, GLenum type)
+{
+    if (type == GL_UNSIGNED_SHORT_5_6_5) {
+        return PixelInfo::R5G6B5;
+    }
+    else if (type == GL_UNSIGNED_SHORT_4_4_4_4) {
+        return PixelInfo::R4G4B4A4;
+    }
+    else if (type == GL_UNSIGNED_SHORT_5_5_5_1) {
+        return PixelInfo::R5G5B5A1;
+    }
+    else if (format == GL_LUMINANCE) {
+        return PixelInfo::L8;
+    }
+    else if (format == GL_LUMINANCE_ALPHA) {
+        return PixelInfo::L8A8;
+    }
+    else if (format == GL_RGB && type == GL_UNSIGNED_BYTE) {
+        return PixelInfo::R8G8B8;
+    }
+    else if (format == GL_RGBA && type == GL_UNSIGNED_BYTE) {
+        return PixelInfo::R8G8B8A8;
+    }
+    return formatType;
+}
+
+//R8G8B8 and R8G8B8A8 are little-endian integers with red in the highest bits, so their bytes are B,G,R and A,B,G,R in memory.
+//GL_RGB(A) with GL_UNSIGNED_BYTE reads R,G,B(,A) bytes though. Desktop OpenGL can read our order as GL_BGR or GL_UNSIGNED_INT_8_8_8_8,
+//OpenGL ES 2.0 can not, so the bytes of each pixel are reversed in a copy there.
+static bool hasReversedBytes(PixelInfo::FormatType formatType, GLenum format, GLenum type)
+{
+    return type == GL_UNSIGNED_BYTE && ((format == GL_RGB && formatType == PixelInfo::R8G8B8) || (format == GL_RGBA && formatType == PixelInfo::R8G8B8A8));
+}
+
+//Client format and type to upload pixels of a format with. On OpenGL ES data with reversed bytes needs to be swapped with reverseBytes() first.
+static void clientFormat(GLenum & format, GLenum & type, PixelInfo::FormatType formatType, GLenum textureFormat, GLenum textureType)
+{
+    format = textureFormat;
+    type = textureType;
+#ifdef USE_OPENGL_DESKTOP
+    if (hasReversedBytes(formatType, textureFormat, textureType)) {
+        if (textureFormat == GL_RGB) {
+            format = GL_BGR;
+        }
+        else {
+            type = GL_UNSIGNED_INT_8_8_8_8;
+        }
+    }
+#endif
+}
+
+//Copy of a view with the bytes of every pixel in reverse order. The format of the copy does not describe its bytes anymore, so it must only be uploaded.
+static Image reverseBytes(const ConstImageView & view)
+{
+    const size_t bytesPerPixel = PixelInfo::pixelInfo(view.formatType).bytesPerPixel;
+    Image reversed(view.width, view.height, view.formatType);
+    for (size_t y = 0; y < view.height; ++y) {
+        const uint8_t * src = view.row(y);
+        uint8_t * dest = reversed.pixels() + y * view.width * bytesPerPixel;
+        for (size_t x = 0; x < view.width * bytesPerPixel; x += bytesPerPixel) {
+            for (size_t c = 0; c < bytesPerPixel; ++c) {
+                dest[x + c] = src[x + bytesPerPixel - 1 - c];
+            }
+        }
+    }
+    return reversed;
+}
+
+//OpenGL internal format and extension needed to upload a compressed image directly.
+static GLenum compressedInternalFormat(PixelInfo::FormatType formatType, const char * & extension)
+{
+    if (formatType == PixelInfo::ETC1_R8G8B8) {
+        extension = "GL_OES_compressed_ETC1_RGB8_texture";
+        return GL_ETC1_RGB8_OES;
+    }
+    else if (formatType == PixelInfo::BC1_R5G6B5) {
+        extension = "GL_EXT_texture_compression_s3tc";
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+    else if (formatType == PixelInfo::BC3_R5G6B5A8) {
+        extension = "GL_EXT_texture_compression_s3tc";
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    }
+    extension = nullptr;
+    return GL_NONE;
+}
+
+//Uncompressed images passed to setPixels() for the base level are compressed in real-time mode before uploading, e.g. BC1_R5G6B5 for runtime-generated textures.
+//BAD_FORMAT switches back to uncompressed uploads. Fails if the context does not support the format.
+bool GLTexture2D::setUploadCompression(const PixelInfo::FormatType formatType)
+{
+    if (glId > 0) {
+        if (formatType != PixelInfo::BAD_FORMAT) {
+            const char * extension = nullptr;
+            if (compressedInternalFormat(formatType, extension) == GL_NONE || glContext->glCompressedTexImage2D == nullptr || !glContext->isExtensionAvailable(extension)) {
+                std::cout << "Compressed format " << PixelInfo::pixelInfo(formatType).name << " not supported by 2D texture " << glId << "!" << std::endl;
+                return false;
+            }
+        }
+        uploadCompressedType = formatType;
+        return true;
+    }
+    return false;
+}
+
+//Uncompressed images passed to setPixels() for the base level are converted to the smallest format their content needs, see compactFormat().
+//The texture is re-created in that format, e.g. GL_LUMINANCE for grayscale or GL_UNSIGNED_SHORT_5_6_5 for opaque images.
+bool GLTexture2D::setUploadAutoFormat(const bool enable)
+{
+    if (glId > 0) {
+        uploadAutoFormat = enable;
+        return true;
+    }
+    return false;
+}
+
+//Straight alpha images passed to setPixels() are premultiplied once before they are scaled, mipmapped or compressed, so all filtering happens in premultiplied space.
+//Images that are premultiplied already, e.g. baked that way, are uploaded as they are. Check isPremultiplied() to pick the blend function.
+bool GLTexture2D::setUploadPremultiplied(const bool enable)
+{
+    if (glId > 0) {
+        uploadPremultiplied = enable;
+        return true;
+    }
+    return false;
+}
+
 bool GLTexture2D::setPixels(const Image & image, const GLint level)
 {
     if (glId > 0) {
-        Image sourceImage;
-        //check if we need to resize the texture
+        if (PixelInfo::pixelInfo(image.formatType()).paletteEntries > 0) {
+            //palette indices can not be scaled, analyzed or uploaded. look up the colors first
+            Image colorImage(image.width(), image.height(), PixelInfo::R8G8B8A8, image.pixels(), (uint8_t *)image.palette(), image.formatType());
+            colorImage.setPremultiplied(image.isPremultiplied());
+            return setPixels(colorImage, level);
+        }
+        if (uploadPremultiplied && !image.isPremultiplied() && !PixelInfo::pixelInfo(image.formatType()).compressed) {
+            Image premultipliedImage = image;
+            premultipliedImage.premultiplyAlpha();
+            return setPixels(premultipliedImage, level);
+        }
+        if (level == 0) {
+            premultiplied = image.isPremultiplied();
+        }
+        if (PixelInfo::pixelInfo(image.formatType()).compressed) {
+            const char * extension = nullptr;
+            const GLenum internalFormat = compressedInternalFormat(image.formatType(), extension);
+            if (internalFormat != GL_NONE && glContext->isExtensionAvailable(extension) && w == image.width() && h == image.height() && level == 0) {
+                if (autoMipMaps) {
+                    //mipmaps of compressed data can only be made from the decoded pixels. compress every level again
+                    std::vector<Image> levels = image.decompressed().generateMipChain();
+                    levels.front() = image;
+                    for (size_t i = 1; i < levels.size(); ++i) {
+                        levels[i] = levels[i].compressed(image.formatType());
+                    }
+                    return setCompressedMipChain(levels);
+                }
+                //upload the blocks as they are. no decoding on the CPU needed
+                return setCompressedMipChain(std::vector<Image>(1, image));
+            }
+            //the GPU can not use the format or the image needs resizing. decode it and upload the pixels instead
+            return setPixels(image.decompressed(), level);
+        }
+        if (uploadCompressedType != PixelInfo::BAD_FORMAT && level == 0) {
+            //compress the base level and all mipmaps in real-time mode. scaling is done on the full color pixels first
+            const Image sourceImage = (w != image.width() || h != image.height()) ? image.scaled(w, h) : image;
+            std::vector<Image> levels = autoMipMaps ? sourceImage.generateMipChain() : std::vector<Image>(1, sourceImage);
+            for (size_t i = 0; i < levels.size(); ++i) {
+                levels[i] = levels[i].compressed(uploadCompressedType, Image::COMPRESS_FAST);
+            }
+            return setCompressedMipChain(levels);
+        }
+        if (uploadAutoFormat && level == 0) {
+            //pick the format from the content. scaling and converting is done in one pass, then the storage is re-created in that format
+            const PixelInfo::FormatType formatType = compactFormat(image.statistics());
+            Image sourceImage = image;
+            if (w != image.width() || h != image.height()) {
+                sourceImage = image.scaled(w, h, formatType);
+            }
+            else if (formatType != image.formatType()) {
+                sourceImage = Image(image.width(), image.height(), formatType, image.pixels(), nullptr, image.formatType());
+                sourceImage.setPremultiplied(image.isPremultiplied());
+            }
+            return setStorage(autoMipMaps ? sourceImage.generateMipChain() : std::vector<Image>(1, sourceImage));
+        }
+        const PixelInfo::FormatType formatType = uploadFormat(image.formatType(), glFormat, glType);
+        //check if we need to resize the texture. scaling and converting is done in one pass
         if (w != image.width() || h != image.height()) {
-            sourceImage = image.scaled(w, h);
+            const Image sourceImage = image.scaled(w, h, formatType);
+            //upload pre-calculated mipmaps if the base level is set
+            if ((autoMipMaps || glCompressedFormat != GL_NONE) && level == 0) {
+                return setMipChain(autoMipMaps ? sourceImage.generateMipChain() : std::vector<Image>(1, sourceImage));
+            }
+            return setPixels(sourceImage.view(), level);
+        }
+        //same size, but different format. convert once
+        if (formatType != image.formatType()) {
+            const Image sourceImage(image.width(), image.height(), formatType, image.pixels(), nullptr, image.formatType());
+            if ((autoMipMaps || glCompressedFormat != GL_NONE) && level == 0) {
+                return setMipChain(autoMipMaps ? sourceImage.generateMipChain() : std::vector<Image>(1, sourceImage));
+            }
+            return setPixels(sourceImage.view(), level);
+        }
+        //compressed storage can not be updated with uncompressed pixels, so it is re-created in setMipChain()
+        if ((autoMipMaps || glCompressedFormat != GL_NONE) && level == 0) {
+            return setMipChain(autoMipMaps ? image.generateMipChain() : std::vector<Image>(1, image));
+        }
+        //same size and format. upload directly without a copy
+        return setPixels(image.view(), level);
+    }
+    return false;
+}
+
+//Views are uploaded without a copy if their format matches the texture. Other formats are converted to a temporary image first.
+//OpenGL ES 2.0 needs a copy of R8G8B8 and R8G8B8A8 views with the bytes swapped, see hasReversedBytes().
+//Compressed and paletted views can not be converted and fail.
+bool GLTexture2D::setPixels(const ConstImageView & view, const GLint level, const GLint xOffset, const GLint yOffset)
+{
+    if (glId > 0 && view.data != nullptr) {
+        const PixelInfo::FormatType formatType = uploadFormat(view.formatType, glFormat, glType);
+        if (formatType != view.formatType) {
+            if (PixelInfo::pixelInfo(view.formatType).compressed || PixelInfo::pixelInfo(view.formatType).paletteEntries > 0) {
+                std::cout << "Format " << PixelInfo::pixelInfo(view.formatType).name << " of view does not match 2D texture " << glId << "!" << std::endl;
+                return false;
+            }
+            Image converted(view.width, view.height, formatType);
+            convertFormat(converted.view(), view);
+            return setPixels(((const Image &)converted).view(), level, xOffset, yOffset);
+        }
+        GLenum format = GL_NONE;
+        GLenum type = GL_NONE;
+        clientFormat(format, type, view.formatType, glFormat, glType);
+#ifndef USE_OPENGL_DESKTOP
+        if (hasReversedBytes(view.formatType, glFormat, glType)) {
+            const Image reversed = reverseBytes(view);
+            return uploadView(reversed.view(), level, xOffset, yOffset, format, type);
+        }
+#endif
+        return uploadView(view, level, xOffset, yOffset, format, type);
+    }
+    return false;
+}
+
+bool GLTexture2D::uploadView(const ConstImageView & view, const GLint level, const GLint xOffset, const GLint yOffset, const GLenum format, const GLenum type)
+{
+    glContext->makeCurrent();
+#ifdef USE_OPENGL_DESKTOP
+    //push all enable attributes. OpenGL ES doesn't have those functions...
+    glPushAttrib(GL_ENABLE_BIT);
+    glEnable(GL_TEXTURE_2D);
+    const bool rowLengthAvailable = true;
+#else
+    const bool rowLengthAvailable = glContext->isExtensionAvailable("GL_EXT_unpack_subimage");
+#endif
+    glBindTexture(GL_TEXTURE_2D, glId);
+    //use the biggest unpack alignment the row pitch and the data pointer allow
+    GLint unpackAlignment = 4;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    GLint alignment = 8;
+    while (alignment > 1 && ((view.pitch % alignment) != 0 || ((size_t)view.data % alignment) != 0)) {
+        alignment /= 2;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    const size_t bytesPerPixel = PixelInfo::pixelInfo(view.formatType).bytesPerPixel;
+    const size_t alignedRowBytes = ((view.rowBytes() + alignment - 1) / alignment) * alignment;
+    if (view.pitch == alignedRowBytes || view.height == 1) {
+        //rows are packed or padded to the alignment. OpenGL can skip the padding by itself
+        glTexSubImage2D(GL_TEXTURE_2D, level, xOffset, yOffset, (GLsizei)view.width, (GLsizei)view.height, format, type, view.data);
+    }
+    else if (rowLengthAvailable && (view.pitch % bytesPerPixel) == 0) {
+        //sub-rectangle of a bigger image. tell OpenGL how long a source row is
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)(view.pitch / bytesPerPixel));
+        glTexSubImage2D(GL_TEXTURE_2D, level, xOffset, yOffset, (GLsizei)view.width, (GLsizei)view.height, format, type, view.data);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+    else {
+        //plain OpenGL ES 2.0 can not skip pixels. upload row by row, which still avoids a copy
+        for (size_t y = 0; y < view.height; ++y) {
+            glTexSubImage2D(GL_TEXTURE_2D, level, xOffset, yOffset + (GLint)y, (GLsizei)view.width, 1, format, type, view.row(y));
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+    glBindTexture(GL_TEXTURE_2D, 0);
+#ifdef USE_OPENGL_DESKTOP
+    //restore enabled attributes
+    glPopAttrib();
+#endif
+    //mark as changed
+    changed = true;
+    //check for errors
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        std::cout << "Error 0x" << std::hex << error << " updating 2D texture " << glId << " from view!"<< std::endl;
+        valid = false;
+        return false;
+    }
+    return true;
+}
+
+bool GLTexture2D::setMipChain(const std::vector<Image> & levels)
+{
+    if (glId > 0 && !levels.empty()) {
+        if (levels.front().width() != w || levels.front().height() != h) {
+            std::cout << "Mipmap base level size does not match 2D texture " << glId << "!" << std::endl;
+            return false;
+        }
+        if (PixelInfo::pixelInfo(levels.front().formatType()).compressed) {
+            return setCompressedMipChain(levels);
+        }
+        glContext->makeCurrent();
+#ifdef USE_OPENGL_DESKTOP
+        //push all enable attributes. OpenGL ES doesn't have those functions...
+        glPushAttrib(GL_ENABLE_BIT);
+        glEnable(GL_TEXTURE_2D);
+#endif
+        glBindTexture(GL_TEXTURE_2D, glId);
+        //rows of small levels are not 4-byte aligned
+        GLint unpackAlignment = 4;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (size_t i = 0; i < levels.size(); ++i) {
+            GLenum format = GL_NONE;
+            GLenum type = GL_NONE;
+            clientFormat(format, type, levels[i].formatType(), glFormat, glType);
+#ifndef USE_OPENGL_DESKTOP
+            if (hasReversedBytes(levels[i].formatType(), glFormat, glType)) {
+                const Image reversed = reverseBytes(levels[i].view());
+                glTexImage2D(GL_TEXTURE_2D, (GLint)i, glInternalFormat, (GLsizei)levels[i].width(), (GLsizei)levels[i].height(), 0, format, type, reversed.pixels());
+                continue;
+            }
+#endif
+            glTexImage2D(GL_TEXTURE_2D, (GLint)i, glInternalFormat, (GLsizei)levels[i].width(), (GLsizei)levels[i].height(), 0, format, type, levels[i].pixels());
+        }
+        glCompressedFormat = GL_NONE;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+        glBindTexture(GL_TEXTURE_2D, 0);
+#ifdef USE_OPENGL_DESKTOP
+        //restore enabled attributes
+        glPopAttrib();
+#endif
+        //mark as changed
+        changed = true;
+        //check for errors
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR) {
+            std::cout << "Error 0x" << std::hex << error << " uploading mipmaps to 2D texture " << glId << "!"<< std::endl;
+            valid = false;
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool GLTexture2D::setCompressedMipChain(const std::vector<Image> & levels)
+{
+    const char * extension = nullptr;
+    const GLenum internalFormat = compressedInternalFormat(levels.front().formatType(), extension);
+    if (internalFormat == GL_NONE || glContext->glCompressedTexImage2D == nullptr || !glContext->isExtensionAvailable(extension)) {
+        std::cout << "Compressed format of mipmaps not supported by 2D texture " << glId << "!" << std::endl;
+        return false;
+    }
+    glContext->makeCurrent();
+#ifdef USE_OPENGL_DESKTOP
+    //push all enable attributes. OpenGL ES doesn't have those functions...
+    glPushAttrib(GL_ENABLE_BIT);
+    glEnable(GL_TEXTURE_2D);
+#endif
+    glBindTexture(GL_TEXTURE_2D, glId);
+    //compressed data replaces the storage of the texture. the block size is implied by the format
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const size_t dataSize = PixelInfo::dataSize(levels[i].formatType(), levels[i].width(), levels[i].height());
+        glContext->glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, internalFormat, (GLsizei)levels[i].width(), (GLsizei)levels[i].height(), 0, (GLsizei)dataSize, levels[i].pixels());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+#ifdef USE_OPENGL_DESKTOP
+    //restore enabled attributes
+    glPopAttrib();
+#endif
+    //mark as changed
+    changed = true;
+    //check for errors
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        std::cout << "Error 0x" << std::hex << error << " uploading compressed data to 2D texture " << glId << "!"<< std::endl;
+        valid = false;
+        return false;
+    }
+    glCompressedFormat = internalFormat;
+    return true;
+}
+
+//Re-create the texture with the size and format of the levels, e.g. loaded from a KTX file, and upload them as they are.
+//Levels are only converted if the context can not use their format.
+bool GLTexture2D::setStorage(const std::vector<Image> & levels)
+{
+    if (glId > 0 && !levels.empty()) {
+        KTXFormat format;
+        if (!ktxFormat(format, levels.front().formatType())) {
+            std::cout << "Format of mipmaps not supported by 2D texture " << glId << "!" << std::endl;
+            return false;
+        }
+        //the storage is re-created, so the texture takes the size of the levels
+        w = (GLsizei)levels.front().width();
+        h = (GLsizei)levels.front().height();
+        premultiplied = levels.front().isPremultiplied();
+        const char * extension = nullptr;
+        if (PixelInfo::pixelInfo(levels.front().formatType()).compressed) {
+            if (compressedInternalFormat(levels.front().formatType(), extension) != GL_NONE && glContext->glCompressedTexImage2D != nullptr && glContext->isExtensionAvailable(extension)) {
+                return setCompressedMipChain(levels);
+            }
         }
         else {
-            sourceImage = image;
+#ifdef USE_OPENGL_DESKTOP
+            const GLint internalFormat = (GLint)format.glInternalFormat;
+            const bool direct = true;
+#else
+            //OpenGL ES 2.0 needs the unsized internal format and has no BGR(A) or 32bit packed types
+            const GLint internalFormat = (GLint)format.glBaseInternalFormat;
+            const bool direct = format.glType == GL_UNSIGNED_SHORT_5_6_5 || format.glType == GL_UNSIGNED_SHORT_4_4_4_4 || format.glType == GL_UNSIGNED_SHORT_5_5_5_1
+                || format.glFormat == GL_LUMINANCE || format.glFormat == GL_LUMINANCE_ALPHA;
+#endif
+            if (direct) {
+                glInternalFormat = internalFormat;
+                glFormat = (GLenum)format.glFormat;
+                glType = (GLenum)format.glType;
+                return setMipChain(levels);
+            }
+        }
+        //the GPU can not use the format. decode compressed levels or convert the levels to the format of the texture
+        std::vector<Image> converted;
+        for (size_t i = 0; i < levels.size(); ++i) {
+            if (PixelInfo::pixelInfo(levels[i].formatType()).compressed) {
+                converted.push_back(levels[i].decompressed());
+            }
+            else {
+                const PixelInfo::FormatType formatType = uploadFormat(levels[i].formatType(), glFormat, glType);
+                converted.push_back(formatType == levels[i].formatType() ? levels[i] : Image(levels[i].width(), levels[i].height(), formatType, levels[i].pixels(), nullptr, levels[i].formatType()));
+            }
         }
-        return setPixels(sourceImage.pixels(), level, w, h);
+        return PixelInfo::pixelInfo(levels.front().formatType()).compressed ? setStorage(converted) : setMipChain(converted);
     }
     return false;
 }
@@ -219,7 +688,7 @@ bool GLTexture2D::setPixels(const GLvoid * pixels, const GLint level, const GLsi
             valid = false;
             return false;
         }
-        //TODO: Re-generate mipmaps?!
+        //raw data has no format information, so mipmaps are only generated in setPixels(const Image &)
         return true;
     }
     return false;
@@ -272,6 +741,7 @@ GLTexture2D::~GLTexture2D()
         w = -1;
         h = -1;
         glInternalFormat = GL_NONE;
+        glCompressedFormat = GL_NONE;
         glFormat = GL_NONE;
         glType = GL_NONE;
         glUnit = GL_NONE;
@@ -14,6 +14,15 @@ class GLTexture2D : public IChangeableObject, public IGLObject
     GLenum glFormat;
     GLenum glType;
     GLenum glUnit;
+    GLenum glCompressedFormat; //!<Internal format of compressed texture data or GL_NONE if the texture is not compressed.
+    PixelInfo::FormatType uploadCompressedType; //!<Compressed format uncompressed images are encoded to in setPixels() or BAD_FORMAT.
+    bool uploadAutoFormat; //!<If true setPixels() re-creates the texture in the smallest format the image content needs.
+    bool uploadPremultiplied; //!<If true setPixels() premultiplies straight alpha images before scaling, mipmapping and compressing them.
+    bool premultiplied; //!<True if the texture content is premultiplied with alpha.
+    bool autoMipMaps;
+
+    bool setCompressedMipChain(const std::vector<Image> & levels);
+    bool uploadView(const ConstImageView & view, const GLint level, const GLint xOffset, const GLint yOffset, const GLenum format, const GLenum type);
 
 public:
     GLTexture2D(std::shared_ptr<ContextBase> & c, int width, int height, const GLint internalFormat = GL_RGBA, const GLenum format = GL_RGBA, const GLenum type = GL_UNSIGNED_BYTE);
@@ -23,12 +32,19 @@ public:
     GLuint getId() const;
     GLenum getFormat() const;
     GLenum getType() const;
+    bool isPremultiplied() const;
 
     bool setAutoMipMaps(const bool enable = false);
+    bool setUploadCompression(const PixelInfo::FormatType formatType = PixelInfo::BAD_FORMAT);
+    bool setUploadAutoFormat(const bool enable = false);
+    bool setUploadPremultiplied(const bool enable = false);
     bool setMagMinFilter(const GLenum magfilter = GL_LINEAR, const GLenum minfilter = GL_LINEAR);
     bool setWrapST(const GLenum wraps = GL_CLAMP_TO_EDGE, const GLenum wrapt = GL_CLAMP_TO_EDGE);
     bool setPixels(const Image & image, const GLint level = 0);
     bool setPixels(const GLvoid * pixels = nullptr, const GLint level = 0, const GLsizei width = -1, GLsizei height = -1);
+    bool setMipChain(const std::vector<Image> & levels);
+    bool setStorage(const std::vector<Image> & levels);
+    bool setPixels(const ConstImageView & view, const GLint level = 0, const GLint xOffset = 0, const GLint yOffset = 0);
 
     bool bind(const Parameter<GLenum> & parameter = Parameter<GLenum>(GL_TEXTURE0));
     bool unbind();
@@ -0,0 +1,427 @@
+#include "Image.h"
+#include "KTXFile.h"
+#include "MappedFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#if defined(WIN32) || defined(_WIN32)
+    #include <direct.h>
+#endif
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+
+/*
+Offline asset baker. Reads a manifest of source assets and writes GPU-ready outputs to an output directory.
+Manifest lines look like this. Input paths are relative to the manifest, output paths relative to the output directory:
+
+    # comment
+    image textures/wall.png wall.rimg format=R5G6B5 mips=1 maxsize=1024 filter=lanczos3 orientation=bottomup
+    image textures/floor.png floor.rimg format=ETC1_R8G8B8 mips=1 quality=best
+    image textures/sky.png sky.ktx format=BC1_R5G6B5 mips=1
+    image sprites/tree.png tree.ktx format=BC3_R5G6B5A8 mips=1 premultiply=1
+    copy models/box.obj box.obj
+
+Images are written as raw image containers (see Image::saveRaw), so they can be memory-mapped at runtime. Mip levels 1..n go to "<name>.mip<level><ext>".
+Outputs ending in ".ktx" are written as a single KTX file with all mip levels instead (see saveKTX).
+Compressed formats are encoded after the mip levels have been generated from the uncompressed image. quality=best searches harder for good block encodings.
+premultiply=1 multiplies colors with alpha before scaling and mipmapping. Both output types store that, so Image::isPremultiplied() is set when loading them.
+Everything else is copied. A content hash of every input and its options is kept in the output directory and unchanged entries are skipped.
+*/
+
+//Bump this when the output of the baker changes, so all entries are rebuilt.
+#define BAKE_VERSION 2
+#define BAKE_CACHE_FILE ".bake_cache"
+
+enum BakeStage { STAGE_HASH, STAGE_DECODE, STAGE_CONVERT, STAGE_MIPS, STAGE_COMPRESS, STAGE_WRITE, NR_OF_STAGES };
+static const char * s_stageNames[NR_OF_STAGES] = { "hash", "decode", "convert", "mips", "compress", "write" };
+
+struct BakeEntry
+{
+    std::string type; //!< "image" or "copy".
+    std::string input; //!< Input path.
+    std::string output; //!< Output path.
+    std::map<std::string, std::string> options; //!< key=value options.
+    std::string optionString; //!< Options as written in the manifest. Part of the content hash.
+    uint64_t hash; //!< Content hash of input and options.
+    bool baked; //!< True if the entry was baked in this run.
+    bool failed;
+};
+
+//Time spent in every stage over all threads in microseconds.
+static std::atomic<uint64_t> s_stageTimes[NR_OF_STAGES];
+
+class StageTimer
+{
+    BakeStage m_stage;
+    std::chrono::high_resolution_clock::time_point m_start;
+public:
+    StageTimer(BakeStage stage) : m_stage(stage), m_start(std::chrono::high_resolution_clock::now()) {}
+    ~StageTimer() { s_stageTimes[m_stage] += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - m_start).count(); }
+};
+
+//-------------------------------------------------------------------------------------------------
+
+//64bit FNV-1a hash.
+static uint64_t hashBytes(const uint8_t * data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t hashString(const std::string & value, uint64_t hash)
+{
+    return hashBytes((const uint8_t *)value.data(), value.size(), hash);
+}
+
+static std::string directoryOf(const std::string & path)
+{
+    const size_t separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+}
+
+static bool fileExists(const std::string & path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+//Create all directories of a path. Existing directories are fine.
+static void createDirectories(const std::string & path)
+{
+    for (size_t separator = path.find_first_of("/\\", 1); separator != std::string::npos; separator = path.find_first_of("/\\", separator + 1)) {
+        const std::string directory = path.substr(0, separator);
+#if defined(WIN32) || defined(_WIN32)
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+    }
+}
+
+static PixelInfo::FormatType formatFromName(const std::string & name)
+{
+    for (int type = PixelInfo::BAD_FORMAT + 1; type < PixelInfo::MAX_FORMAT; ++type) {
+        if (PixelInfo::pixelInfo((PixelInfo::FormatType)type).name == name) {
+            return (PixelInfo::FormatType)type;
+        }
+    }
+    throw ImageException("Unknown pixel format \"" + name + "\"!");
+}
+
+static ResampleFilter filterFromName(const std::string & name)
+{
+    if (name == "nearest") { return ResampleNearest(); }
+    if (name == "linear") { return ResampleLinear(); }
+    if (name == "box") { return ResampleBox(); }
+    if (name == "lanczos2") { return ResampleLanczos2(); }
+    if (name == "lanczos3") { return ResampleLanczos3(); }
+    if (name == "mitchell") { return ResampleMitchell(); }
+    if (name == "catmullrom") { return ResampleCatmullRom(); }
+    throw ImageException("Unknown filter \"" + name + "\"!");
+}
+
+static std::string option(const BakeEntry & entry, const std::string & key, const std::string & defaultValue)
+{
+    std::map<std::string, std::string>::const_iterator it = entry.options.find(key);
+    return it != entry.options.end() ? it->second : defaultValue;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static bool readManifest(const std::string & path, std::vector<BakeEntry> & entries)
+{
+    std::ifstream file(path.c_str());
+    if (!file.is_open()) {
+        std::cout << "Failed to open manifest \"" << path << "\"!" << std::endl;
+        return false;
+    }
+    const std::string baseDirectory = directoryOf(path);
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        std::istringstream stream(line);
+        BakeEntry entry;
+        if (!(stream >> entry.type) || entry.type[0] == '#') {
+            continue;
+        }
+        if (!(stream >> entry.input >> entry.output) || (entry.type != "image" && entry.type != "copy")) {
+            std::cout << path << ":" << lineNumber << ": Invalid entry!" << std::endl;
+            return false;
+        }
+        entry.input = baseDirectory + entry.input;
+        std::string keyValue;
+        while (stream >> keyValue) {
+            const size_t equals = keyValue.find('=');
+            if (equals == std::string::npos) {
+                std::cout << path << ":" << lineNumber << ": Options must be key=value!" << std::endl;
+                return false;
+            }
+            entry.options[keyValue.substr(0, equals)] = keyValue.substr(equals + 1);
+            entry.optionString += keyValue + " ";
+        }
+        entry.hash = 0;
+        entry.baked = false;
+        entry.failed = false;
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+static std::map<std::string, uint64_t> readCache(const std::string & path)
+{
+    std::map<std::string, uint64_t> cache;
+    std::ifstream file(path.c_str());
+    std::string output;
+    std::string hash;
+    while (file >> hash >> output) {
+        cache[output] = strtoull(hash.c_str(), nullptr, 16);
+    }
+    return cache;
+}
+
+static bool writeCache(const std::string & path, const std::vector<BakeEntry> & entries)
+{
+    //write to a temporary file first, so an interrupted bake does not leave a broken cache
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath.c_str());
+        if (!file.is_open()) {
+            return false;
+        }
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (!entries[i].failed) {
+                char hash[32];
+                snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)entries[i].hash);
+                file << hash << " " << entries[i].output << std::endl;
+            }
+        }
+    }
+    remove(path.c_str());
+    return rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static uint64_t hashEntry(const BakeEntry & entry)
+{
+    StageTimer timer(STAGE_HASH);
+    std::ostringstream header;
+    header << BAKE_VERSION << " " << entry.type << " " << entry.output << " " << entry.optionString;
+    uint64_t hash = hashString(header.str(), 14695981039346656037ULL);
+    MappedFile file;
+    if (!file.open(entry.input)) {
+        //empty files can not be mapped
+        if (!fileExists(entry.input)) {
+            throw ImageException("Input file not found!");
+        }
+        return hash;
+    }
+    return hashBytes(file.data(), file.size(), hash);
+}
+
+static std::string mipPath(const std::string & path, size_t level)
+{
+    const size_t dot = path.find_last_of('.');
+    const size_t separator = path.find_last_of("/\\");
+    std::ostringstream result;
+    if (dot == std::string::npos || (separator != std::string::npos && dot < separator)) {
+        result << path << ".mip" << level;
+    }
+    else {
+        result << path.substr(0, dot) << ".mip" << level << path.substr(dot);
+    }
+    return result.str();
+}
+
+static void bakeImage(const BakeEntry & entry, const std::string & outputPath)
+{
+    const std::string formatName = option(entry, "format", "");
+    const PixelInfo::FormatType outputType = formatName.empty() ? PixelInfo::BAD_FORMAT : formatFromName(formatName);
+    //compressed images are encoded from full color pixels at the very end
+    const bool compress = outputType != PixelInfo::BAD_FORMAT && PixelInfo::pixelInfo(outputType).compressed;
+    const PixelInfo::FormatType formatType = compress ? PixelInfo::R8G8B8A8 : outputType;
+    const Image::CompressionQuality quality = option(entry, "quality", "fast") == "best" ? Image::COMPRESS_QUALITY : Image::COMPRESS_FAST;
+    const Image::Orientation orientation = option(entry, "orientation", "bottomup") == "topdown" ? Image::TOP_DOWN : Image::BOTTOM_UP;
+    const ResampleFilter filter = filterFromName(option(entry, "filter", "linear"));
+    const size_t maxSize = (size_t)atoi(option(entry, "maxsize", "0").c_str());
+    Image image;
+    {
+        StageTimer timer(STAGE_DECODE);
+        if (maxSize > 0) {
+            image.load(entry.input, maxSize, maxSize, filter);
+        }
+        else {
+            //convert and flip while copying out of the decoder
+            image.load(entry.input, formatType, orientation);
+        }
+    }
+    if (maxSize > 0 && ((formatType != PixelInfo::BAD_FORMAT && formatType != image.formatType()) || orientation != Image::BOTTOM_UP)) {
+        StageTimer timer(STAGE_CONVERT);
+        if (orientation != Image::BOTTOM_UP) {
+            image.flipVertical();
+        }
+        if (formatType != PixelInfo::BAD_FORMAT && formatType != image.formatType()) {
+            const Image & source = image;
+            image = Image(source.width(), source.height(), formatType, source.pixels(), nullptr, source.formatType());
+        }
+    }
+    if (option(entry, "premultiply", "0") != "0") {
+        StageTimer timer(STAGE_CONVERT);
+        image.premultiplyAlpha();
+    }
+    std::vector<Image> levels;
+    if (option(entry, "mips", "0") != "0") {
+        StageTimer timer(STAGE_MIPS);
+        levels = image.generateMipChain(filter);
+    }
+    else {
+        levels.push_back(image);
+    }
+    if (compress) {
+        StageTimer timer(STAGE_COMPRESS);
+        for (size_t level = 0; level < levels.size(); ++level) {
+            levels[level] = levels[level].compressed(outputType, quality);
+        }
+    }
+    StageTimer timer(STAGE_WRITE);
+    createDirectories(outputPath);
+    if (outputPath.size() > 4 && outputPath.compare(outputPath.size() - 4, 4, ".ktx") == 0) {
+        if (!saveKTX(outputPath, levels, orientation)) {
+            throw ImageException("Failed to write output!");
+        }
+        return;
+    }
+    for (size_t level = 0; level < levels.size(); ++level) {
+        if (!levels[level].saveRaw(level == 0 ? outputPath : mipPath(outputPath, level))) {
+            throw ImageException("Failed to write output!");
+        }
+    }
+}
+
+static void copyFile(const BakeEntry & entry, const std::string & outputPath)
+{
+    StageTimer timer(STAGE_WRITE);
+    createDirectories(outputPath);
+    FILE * output = fopen(outputPath.c_str(), "wb");
+    if (output == nullptr) {
+        throw ImageException("Failed to open output!");
+    }
+    MappedFile input;
+    const bool worked = !input.open(entry.input) || fwrite(input.data(), input.size(), 1, output) == 1;
+    fclose(output);
+    if (!worked) {
+        throw ImageException("Failed to write output!");
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void printUsage()
+{
+    std::cout << "Usage: asset_bake [-f] [-j THREADS] MANIFEST OUTPUT_DIRECTORY" << std::endl;
+    std::cout << "  -f          Rebuild all entries, even if they have not changed." << std::endl;
+    std::cout << "  -j THREADS  Number of worker threads. Defaults to the number of CPUs." << std::endl;
+}
+
+int main(int argc, char * argv[])
+{
+    bool force = false;
+    int nrOfThreads = 0;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-f") == 0) {
+            force = true;
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            nrOfThreads = atoi(argv[++i]);
+        }
+        else {
+            arguments.push_back(argv[i]);
+        }
+    }
+    if (arguments.size() != 2) {
+        printUsage();
+        return 2;
+    }
+    const std::string manifestPath = arguments[0];
+    std::string outputDirectory = arguments[1];
+    if (outputDirectory.find_last_of("/\\") != outputDirectory.size() - 1) {
+        outputDirectory += "/";
+    }
+#ifdef _OPENMP
+    if (nrOfThreads > 0) {
+        omp_set_num_threads(nrOfThreads);
+    }
+#else
+    if (nrOfThreads > 1) {
+        std::cout << "Built without OpenMP support. Ignoring -j " << nrOfThreads << " and baking serially." << std::endl;
+    }
+#endif
+    std::vector<BakeEntry> entries;
+    if (!readManifest(manifestPath, entries)) {
+        return 1;
+    }
+    const std::map<std::string, uint64_t> cache = force ? std::map<std::string, uint64_t>() : readCache(outputDirectory + BAKE_CACHE_FILE);
+    for (int stage = 0; stage < NR_OF_STAGES; ++stage) {
+        s_stageTimes[stage] = 0;
+    }
+    const auto start = std::chrono::high_resolution_clock::now();
+    //entries differ a lot in cost, so idle threads take the next entry from the list as soon as they are done
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < (int)entries.size(); ++i) {
+        BakeEntry & entry = entries[i];
+        const std::string outputPath = outputDirectory + entry.output;
+        try {
+            entry.hash = hashEntry(entry);
+            std::map<std::string, uint64_t>::const_iterator cached = cache.find(entry.output);
+            if (cached != cache.end() && cached->second == entry.hash && fileExists(outputPath)) {
+                continue;
+            }
+            if (entry.type == "image") {
+                bakeImage(entry, outputPath);
+            }
+            else {
+                copyFile(entry, outputPath);
+            }
+            entry.baked = true;
+        }
+        catch (const std::exception & e) {
+            entry.failed = true;
+#pragma omp critical
+            std::cout << "Failed to bake \"" << entry.input << "\": " << e.what() << std::endl;
+        }
+    }
+    const double wallTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    //report what was done
+    size_t nrOfBaked = 0;
+    size_t nrOfFailed = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        nrOfBaked += entries[i].baked ? 1 : 0;
+        nrOfFailed += entries[i].failed ? 1 : 0;
+    }
+    std::cout << entries.size() << " entries: " << nrOfBaked << " baked, " << (entries.size() - nrOfBaked - nrOfFailed) << " unchanged, " << nrOfFailed << " failed in " << wallTime << "ms" << std::endl;
+    std::cout << "Time per stage summed over all threads:";
+    for (int stage = 0; stage < NR_OF_STAGES; ++stage) {
+        std::cout << " " << s_stageNames[stage] << " " << (double)s_stageTimes[stage] / 1000.0 << "ms";
+    }
+    std::cout << std::endl;
+    if (!writeCache(outputDirectory + BAKE_CACHE_FILE, entries)) {
+        std::cout << "Failed to write cache file!" << std::endl;
+        return 1;
+    }
+    return nrOfFailed > 0 ? 1 : 0;
+}
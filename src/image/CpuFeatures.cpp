@@ -0,0 +1,64 @@
+#include "CpuFeatures.h"
+
+#if defined(IMAGE_SIMD_X86)
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+
+#if defined(IMAGE_SIMD_X86)
+static void cpuid(int leaf, int subLeaf, unsigned int registers[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex((int *)registers, leaf, subLeaf);
+#else
+    __cpuid_count(leaf, subLeaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+static unsigned long long xgetbv(unsigned int index)
+{
+#if defined(_MSC_VER)
+    return _xgetbv(index);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+static CpuFeatures detectFeatures()
+{
+    CpuFeatures features;
+#if defined(IMAGE_SIMD_X86)
+    unsigned int registers[4] = {0, 0, 0, 0};
+    cpuid(0, 0, registers);
+    const unsigned int maxLeaf = registers[0];
+    if (maxLeaf >= 1) {
+        cpuid(1, 0, registers);
+        features.sse2 = (registers[3] & (1 << 26)) != 0;
+        features.ssse3 = (registers[2] & (1 << 9)) != 0;
+        //AVX needs the OS to save the YMM registers on context switches, check OSXSAVE and XCR0
+        const bool osxsave = (registers[2] & (1 << 27)) != 0;
+        const bool avx = (registers[2] & (1 << 28)) != 0;
+        if (maxLeaf >= 7 && osxsave && avx && (xgetbv(0) & 0x6) == 0x6) {
+            cpuid(7, 0, registers);
+            features.avx2 = (registers[1] & (1 << 5)) != 0;
+        }
+    }
+#endif
+#if defined(IMAGE_SIMD_NEON)
+    features.neon = true;
+#endif
+    return features;
+}
+
+const CpuFeatures & CpuFeatures::detected()
+{
+    static const CpuFeatures features = detectFeatures();
+    return features;
+}
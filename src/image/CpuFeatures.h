@@ -0,0 +1,41 @@
+#pragma once
+
+//Figure out what SIMD instruction sets we can compile for.
+//x86 kernels are always compiled in and selected at runtime, NEON is a compile-time decision (e.g. -mfpu=neon on the Raspberry Pi).
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+    #define IMAGE_SIMD_X86
+    #include <emmintrin.h>
+    #include <tmmintrin.h>
+    #include <immintrin.h>
+#endif
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    #define IMAGE_SIMD_NEON
+    #include <arm_neon.h>
+#endif
+
+//GCC needs to be told a function may use instructions not enabled on the command line. MSVC always allows intrinsics.
+#if defined(_MSC_VER)
+    #define SIMD_TARGET(isa)
+#else
+    #define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+
+struct CpuFeatures
+{
+    bool sse2; //!< SSE2 is available.
+    bool ssse3; //!< SSSE3 is available (pshufb).
+    bool avx2; //!< AVX2 is available and the OS saves the YMM registers.
+    bool neon; //!< ARM NEON is available.
+
+    /*!
+    Construct with all features disabled. Use this to force the scalar code paths.
+    */
+    CpuFeatures() : sse2(false), ssse3(false), avx2(false), neon(false) {}
+
+    /*!
+    Retrieve the features of the CPU we're running on. This is detected once and cached.
+    \return Returns a reference to the detected CPU features.
+    */
+    static const CpuFeatures & detected();
+};
@@ -0,0 +1,457 @@
+#include "ETC1Codec.h"
+#include "PixelAllocator.h"
+
+#include <string.h>
+
+
+//Intensity modifier tables. The 2bit pixel indices 0-3 select +a, +b, -a, -b of a table.
+static const int s_modifiers[8][4] = {
+    {2, 8, -2, -8}, {5, 17, -5, -17}, {9, 29, -9, -29}, {13, 42, -13, -42},
+    {18, 60, -18, -60}, {24, 80, -24, -80}, {33, 106, -33, -106}, {47, 183, -47, -183}
+};
+
+//Pixels of both sub-blocks as y * 4 + x. Without the flip bit the sub-blocks are the left and right 2x4 half, with it the top and bottom 4x2 half.
+static const uint8_t s_subBlockPixels[2][2][8] = {
+    {{0, 1, 4, 5, 8, 9, 12, 13}, {2, 3, 6, 7, 10, 11, 14, 15}},
+    {{0, 1, 2, 3, 4, 5, 6, 7}, {8, 9, 10, 11, 12, 13, 14, 15}}
+};
+
+//Search radius around the average color of a sub-block in quality mode: +-1 in every component.
+#define ETC1_NR_OF_COLOR_CANDIDATES 27
+
+/*!
+Calculate the summed squared error of the 8 pixels of a sub-block, every pixel using the best of 4 candidate colors.
+\param[in] pixels 8 red, 8 green and 8 blue values.
+\param[in] candidates 4 candidate colors as red, green, blue. Every value must be in [0,255].
+*/
+typedef uint32_t (*SubBlockErrorFunction)(const int16_t * pixels, const int16_t * candidates);
+
+static uint32_t subBlockError(const int16_t * pixels, const int16_t * candidates)
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < 8; ++i) {
+        uint32_t best = 0xFFFFFFFF;
+        for (int m = 0; m < 4; ++m) {
+            const int dr = pixels[i] - candidates[3 * m];
+            const int dg = pixels[8 + i] - candidates[3 * m + 1];
+            const int db = pixels[16 + i] - candidates[3 * m + 2];
+            const uint32_t error = (uint32_t)(dr * dr + dg * dg + db * db);
+            best = error < best ? error : best;
+        }
+        sum += best;
+    }
+    return sum;
+}
+
+#if defined(IMAGE_SIMD_X86)
+
+SIMD_TARGET("sse2") static uint32_t subBlockError_SSE2(const int16_t * pixels, const int16_t * candidates)
+{
+    const __m128i r = _mm_loadu_si128((const __m128i *)pixels);
+    const __m128i g = _mm_loadu_si128((const __m128i *)(pixels + 8));
+    const __m128i b = _mm_loadu_si128((const __m128i *)(pixels + 16));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i bestLo = _mm_set1_epi32(0x7FFFFFFF);
+    __m128i bestHi = bestLo;
+    for (int m = 0; m < 4; ++m) {
+        const __m128i dr = _mm_sub_epi16(r, _mm_set1_epi16(candidates[3 * m]));
+        const __m128i dg = _mm_sub_epi16(g, _mm_set1_epi16(candidates[3 * m + 1]));
+        const __m128i db = _mm_sub_epi16(b, _mm_set1_epi16(candidates[3 * m + 2]));
+        //madd squares and adds pairs of 16bit values, so interleave red with green and blue with zero
+        const __m128i rgLo = _mm_unpacklo_epi16(dr, dg);
+        const __m128i rgHi = _mm_unpackhi_epi16(dr, dg);
+        const __m128i bLo = _mm_unpacklo_epi16(db, zero);
+        const __m128i bHi = _mm_unpackhi_epi16(db, zero);
+        const __m128i errorLo = _mm_add_epi32(_mm_madd_epi16(rgLo, rgLo), _mm_madd_epi16(bLo, bLo));
+        const __m128i errorHi = _mm_add_epi32(_mm_madd_epi16(rgHi, rgHi), _mm_madd_epi16(bHi, bHi));
+        //SSE2 has no 32bit minimum. errors are positive, so a signed compare works
+        const __m128i lessLo = _mm_cmplt_epi32(errorLo, bestLo);
+        const __m128i lessHi = _mm_cmplt_epi32(errorHi, bestHi);
+        bestLo = _mm_or_si128(_mm_and_si128(lessLo, errorLo), _mm_andnot_si128(lessLo, bestLo));
+        bestHi = _mm_or_si128(_mm_and_si128(lessHi, errorHi), _mm_andnot_si128(lessHi, bestHi));
+    }
+    __m128i sum = _mm_add_epi32(bestLo, bestHi);
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(sum);
+}
+
+#endif
+
+#if defined(IMAGE_SIMD_NEON)
+
+static uint32_t subBlockError_NEON(const int16_t * pixels, const int16_t * candidates)
+{
+    const int16x8_t r = vld1q_s16(pixels);
+    const int16x8_t g = vld1q_s16(pixels + 8);
+    const int16x8_t b = vld1q_s16(pixels + 16);
+    uint32x4_t bestLo = vdupq_n_u32(0xFFFFFFFF);
+    uint32x4_t bestHi = bestLo;
+    for (int m = 0; m < 4; ++m) {
+        const int16x8_t dr = vsubq_s16(r, vdupq_n_s16(candidates[3 * m]));
+        const int16x8_t dg = vsubq_s16(g, vdupq_n_s16(candidates[3 * m + 1]));
+        const int16x8_t db = vsubq_s16(b, vdupq_n_s16(candidates[3 * m + 2]));
+        int32x4_t errorLo = vmull_s16(vget_low_s16(dr), vget_low_s16(dr));
+        errorLo = vmlal_s16(errorLo, vget_low_s16(dg), vget_low_s16(dg));
+        errorLo = vmlal_s16(errorLo, vget_low_s16(db), vget_low_s16(db));
+        int32x4_t errorHi = vmull_s16(vget_high_s16(dr), vget_high_s16(dr));
+        errorHi = vmlal_s16(errorHi, vget_high_s16(dg), vget_high_s16(dg));
+        errorHi = vmlal_s16(errorHi, vget_high_s16(db), vget_high_s16(db));
+        bestLo = vminq_u32(bestLo, vreinterpretq_u32_s32(errorLo));
+        bestHi = vminq_u32(bestHi, vreinterpretq_u32_s32(errorHi));
+    }
+    const uint64x2_t sum = vpaddlq_u32(vaddq_u32(bestLo, bestHi));
+    return (uint32_t)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+}
+
+#endif
+
+static SubBlockErrorFunction getSubBlockErrorFunction(const CpuFeatures & features)
+{
+#if defined(IMAGE_SIMD_X86)
+    if (features.sse2) {
+        return subBlockError_SSE2;
+    }
+#endif
+#if defined(IMAGE_SIMD_NEON)
+    if (features.neon) {
+        return subBlockError_NEON;
+    }
+#endif
+    return subBlockError;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static inline int clamp255(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+//Expand a quantized base color to 8bit by replicating the upper bits.
+static inline void expandColor(int * base, const int * color, bool differential)
+{
+    for (int c = 0; c < 3; ++c) {
+        base[c] = differential ? ((color[c] << 3) | (color[c] >> 2)) : ((color[c] << 4) | color[c]);
+    }
+}
+
+/*!
+Find the modifier table with the smallest error for a base color.
+\return Returns the error of the best table.
+*/
+static uint32_t findTable(int & table, const int16_t * pixels, const int * base, SubBlockErrorFunction errorFunction)
+{
+    uint32_t bestError = 0xFFFFFFFF;
+    for (int t = 0; t < 8 && bestError > 0; ++t) {
+        int16_t candidates[12];
+        for (int m = 0; m < 4; ++m) {
+            for (int c = 0; c < 3; ++c) {
+                candidates[3 * m + c] = (int16_t)clamp255(base[c] + s_modifiers[t][m]);
+            }
+        }
+        const uint32_t error = errorFunction(pixels, candidates);
+        if (error < bestError) {
+            bestError = error;
+            table = t;
+        }
+    }
+    return bestError;
+}
+
+struct BlockEncoding
+{
+    uint32_t error;
+    int flip;
+    bool differential;
+    int colors[2][3]; //!< Quantized base colors of both sub-blocks. 4bit in individual mode, 5bit in differential mode.
+    int tables[2];
+};
+
+//Sub-block pixels split into components plus their average color.
+struct SubBlock
+{
+    int16_t pixels[24];
+    int average[3];
+};
+
+static void tryColors(BlockEncoding & best, const SubBlock * subBlocks, int flip, bool differential, const int colors[2][3], SubBlockErrorFunction errorFunction)
+{
+    BlockEncoding encoding;
+    encoding.error = 0;
+    encoding.flip = flip;
+    encoding.differential = differential;
+    for (int s = 0; s < 2 && encoding.error < best.error; ++s) {
+        int base[3];
+        expandColor(base, colors[s], differential);
+        encoding.error += findTable(encoding.tables[s], subBlocks[s].pixels, base, errorFunction);
+        memcpy(encoding.colors[s], colors[s], sizeof(encoding.colors[s]));
+    }
+    if (encoding.error < best.error) {
+        best = encoding;
+    }
+}
+
+//Quantize the average colors of the sub-blocks and only try those.
+static void encodeFast(BlockEncoding & best, const SubBlock * subBlocks, int flip, SubBlockErrorFunction errorFunction)
+{
+    int colors5[2][3];
+    int colors4[2][3];
+    bool fits = true;
+    for (int c = 0; c < 3; ++c) {
+        for (int s = 0; s < 2; ++s) {
+            colors5[s][c] = (subBlocks[s].average[c] * 31 + 127) / 255;
+            colors4[s][c] = (subBlocks[s].average[c] * 15 + 127) / 255;
+        }
+        const int delta = colors5[1][c] - colors5[0][c];
+        fits &= delta >= -4 && delta <= 3;
+    }
+    if (fits) {
+        tryColors(best, subBlocks, flip, true, colors5, errorFunction);
+    }
+    tryColors(best, subBlocks, flip, false, colors4, errorFunction);
+}
+
+//Try all colors around the quantized averages and pick the best combination that can be encoded.
+static void encodeQuality(BlockEncoding & best, const SubBlock * subBlocks, int flip, SubBlockErrorFunction errorFunction)
+{
+    for (int mode = 0; mode < 2; ++mode) {
+        const bool differential = mode == 0;
+        const int maxValue = differential ? 31 : 15;
+        uint32_t errors[2][ETC1_NR_OF_COLOR_CANDIDATES];
+        int tables[2][ETC1_NR_OF_COLOR_CANDIDATES];
+        int colors[2][ETC1_NR_OF_COLOR_CANDIDATES][3];
+        for (int s = 0; s < 2; ++s) {
+            for (int k = 0; k < ETC1_NR_OF_COLOR_CANDIDATES; ++k) {
+                const int offsets[3] = {k % 3 - 1, (k / 3) % 3 - 1, k / 9 - 1};
+                for (int c = 0; c < 3; ++c) {
+                    const int value = (subBlocks[s].average[c] * maxValue + 127) / 255 + offsets[c];
+                    colors[s][k][c] = value < 0 ? 0 : (value > maxValue ? maxValue : value);
+                }
+                int base[3];
+                expandColor(base, colors[s][k], differential);
+                errors[s][k] = findTable(tables[s][k], subBlocks[s].pixels, base, errorFunction);
+            }
+        }
+        //individual colors are independent, differential colors must be close enough to each other
+        int best0 = -1;
+        int best1 = -1;
+        uint32_t bestError = 0xFFFFFFFF;
+        for (int k0 = 0; k0 < ETC1_NR_OF_COLOR_CANDIDATES; ++k0) {
+            for (int k1 = 0; k1 < ETC1_NR_OF_COLOR_CANDIDATES; ++k1) {
+                bool fits = true;
+                for (int c = 0; c < 3 && differential; ++c) {
+                    const int delta = colors[1][k1][c] - colors[0][k0][c];
+                    fits &= delta >= -4 && delta <= 3;
+                }
+                if (fits && errors[0][k0] + errors[1][k1] < bestError) {
+                    bestError = errors[0][k0] + errors[1][k1];
+                    best0 = k0;
+                    best1 = k1;
+                }
+            }
+        }
+        if (best0 >= 0 && bestError < best.error) {
+            best.error = bestError;
+            best.flip = flip;
+            best.differential = differential;
+            memcpy(best.colors[0], colors[0][best0], sizeof(best.colors[0]));
+            memcpy(best.colors[1], colors[1][best1], sizeof(best.colors[1]));
+            best.tables[0] = tables[0][best0];
+            best.tables[1] = tables[1][best1];
+        }
+    }
+}
+
+static void writeBlock(uint8_t * block, const BlockEncoding & encoding, const uint32_t * pixels)
+{
+    const int (*colors)[3] = encoding.colors;
+    uint32_t high = 0;
+    if (encoding.differential) {
+        for (int c = 0; c < 3; ++c) {
+            high |= ((uint32_t)colors[0][c] << (27 - 8 * c)) | ((uint32_t)((colors[1][c] - colors[0][c]) & 7) << (24 - 8 * c));
+        }
+        high |= 2;
+    }
+    else {
+        for (int c = 0; c < 3; ++c) {
+            high |= ((uint32_t)colors[0][c] << (28 - 8 * c)) | ((uint32_t)colors[1][c] << (24 - 8 * c));
+        }
+    }
+    high |= ((uint32_t)encoding.tables[0] << 5) | ((uint32_t)encoding.tables[1] << 2) | (uint32_t)encoding.flip;
+    //pick the best modifier of every pixel. pixel indices are stored column by column, the high bits in the upper half
+    uint32_t low = 0;
+    for (int s = 0; s < 2; ++s) {
+        int base[3];
+        expandColor(base, colors[s], encoding.differential);
+        const int * modifiers = s_modifiers[encoding.tables[s]];
+        for (int i = 0; i < 8; ++i) {
+            const int p = s_subBlockPixels[encoding.flip][s][i];
+            const int pixel[3] = {(int)(pixels[p] >> 24), (int)((pixels[p] >> 16) & 0xFF), (int)((pixels[p] >> 8) & 0xFF)};
+            int bestIndex = 0;
+            int bestError = 0x7FFFFFFF;
+            for (int m = 0; m < 4; ++m) {
+                int error = 0;
+                for (int c = 0; c < 3; ++c) {
+                    const int difference = pixel[c] - clamp255(base[c] + modifiers[m]);
+                    error += difference * difference;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    bestIndex = m;
+                }
+            }
+            const int bit = (p & 3) * 4 + (p >> 2);
+            low |= ((uint32_t)(bestIndex >> 1) << (16 + bit)) | ((uint32_t)(bestIndex & 1) << bit);
+        }
+    }
+    //blocks are big-endian
+    for (int i = 0; i < 4; ++i) {
+        block[i] = (uint8_t)(high >> (24 - 8 * i));
+        block[4 + i] = (uint8_t)(low >> (24 - 8 * i));
+    }
+}
+
+static void encodeBlock(uint8_t * block, const uint32_t * pixels, Image::CompressionQuality quality, SubBlockErrorFunction errorFunction)
+{
+    BlockEncoding best;
+    best.error = 0xFFFFFFFF;
+    for (int flip = 0; flip < 2 && best.error > 0; ++flip) {
+        SubBlock subBlocks[2];
+        for (int s = 0; s < 2; ++s) {
+            int sums[3] = {0, 0, 0};
+            for (int i = 0; i < 8; ++i) {
+                const uint32_t pixel = pixels[s_subBlockPixels[flip][s][i]];
+                for (int c = 0; c < 3; ++c) {
+                    const int value = (int)((pixel >> (24 - 8 * c)) & 0xFF);
+                    subBlocks[s].pixels[8 * c + i] = (int16_t)value;
+                    sums[c] += value;
+                }
+            }
+            for (int c = 0; c < 3; ++c) {
+                subBlocks[s].average[c] = (sums[c] + 4) / 8;
+            }
+        }
+        if (quality == Image::COMPRESS_QUALITY) {
+            encodeQuality(best, subBlocks, flip, errorFunction);
+        }
+        else {
+            encodeFast(best, subBlocks, flip, errorFunction);
+        }
+    }
+    writeBlock(block, best, pixels);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+void encodeETC1Block(uint8_t * block, const uint32_t * pixels, Image::CompressionQuality quality, const CpuFeatures & features)
+{
+    encodeBlock(block, pixels, quality, getSubBlockErrorFunction(features));
+}
+
+void decodeETC1Block(uint32_t * pixels, const uint8_t * block)
+{
+    const uint32_t high = ((uint32_t)block[0] << 24) | ((uint32_t)block[1] << 16) | ((uint32_t)block[2] << 8) | block[3];
+    const uint32_t low = ((uint32_t)block[4] << 24) | ((uint32_t)block[5] << 16) | ((uint32_t)block[6] << 8) | block[7];
+    const int flip = high & 1;
+    const bool differential = (high & 2) != 0;
+    int bases[2][3];
+    for (int c = 0; c < 3; ++c) {
+        if (differential) {
+            const int color = (high >> (27 - 8 * c)) & 31;
+            const int delta = (high >> (24 - 8 * c)) & 7;
+            const int colors[2] = {color, (color + (delta >= 4 ? delta - 8 : delta)) & 31};
+            bases[0][c] = (colors[0] << 3) | (colors[0] >> 2);
+            bases[1][c] = (colors[1] << 3) | (colors[1] >> 2);
+        }
+        else {
+            bases[0][c] = ((high >> (28 - 8 * c)) & 15) * 17;
+            bases[1][c] = ((high >> (24 - 8 * c)) & 15) * 17;
+        }
+    }
+    const int tables[2] = {(int)((high >> 5) & 7), (int)((high >> 2) & 7)};
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            const int s = flip ? (y >> 1) : (x >> 1);
+            const int bit = x * 4 + y;
+            const int index = (((low >> (16 + bit)) & 1) << 1) | ((low >> bit) & 1);
+            const int modifier = s_modifiers[tables[s]][index];
+            pixels[y * 4 + x] = ((uint32_t)clamp255(bases[s][0] + modifier) << 24) | ((uint32_t)clamp255(bases[s][1] + modifier) << 16) | ((uint32_t)clamp255(bases[s][2] + modifier) << 8) | 0xFF;
+        }
+    }
+}
+
+void encodeETC1(uint8_t * dest, const ConstImageView & source, Image::CompressionQuality quality)
+{
+    encodeETC1(dest, source, quality, CpuFeatures::detected());
+}
+
+void encodeETC1(uint8_t * dest, const ConstImageView & source, Image::CompressionQuality quality, const CpuFeatures & features)
+{
+    if (dest == nullptr || source.data == nullptr || source.width == 0 || source.height == 0) {
+        throw ImageException("encodeETC1() - Invalid image data!");
+    }
+    if (!PixelInfo::isDirectColor(source.formatType)) {
+        throw ImageException("encodeETC1() - Invalid image format!");
+    }
+    const SubBlockErrorFunction errorFunction = getSubBlockErrorFunction(features);
+    const size_t blocksX = (source.width + 3) / 4;
+    const size_t blocksY = (source.height + 3) / 4;
+    const size_t rowLength = blocksX * 4;
+#pragma omp parallel
+    {
+        //every thread converts the 4 rows of a block row to R8G8B8A8 and repeats the edge pixels in partial blocks
+        uint32_t * rows = (uint32_t *)PixelAllocator::allocate(4 * rowLength * sizeof(uint32_t));
+#pragma omp for schedule(dynamic)
+        for (int by = 0; by < (int)blocksY; ++by) {
+            for (size_t r = 0; r < 4; ++r) {
+                const size_t y = (by * 4 + r) < source.height ? (by * 4 + r) : (source.height - 1);
+                uint32_t * row = rows + r * rowLength;
+                convertFormat((uint8_t *)row, nullptr, PixelInfo::R8G8B8A8, source.row(y), nullptr, source.formatType, source.width);
+                for (size_t x = source.width; x < rowLength; ++x) {
+                    row[x] = row[source.width - 1];
+                }
+            }
+            for (size_t bx = 0; bx < blocksX; ++bx) {
+                uint32_t pixels[16];
+                for (size_t r = 0; r < 4; ++r) {
+                    memcpy(pixels + r * 4, rows + r * rowLength + bx * 4, 4 * sizeof(uint32_t));
+                }
+                encodeBlock(dest + (by * blocksX + bx) * 8, pixels, quality, errorFunction);
+            }
+        }
+        PixelAllocator::release((uint8_t *)rows);
+    }
+}
+
+void decodeETC1(const ImageView & dest, const uint8_t * source)
+{
+    if (source == nullptr || dest.data == nullptr || dest.width == 0 || dest.height == 0) {
+        throw ImageException("decodeETC1() - Invalid image data!");
+    }
+    if (!PixelInfo::isDirectColor(dest.formatType)) {
+        throw ImageException("decodeETC1() - Invalid image format!");
+    }
+    const size_t blocksX = (dest.width + 3) / 4;
+    const size_t blocksY = (dest.height + 3) / 4;
+    const size_t rowLength = blocksX * 4;
+#pragma omp parallel
+    {
+        uint32_t * rows = (uint32_t *)PixelAllocator::allocate(4 * rowLength * sizeof(uint32_t));
+#pragma omp for
+        for (int by = 0; by < (int)blocksY; ++by) {
+            for (size_t bx = 0; bx < blocksX; ++bx) {
+                uint32_t pixels[16];
+                decodeETC1Block(pixels, source + (by * blocksX + bx) * 8);
+                for (size_t r = 0; r < 4; ++r) {
+                    memcpy(rows + r * rowLength + bx * 4, pixels + r * 4, 4 * sizeof(uint32_t));
+                }
+            }
+            //convert the rows inside the image to the destination format
+            for (size_t r = 0; r < 4 && (by * 4 + r) < dest.height; ++r) {
+                convertFormat(dest.row(by * 4 + r), nullptr, dest.formatType, (const uint8_t *)(rows + r * rowLength), nullptr, PixelInfo::R8G8B8A8, dest.width);
+            }
+        }
+        PixelAllocator::release((uint8_t *)rows);
+    }
+}
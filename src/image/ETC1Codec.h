@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Image.h"
+#include "CpuFeatures.h"
+
+
+/*!
+Encoder and decoder for ETC1 (Ericsson Texture Compression), the baseline compressed texture format of OpenGL ES 2.0 (OES_compressed_ETC1_RGB8_texture).
+Every 4x4 pixel block is stored in 64 bits: two 4x2 or 2x4 sub-blocks with a base color each, a table of intensity modifiers and a 2bit modifier index per pixel.
+RGB data is compressed 6:1, RGBA 8:1. Alpha is dropped.
+Blocks are encoded and decoded in parallel. The error of candidate encodings is calculated with SSE2 or NEON if available.
+*/
+
+/*!
+Encode one 4x4 block.
+\param[in] block Receives the 8 bytes of the block.
+\param[in] pixels 16 R8G8B8A8 pixels in row order.
+\param[in] quality How hard the encoder searches for the best encoding.
+\param[in] features CPU features the encoder may use.
+*/
+void encodeETC1Block(uint8_t * block, const uint32_t * pixels, Image::CompressionQuality quality, const CpuFeatures & features);
+
+/*!
+Decode one 4x4 block.
+\param[in] pixels Receives 16 R8G8B8A8 pixels in row order. Alpha is always 255.
+\param[in] block The 8 bytes of the block.
+*/
+void decodeETC1Block(uint32_t * pixels, const uint8_t * block);
+
+/*!
+Encode a view to ETC1 blocks. Partial blocks at the right and bottom edge are padded by repeating the edge pixels.
+\param[in] dest Output data. Must have PixelInfo::dataSize(ETC1_R8G8B8, width, height) bytes.
+\param[in] source Input view. Palette and compressed formats are not supported.
+\param[in] quality Optional. How hard the encoder searches for the best encoding.
+\note Throws an ImageException if the view is invalid.
+*/
+void encodeETC1(uint8_t * dest, const ConstImageView & source, Image::CompressionQuality quality = Image::COMPRESS_FAST);
+
+/*!
+Encode a view to ETC1 blocks using only some CPU features. The result does not depend on the features, use this to test the SIMD code.
+*/
+void encodeETC1(uint8_t * dest, const ConstImageView & source, Image::CompressionQuality quality, const CpuFeatures & features);
+
+/*!
+Decode ETC1 blocks to a view.
+\param[in] dest Output view. Its size is the size of the image. Palette and compressed formats are not supported.
+\param[in] source ETC1 data of the image.
+\note Throws an ImageException if the view is invalid.
+*/
+void decodeETC1(const ImageView & dest, const uint8_t * source);
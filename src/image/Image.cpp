@@ -1,37 +1,182 @@
 #include "Image.h"
+#include "MappedFile.h"
+#include "PixelAllocator.h"
+#include "SummedAreaTable.h"
+#include "PixelFormatSIMD.h"
+#include "ResampleStream.h"
+#include "ETC1Codec.h"
+#include "S3TCCodec.h"
+#include "ImageStatistics.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <FreeImage.h>
 
 
+//Raw image container. Header, palette, padding to 16 bytes, pixel data. All values are little-endian.
+#define RAW_IMAGE_MAGIC "RIMG"
+#define RAW_IMAGE_VERSION 2
+#define RAW_IMAGE_FLAG_PREMULTIPLIED 0x1 //!< Color components are premultiplied with alpha.
+
+struct RawImageHeader
+{
+    char magic[4]; //!< Always RAW_IMAGE_MAGIC.
+    uint32_t version; //!< Container version.
+    uint32_t width; //!< Width of image.
+    uint32_t height; //!< Height of image.
+    uint32_t formatType; //!< PixelInfo::FormatType of pixel data.
+    uint32_t paletteSize; //!< Size of palette in bytes. It directly follows the header.
+    uint32_t dataOffset; //!< Offset of pixel data from start of header. Aligned to 16 bytes.
+    uint32_t dataSize; //!< Size of pixel data in bytes.
+    uint32_t flags; //!< RAW_IMAGE_FLAG_* values.
+    uint32_t reserved[3]; //!< Always 0. Keeps the header 16 bytes aligned.
+};
+
+static bool checkRawHeader(const RawImageHeader & header, size_t size)
+{
+    if (header.version != RAW_IMAGE_VERSION || header.width == 0 || header.height == 0) {
+        return false;
+    }
+    if (header.formatType <= PixelInfo::BAD_FORMAT || header.formatType >= PixelInfo::MAX_FORMAT) {
+        return false;
+    }
+    const PixelInfo & info = PixelInfo::pixelInfo((PixelInfo::FormatType)header.formatType);
+    if (header.dataSize != PixelInfo::dataSize((PixelInfo::FormatType)header.formatType, header.width, header.height) || (header.paletteSize != 0 && header.paletteSize != info.paletteEntries * 4)) {
+        return false;
+    }
+    return header.dataOffset >= sizeof(RawImageHeader) + header.paletteSize && (size_t)header.dataOffset + header.dataSize <= size;
+}
+
+
+static PixelInfo::FormatType bitmapFormatType(FIBITMAP * fiBitmap);
+static PixelInfo::FormatType targetFormatType(PixelInfo::FormatType fileFormatType, PixelInfo::FormatType formatType);
+static void copyBitmap(uint8_t * data, uint8_t * palette, PixelInfo::FormatType formatType, Image::Orientation orientation, FIBITMAP * fiBitmap, PixelInfo::FormatType fileFormatType, size_t width, size_t height);
+
+//File of a lazily loaded image. Only its header has been read so far.
+struct LazyDecode
+{
+    std::string path;
+    FREE_IMAGE_FORMAT fif;
+    PixelInfo::FormatType fileFormatType; //!< Format the header promised.
+    PixelInfo::FormatType formatType; //!< Format the pixels are converted to while decoding.
+    Image::Orientation orientation;
+    size_t width;
+    size_t height;
+    std::mutex mutex; //!< Held while decoding, so only one thread decodes.
+    std::atomic<bool> decoded;
+    std::shared_future<void> prefetched; //!< Ready when a prefetch thread has released its reference to the storage. Not valid without prefetching.
+
+    LazyDecode(const std::string & p, FREE_IMAGE_FORMAT f, PixelInfo::FormatType fileFormat, PixelInfo::FormatType format, Image::Orientation o, size_t w, size_t h)
+        : path(p), fif(f), fileFormatType(fileFormat), formatType(format), orientation(o), width(w), height(h), decoded(false) {}
+};
+
+//Pixel and palette data shared between copies of an image. Images only write to it while they hold the only reference.
+struct PixelStorage
+{
+    uint8_t * data;
+    uint8_t * palette; //!< Palette data in R8G8B8A8 format.
+    size_t capacity; //!< Size of data in bytes. 0 if the data is not owned by the storage.
+    bool foreign; //!< If true, data and palette were passed in with takeOwnership and are freed with delete[].
+    std::shared_ptr<MappedFile> mapping; //!< If set, data and palette point into this mapped file and are not freed.
+    std::unique_ptr<LazyDecode> lazy; //!< If set, data and palette are decoded from this file on first access.
+
+    PixelStorage() : data(nullptr), palette(nullptr), capacity(0), foreign(false) {}
+
+    //Decode the file of a lazily loaded image, if that has not happened yet. This can be called from multiple threads.
+    void decode()
+    {
+        if (lazy == nullptr || lazy->decoded) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(lazy->mutex);
+        if (!lazy->decoded) {
+            FIBITMAP * fiBitmap = FreeImage_Load(lazy->fif, lazy->path.c_str());
+            if (fiBitmap == nullptr) {
+                throw ImageException("Image::decode() - Failed to load image!");
+            }
+            //the file might have changed since its header was read
+            if (bitmapFormatType(fiBitmap) != lazy->fileFormatType || FreeImage_GetWidth(fiBitmap) != lazy->width || FreeImage_GetHeight(fiBitmap) != lazy->height) {
+                FreeImage_Unload(fiBitmap);
+                throw ImageException("Image::decode() - Image file has changed!");
+            }
+            const PixelInfo & info = PixelInfo::pixelInfo(lazy->formatType);
+            capacity = lazy->width * lazy->height * info.bytesPerPixel;
+            data = PixelAllocator::allocate(capacity);
+            if (info.paletteEntries > 0) {
+                palette = PixelAllocator::allocate(info.paletteEntries * 4);
+            }
+            copyBitmap(data, palette, lazy->formatType, lazy->orientation, fiBitmap, lazy->fileFormatType, lazy->width, lazy->height);
+            FreeImage_Unload(fiBitmap);
+            lazy->decoded = true;
+        }
+    }
+
+    ~PixelStorage()
+    {
+        //mapped data is released when the last image using the mapping is gone
+        if (mapping == nullptr) {
+            if (foreign) {
+                delete [] data;
+                delete [] palette;
+            }
+            else {
+                PixelAllocator::release(data);
+                PixelAllocator::release(palette);
+            }
+        }
+    }
+
+private:
+    PixelStorage(const PixelStorage & b);
+    PixelStorage & operator=(const PixelStorage & b);
+};
+
+
+//Decode a lazily loaded image on a background thread. The reference to the storage is dropped before released is signaled.
+static void prefetchStorage(std::shared_ptr<PixelStorage> storage, std::promise<void> released)
+{
+    try {
+        storage->decode();
+    }
+    catch (...) {
+    }
+    storage.reset();
+    released.set_value();
+}
+
 Image::Image(size_t width, size_t height, PixelInfo::FormatType formatType, uint8_t * source, uint8_t * palette, bool takeOwnership)
-    : m_width(width)
+    : m_data(nullptr)
+    , m_palette(nullptr)
+    , m_width(width)
     , m_height(height)
     , m_formatType(formatType)
-    , m_data(nullptr)
-    , m_palette(nullptr)
-    , m_resampler(formatType)
+    , m_premultiplied(false)
 {
     if (source == nullptr) {
         //if we have a width given, allocate memory
         if (width > 0 && height > 0 && formatType != PixelInfo::BAD_FORMAT) {
-            m_data = new uint8_t[width * height * PixelInfo::pixelInfo(m_formatType).bytesPerPixel];
-            if (PixelInfo::pixelInfo(m_formatType).paletteEntries > 0) {
-                m_palette = new uint8_t[PixelInfo::pixelInfo(m_formatType).paletteEntries * 4];
-            }
+            allocate(width, height);
         }
     }
     else {
         if (takeOwnership) {
+            m_storage = std::make_shared<PixelStorage>();
+            m_storage->data = source;
+            m_storage->palette = palette;
+            m_storage->capacity = PixelInfo::dataSize(m_formatType, width, height);
+            m_storage->foreign = true;
             m_data = source;
             m_palette = palette;
         }
         else if (width > 0 && height > 0 && formatType != PixelInfo::BAD_FORMAT) {
-            m_data = new uint8_t[width * height * PixelInfo::pixelInfo(m_formatType).bytesPerPixel];
-            memcpy(m_data, source, width * height * PixelInfo::pixelInfo(m_formatType).bytesPerPixel); 
-            if (PixelInfo::pixelInfo(m_formatType).paletteEntries > 0) {
-                m_palette = new uint8_t[PixelInfo::pixelInfo(m_formatType).paletteEntries * 4];
+            allocate(width, height);
+            memcpy(m_data, source, PixelInfo::dataSize(m_formatType, width, height));
+            if (m_palette != nullptr && palette != nullptr) {
                 memcpy(m_palette, palette, PixelInfo::pixelInfo(m_formatType).paletteEntries * 4);
             }
         }
@@ -39,12 +184,12 @@ Image::Image(size_t width, size_t height, PixelInfo::FormatType formatType, uint
 }
 
 Image::Image(size_t width, size_t height, PixelInfo::FormatType formatType, const uint8_t * source, uint8_t * palette, PixelInfo::FormatType sourceType)
-    : m_width(width)
+    : m_data(nullptr)
+    , m_palette(nullptr)
+    , m_width(width)
     , m_height(height)
     , m_formatType(formatType)
-    , m_data(nullptr)
-    , m_palette(nullptr)
-    , m_resampler(formatType)
+    , m_premultiplied(false)
 {   
     if (formatType == PixelInfo::BAD_FORMAT) {
         throw ImageException("Image::Image() - Invalid image format!");
@@ -53,10 +198,7 @@ Image::Image(size_t width, size_t height, PixelInfo::FormatType formatType, cons
         throw ImageException("Image::Image() - Invalid source image format!");
     }
     if (width > 0 && height > 0 && formatType != PixelInfo::BAD_FORMAT) {
-        m_data = new uint8_t[width * height * PixelInfo::pixelInfo(m_formatType).bytesPerPixel];
-        if (PixelInfo::pixelInfo(m_formatType).paletteEntries > 0) {
-            m_palette = new uint8_t[PixelInfo::pixelInfo(m_formatType).paletteEntries * 4];
-        }
+        allocate(width, height);
         if (source != nullptr && sourceType != PixelInfo::BAD_FORMAT) {
             convertFormat(m_data, m_palette, m_formatType, source, palette, sourceType, width * height);
         }
@@ -64,14 +206,179 @@ Image::Image(size_t width, size_t height, PixelInfo::FormatType formatType, cons
 }
 
 Image::Image(const Image & source)
-    : m_width(0)
-    , m_height(0)
-    , m_formatType(PixelInfo::BAD_FORMAT)
-    , m_data(nullptr)
+    : m_data(source.m_data)
+    , m_palette(source.m_palette)
+    , m_width(source.m_width)
+    , m_height(source.m_height)
+    , m_formatType(source.m_formatType)
+    , m_premultiplied(source.m_premultiplied)
+    , m_storage(source.m_storage)
+{
+}
+
+Image::Image(Image && source)
+    : m_data(source.m_data)
+    , m_palette(source.m_palette)
+    , m_width(source.m_width)
+    , m_height(source.m_height)
+    , m_formatType(source.m_formatType)
+    , m_premultiplied(source.m_premultiplied)
+    , m_storage(std::move(source.m_storage))
+{
+    //leave source empty, but keep its format
+    source.m_data = nullptr;
+    source.m_palette = nullptr;
+    source.m_width = 0;
+    source.m_height = 0;
+}
+
+Image::Image(const ConstImageView & source)
+    : m_data(nullptr)
     , m_palette(nullptr)
-    , m_resampler(PixelInfo::BAD_FORMAT)
+    , m_width(0)
+    , m_height(0)
+    , m_formatType(source.formatType)
+    , m_premultiplied(false)
+{
+    if (source.width <= 0 || source.height <= 0 || source.data == nullptr) {
+        throw ImageException("Image::Image() - Invalid image view!");
+    }
+    else if (source.formatType == PixelInfo::BAD_FORMAT) {
+        throw ImageException("Image::Image() - Invalid image format!");
+    }
+    allocate(source.width, source.height);
+    //views have no palette, so start with an empty one
+    if (m_palette != nullptr) {
+        memset(m_palette, 0, PixelInfo::pixelInfo(m_formatType).paletteEntries * 4);
+    }
+    copyPixels(view(), source);
+}
+
+void Image::allocate(size_t width, size_t height)
+{
+    const PixelInfo & info = PixelInfo::pixelInfo(m_formatType);
+    const size_t dataSize = PixelInfo::dataSize(m_formatType, width, height);
+    //keep the current buffer if nobody else uses it and it is big enough. mapped or adopted data is not ours to resize though
+    if (m_storage == nullptr || m_storage.use_count() > 1 || m_storage->mapping != nullptr || m_storage->foreign || dataSize > m_storage->capacity) {
+        std::shared_ptr<PixelStorage> storage = std::make_shared<PixelStorage>();
+        storage->data = PixelAllocator::allocate(dataSize);
+        storage->capacity = dataSize;
+        m_storage = storage;
+    }
+    if (info.paletteEntries > 0 && m_storage->palette == nullptr) {
+        m_storage->palette = PixelAllocator::allocate(info.paletteEntries * 4);
+    }
+    else if (info.paletteEntries == 0 && m_storage->palette != nullptr) {
+        PixelAllocator::release(m_storage->palette);
+        m_storage->palette = nullptr;
+    }
+    m_data = m_storage->data;
+    m_palette = m_storage->palette;
+    m_width = width;
+    m_height = height;
+}
+
+void Image::detach()
+{
+    //lazily loaded images are decoded first. the decoded data is shared by all copies
+    if (m_data == nullptr && m_storage != nullptr && m_storage->lazy != nullptr) {
+        m_storage->decode();
+        m_data = m_storage->data;
+        m_palette = m_storage->palette;
+        //the reference of a prefetch thread must not count as a copy, so wait until it is gone
+        const std::shared_future<void> prefetched = m_storage->lazy->prefetched;
+        if (prefetched.valid()) {
+            prefetched.wait();
+        }
+    }
+    //make a private copy if the data is shared with other images or a mapped file
+    if (m_storage != nullptr && (m_storage.use_count() > 1 || m_storage->mapping != nullptr)) {
+        const PixelInfo & info = PixelInfo::pixelInfo(m_formatType);
+        const size_t dataSize = PixelInfo::dataSize(m_formatType, m_width, m_height);
+        std::shared_ptr<PixelStorage> storage = std::make_shared<PixelStorage>();
+        storage->data = PixelAllocator::allocate(dataSize);
+        storage->capacity = dataSize;
+        memcpy(storage->data, m_data, dataSize);
+        if (m_palette != nullptr) {
+            storage->palette = PixelAllocator::allocate(info.paletteEntries * 4);
+            memcpy(storage->palette, m_palette, info.paletteEntries * 4);
+        }
+        m_storage = storage;
+        m_data = m_storage->data;
+        m_palette = m_storage->palette;
+    }
+}
+
+const uint8_t * Image::pixels() const
+{
+    //lazily loaded images are decoded on first access. this does not touch our members, so it is safe to call from multiple threads
+    if (m_data == nullptr && m_storage != nullptr && m_storage->lazy != nullptr) {
+        m_storage->decode();
+        return m_storage->data;
+    }
+    return m_data;
+}
+
+uint8_t * Image::pixels()
 {
-    *this = source;
+    detach();
+    return m_data;
+}
+
+const uint8_t * Image::palette() const
+{
+    if (m_data == nullptr && m_storage != nullptr && m_storage->lazy != nullptr) {
+        m_storage->decode();
+        return m_storage->palette;
+    }
+    return m_palette;
+}
+
+uint8_t * Image::palette()
+{
+    detach();
+    return m_palette;
+}
+
+ConstImageView Image::view() const
+{
+    return ConstImageView(pixels(), m_width, m_height, m_formatType);
+}
+
+ImageView Image::view()
+{
+    detach();
+    return ImageView(m_data, m_width, m_height, m_formatType);
+}
+
+bool Image::isDecoded() const
+{
+    return m_storage == nullptr || m_storage->lazy == nullptr || m_storage->lazy->decoded;
+}
+
+bool Image::isMapped() const
+{
+    return m_storage != nullptr && m_storage->mapping != nullptr;
+}
+
+size_t Image::capacity() const
+{
+    return m_storage != nullptr ? m_storage->capacity : 0;
+}
+
+void Image::resize(size_t width, size_t height, PixelInfo::FormatType formatType)
+{
+    if (width <= 0 || height <= 0) {
+        throw ImageException("Image::resize() - Invalid image dimensions!");
+    }
+    if (formatType != PixelInfo::BAD_FORMAT) {
+        m_formatType = formatType;
+    }
+    else if (m_formatType == PixelInfo::BAD_FORMAT) {
+        throw ImageException("Image::resize() - Invalid image format!");
+    }
+    m_premultiplied = false;
+    allocate(width, height);
 }
 
 void Image::copyToInternal(size_t width, size_t height, const uint8_t * source, const uint8_t * palette, PixelInfo::FormatType sourceType)
@@ -85,48 +392,105 @@ void Image::copyToInternal(size_t width, size_t height, const uint8_t * source,
     else if (source == nullptr) {
         throw ImageException("Image::copyToInternal() - Invalid image data!");
     }
-    if (m_width != width || m_height != height) {
-        m_width = width;
-        m_height = height;
-        if (m_data != nullptr) {
-            delete [] m_data;
-            m_data = nullptr;
-        }
-        if (m_palette != nullptr) {
-            delete [] m_palette;
-            m_palette = nullptr;
-        }
-        //if our internal image format is bad we can use the source format as it doesn't matter
-        if (m_formatType == PixelInfo::BAD_FORMAT) {
-            m_formatType = sourceType;
-        }
-        if (width > 0 && height > 0 && m_formatType != PixelInfo::BAD_FORMAT) {
-            m_data = new uint8_t[m_width * m_height * PixelInfo::pixelInfo(m_formatType).bytesPerPixel];
-            if (PixelInfo::pixelInfo(m_formatType).paletteEntries > 0) {
-                m_palette = new uint8_t[PixelInfo::pixelInfo(m_formatType).paletteEntries * 4];
-            }
-        }
+    //if our internal image format is bad we can use the source format as it doesn't matter
+    if (m_formatType == PixelInfo::BAD_FORMAT) {
+        m_formatType = sourceType;
     }
+    //this only reallocates if the current buffer is shared or too small
+    allocate(width, height);
     convertFormat(m_data, m_palette, m_formatType, source, palette, sourceType, width * height);
+    if (sourceType == m_formatType && palette != nullptr && m_palette != nullptr) {
+        memcpy(m_palette, palette, PixelInfo::pixelInfo(m_formatType).paletteEntries * 4);
+    }
 }
 
 Image & Image::operator=(const Image & source)
 {
-    copyToInternal(source.width(), source.height(), source.pixels(), source.palette(), source.formatType());
+    if (this != &source) {
+        if (m_formatType == PixelInfo::BAD_FORMAT || m_formatType == source.m_formatType) {
+            //no conversion needed. share the data, it is copied when one of the images is modified
+            m_formatType = source.m_formatType;
+            m_storage = source.m_storage;
+            m_data = source.m_data;
+            m_palette = source.m_palette;
+            m_width = source.m_width;
+            m_height = source.m_height;
+        }
+        else {
+            copyToInternal(source.width(), source.height(), source.pixels(), source.palette(), source.formatType());
+        }
+        m_premultiplied = source.m_premultiplied;
+    }
+    return *this;
+}
+
+Image & Image::operator=(Image && source)
+{
+    if (this != &source) {
+        m_width = source.m_width;
+        m_height = source.m_height;
+        m_formatType = source.m_formatType;
+        m_premultiplied = source.m_premultiplied;
+        m_data = source.m_data;
+        m_palette = source.m_palette;
+        m_storage = std::move(source.m_storage);
+        source.m_data = nullptr;
+        source.m_palette = nullptr;
+        source.m_width = 0;
+        source.m_height = 0;
+    }
     return *this;
 }
 
 Image::~Image()
 {
-    delete [] m_data;
 }
 
+void Image::freeData()
+{
+    //the data is released when the last image using it is gone
+    m_storage.reset();
+    m_data = nullptr;
+    m_palette = nullptr;
+    m_premultiplied = false;
+}
 
-Image Image::scaled(size_t width, size_t height, Image::AspectRatioMode aspectMode, const ResampleFilter & filter) const
+Image Image::scaled(size_t width, size_t height, Image::AspectRatioMode aspectMode, const ResampleFilter & filter, bool filterPremultiplied) const
+{
+    return scaled(width, height, m_formatType, aspectMode, filter, filterPremultiplied);
+}
+
+Image Image::scaled(size_t width, size_t height, PixelInfo::FormatType formatType, Image::AspectRatioMode aspectMode, const ResampleFilter & filter, bool filterPremultiplied) const
 {
     if (width <= 0 || height <= 0) {
         throw ImageException("Image::scaled() - Invalid image dimensions!");
     }
+    adjustToAspect(width, height, aspectMode);
+    //create empty destination image
+    Image destImage(width, height, formatType);
+    //scale and convert image and return it. the plan uses a scratch buffer of the calling thread, so this can be called from multiple threads
+    //premultiplied images are filtered as they are
+    const ResamplePlan plan(m_formatType, m_width, m_height, width, height, filter, true, formatType, filterPremultiplied && !m_premultiplied);
+    plan.execute(destImage.view(), view());
+    destImage.m_premultiplied = m_premultiplied;
+    return destImage;
+}
+
+Image Image::scaledArea(size_t width, size_t height, Image::AspectRatioMode aspectMode, size_t nrOfBoxes) const
+{
+    if (width <= 0 || height <= 0) {
+        throw ImageException("Image::scaledArea() - Invalid image dimensions!");
+    }
+    adjustToAspect(width, height, aspectMode);
+    Image destImage(width, height, m_formatType);
+    destImage.m_premultiplied = m_premultiplied;
+    const SummedAreaTable table(view());
+    table.scale(destImage.view(), nrOfBoxes);
+    return destImage;
+}
+
+void Image::adjustToAspect(size_t & width, size_t & height, Image::AspectRatioMode aspectMode) const
+{
     //calculate scale ratios
     const float scaleW = (float)m_width / (float)width;
     const float scaleH = (float)m_height / (float)height;
@@ -144,29 +508,105 @@ Image Image::scaled(size_t width, size_t height, Image::AspectRatioMode aspectMo
             width = (size_t)((float)m_width / scaleH);
         }
     }
-    //create empty destination image
-    Image destImage(width, height, m_formatType);
-    //scale image and return it
-    m_resampler.scaleImage(destImage.pixels(), width, height, m_data, m_width, m_height, filter);
-    return destImage;
 }
 
-void Image::scaleTo(Image & destImage, const ResampleFilter & filter) const
+void Image::scaleTo(Image & destImage, const ResampleFilter & filter, bool filterPremultiplied) const
 {
     if (destImage.width() <= 0 || destImage.height() <= 0) {
         throw ImageException("Image::scaleTo() - Invalid image dimensions!");
     }
-    else if (destImage.formatType() != m_formatType) {
-        throw ImageException("Image::scaleTo() - Image format types must match!");
+    else if (destImage.formatType() == PixelInfo::BAD_FORMAT) {
+        throw ImageException("Image::scaleTo() - Invalid image format!");
+    }
+    scaleTo(destImage, ResamplePlan(m_formatType, m_width, m_height, destImage.width(), destImage.height(), filter, true, destImage.formatType(), filterPremultiplied && !m_premultiplied));
+}
+
+void Image::scaleTo(Image & destImage, const ResamplePlan & plan) const
+{
+    if (destImage.width() != plan.destWidth() || destImage.height() != plan.destHeight() || m_width != plan.srcWidth() || m_height != plan.srcHeight()) {
+        throw ImageException("Image::scaleTo() - Image dimensions do not match plan!");
+    }
+    else if (destImage.formatType() != plan.destFormatType() || plan.formatType() != m_formatType) {
+        throw ImageException("Image::scaleTo() - Image format types do not match plan!");
     }
+    else if (m_premultiplied && plan.filterPremultiplied()) {
+        throw ImageException("Image::scaleTo() - Image is premultiplied already!");
+    }
+    //make sure destImage has a buffer of its own. the content is overwritten anyway, so it does not need to be copied
+    destImage.allocate(destImage.m_width, destImage.m_height);
     //scale image using destImage data pointer
-    m_resampler.scaleImage(destImage.pixels(), destImage.width(), destImage.height(), m_data, m_width, m_height, filter);
+    plan.execute(ImageView(destImage.m_data, destImage.m_width, destImage.m_height, destImage.m_formatType), view());
+    destImage.m_premultiplied = m_premultiplied;
+}
+
+std::vector<Image> Image::generateMipChain(const ResampleFilter & filter, bool filterPremultiplied) const
+{
+    if (m_width <= 0 || m_height <= 0 || pixels() == nullptr) {
+        throw ImageException("Image::generateMipChain() - Invalid image dimensions!");
+    }
+    else if (m_formatType == PixelInfo::BAD_FORMAT || PixelInfo::pixelInfo(m_formatType).compressed) {
+        throw ImageException("Image::generateMipChain() - Invalid image format!");
+    }
+    else if (PixelInfo::pixelInfo(m_formatType).paletteEntries > 0) {
+        //averaging palette indices gives random colors. load paletted files into a color format instead
+        throw ImageException("Image::generateMipChain() - Palette formats are not supported!");
+    }
+    if (filterPremultiplied && !m_premultiplied && supportsPremultipliedAlpha(m_formatType)) {
+        //premultiply once and build all levels from that. level 0 stays the original image, all others are converted back
+        Image premultiplied(*this);
+        premultiplied.premultiplyAlpha();
+        std::vector<Image> levels = premultiplied.generateMipChain(filter);
+        levels[0] = *this;
+        for (size_t level = 1; level < levels.size(); ++level) {
+            levels[level].unpremultiplyAlpha();
+        }
+        return levels;
+    }
+    //count levels down to 1x1
+    size_t nrOfLevels = 1;
+    for (size_t width = m_width, height = m_height; width > 1 || height > 1; ++nrOfLevels) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    //reserve space, so the images are never copied when adding levels
+    std::vector<Image> levels;
+    levels.reserve(nrOfLevels);
+    //level 0 shares the data with this image
+    levels.emplace_back(*this);
+    const size_t bytesPerPixel = PixelInfo::pixelInfo(m_formatType).bytesPerPixel;
+    ImageResample resampler(m_formatType);
+    for (size_t level = 1; level < nrOfLevels; ++level) {
+        const size_t width = levels.back().width() > 1 ? levels.back().width() / 2 : 1;
+        const size_t height = levels.back().height() > 1 ? levels.back().height() / 2 : 1;
+        levels.emplace_back(width, height, m_formatType);
+        levels.back().m_premultiplied = m_premultiplied;
+        const Image & srcImage = levels[level - 1];
+        Image & destImage = levels[level];
+        //check if we can halve the image exactly
+        if (srcImage.width() == 2 * width && srcImage.height() == 2 * height && ImageResample::supportsFixedPoint(m_formatType)) {
+            const size_t srcStride = srcImage.width() * bytesPerPixel;
+            const size_t destStride = width * bytesPerPixel;
+            const uint8_t * src = srcImage.pixels();
+            uint8_t * dest = destImage.pixels();
+            //every thread gets a band of rows
+#pragma omp parallel for schedule(static)
+            for (int y = 0; y < (int)height; ++y) {
+                downsampleBox2x2(dest + y * destStride, width, src + 2 * y * srcStride, srcStride, bytesPerPixel);
+            }
+        }
+        else {
+            //odd size or format with non-8bit components. use regular resampling
+            resampler.scaleImage(destImage.pixels(), width, height, srcImage.pixels(), srcImage.width(), srcImage.height(), filter);
+        }
+    }
+    return levels;
 }
 
 void Image::flipVertical()
 {
+    detach();
     //buffer for swapping
-    uint8_t * lineBuffer = new uint8_t[m_width * PixelInfo::pixelInfo(m_formatType).bytesPerPixel];
+    uint8_t * lineBuffer = PixelAllocator::allocate(m_width * PixelInfo::pixelInfo(m_formatType).bytesPerPixel);
     //swap lines
     for (size_t i = 0; i < m_height / 2; ++i)
     {
@@ -179,23 +619,123 @@ void Image::flipVertical()
         //now copy buffer to bottom
         memcpy(&m_data[m_width * PixelInfo::pixelInfo(m_formatType).bytesPerPixel * j], lineBuffer, m_width * PixelInfo::pixelInfo(m_formatType).bytesPerPixel);
     }
-    delete [] lineBuffer;
+    PixelAllocator::release(lineBuffer);
 }
 
-bool Image::load(const std::string & path)
+Image Image::compressed(PixelInfo::FormatType formatType, CompressionQuality quality) const
 {
-    //clear current data
-    m_width = 0;
-    m_height = 0;
-    if (m_data != nullptr) {
-        delete [] m_data;
-        m_data = nullptr;
+    if (m_width <= 0 || m_height <= 0 || pixels() == nullptr) {
+        throw ImageException("Image::compressed() - Invalid image dimensions!");
+    }
+    else if (m_formatType == PixelInfo::BAD_FORMAT || PixelInfo::pixelInfo(m_formatType).compressed || PixelInfo::pixelInfo(m_formatType).paletteEntries > 0) {
+        throw ImageException("Image::compressed() - Invalid image format!");
+    }
+    Image result(m_width, m_height, formatType);
+    switch (formatType) {
+        case PixelInfo::ETC1_R8G8B8:
+            encodeETC1(result.m_data, view(), quality);
+            break;
+        case PixelInfo::BC1_R5G6B5:
+        case PixelInfo::BC3_R5G6B5A8:
+            encodeS3TC(result.m_data, view(), formatType, quality);
+            break;
+        default:
+            throw ImageException("Image::compressed() - Unsupported compressed format!");
     }
+    result.m_premultiplied = m_premultiplied;
+    return result;
+}
+
+Image Image::decompressed(PixelInfo::FormatType formatType) const
+{
+    const uint8_t * data = pixels();
+    if (m_width <= 0 || m_height <= 0 || data == nullptr) {
+        throw ImageException("Image::decompressed() - Invalid image dimensions!");
+    }
+    else if (formatType == PixelInfo::BAD_FORMAT || PixelInfo::pixelInfo(formatType).compressed || PixelInfo::pixelInfo(formatType).paletteEntries > 0) {
+        throw ImageException("Image::decompressed() - Invalid result format!");
+    }
+    Image result(m_width, m_height, formatType);
+    switch (m_formatType) {
+        case PixelInfo::ETC1_R8G8B8:
+            decodeETC1(result.view(), data);
+            break;
+        case PixelInfo::BC1_R5G6B5:
+        case PixelInfo::BC3_R5G6B5A8:
+            decodeS3TC(result.view(), data, m_formatType);
+            break;
+        default:
+            throw ImageException("Image::decompressed() - Image is not in a supported compressed format!");
+    }
+    result.m_premultiplied = m_premultiplied;
+    return result;
+}
+
+void Image::premultiplyAlpha()
+{
+    if (PixelInfo::pixelInfo(m_formatType).compressed) {
+        throw ImageException("Image::premultiplyAlpha() - Compressed images are not supported!");
+    }
+    if (m_premultiplied || m_storage == nullptr) {
+        return;
+    }
+    //without alpha the pixels are the same either way
+    if (!supportsPremultipliedAlpha(m_formatType) && PixelInfo::pixelInfo(m_formatType).paletteEntries == 0) {
+        m_premultiplied = true;
+        return;
+    }
+    detach();
     if (m_palette != nullptr) {
-        delete [] m_palette;
-        m_palette = nullptr;
+        premultiplyPixels(m_palette, m_palette, PixelInfo::R8G8B8A8, PixelInfo::pixelInfo(m_formatType).paletteEntries);
     }
-    m_formatType = PixelInfo::BAD_FORMAT;
+    else {
+        premultiplyPixels(m_data, m_data, m_formatType, m_width * m_height);
+    }
+    m_premultiplied = true;
+}
+
+void Image::unpremultiplyAlpha()
+{
+    if (PixelInfo::pixelInfo(m_formatType).compressed) {
+        throw ImageException("Image::unpremultiplyAlpha() - Compressed images are not supported!");
+    }
+    if (!m_premultiplied || m_storage == nullptr) {
+        return;
+    }
+    //without alpha the pixels are the same either way
+    if (!supportsPremultipliedAlpha(m_formatType) && PixelInfo::pixelInfo(m_formatType).paletteEntries == 0) {
+        m_premultiplied = false;
+        return;
+    }
+    detach();
+    if (m_palette != nullptr) {
+        unpremultiplyPixels(m_palette, m_palette, PixelInfo::R8G8B8A8, PixelInfo::pixelInfo(m_formatType).paletteEntries);
+    }
+    else {
+        unpremultiplyPixels(m_data, m_data, m_formatType, m_width * m_height);
+    }
+    m_premultiplied = false;
+}
+
+ImageStatistics Image::statistics() const
+{
+    if (PixelInfo::pixelInfo(m_formatType).compressed) {
+        return calculateStatistics(decompressed().view());
+    }
+    if (palette() != nullptr) {
+        const Image converted(m_width, m_height, PixelInfo::R8G8B8A8, pixels(), (uint8_t *)palette(), m_formatType);
+        return calculateStatistics(converted.view());
+    }
+    return calculateStatistics(view());
+}
+
+bool Image::load(const std::string & path, Image::DecodeMode decodeMode)
+{
+    return load(path, PixelInfo::BAD_FORMAT, BOTTOM_UP, decodeMode);
+}
+
+bool Image::load(const std::string & path, PixelInfo::FormatType formatType, Image::Orientation orientation, Image::DecodeMode decodeMode)
+{
     //check the file signature and deduce its format
     FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(path.c_str(), 0);
     if (fif == FIF_UNKNOWN) {
@@ -204,101 +744,430 @@ bool Image::load(const std::string & path)
     }
     //format ok? check that the plugin has reading capabilities ...
     if ((fif != FIF_UNKNOWN) && FreeImage_FIFSupportsReading(fif)) {
+        //only read the header if we may and the plugin can do that. the pixels are decoded later
+        if (decodeMode != DECODE_NOW && FreeImage_FIFSupportsNoPixels(fif)) {
+            FIBITMAP * fiBitmap = FreeImage_Load(fif, path.c_str(), FIF_LOAD_NOPIXELS);
+            if (fiBitmap == nullptr) {
+                throw ImageException("Image::load() - Failed to load image header!");
+            }
+            freeData();
+            m_width = 0;
+            m_height = 0;
+            m_formatType = PixelInfo::BAD_FORMAT;
+            const PixelInfo::FormatType fileFormatType = bitmapFormatType(fiBitmap);
+            const size_t width = FreeImage_GetWidth(fiBitmap);
+            const size_t height = FreeImage_GetHeight(fiBitmap);
+            FreeImage_Unload(fiBitmap);
+            m_formatType = targetFormatType(fileFormatType, formatType);
+            m_width = width;
+            m_height = height;
+            m_storage = std::make_shared<PixelStorage>();
+            m_storage->lazy.reset(new LazyDecode(path, fif, fileFormatType, m_formatType, orientation, width, height));
+            if (decodeMode == DECODE_PREFETCH) {
+                //decode on a background thread. it keeps the storage alive until it is done. errors are reported on first access again
+                std::promise<void> released;
+                m_storage->lazy->prefetched = released.get_future().share();
+                std::thread(prefetchStorage, m_storage, std::move(released)).detach();
+            }
+            return true;
+        }
         //ok, let's load the file
         FIBITMAP * fiBitmap = FreeImage_Load(fif, path.c_str());
         if (fiBitmap != nullptr)
         {
-            //convert to one of the formats we support
-            if (FreeImage_GetImageType(fiBitmap) == FIT_BITMAP)
+            return loadBitmap(fiBitmap, formatType, orientation);
+        }
+        else
+        {
+            throw ImageException("Image::load() - Failed to load image!");
+        }
+    }
+    else
+    {
+        throw ImageException("Image::load() - File type unknown/unsupported!");
+    }
+    return false;
+}
+
+bool Image::load(const std::string & path, size_t maxWidth, size_t maxHeight, const ResampleFilter & filter)
+{
+    if (maxWidth <= 0 || maxHeight <= 0) {
+        throw ImageException("Image::load() - Invalid maximum dimensions!");
+    }
+    //check the file signature and deduce its format
+    FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(path.c_str(), 0);
+    if (fif == FIF_UNKNOWN) {
+        //try to guess the file format from the file extension
+        fif = FreeImage_GetFIFFromFilename(path.c_str());
+    }
+    if ((fif == FIF_UNKNOWN) || !FreeImage_FIFSupportsReading(fif)) {
+        throw ImageException("Image::load() - File type unknown/unsupported!");
+    }
+    //read the header to find the size we need. the JPEG decoder can then skip most of the work
+    int flags = 0;
+    if (fif == FIF_JPEG && FreeImage_FIFSupportsNoPixels(fif)) {
+        FIBITMAP * header = FreeImage_Load(fif, path.c_str(), FIF_LOAD_NOPIXELS);
+        if (header == nullptr) {
+            throw ImageException("Image::load() - Failed to load image header!");
+        }
+        size_t width = FreeImage_GetWidth(header);
+        size_t height = FreeImage_GetHeight(header);
+        FreeImage_Unload(header);
+        fitSize(width, height, maxWidth, maxHeight);
+        //the JPEG plugin takes the requested size in the upper 16 bits and decodes with the smallest DCT scale that keeps the image at least that big
+        const size_t requestedSize = width > height ? width : height;
+        if (requestedSize < 65536) {
+            flags |= (int)(requestedSize << 16);
+        }
+    }
+    FIBITMAP * fiBitmap = FreeImage_Load(fif, path.c_str(), flags);
+    if (fiBitmap == nullptr) {
+        throw ImageException("Image::load() - Failed to load image!");
+    }
+    const size_t srcWidth = FreeImage_GetWidth(fiBitmap);
+    const size_t srcHeight = FreeImage_GetHeight(fiBitmap);
+    size_t width = srcWidth;
+    size_t height = srcHeight;
+    fitSize(width, height, maxWidth, maxHeight);
+    if (width == srcWidth && height == srcHeight) {
+        //small enough already
+        return loadBitmap(fiBitmap, PixelInfo::BAD_FORMAT, BOTTOM_UP);
+    }
+    //palette indices can not be filtered. let FreeImage look up the colors first. opaque 32bit bitmaps are reported as FIC_RGB, which we do not support
+    if (FreeImage_GetColorType(fiBitmap) == FIC_PALETTE) {
+        FIBITMAP * colorBitmap = FreeImage_IsTransparent(fiBitmap) ? FreeImage_ConvertTo32Bits(fiBitmap) : FreeImage_ConvertTo24Bits(fiBitmap);
+        FreeImage_Unload(fiBitmap);
+        if (colorBitmap == nullptr) {
+            throw ImageException("Image::load() - Failed to convert palette image!");
+        }
+        fiBitmap = colorBitmap;
+    }
+    //clear current data
+    freeData();
+    m_width = 0;
+    m_height = 0;
+    m_formatType = PixelInfo::BAD_FORMAT;
+    m_formatType = bitmapFormatType(fiBitmap);
+    allocate(width, height);
+    //stream the scanlines through the resampler, so we never hold a full resolution copy ourselves
+    const size_t pitch = width * PixelInfo::pixelInfo(m_formatType).bytesPerPixel;
+    uint8_t * data = m_data;
+    try {
+        ResampleStream stream(m_formatType, srcWidth, srcHeight, width, height, filter, [data, pitch](const uint8_t * row, size_t y) {
+            memcpy(data + y * pitch, row, pitch);
+        });
+        for (size_t i = 0; i < srcHeight; i++) {
+            stream.pushRow(FreeImage_GetScanLine(fiBitmap, (int)i));
+        }
+    }
+    catch (...) {
+        FreeImage_Unload(fiBitmap);
+        throw;
+    }
+    //free bitmap data
+    FreeImage_Unload(fiBitmap);
+    return true;
+}
+
+void Image::fitSize(size_t & width, size_t & height, size_t maxWidth, size_t maxHeight)
+{
+    if (width <= maxWidth && height <= maxHeight) {
+        return;
+    }
+    //scale down by the bigger ratio, so both dimensions fit. never go below one pixel
+    const double scaleW = (double)maxWidth / (double)width;
+    const double scaleH = (double)maxHeight / (double)height;
+    const double scale = scaleW < scaleH ? scaleW : scaleH;
+    const size_t newWidth = (size_t)((double)width * scale + 0.5);
+    const size_t newHeight = (size_t)((double)height * scale + 0.5);
+    width = newWidth < 1 ? 1 : (newWidth > maxWidth ? maxWidth : newWidth);
+    height = newHeight < 1 ? 1 : (newHeight > maxHeight ? maxHeight : newHeight);
+}
+
+bool Image::load(const uint8_t * data, const size_t size)
+{
+    if (data == nullptr || size == 0) {
+        throw ImageException("Image::load() - Invalid image data!");
+    }
+    //check if this is a raw image container, which needs no decoding
+    if (size >= sizeof(RawImageHeader) && memcmp(data, RAW_IMAGE_MAGIC, 4) == 0) {
+        RawImageHeader header;
+        memcpy(&header, data, sizeof(RawImageHeader));
+        if (!checkRawHeader(header, size)) {
+            throw ImageException("Image::load() - Invalid raw image container!");
+        }
+        m_formatType = (PixelInfo::FormatType)header.formatType;
+        m_premultiplied = (header.flags & RAW_IMAGE_FLAG_PREMULTIPLIED) != 0;
+        //reuses the current buffer if it is big enough
+        allocate(header.width, header.height);
+        memcpy(m_data, data + header.dataOffset, header.dataSize);
+        if (header.paletteSize > 0) {
+            memcpy(m_palette, data + sizeof(RawImageHeader), header.paletteSize);
+        }
+        return true;
+    }
+    //let FreeImage read from our memory without copying it
+    FIMEMORY * memory = FreeImage_OpenMemory((BYTE *)data, (DWORD)size);
+    if (memory == nullptr) {
+        throw ImageException("Image::load() - Failed to open memory!");
+    }
+    FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromMemory(memory, 0);
+    if ((fif != FIF_UNKNOWN) && FreeImage_FIFSupportsReading(fif)) {
+        FIBITMAP * fiBitmap = FreeImage_LoadFromMemory(fif, memory);
+        FreeImage_CloseMemory(memory);
+        if (fiBitmap != nullptr)
+        {
+            return loadBitmap(fiBitmap, PixelInfo::BAD_FORMAT, BOTTOM_UP);
+        }
+        else
+        {
+            throw ImageException("Image::load() - Failed to load image!");
+        }
+    }
+    FreeImage_CloseMemory(memory);
+    throw ImageException("Image::load() - File type unknown/unsupported!");
+    return false;
+}
+
+bool Image::loadMapped(const std::string & path)
+{
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(path)) {
+        throw ImageException("Image::loadMapped() - Failed to map file!");
+    }
+    return loadMapped(file, 0);
+}
+
+bool Image::loadMapped(const std::shared_ptr<MappedFile> & file, size_t offset)
+{
+    if (file == nullptr || !file->isOpen() || offset + sizeof(RawImageHeader) > file->size()) {
+        throw ImageException("Image::loadMapped() - Invalid mapped file!");
+    }
+    RawImageHeader header;
+    memcpy(&header, file->data() + offset, sizeof(RawImageHeader));
+    if (memcmp(header.magic, RAW_IMAGE_MAGIC, 4) != 0 || !checkRawHeader(header, file->size() - offset)) {
+        throw ImageException("Image::loadMapped() - Invalid raw image container!");
+    }
+    //point into the mapping and keep it alive
+    m_storage = std::make_shared<PixelStorage>();
+    m_storage->mapping = file;
+    m_storage->data = file->data() + offset + header.dataOffset;
+    m_storage->palette = header.paletteSize > 0 ? file->data() + offset + sizeof(RawImageHeader) : nullptr;
+    m_width = header.width;
+    m_height = header.height;
+    m_formatType = (PixelInfo::FormatType)header.formatType;
+    m_premultiplied = (header.flags & RAW_IMAGE_FLAG_PREMULTIPLIED) != 0;
+    m_data = m_storage->data;
+    m_palette = m_storage->palette;
+    return true;
+}
+
+bool Image::loadMapped(const std::shared_ptr<MappedFile> & file, size_t offset, size_t width, size_t height, PixelInfo::FormatType formatType)
+{
+    if (file == nullptr || !file->isOpen() || width == 0 || height == 0) {
+        throw ImageException("Image::loadMapped() - Invalid mapped file!");
+    }
+    if (formatType <= PixelInfo::BAD_FORMAT || formatType >= PixelInfo::MAX_FORMAT || PixelInfo::pixelInfo(formatType).paletteEntries > 0) {
+        throw ImageException("Image::loadMapped() - Invalid image format!");
+    }
+    if (offset > file->size() || PixelInfo::dataSize(formatType, width, height) > file->size() - offset) {
+        throw ImageException("Image::loadMapped() - Image data exceeds mapped file!");
+    }
+    m_storage = std::make_shared<PixelStorage>();
+    m_storage->mapping = file;
+    m_storage->data = file->data() + offset;
+    m_width = width;
+    m_height = height;
+    m_formatType = formatType;
+    m_premultiplied = false;
+    m_data = m_storage->data;
+    m_palette = nullptr;
+    return true;
+}
+
+bool Image::saveRaw(const std::string & path) const
+{
+    const uint8_t * data = pixels();
+    if (data == nullptr || m_formatType == PixelInfo::BAD_FORMAT) {
+        throw ImageException("Image::saveRaw() - No image data!");
+    }
+    RawImageHeader header;
+    memcpy(header.magic, RAW_IMAGE_MAGIC, 4);
+    header.version = RAW_IMAGE_VERSION;
+    header.width = (uint32_t)m_width;
+    header.height = (uint32_t)m_height;
+    header.formatType = (uint32_t)m_formatType;
+    header.paletteSize = palette() != nullptr ? PixelInfo::pixelInfo(m_formatType).paletteEntries * 4 : 0;
+    header.dataOffset = (uint32_t)((sizeof(RawImageHeader) + header.paletteSize + 15) & ~(size_t)15);
+    header.dataSize = (uint32_t)PixelInfo::dataSize(m_formatType, m_width, m_height);
+    header.flags = m_premultiplied ? RAW_IMAGE_FLAG_PREMULTIPLIED : 0;
+    memset(header.reserved, 0, sizeof(header.reserved));
+    FILE * file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw ImageException("Image::saveRaw() - Failed to open file!");
+    }
+    const uint8_t padding[16] = {0};
+    bool worked = fwrite(&header, sizeof(RawImageHeader), 1, file) == 1;
+    if (header.paletteSize > 0) {
+        worked &= fwrite(palette(), header.paletteSize, 1, file) == 1;
+    }
+    const size_t paddingSize = header.dataOffset - sizeof(RawImageHeader) - header.paletteSize;
+    if (paddingSize > 0) {
+        worked &= fwrite(padding, paddingSize, 1, file) == 1;
+    }
+    worked &= fwrite(data, header.dataSize, 1, file) == 1;
+    fclose(file);
+    return worked;
+}
+
+static PixelInfo::FormatType bitmapFormatType(FIBITMAP * fiBitmap)
+{
+    //find the format we support that matches the bitmap
+    if (FreeImage_GetImageType(fiBitmap) == FIT_BITMAP)
+    {
+        if (FreeImage_GetColorType(fiBitmap) == FIC_PALETTE)
+        {
+            if (FreeImage_GetBPP(fiBitmap) == 8)
             {
-                if (FreeImage_GetColorType(fiBitmap) == FIC_PALETTE)
-                {
-                    if (FreeImage_GetBPP(fiBitmap) == 8)
-                    {
-                        m_formatType = PixelInfo::I8;
-                    }
-                    else
-                    {
-                        throw ImageException("Image::load() - Unsupported palette depth!");
-                    }
-                }
-                else if (FreeImage_GetColorType(fiBitmap) == FIC_RGB)
+                return PixelInfo::I8;
+            }
+            else
+            {
+                FreeImage_Unload(fiBitmap);
+                throw ImageException("Image::load() - Unsupported palette depth!");
+            }
+        }
+        else if (FreeImage_GetColorType(fiBitmap) == FIC_RGB)
+        {
+            if (FreeImage_GetBPP(fiBitmap) == 24) 
+            {
+                return PixelInfo::R8G8B8;
+            }
+            else if (FreeImage_GetBPP(fiBitmap) == 16)
+            {
+                if (FreeImage_GetRedMask(fiBitmap) != FreeImage_GetGreenMask(fiBitmap))
                 {
-                    if (FreeImage_GetBPP(fiBitmap) == 24) 
-                    {
-                        m_formatType = PixelInfo::R8G8B8;
-                    }
-                    else if (FreeImage_GetBPP(fiBitmap) == 16)
-                    {
-                        if (FreeImage_GetRedMask(fiBitmap) != FreeImage_GetGreenMask(fiBitmap))
-                        {
-                            m_formatType = PixelInfo::R5G6B5;
-                        }
-                        else 
-                        {
-                            m_formatType = PixelInfo::X1R5G5B5;
-                        }
-                    }
-                    else {
-                        throw ImageException("Image::load() - Unsupported RGB format!");
-                    }
+                    return PixelInfo::R5G6B5;
                 }
-                else if (FreeImage_GetColorType(fiBitmap) == FIC_RGBALPHA)
+                else 
                 {
-                    if (FreeImage_GetBPP(fiBitmap) == 32)
-                    {
-                        m_formatType = PixelInfo::R8G8B8A8;
-                    }
-                    else
-                    {
-                        throw ImageException("Image::load() - Unsupported RGBA format!");
-                    }
+                    return PixelInfo::X1R5G5B5;
                 }
-                else {
-                    throw ImageException("Image::load() - Unsupported color type!");
-                }
-            }
-            else if (FreeImage_GetImageType(fiBitmap) == FIT_UINT16)
-            {
-                m_formatType = PixelInfo::I16;
             }
             else {
-                //free bitmap data
                 FreeImage_Unload(fiBitmap);
-                throw ImageException("Image::load() - Unsupported image format!");
+                throw ImageException("Image::load() - Unsupported RGB format!");
             }
-            //convert image to raw data. set up members
-            m_width = FreeImage_GetWidth(fiBitmap);
-            m_height = FreeImage_GetHeight(fiBitmap);
-            const size_t pitch = m_width * PixelInfo::pixelInfo(m_formatType).bytesPerPixel;
-            //const unsigned int pitch = FreeImage_GetPitch(fiBitmap);
-            //allocate memory
-            m_data = new uint8_t[m_height * pitch];
-            //copy scanlines to image memory
-            for (size_t i = 0; i < m_height; i++)
+        }
+        else if (FreeImage_GetColorType(fiBitmap) == FIC_RGBALPHA)
+        {
+            if (FreeImage_GetBPP(fiBitmap) == 32)
             {
-                const BYTE * scanLine = FreeImage_GetScanLine(fiBitmap, (int)i);
-                memcpy(m_data + (i * pitch), scanLine, pitch);
+                return PixelInfo::R8G8B8A8;
             }
-            //if the image has a palette, copy that too
-            if (FreeImage_GetPalette(fiBitmap) != nullptr && PixelInfo::pixelInfo(m_formatType).paletteEntries > 0) {
-                m_palette = new uint8_t[PixelInfo::pixelInfo(m_formatType).paletteEntries * 4];
-                memcpy(m_palette, FreeImage_GetPalette(fiBitmap), PixelInfo::pixelInfo(m_formatType).paletteEntries * 4);
+            else
+            {
+                FreeImage_Unload(fiBitmap);
+                throw ImageException("Image::load() - Unsupported RGBA format!");
             }
-            //free bitmap data
-            FreeImage_Unload(fiBitmap);
-            return true;
         }
-        else
-        {
-            throw ImageException("Image::load() - Failed to load image!");
+        else {
+            FreeImage_Unload(fiBitmap);
+            throw ImageException("Image::load() - Unsupported color type!");
         }
     }
-    else
+    else if (FreeImage_GetImageType(fiBitmap) == FIT_UINT16)
     {
-        throw ImageException("Image::load() - File type unknown/unsupported!");
+        return PixelInfo::I16;
+    }
+    //free bitmap data
+    FreeImage_Unload(fiBitmap);
+    throw ImageException("Image::load() - Unsupported image format!");
+}
+
+static PixelInfo::FormatType targetFormatType(PixelInfo::FormatType fileFormatType, PixelInfo::FormatType formatType)
+{
+    if (formatType == PixelInfo::BAD_FORMAT || formatType == fileFormatType) {
+        return fileFormatType;
+    }
+    //we can not decode to compressed formats or quantize to a palette
+    if (formatType >= PixelInfo::MAX_FORMAT || PixelInfo::pixelInfo(formatType).compressed || PixelInfo::pixelInfo(formatType).paletteEntries > 0) {
+        throw ImageException("Image::load() - Unsupported target format!");
+    }
+    return formatType;
+}
+
+//FreeImage palettes are RGBQUADs with alpha in a separate transparency table. Convert them to our R8G8B8A8 palettes.
+static std::vector<uint32_t> bitmapPalette(FIBITMAP * fiBitmap, size_t nrOfEntries)
+{
+    std::vector<uint32_t> palette(nrOfEntries, 0);
+    const RGBQUAD * filePalette = FreeImage_GetPalette(fiBitmap);
+    if (filePalette == nullptr) {
+        return palette;
+    }
+    const BYTE * transparency = FreeImage_IsTransparent(fiBitmap) ? FreeImage_GetTransparencyTable(fiBitmap) : nullptr;
+    const size_t transparencyCount = transparency != nullptr ? FreeImage_GetTransparencyCount(fiBitmap) : 0;
+    const size_t colorsUsed = FreeImage_GetColorsUsed(fiBitmap) < nrOfEntries ? FreeImage_GetColorsUsed(fiBitmap) : nrOfEntries;
+    for (size_t i = 0; i < colorsUsed; ++i) {
+        const uint32_t alpha = i < transparencyCount ? transparency[i] : 0xFF;
+        palette[i] = ((uint32_t)filePalette[i].rgbRed << 24) | ((uint32_t)filePalette[i].rgbGreen << 16) | ((uint32_t)filePalette[i].rgbBlue << 8) | alpha;
+    }
+    return palette;
+}
+
+static void copyBitmap(uint8_t * data, uint8_t * palette, PixelInfo::FormatType formatType, Image::Orientation orientation, FIBITMAP * fiBitmap, PixelInfo::FormatType fileFormatType, size_t width, size_t height)
+{
+    const size_t pitch = width * PixelInfo::pixelInfo(formatType).bytesPerPixel;
+    //palette files are expanded to colors through the palette if the target has none
+    const size_t paletteEntries = FreeImage_GetPalette(fiBitmap) != nullptr ? PixelInfo::pixelInfo(fileFormatType).paletteEntries : 0;
+    const std::vector<uint32_t> convertedPalette = bitmapPalette(fiBitmap, paletteEntries);
+    const uint8_t * filePalette = paletteEntries > 0 ? (const uint8_t *)convertedPalette.data() : nullptr;
+    ConvertRowFunction rowFunction = formatType != fileFormatType ? getConvertRowFunction(formatType, fileFormatType) : nullptr;
+    //copy scanlines to their final position in image memory and convert them on the way. FreeImage pads scanlines to 4 bytes and
+    //stores them bottom-up, so we can't copy it all at once anyway
+#pragma omp parallel for
+    for (int i = 0; i < (int)height; i++)
+    {
+        const BYTE * scanLine = FreeImage_GetScanLine(fiBitmap, orientation == Image::TOP_DOWN ? (int)height - 1 - i : i);
+        uint8_t * destLine = data + (i * pitch);
+        if (formatType == fileFormatType) {
+            memcpy(destLine, scanLine, pitch);
+        }
+        else if (rowFunction != nullptr) {
+            rowFunction(destLine, scanLine, width);
+        }
+        else {
+            convertFormat(destLine, nullptr, formatType, scanLine, filePalette, fileFormatType, width);
+        }
+    }
+    //if the image has a palette, copy that too
+    if (filePalette != nullptr && palette != nullptr) {
+        memcpy(palette, filePalette, paletteEntries * 4);
     }
-    return false;
+}
+
+bool Image::loadBitmap(FIBITMAP * fiBitmap, PixelInfo::FormatType formatType, Image::Orientation orientation)
+{
+    //clear current data
+    freeData();
+    m_width = 0;
+    m_height = 0;
+    m_formatType = PixelInfo::BAD_FORMAT;
+    //find one of the formats we support and the format to convert to
+    const PixelInfo::FormatType fileFormatType = bitmapFormatType(fiBitmap);
+    try {
+        m_formatType = targetFormatType(fileFormatType, formatType);
+    }
+    catch (...) {
+        FreeImage_Unload(fiBitmap);
+        throw;
+    }
+    //convert image to raw data. set up members and allocate memory
+    allocate(FreeImage_GetWidth(fiBitmap), FreeImage_GetHeight(fiBitmap));
+    copyBitmap(m_data, m_palette, m_formatType, orientation, fiBitmap, fileFormatType, m_width, m_height);
+    //free bitmap data
+    FreeImage_Unload(fiBitmap);
+    return true;
 }
 
 bool Image::save(const std::string & path)
@@ -335,6 +1204,8 @@ bool Image::save(const std::string & path)
 
 //-------------------------------------------------------------------------------------------------
 
+//-------------------------------------------------------------------------------------------------
+
 ImageException::ImageException(const char * errorString) throw()
     : InternalException(errorString)
 {
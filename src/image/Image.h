@@ -3,14 +3,22 @@
 #include "../Base.h"
 #include "PixelFormat.h"
 #include "ImageResample.h"
+#include "ResamplePlan.h"
 
+#include <memory>
 #include <string>
+#include <vector>
 #include <stdint.h>
 
+struct FIBITMAP;
+class MappedFile;
+struct ImageStatistics;
+struct PixelStorage;
+
 //TODO: Variable palette depth.
 //TODO: Conversion from/to paletted images.
 //TODO: Rescaling of paletted images.
-//TODO: Thread-safety.
+//TODO: Thread-safety. Const methods can be called from multiple threads. Copies share their data, so do not modify an image while another thread copies it.
 
 class Image
 {
@@ -20,13 +28,27 @@ public:
                            KEEP_HEIGHT, //!<Keep height, adjust width to fit.
     };
 
+    enum Orientation { BOTTOM_UP, //!<First row is the bottom row of the picture. This is how FreeImage and OpenGL store images.
+                       TOP_DOWN, //!<First row is the top row of the picture.
+    };
+
+    enum DecodeMode { DECODE_NOW, //!<Decode the pixels while loading.
+                      DECODE_LAZY, //!<Only read the file header while loading. The pixels are decoded on first access.
+                      DECODE_PREFETCH, //!<Only read the file header while loading and decode the pixels on a background thread.
+    };
+
+    enum CompressionQuality { COMPRESS_FAST, //!<Only try the obvious block encodings. Good enough for textures compressed at runtime.
+                              COMPRESS_QUALITY, //!<Search more block encodings. Several times slower, use it for offline baking.
+    };
+
     /*!
     Create a new empty image or use already allocated image data in same format.
     \param[in] width Width of image.
     \param[in] height Height of image.
     \param[in] source Source data for image. Needs to have the same correct and size!
     \param[in] palette Source palette for image in R8G8B8A8 format. Needs to have the correct format and size!
-    \param[in] takeOwnerShip Pass bool for the image to take ownership of the source and palette pointer, else it'll make a copy.
+    \param[in] takeOwnerShip Pass bool for the image to take ownership of the source and palette pointer, else it'll make a copy. The pointers must have been allocated with new[].
+    \note Image buffers are allocated from PixelAllocator and aligned to PIXEL_BUFFER_ALIGNMENT bytes. Buffers taken over from the caller are not.
     */
     Image(size_t width = 0, size_t height = 0, PixelInfo::FormatType formatType = PixelInfo::BAD_FORMAT, uint8_t * source = nullptr, uint8_t * palette = nullptr, bool takeOwnership = false);
 
@@ -41,15 +63,32 @@ public:
     Image(size_t width, size_t height, PixelInfo::FormatType formatType, const uint8_t * source, uint8_t * palette, PixelInfo::FormatType sourceFormat);
 
     /*!
-    Copy constructors. This makes a deep copy of the image data and does a conversion if neccessary.
+    Copy constructor. The image data is shared with source until one of the images is modified, so this does not copy any pixels.
     */
     Image(const Image & source);
 
     /*!
-    Copy operator. This makes a deep copy of the image data and does a conversion if neccessary.
+    Move constructor. Takes over the image data of source without copying. Source is left empty, but keeps its format.
+    */
+    Image(Image && source);
+
+    /*!
+    Create a tightly packed copy of the pixels in a view, e.g. to copy out a crop.
+    \param[in] source Source view.
+    */
+    explicit Image(const ConstImageView & source);
+
+    /*!
+    Copy operator. If the formats match or this image has no format yet, the image data is shared like in the copy constructor.
+    Otherwise the data is converted to the format of this image.
     */
     Image & operator=(const Image & source);
 
+    /*!
+    Move operator. Frees the current image data and takes over the image data of source without copying.
+    */
+    Image & operator=(Image && source);
+
     /*!
     Destructor. Frees image data.
     */
@@ -58,19 +97,103 @@ public:
     /*!
     Try loading an image from path.
     \param[in] path Path to image to load.
+    \param[in] decodeMode Optional. Pass DECODE_LAZY or DECODE_PREFETCH to only read the header, so width(), height() and formatType() are available right away.
+    The pixels are decoded on first access of pixels(), palette() or view() then. Formats FreeImage can not read headers of are decoded immediately.
     \return Returns true if the image could be loaded.
     \note All image content will be replaced and the image will be in the format resembling the file the most.
+    Errors while decoding lazily are thrown as ImageException on first access. The file must not change until then.
     */
-    bool load(const std::string & path);
+    bool load(const std::string & path, DecodeMode decodeMode = DECODE_NOW);
+
+    /*!
+    Try loading an image from path and convert it to a format and orientation while copying it out of the decoder.
+    Every scanline is written to its final position in its final format once, so no flipVertical() or conversion pass is needed afterwards.
+    \param[in] path Path to image to load.
+    \param[in] formatType Format of the image after loading. Pass BAD_FORMAT to use the format resembling the file the most. Palette and compressed formats are not supported.
+    Palette files are expanded through their palette, including its transparency.
+    \param[in] orientation Optional. Row order of the image after loading. FreeImage and OpenGL use BOTTOM_UP.
+    \param[in] decodeMode Optional. Pass DECODE_LAZY or DECODE_PREFETCH to decode the pixels later. See load().
+    \return Returns true if the image could be loaded.
+    */
+    bool load(const std::string & path, PixelInfo::FormatType formatType, Orientation orientation = BOTTOM_UP, DecodeMode decodeMode = DECODE_NOW);
+
+    /*!
+    Try loading an image from path and scale it down while loading, so it fits into maxWidth x maxHeight. The aspect ratio is kept and images are never scaled up.
+    JPEG files are reduced by the decoder using DCT scaling first. The remaining reduction is done while streaming the scanlines through \sa ResampleStream,
+    so the image never holds the full resolution pixels. Formats without decoder-side reduction are still fully decoded by FreeImage though.
+    Palette images that need scaling are converted to 24bit colors, or 32bit colors if they have transparency, by FreeImage first.
+    \param[in] path Path to image to load.
+    \param[in] maxWidth Maximum width of the image after loading.
+    \param[in] maxHeight Maximum height of the image after loading.
+    \param[in] filter Optional. Resampling filter structure.
+    \return Returns true if the image could be loaded.
+    */
+    bool load(const std::string & path, size_t maxWidth, size_t maxHeight, const ResampleFilter & filter = ResampleLinear());
 
     /*!
     Try loading an image from raw data.
-    \param[in] data Pointer to raw data in memory.
+    \param[in] data Pointer to raw data in memory, e.g. a file read from a packed archive.
     \param[in] size Size of raw data in memory.
     \return Returns true if the image could be loaded.
     \note All image content will be replaced and the image will be in the format resembling the file data the most.
+    Raw image containers (see saveRaw()) are recognized too and copied without decoding.
+    */
+    bool load(const uint8_t * data, const size_t size);
+
+    /*!
+    Map a raw image container file (see saveRaw()) into memory and use its pixels directly without copying.
+    \param[in] path Path to raw image container.
+    \return Returns true if the image could be loaded.
+    \note Modifying the pixels makes a private copy of the image data first, so the mapped file stays untouched.
     */
-    //bool load(const uint8_t * data, const size_t size = 0);
+    bool loadMapped(const std::string & path);
+
+    /*!
+    Use the pixels of a raw image container in an already mapped file without copying, e.g. in a packed archive.
+    \param[in] file Mapped file. The image keeps the mapping alive as long as it uses its data.
+    \param[in] offset Byte offset of the raw image container in the file.
+    \return Returns true if the image could be loaded.
+    */
+    bool loadMapped(const std::shared_ptr<MappedFile> & file, size_t offset = 0);
+
+    /*!
+    Use tightly packed pixel data in an already mapped file without copying, e.g. a mip level of a texture container.
+    \param[in] file Mapped file. The image keeps the mapping alive as long as it uses its data.
+    \param[in] offset Byte offset of the pixel data in the file.
+    \param[in] width Width of image.
+    \param[in] height Height of image.
+    \param[in] formatType Format of the pixel data. Palette formats are not supported.
+    \return Returns true if the image could be loaded.
+    \note Throws an ImageException if the data does not fit into the file.
+    */
+    bool loadMapped(const std::shared_ptr<MappedFile> & file, size_t offset, size_t width, size_t height, PixelInfo::FormatType formatType);
+
+    /*!
+    Save the image as an uncompressed raw image container. The container is a small header, followed by the palette and the pixel data.
+    The pixel data is aligned to 16 bytes and stored exactly like in memory, so it can be memory-mapped with loadMapped().
+    The header also stores if the image is premultiplied, so loading restores isPremultiplied().
+    \param[in] path Path to file to save.
+    \return Returns true if the image could be saved.
+    */
+    bool saveRaw(const std::string & path) const;
+
+    /*!
+    Check if the pixels of the image have been decoded.
+    \return Returns false if the image was loaded lazily and its pixels have not been accessed yet.
+    */
+    bool isDecoded() const;
+
+    /*!
+    Check if the image data is owned by a memory-mapped file.
+    \return Returns true if the image uses the pixels of a mapped file.
+    */
+    bool isMapped() const;
+
+    /*!
+    Check if the image data is shared with other images.
+    \return Returns true if other images use the same data. Modifying this image will make a private copy then.
+    */
+    bool isShared() const { return m_storage.use_count() > 1; }
 
 	/*!
 	Try saving image from current data.
@@ -82,26 +205,54 @@ public:
     /*!
     Get pointer to image data.
     \return Returns a pointer to the raw image data.
+    \note Images loaded lazily are decoded on the first call. That is thread-safe, the pixels are only decoded once.
     */
-    const uint8_t * pixels() const { return (const uint8_t *)m_data; }
+    const uint8_t * pixels() const;
 
     /*!
-    Get pointer to image data.
+    Get pointer to image data for writing.
     \return Returns a pointer to the raw image data.
+    \note If the data is shared with other images or a mapped file, a private copy is made first.
     */
-    uint8_t * pixels() { return m_data; }
+    uint8_t * pixels();
 
     /*!
     Get pointer to palette data in R8G8B8A8 format.
     \return Returns a pointer to the raw palette data.
     */
-    const uint8_t * palette() const { return (const uint8_t *)m_palette; }
+    const uint8_t * palette() const;
 
     /*!
-    Get pointer to image data in R8G8B8A8 format.
-    \return Returns a pointer to the raw image data.
+    Get pointer to palette data in R8G8B8A8 format for writing.
+    \return Returns a pointer to the raw palette data.
+    \note If the data is shared with other images or a mapped file, a private copy is made first.
+    */
+    uint8_t * palette();
+
+    /*!
+    Get a view of the whole image.
+    \return Returns a view of the image data. It is valid as long as the image data is not reallocated.
+    */
+    ConstImageView view() const;
+
+    /*!
+    Get a view of the whole image.
+    \return Returns a writable view of the image data. It is valid as long as the image data is not reallocated.
+    \note If the data is shared with other images or a mapped file, a private copy is made first.
+    */
+    ImageView view();
+
+    /*!
+    Get a view of a sub-rectangle of the image without copying it.
+    \param[in] x Left pixel of sub-rectangle.
+    \param[in] y Top row of sub-rectangle.
+    \param[in] width Width of sub-rectangle.
+    \param[in] height Height of sub-rectangle.
+    \return Returns a view of the sub-rectangle.
+    \note Throws an ImageException if the sub-rectangle is not inside the image.
     */
-    uint8_t * palette() { return m_palette; }
+    ConstImageView view(size_t x, size_t y, size_t width, size_t height) const { return view().subView(x, y, width, height); }
+    ImageView view(size_t x, size_t y, size_t width, size_t height) { return view().subView(x, y, width, height); }
 
     /*!
     Get the pixel type.
@@ -121,21 +272,83 @@ public:
     */
     size_t height() const { return m_height; }
 
+    /*!
+    Get number of bytes allocated for image data. This can be bigger than the data actually used, because buffers are reused if big enough.
+    \return Returns the capacity of the image data buffer in bytes.
+    */
+    size_t capacity() const;
+
+    /*!
+    Change image dimensions and optionally format. The current buffer is reused if it is big enough, so no memory is allocated.
+    \param[in] width New width.
+    \param[in] height New height.
+    \param[in] formatType Optional. New pixel format. Pass BAD_FORMAT to keep the current format.
+    \note The image content is undefined afterwards.
+    */
+    void resize(size_t width, size_t height, PixelInfo::FormatType formatType = PixelInfo::BAD_FORMAT);
+
     /*!
     Return image scaled to new dimensions.
     \param[in] width New width.
     \param[in] height New height.
     \param[in] aspectMode Optional. Pass aspect ration mode to honour.
     \param[in] fastMode. Do not reallocate memory. Faster, but uses more memory for the result image.
+    \param[in] filterPremultiplied Optional. Filter straight alpha images in premultiplied space, so transparent pixels do not darken the edges. \sa ResamplePlan.
+    \note This is thread-safe. Multiple threads can scale the same image at once.
+    */
+    Image scaled(size_t width, size_t height, AspectRatioMode aspectMode = DONT_CARE, const ResampleFilter & filter = ResampleLinear(), bool filterPremultiplied = false) const;
+
+    /*!
+    Return image scaled to new dimensions and converted to another format in a single pass. Scaled rows are converted while they are written,
+    so there is no intermediate image and the result is only written once.
+    \param[in] width New width.
+    \param[in] height New height.
+    \param[in] formatType Pixel format of the result.
+    \param[in] aspectMode Optional. Pass aspect ration mode to honour.
+    \param[in] filter Optional. Resampling filter structure.
+    \param[in] filterPremultiplied Optional. Filter straight alpha images in premultiplied space. The result has straight alpha again.
+    \note This is thread-safe. Multiple threads can scale the same image at once.
+    */
+    Image scaled(size_t width, size_t height, PixelInfo::FormatType formatType, AspectRatioMode aspectMode = DONT_CARE, const ResampleFilter & filter = ResampleLinear(), bool filterPremultiplied = false) const;
+
+    /*!
+    Return image scaled down using a summed-area table. Every destination pixel is a box average over the source pixels it covers,
+    so the cost does not depend on the reduction ratio. Use this for big reductions, e.g. previews. For multiple previews of the same image
+    build a \sa SummedAreaTable once and scale from that.
+    \param[in] width New width.
+    \param[in] height New height.
+    \param[in] aspectMode Optional. Pass aspect ration mode to honour.
+    \param[in] nrOfBoxes Optional. Number of nested boxes per pixel. 1 is a plain box filter, 3 approximates a Gaussian. \sa SummedAreaTable::scale.
+    \note Palette formats are not supported.
     */
-    Image scaled(size_t width, size_t height, AspectRatioMode aspectMode = DONT_CARE, const ResampleFilter & filter = ResampleLinear()) const;
+    Image scaledArea(size_t width, size_t height, AspectRatioMode aspectMode = DONT_CARE, size_t nrOfBoxes = 1) const;
 
     /*!
     Scale image to destImage dimensions.
-    \param[in] destImage Target image. This image will be scaled to destImage.width() x destImage.height().
-    \note Should theoretically be faster, because it does not need to copy the data.
+    \param[in] destImage Target image. This image will be scaled to destImage.width() x destImage.height() and converted to the format of destImage.
+    \param[in] filterPremultiplied Optional. Filter straight alpha images in premultiplied space.
+    \note Faster than scaled(), because the buffer of destImage and the scale buffer are reused and no memory is allocated.
+    */
+    void scaleTo(Image & destImage, const ResampleFilter & filter = ResampleLinear(), bool filterPremultiplied = false) const;
+
+    /*!
+    Scale image to destImage dimensions using a prepared plan. Plans can be shared between threads, so this does not need any locking.
+    \param[in] destImage Target image. Must have the destination size of the plan.
+    \param[in] plan Resample plan. Its source size and format must match this image, its destination format must match destImage.
+    \note Throws an ImageException if the plan does not match the images or premultiplies an image that is premultiplied already.
     */
-    void scaleTo(Image & destImage, const ResampleFilter & filter = ResampleLinear()) const;
+    void scaleTo(Image & destImage, const ResamplePlan & plan) const;
+
+    /*!
+    Generate a full mipmap chain down to 1x1 pixels.
+    \param[in] filter Resampling filter used for levels that can not be halved exactly, e.g. odd sizes.
+    \param[in] filterPremultiplied Optional. Filter straight alpha images in premultiplied space. The image is premultiplied once,
+    all levels are built from that and converted back to straight alpha, so colors of transparent pixels do not bleed into the smaller levels.
+    \return Returns all mipmap levels. Level 0 is a copy of this image.
+    \note Levels with even dimensions in 8bit component formats use an exact SIMD 2x2 box filter. Rows of a level are split between threads.
+    \note Throws an ImageException for compressed and palette formats.
+    */
+    std::vector<Image> generateMipChain(const ResampleFilter & filter = ResampleLinear(), bool filterPremultiplied = false) const;
 
     /*!
     Flip image vertical.
@@ -143,10 +356,53 @@ public:
     void flipVertical();
 
     /*!
-    Calculate color range of image. Delivers the min and max pixel color value.
-    \return Returns the color range of the data.
+    Return image compressed to a block compressed format. Blocks are encoded in parallel.
+    \param[in] formatType Compressed pixel format of the result. ETC1_R8G8B8, BC1_R5G6B5 and BC3_R5G6B5A8 are supported.
+    \param[in] quality Optional. How hard the encoder searches for the best block encoding.
+    \note Throws an ImageException if the format is not supported or the image is compressed or has a palette.
+    Blocks are stored in row order, so the first block row covers the first 4 rows of the image.
+    */
+    Image compressed(PixelInfo::FormatType formatType, CompressionQuality quality = COMPRESS_FAST) const;
+
+    /*!
+    Return a compressed image decoded to an uncompressed format, e.g. to verify the encoder or if the GPU does not support the format.
+    \param[in] formatType Optional. Uncompressed pixel format of the result.
+    \note Throws an ImageException if the image is not compressed or the format is not supported.
     */
-    //ColorRange colorRange() const;
+    Image decompressed(PixelInfo::FormatType formatType = PixelInfo::R8G8B8A8) const;
+
+    /*!
+    Check if the color components of the image are multiplied with its alpha, e.g. after premultiplyAlpha().
+    Premultiplied images filter without dark fringes and are blended with GL_ONE, GL_ONE_MINUS_SRC_ALPHA.
+    \return Returns true if the image is premultiplied.
+    \note The flag is stored in raw image containers and KTX files and restored when loading them.
+    */
+    bool isPremultiplied() const { return m_premultiplied; }
+
+    /*!
+    Mark the image as premultiplied or straight alpha without changing any pixels.
+    */
+    void setPremultiplied(bool premultiplied) { m_premultiplied = premultiplied; }
+
+    /*!
+    Multiply the color components of all pixels with their alpha in place. Palette images premultiply their palette instead. See \sa premultiplyPixels.
+    Does nothing if the image is premultiplied already.
+    \note Throws an ImageException if the image is compressed.
+    */
+    void premultiplyAlpha();
+
+    /*!
+    Divide the color components of all pixels by their alpha in place. See \sa unpremultiplyPixels. Does nothing if the image is not premultiplied.
+    \note Throws an ImageException if the image is compressed.
+    */
+    void unpremultiplyAlpha();
+
+    /*!
+    Calculate statistics of the image: color range, histograms, the kind of alpha channel and the number of unique colors. See \sa calculateStatistics.
+    \return Returns the statistics of all pixels.
+    \note Palette images are converted to R8G8B8A8 and compressed images are decoded first.
+    */
+    ImageStatistics statistics() const;
 
 protected:
     /*!
@@ -154,13 +410,44 @@ protected:
     */
     void copyToInternal(size_t width, size_t height, const uint8_t * source, const uint8_t * palette, PixelInfo::FormatType formatType);
 
+    /*!
+    INTERNAL. Free or release image and palette data.
+    */
+    void freeData();
+
+    /*!
+    INTERNAL. Make sure the buffers can hold an image of the size and the current format. Reallocates only if the buffer is shared or too small.
+    */
+    void allocate(size_t width, size_t height);
+
+    /*!
+    INTERNAL. Shrink dimensions so they fit into maxWidth x maxHeight while keeping their aspect ratio.
+    */
+    static void fitSize(size_t & width, size_t & height, size_t maxWidth, size_t maxHeight);
+
+    /*!
+    INTERNAL. Adjust new dimensions to the aspect ratio of the image according to aspect mode.
+    */
+    void adjustToAspect(size_t & width, size_t & height, AspectRatioMode aspectMode) const;
+
+    /*!
+    INTERNAL. Make a private copy of the image data if it is shared with other images or a mapped file.
+    */
+    void detach();
+
+    /*!
+    INTERNAL. Copy a bitmap loaded by FreeImage to internal data. Converts it to formatType and orientation on the way. Pass BAD_FORMAT to keep the file format.
+    */
+    bool loadBitmap(FIBITMAP * bitmap, PixelInfo::FormatType formatType, Orientation orientation);
+
 private:
     uint8_t * m_data;
     uint8_t * m_palette; //!< Palette data in R8G8B8A8 format.
     size_t m_width;
     size_t m_height;
     PixelInfo::FormatType m_formatType;
-    mutable ImageResample m_resampler;
+    bool m_premultiplied; //!< True if the color components are multiplied with alpha.
+    std::shared_ptr<PixelStorage> m_storage; //!< Owns m_data and m_palette. Shared between copies of the image.
 };
 
 //-------------------------------------------------------------------------------------------------
@@ -1,70 +1,127 @@
 #include "ImageResample.h"
+#include "ResamplePlan.h"
+#include "CpuFeatures.h"
+#include "PixelAllocator.h"
+
+#include <string.h>
 
 
 ImageResample::ImageResample(PixelInfo::FormatType formatType)
     : m_formatType(formatType)
     , m_scaleBuffer(nullptr)
-    , m_scaleBufferWidth(0)
-    , m_scaleBufferHeight(0)
+    , m_scaleBufferSize(0)
+    , m_useFixedPoint(true)
 {
 }
 
 ImageResample::ImageResample(const ImageResample & b)
+    : m_scaleBuffer(nullptr)
 {
     *this = b;
 }
 
+ImageResample::ImageResample(ImageResample && b)
+    : m_plan(std::move(b.m_plan))
+    , m_scaleBuffer(b.m_scaleBuffer)
+    , m_scaleBufferSize(b.m_scaleBufferSize)
+    , m_formatType(b.m_formatType)
+    , m_useFixedPoint(b.m_useFixedPoint)
+{
+    b.m_scaleBuffer = nullptr;
+    b.m_scaleBufferSize = 0;
+}
+
 ImageResample & ImageResample::operator=(const ImageResample & b)
 {
-    m_formatType = b.m_formatType;
-    m_scaleBuffer = nullptr;
-    m_scaleBufferWidth = b.m_scaleBufferWidth;
-    m_scaleBufferHeight = b.m_scaleBufferHeight;
+    if (this != &b) {
+        PixelAllocator::release(m_scaleBuffer);
+        m_plan = b.m_plan;
+        m_formatType = b.m_formatType;
+        m_scaleBuffer = nullptr;
+        m_scaleBufferSize = 0;
+        m_useFixedPoint = b.m_useFixedPoint;
+    }
     return *this;
 }
 
+ImageResample & ImageResample::operator=(ImageResample && b)
+{
+    if (this != &b) {
+        PixelAllocator::release(m_scaleBuffer);
+        m_plan = std::move(b.m_plan);
+        m_formatType = b.m_formatType;
+        m_scaleBuffer = b.m_scaleBuffer;
+        m_scaleBufferSize = b.m_scaleBufferSize;
+        m_useFixedPoint = b.m_useFixedPoint;
+        b.m_scaleBuffer = nullptr;
+        b.m_scaleBufferSize = 0;
+    }
+    return *this;
+}
+
+ImageResample::~ImageResample()
+{
+    PixelAllocator::release(m_scaleBuffer);
+}
+
+void ImageResample::setUseFixedPoint(bool enable)
+{
+    m_useFixedPoint = enable;
+}
+
+bool ImageResample::supportsFixedPoint(PixelInfo::FormatType formatType)
+{
+    switch (formatType) {
+        case PixelInfo::R8G8B8A8:
+        case PixelInfo::A8R8G8B8:
+        case PixelInfo::R8G8B8X8:
+        case PixelInfo::X8R8G8B8:
+        case PixelInfo::R8G8B8:
+        case PixelInfo::L8:
+        case PixelInfo::L8A8:
+            return true;
+        default:
+            return false;
+    }
+}
+
 void ImageResample::scaleImage(uint8_t * dest, size_t destWidth, size_t destHeight, const uint8_t * src, size_t srcWidth, size_t srcHeight, const ResampleFilter & filter)
 {
     //check if we have data
     if (dest == nullptr || src == nullptr || m_formatType == PixelInfo::BAD_FORMAT ) {
         return;
     }
-    //check if we need to re-allocate the scale buffer
-    if (m_scaleBufferWidth != destWidth || m_scaleBufferHeight != srcHeight)
+    scaleImage(ImageView(dest, destWidth, destHeight, m_formatType), ConstImageView(src, srcWidth, srcHeight, m_formatType), filter);
+}
+
+void ImageResample::scaleImage(const ImageView & dest, const ConstImageView & src, const ResampleFilter & filter)
+{
+    //check if we have data
+    if (dest.data == nullptr || src.data == nullptr || m_formatType == PixelInfo::BAD_FORMAT || dest.formatType == PixelInfo::BAD_FORMAT || src.formatType != m_formatType) {
+        return;
+    }
+    if (dest.width == 0 || dest.height == 0 || src.width == 0 || src.height == 0) {
+        return;
+    }
+    //plans are immutable, so only create a new one if something changed
+    if (m_plan == nullptr || m_plan->destWidth() != dest.width || m_plan->destHeight() != dest.height || m_plan->srcWidth() != src.width || m_plan->srcHeight() != src.height
+        || m_plan->formatType() != m_formatType || m_plan->destFormatType() != dest.formatType || m_plan->filter() != filter || m_plan->useFixedPoint() != (m_useFixedPoint && supportsFixedPoint(m_formatType)))
     {
-        //re-allocate temporary space for initial vertical rescale
-        delete [] m_scaleBuffer;
-        m_scaleBuffer = new uint8_t[destWidth * srcHeight * PixelInfo::pixelInfo(m_formatType).bytesPerPixel];
-        m_scaleBufferWidth = destWidth;
-        m_scaleBufferHeight = srcHeight;
-    }
-    //get weights for horizontal rescale
-    const KernelWeights * horizontalWeights = m_horizontalKernel.getWeigths(filter, destWidth, srcWidth);
-    const size_t horizontalStride = PixelInfo::pixelInfo(m_formatType).bytesPerPixel;
-    //first rescale horizontally
-#pragma omp parallel for
-    for (size_t y = 0; y < srcHeight; ++y) {
-        //calculate new scanlines
-        uint8_t * destScanLine = (uint8_t *)(m_scaleBuffer + y * destWidth);
-        const uint8_t * srcScanLine = (uint8_t *)(src + y * srcWidth);
-        //loop horizontally
-        accumulateWeighted(destScanLine, horizontalStride, destWidth, srcScanLine, srcWidth, horizontalWeights, m_formatType);
-    }
-    //get weights for vertical rescale
-    const KernelWeights * verticalWeights = m_verticalKernel.getWeigths(filter, destHeight, srcHeight);
-    const size_t verticalStride = PixelInfo::pixelInfo(m_formatType).bytesPerPixel * destWidth;
-    //now rescale vertically
-#pragma omp parallel for
-    for (size_t x = 0; x < destWidth; ++x) {
-        //calculate new scanlines
-        uint8_t * destPixel = (uint8_t *)(dest + x);
-        const uint8_t * srcPixel = (uint8_t *)(m_scaleBuffer + x);
-        //loop vertically
-        accumulateWeighted(destPixel, verticalStride, destHeight, srcPixel, verticalStride, verticalWeights, m_formatType);
-    }
-}
-
-inline void accumulateWeighted(uint8_t * dest, size_t destStride, size_t count, const uint8_t * src, size_t srcStride, const KernelWeights * srcWeights, PixelInfo::FormatType m_formatType)
+        m_plan = std::make_shared<ResamplePlan>(m_formatType, src.width, src.height, dest.width, dest.height, filter, m_useFixedPoint, dest.formatType);
+    }
+    //check if we need to re-allocate the scale buffer. it is only ever grown, so repeated scaling does not allocate
+    const size_t scaleBufferSize = m_plan->scratchSize();
+    if (m_scaleBufferSize < scaleBufferSize || m_scaleBuffer == nullptr)
+    {
+        //re-allocate temporary space for initial horizontal rescale
+        PixelAllocator::release(m_scaleBuffer);
+        m_scaleBuffer = PixelAllocator::allocate(scaleBufferSize);
+        m_scaleBufferSize = scaleBufferSize;
+    }
+    m_plan->execute(dest, src, m_scaleBuffer);
+}
+
+void accumulateWeighted(uint8_t * dest, size_t destStride, size_t count, const uint8_t * src, size_t srcStride, const KernelWeights * srcWeights, PixelInfo::FormatType m_formatType)
 {
     //check what the destination format is
     switch (m_formatType) {
@@ -86,5 +143,450 @@ inline void accumulateWeighted(uint8_t * dest, size_t destStride, size_t count,
             accumulatePixel<PixelInfo::I8>(dest, destStride, count, src, srcStride, srcWeights); break;
         case PixelInfo::I16:
             accumulatePixel<PixelInfo::I16>(dest, destStride, count, src, srcStride, srcWeights); break;
+        case PixelInfo::R5G5B5A1:
+            accumulatePixel<PixelInfo::R5G5B5A1>(dest, destStride, count, src, srcStride, srcWeights); break;
+        case PixelInfo::L8:
+            accumulatePixel<PixelInfo::L8>(dest, destStride, count, src, srcStride, srcWeights); break;
+        case PixelInfo::L8A8:
+            accumulatePixel<PixelInfo::L8A8>(dest, destStride, count, src, srcStride, srcWeights); break;
+        default:
+            break;
+    }
+}
+
+void accumulateWeightedRow(uint8_t * dest, size_t count, const uint8_t * src, size_t srcRowStride, const KernelWeights * srcWeights, PixelInfo::FormatType formatType)
+{
+    //check what the destination format is
+    switch (formatType) {
+        case PixelInfo::R8G8B8A8:
+            accumulateRow<PixelInfo::R8G8B8A8>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::A8R8G8B8:
+            accumulateRow<PixelInfo::A8R8G8B8>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::R8G8B8X8:
+            accumulateRow<PixelInfo::R8G8B8X8>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::X8R8G8B8:
+            accumulateRow<PixelInfo::X8R8G8B8>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::R8G8B8:
+            accumulateRow<PixelInfo::R8G8B8>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::X1R5G5B5:
+            accumulateRow<PixelInfo::X1R5G5B5>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::R5G6B5:
+            accumulateRow<PixelInfo::R5G6B5>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::I8:
+            accumulateRow<PixelInfo::I8>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::I16:
+            accumulateRow<PixelInfo::I16>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::R5G5B5A1:
+            accumulateRow<PixelInfo::R5G5B5A1>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::L8:
+            accumulateRow<PixelInfo::L8>(dest, count, src, srcRowStride, srcWeights); break;
+        case PixelInfo::L8A8:
+            accumulateRow<PixelInfo::L8A8>(dest, count, src, srcRowStride, srcWeights); break;
+        default:
+            break;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+//Fixed-point resampling. Every byte of a pixel is an 8bit color component, so we can ignore the actual layout.
+//Color components are multiplied by weights with FIXED_WEIGHT_BITS fractional bits, summed up in 32bit integers, then rounded and clamped to 0-255.
+
+static inline uint8_t clampFixed(int32_t value)
+{
+    value = (value + (1 << (FIXED_WEIGHT_BITS - 1))) >> FIXED_WEIGHT_BITS;
+    return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+template <size_t BPP>
+static void accumulateFixed(uint8_t * dest, size_t destStride, size_t count, const uint8_t * src, size_t srcStride, const KernelWeights * srcWeights)
+{
+    for (size_t x = 0; x < count; ++x) {
+        const uint8_t * pixel = src + srcWeights->start * srcStride;
+        const size_t srcCount = srcWeights->end - srcWeights->start + 1;
+        int32_t values[BPP] = {0};
+        for (size_t i = 0; i < srcCount; ++i) {
+            const int32_t w = srcWeights->fixedWeights[i];
+            for (size_t c = 0; c < BPP; ++c) {
+                values[c] += pixel[c] * w;
+            }
+            pixel += srcStride;
+        }
+        for (size_t c = 0; c < BPP; ++c) {
+            dest[c] = clampFixed(values[c]);
+        }
+        dest += destStride;
+        srcWeights++;
+    }
+}
+
+//Helpers to load / store 3 or 4 byte pixels from / to a 32bit integer without touching memory outside of the pixel
+template <size_t BPP> static inline uint32_t loadPixel(const uint8_t * src);
+template <> inline uint32_t loadPixel<3>(const uint8_t * src) { return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16); }
+template <> inline uint32_t loadPixel<4>(const uint8_t * src) { uint32_t value; memcpy(&value, src, 4); return value; }
+template <size_t BPP> static inline void storePixel(uint8_t * dest, uint32_t value);
+template <> inline void storePixel<3>(uint8_t * dest, uint32_t value) { dest[0] = (uint8_t)value; dest[1] = (uint8_t)(value >> 8); dest[2] = (uint8_t)(value >> 16); }
+template <> inline void storePixel<4>(uint8_t * dest, uint32_t value) { memcpy(dest, &value, 4); }
+
+#if defined(IMAGE_SIMD_X86)
+template <size_t BPP>
+SIMD_TARGET("sse2") static void accumulateFixed_SSE2(uint8_t * dest, size_t destStride, size_t count, const uint8_t * src, size_t srcStride, const KernelWeights * srcWeights)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(1 << (FIXED_WEIGHT_BITS - 1));
+    for (size_t x = 0; x < count; ++x) {
+        const uint8_t * pixel = src + srcWeights->start * srcStride;
+        const size_t srcCount = srcWeights->end - srcWeights->start + 1;
+        __m128i sum = rounding;
+        size_t i = 0;
+        //process two taps at once. interleave the components of both pixels, so pmaddwd does p0 * w0 + p1 * w1 per component
+        for (; i + 1 < srcCount; i += 2) {
+            const __m128i p0 = _mm_cvtsi32_si128((int)loadPixel<BPP>(pixel));
+            const __m128i p1 = _mm_cvtsi32_si128((int)loadPixel<BPP>(pixel + srcStride));
+            const __m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p0, p1), zero);
+            const __m128i w = _mm_set1_epi32((int)(((uint32_t)(uint16_t)srcWeights->fixedWeights[i]) | ((uint32_t)(uint16_t)srcWeights->fixedWeights[i + 1] << 16)));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(p, w));
+            pixel += 2 * srcStride;
+        }
+        if (i < srcCount) {
+            const __m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)loadPixel<BPP>(pixel)), zero), zero);
+            const __m128i w = _mm_set1_epi32((int)(uint32_t)(uint16_t)srcWeights->fixedWeights[i]);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(p, w));
+        }
+        //scale down and pack with saturation to 0-255
+        sum = _mm_srai_epi32(sum, FIXED_WEIGHT_BITS);
+        sum = _mm_packs_epi32(sum, sum);
+        storePixel<BPP>(dest, (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum)));
+        dest += destStride;
+        srcWeights++;
+    }
+}
+#endif
+
+#if defined(IMAGE_SIMD_NEON)
+template <size_t BPP>
+static void accumulateFixed_NEON(uint8_t * dest, size_t destStride, size_t count, const uint8_t * src, size_t srcStride, const KernelWeights * srcWeights)
+{
+    for (size_t x = 0; x < count; ++x) {
+        const uint8_t * pixel = src + srcWeights->start * srcStride;
+        const size_t srcCount = srcWeights->end - srcWeights->start + 1;
+        int32x4_t sum = vdupq_n_s32(0);
+        for (size_t i = 0; i < srcCount; ++i) {
+            const uint8x8_t p = vreinterpret_u8_u32(vdup_n_u32(loadPixel<BPP>(pixel)));
+            sum = vmlal_n_s16(sum, vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(p))), srcWeights->fixedWeights[i]);
+            pixel += srcStride;
+        }
+        //round, scale down and pack with saturation to 0-255
+        const int16x4_t narrow = vqrshrn_n_s32(sum, FIXED_WEIGHT_BITS);
+        const uint8x8_t packed = vqmovun_s16(vcombine_s16(narrow, narrow));
+        storePixel<BPP>(dest, vget_lane_u32(vreinterpret_u32_u8(packed), 0));
+        dest += destStride;
+        srcWeights++;
+    }
+}
+#endif
+
+void accumulateWeightedFixed(uint8_t * dest, size_t destStride, size_t count, const uint8_t * src, size_t srcStride, const KernelWeights * srcWeights, size_t bytesPerPixel)
+{
+    switch (bytesPerPixel) {
+        case 1:
+            accumulateFixed<1>(dest, destStride, count, src, srcStride, srcWeights); break;
+        case 2:
+            accumulateFixed<2>(dest, destStride, count, src, srcStride, srcWeights); break;
+        case 3:
+#if defined(IMAGE_SIMD_X86)
+            if (CpuFeatures::detected().sse2) { accumulateFixed_SSE2<3>(dest, destStride, count, src, srcStride, srcWeights); break; }
+#elif defined(IMAGE_SIMD_NEON)
+            accumulateFixed_NEON<3>(dest, destStride, count, src, srcStride, srcWeights); break;
+#endif
+            accumulateFixed<3>(dest, destStride, count, src, srcStride, srcWeights); break;
+        case 4:
+#if defined(IMAGE_SIMD_X86)
+            if (CpuFeatures::detected().sse2) { accumulateFixed_SSE2<4>(dest, destStride, count, src, srcStride, srcWeights); break; }
+#elif defined(IMAGE_SIMD_NEON)
+            accumulateFixed_NEON<4>(dest, destStride, count, src, srcStride, srcWeights); break;
+#endif
+            accumulateFixed<4>(dest, destStride, count, src, srcStride, srcWeights); break;
+        default:
+            break;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+//Vertical fixed-point pass. We sum up whole rows, so every byte in a row is processed the same way, regardless of pixel format.
+
+static void accumulateRowFixed(uint8_t * dest, size_t start, size_t rowBytes, const uint8_t * src, size_t srcRowStride, const KernelWeights * srcWeights)
+{
+    const size_t srcCount = srcWeights->end - srcWeights->start + 1;
+    //work on blocks of bytes, so the compiler can vectorize the inner loop and the sums stay in cache
+    const size_t blockSize = 64;
+    int32_t values[blockSize];
+    for (size_t j = start; j < rowBytes; j += blockSize) {
+        const size_t blockBytes = (rowBytes - j) < blockSize ? (rowBytes - j) : blockSize;
+        memset(values, 0, sizeof(values));
+        const uint8_t * row = src + srcWeights->start * srcRowStride + j;
+        for (size_t i = 0; i < srcCount; ++i) {
+            const int32_t w = srcWeights->fixedWeights[i];
+            for (size_t k = 0; k < blockBytes; ++k) {
+                values[k] += row[k] * w;
+            }
+            row += srcRowStride;
+        }
+        for (size_t k = 0; k < blockBytes; ++k) {
+            dest[j + k] = clampFixed(values[k]);
+        }
+    }
+}
+
+#if defined(IMAGE_SIMD_X86)
+SIMD_TARGET("sse2") static void accumulateRowFixed_SSE2(uint8_t * dest, size_t rowBytes, const uint8_t * src, size_t srcRowStride, const KernelWeights * srcWeights)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(1 << (FIXED_WEIGHT_BITS - 1));
+    const size_t srcCount = srcWeights->end - srcWeights->start + 1;
+    size_t j = 0;
+    for (; j + 16 <= rowBytes; j += 16) {
+        __m128i s0 = rounding, s1 = rounding, s2 = rounding, s3 = rounding;
+        const uint8_t * row = src + srcWeights->start * srcRowStride + j;
+        for (size_t i = 0; i < srcCount; i += 2) {
+            //interleave the bytes of two rows, so pmaddwd does a * w0 + b * w1 for every byte. a single last row is paired with zeros
+            const bool pair = (i + 1) < srcCount;
+            const __m128i a = _mm_loadu_si128((const __m128i *)row);
+            const __m128i b = pair ? _mm_loadu_si128((const __m128i *)(row + srcRowStride)) : zero;
+            const uint32_t w1 = pair ? (uint16_t)srcWeights->fixedWeights[i + 1] : 0;
+            const __m128i w = _mm_set1_epi32((int)(((uint32_t)(uint16_t)srcWeights->fixedWeights[i]) | (w1 << 16)));
+            const __m128i lo = _mm_unpacklo_epi8(a, b);
+            const __m128i hi = _mm_unpackhi_epi8(a, b);
+            s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+            s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+            s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+            s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+            row += 2 * srcRowStride;
+        }
+        //scale down and pack with saturation to 0-255
+        const __m128i p0 = _mm_packs_epi32(_mm_srai_epi32(s0, FIXED_WEIGHT_BITS), _mm_srai_epi32(s1, FIXED_WEIGHT_BITS));
+        const __m128i p1 = _mm_packs_epi32(_mm_srai_epi32(s2, FIXED_WEIGHT_BITS), _mm_srai_epi32(s3, FIXED_WEIGHT_BITS));
+        _mm_storeu_si128((__m128i *)(dest + j), _mm_packus_epi16(p0, p1));
+    }
+    accumulateRowFixed(dest, j, rowBytes, src, srcRowStride, srcWeights);
+}
+
+SIMD_TARGET("avx2") static void accumulateRowFixed_AVX2(uint8_t * dest, size_t rowBytes, const uint8_t * src, size_t srcRowStride, const KernelWeights * srcWeights)
+{
+    //same as the SSE2 version. unpack and pack both work per 128bit lane, so the byte order is restored in the end
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i rounding = _mm256_set1_epi32(1 << (FIXED_WEIGHT_BITS - 1));
+    const size_t srcCount = srcWeights->end - srcWeights->start + 1;
+    size_t j = 0;
+    for (; j + 32 <= rowBytes; j += 32) {
+        __m256i s0 = rounding, s1 = rounding, s2 = rounding, s3 = rounding;
+        const uint8_t * row = src + srcWeights->start * srcRowStride + j;
+        for (size_t i = 0; i < srcCount; i += 2) {
+            const bool pair = (i + 1) < srcCount;
+            const __m256i a = _mm256_loadu_si256((const __m256i *)row);
+            const __m256i b = pair ? _mm256_loadu_si256((const __m256i *)(row + srcRowStride)) : zero;
+            const uint32_t w1 = pair ? (uint16_t)srcWeights->fixedWeights[i + 1] : 0;
+            const __m256i w = _mm256_set1_epi32((int)(((uint32_t)(uint16_t)srcWeights->fixedWeights[i]) | (w1 << 16)));
+            const __m256i lo = _mm256_unpacklo_epi8(a, b);
+            const __m256i hi = _mm256_unpackhi_epi8(a, b);
+            s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), w));
+            s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), w));
+            s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), w));
+            s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), w));
+            row += 2 * srcRowStride;
+        }
+        const __m256i p0 = _mm256_packs_epi32(_mm256_srai_epi32(s0, FIXED_WEIGHT_BITS), _mm256_srai_epi32(s1, FIXED_WEIGHT_BITS));
+        const __m256i p1 = _mm256_packs_epi32(_mm256_srai_epi32(s2, FIXED_WEIGHT_BITS), _mm256_srai_epi32(s3, FIXED_WEIGHT_BITS));
+        _mm256_storeu_si256((__m256i *)(dest + j), _mm256_packus_epi16(p0, p1));
+    }
+    accumulateRowFixed(dest, j, rowBytes, src, srcRowStride, srcWeights);
+}
+#endif
+
+#if defined(IMAGE_SIMD_NEON)
+static void accumulateRowFixed_NEON(uint8_t * dest, size_t rowBytes, const uint8_t * src, size_t srcRowStride, const KernelWeights * srcWeights)
+{
+    const size_t srcCount = srcWeights->end - srcWeights->start + 1;
+    size_t j = 0;
+    for (; j + 16 <= rowBytes; j += 16) {
+        int32x4_t s0 = vdupq_n_s32(0), s1 = vdupq_n_s32(0), s2 = vdupq_n_s32(0), s3 = vdupq_n_s32(0);
+        const uint8_t * row = src + srcWeights->start * srcRowStride + j;
+        for (size_t i = 0; i < srcCount; ++i) {
+            const int16_t w = srcWeights->fixedWeights[i];
+            const uint8x16_t p = vld1q_u8(row);
+            const int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(p)));
+            const int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(p)));
+            s0 = vmlal_n_s16(s0, vget_low_s16(lo), w);
+            s1 = vmlal_n_s16(s1, vget_high_s16(lo), w);
+            s2 = vmlal_n_s16(s2, vget_low_s16(hi), w);
+            s3 = vmlal_n_s16(s3, vget_high_s16(hi), w);
+            row += srcRowStride;
+        }
+        //round, scale down and pack with saturation to 0-255
+        const int16x8_t p0 = vcombine_s16(vqrshrn_n_s32(s0, FIXED_WEIGHT_BITS), vqrshrn_n_s32(s1, FIXED_WEIGHT_BITS));
+        const int16x8_t p1 = vcombine_s16(vqrshrn_n_s32(s2, FIXED_WEIGHT_BITS), vqrshrn_n_s32(s3, FIXED_WEIGHT_BITS));
+        vst1q_u8(dest + j, vcombine_u8(vqmovun_s16(p0), vqmovun_s16(p1)));
+    }
+    accumulateRowFixed(dest, j, rowBytes, src, srcRowStride, srcWeights);
+}
+#endif
+
+void accumulateWeightedRowFixed(uint8_t * dest, size_t rowBytes, const uint8_t * src, size_t srcRowStride, const KernelWeights * srcWeights)
+{
+#if defined(IMAGE_SIMD_X86)
+    if (CpuFeatures::detected().avx2) {
+        accumulateRowFixed_AVX2(dest, rowBytes, src, srcRowStride, srcWeights);
+        return;
+    }
+    if (CpuFeatures::detected().sse2) {
+        accumulateRowFixed_SSE2(dest, rowBytes, src, srcRowStride, srcWeights);
+        return;
+    }
+#elif defined(IMAGE_SIMD_NEON)
+    accumulateRowFixed_NEON(dest, rowBytes, src, srcRowStride, srcWeights);
+    return;
+#endif
+    accumulateRowFixed(dest, 0, rowBytes, src, srcRowStride, srcWeights);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+//Exact 2x2 box downsampling for mipmap generation.
+
+static void downsampleBox2x2(uint8_t * dest, size_t start, size_t destWidth, const uint8_t * src, size_t srcStride, size_t bytesPerPixel)
+{
+    const uint8_t * src0 = src + 2 * start * bytesPerPixel;
+    const uint8_t * src1 = src0 + srcStride;
+    dest += start * bytesPerPixel;
+    for (size_t x = start; x < destWidth; ++x) {
+        for (size_t c = 0; c < bytesPerPixel; ++c) {
+            *dest++ = (uint8_t)((src0[c] + src0[c + bytesPerPixel] + src1[c] + src1[c + bytesPerPixel] + 2) >> 2);
+        }
+        src0 += 2 * bytesPerPixel;
+        src1 += 2 * bytesPerPixel;
+    }
+}
+
+#if defined(IMAGE_SIMD_X86)
+SIMD_TARGET("sse2") static void downsampleBox2x2_SSE2_4(uint8_t * dest, size_t destWidth, const uint8_t * src, size_t srcStride)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    const uint8_t * src0 = src;
+    const uint8_t * src1 = src + srcStride;
+    size_t x = 0;
+    for (; x + 4 <= destWidth; x += 4) {
+        //sum up 8 pixels of both rows vertically in 16bit
+        const __m128i a = _mm_loadu_si128((const __m128i *)src0);
+        const __m128i b = _mm_loadu_si128((const __m128i *)(src0 + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i *)src1);
+        const __m128i d = _mm_loadu_si128((const __m128i *)(src1 + 16));
+        const __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(c, zero));
+        const __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(c, zero));
+        const __m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(d, zero));
+        const __m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(d, zero));
+        //now add neighbouring pixels, which are in the low and high 64bit halves
+        const __m128i p01 = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+        const __m128i p23 = _mm_add_epi16(_mm_unpacklo_epi64(s45, s67), _mm_unpackhi_epi64(s45, s67));
+        //round, divide by 4 and pack to 8bit again
+        const __m128i r01 = _mm_srli_epi16(_mm_add_epi16(p01, two), 2);
+        const __m128i r23 = _mm_srli_epi16(_mm_add_epi16(p23, two), 2);
+        _mm_storeu_si128((__m128i *)(dest + x * 4), _mm_packus_epi16(r01, r23));
+        src0 += 32;
+        src1 += 32;
+    }
+    downsampleBox2x2(dest, x, destWidth, src, srcStride, 4);
+}
+
+SIMD_TARGET("sse2") static void downsampleBox2x2_SSE2_1(uint8_t * dest, size_t destWidth, const uint8_t * src, size_t srcStride)
+{
+    const __m128i lowMask = _mm_set1_epi16(0x00FF);
+    const __m128i two = _mm_set1_epi16(2);
+    const uint8_t * src0 = src;
+    const uint8_t * src1 = src + srcStride;
+    size_t x = 0;
+    for (; x + 16 <= destWidth; x += 16) {
+        const __m128i a = _mm_loadu_si128((const __m128i *)src0);
+        const __m128i b = _mm_loadu_si128((const __m128i *)(src0 + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i *)src1);
+        const __m128i d = _mm_loadu_si128((const __m128i *)(src1 + 16));
+        //add even and odd bytes of both rows in 16bit
+        const __m128i s0 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, lowMask), _mm_srli_epi16(a, 8)), _mm_add_epi16(_mm_and_si128(c, lowMask), _mm_srli_epi16(c, 8)));
+        const __m128i s1 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(b, lowMask), _mm_srli_epi16(b, 8)), _mm_add_epi16(_mm_and_si128(d, lowMask), _mm_srli_epi16(d, 8)));
+        const __m128i r0 = _mm_srli_epi16(_mm_add_epi16(s0, two), 2);
+        const __m128i r1 = _mm_srli_epi16(_mm_add_epi16(s1, two), 2);
+        _mm_storeu_si128((__m128i *)(dest + x), _mm_packus_epi16(r0, r1));
+        src0 += 32;
+        src1 += 32;
+    }
+    downsampleBox2x2(dest, x, destWidth, src, srcStride, 1);
+}
+#endif
+
+#if defined(IMAGE_SIMD_NEON)
+static void downsampleBox2x2_NEON_4(uint8_t * dest, size_t destWidth, const uint8_t * src, size_t srcStride)
+{
+    const uint8_t * src0 = src;
+    const uint8_t * src1 = src + srcStride;
+    size_t x = 0;
+    for (; x + 4 <= destWidth; x += 4) {
+        //deinterleave even and odd pixels
+        const uint32x4x2_t a = vld2q_u32((const uint32_t *)src0);
+        const uint32x4x2_t c = vld2q_u32((const uint32_t *)src1);
+        const uint8x16_t a0 = vreinterpretq_u8_u32(a.val[0]);
+        const uint8x16_t a1 = vreinterpretq_u8_u32(a.val[1]);
+        const uint8x16_t c0 = vreinterpretq_u8_u32(c.val[0]);
+        const uint8x16_t c1 = vreinterpretq_u8_u32(c.val[1]);
+        const uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a0), vget_low_u8(a1)), vaddl_u8(vget_low_u8(c0), vget_low_u8(c1)));
+        const uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a0), vget_high_u8(a1)), vaddl_u8(vget_high_u8(c0), vget_high_u8(c1)));
+        //rounding shift does the + 2
+        vst1q_u8(dest + x * 4, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+        src0 += 32;
+        src1 += 32;
+    }
+    downsampleBox2x2(dest, x, destWidth, src, srcStride, 4);
+}
+
+static void downsampleBox2x2_NEON_1(uint8_t * dest, size_t destWidth, const uint8_t * src, size_t srcStride)
+{
+    const uint8_t * src0 = src;
+    const uint8_t * src1 = src + srcStride;
+    size_t x = 0;
+    for (; x + 16 <= destWidth; x += 16) {
+        //pairwise add neighbouring bytes
+        const uint16x8_t lo = vaddq_u16(vpaddlq_u8(vld1q_u8(src0)), vpaddlq_u8(vld1q_u8(src1)));
+        const uint16x8_t hi = vaddq_u16(vpaddlq_u8(vld1q_u8(src0 + 16)), vpaddlq_u8(vld1q_u8(src1 + 16)));
+        vst1q_u8(dest + x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+        src0 += 32;
+        src1 += 32;
+    }
+    downsampleBox2x2(dest, x, destWidth, src, srcStride, 1);
+}
+#endif
+
+void downsampleBox2x2(uint8_t * dest, size_t destWidth, const uint8_t * src, size_t srcStride, size_t bytesPerPixel)
+{
+#if defined(IMAGE_SIMD_X86)
+    if (CpuFeatures::detected().sse2) {
+        if (bytesPerPixel == 4) {
+            downsampleBox2x2_SSE2_4(dest, destWidth, src, srcStride);
+            return;
+        }
+        else if (bytesPerPixel == 1) {
+            downsampleBox2x2_SSE2_1(dest, destWidth, src, srcStride);
+            return;
+        }
+    }
+#elif defined(IMAGE_SIMD_NEON)
+    if (bytesPerPixel == 4) {
+        downsampleBox2x2_NEON_4(dest, destWidth, src, srcStride);
+        return;
+    }
+    else if (bytesPerPixel == 1) {
+        downsampleBox2x2_NEON_1(dest, destWidth, src, srcStride);
+        return;
     }
+#endif
+    downsampleBox2x2(dest, 0, destWidth, src, srcStride, bytesPerPixel);
 }
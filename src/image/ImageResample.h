@@ -1,17 +1,24 @@
 #pragma once
 
 #include "PixelFormat.h"
+#include "ImageView.h"
 #include "ResampleKernel.h"
 
+#include <memory>
 
+class ResamplePlan;
+
+/*!
+Resampler keeping its last plan and scale buffer around, so scaling repeatedly with the same parameters does not allocate.
+It is not thread-safe. Use one instance per thread or share a ResamplePlan between threads.
+*/
 class ImageResample
 {
-    ResampleKernel m_horizontalKernel;
-    ResampleKernel m_verticalKernel;
+    std::shared_ptr<const ResamplePlan> m_plan; //!< Plan of the last scale operation. Reused if the parameters do not change.
     uint8_t * m_scaleBuffer;
-    size_t m_scaleBufferWidth;
-    size_t m_scaleBufferHeight;
+    size_t m_scaleBufferSize; //!< Capacity of m_scaleBuffer in bytes.
     PixelInfo::FormatType m_formatType;
+    bool m_useFixedPoint;
 
 public:
     /*!
@@ -30,6 +37,21 @@ public:
     */
     ImageResample & operator=(const ImageResample & b);
 
+    /*!
+    Move constructor. Takes over the scale buffer and plan of b.
+    */
+    ImageResample(ImageResample && b);
+
+    /*!
+    Move operator. Takes over the scale buffer and plan of b.
+    */
+    ImageResample & operator=(ImageResample && b);
+
+    /*!
+    Destructor. Frees the scale buffer.
+    */
+    ~ImageResample();
+
     /*!
     Scale image data from one size to another.
     \param[in] dest Output data.
@@ -42,10 +64,42 @@ public:
     \param[in] scaleBuffer Temporary scale buffer of size destWidth x srcHeight. If nullptr it will be allocated internally.
     */
     void scaleImage(uint8_t * dest, size_t destWidth, size_t destHeight, const uint8_t * src, size_t srcWidth, size_t srcHeight, const ResampleFilter & filter);
+
+    /*!
+    Scale image data from one view to another. The views may be sub-rectangles or have padded rows.
+    \param[in] dest Output view. Its size is the output size. If its format differs from the source format, the scaled rows are converted while writing them.
+    \param[in] src Input view.
+    \param[in] filter Resampling filter structure.
+    \note The source view must have the format the resampler was constructed with, else nothing is done.
+    */
+    void scaleImage(const ImageView & dest, const ConstImageView & src, const ResampleFilter & filter);
+
+    /*!
+    Enable or disable the fixed-point integer resampling path. It is used by default for all formats supporting it.
+    \param[in] enable Pass false to always use the floating-point path.
+    */
+    void setUseFixedPoint(bool enable);
+
+    /*!
+    Check if a format can be resampled using the fixed-point integer path.
+    \param[in] formatType Pixel format to check.
+    \return Returns true for formats that only have 8bit color components, e.g. R8G8B8A8 or L8.
+    Palette formats return false, because their indices can not be filtered.
+    */
+    static bool supportsFixedPoint(PixelInfo::FormatType formatType);
 };
 
 //-------------------------------------------------------------------------------------------------
 
+/*!
+Clamp a filtered color component to its valid range. Filters with negative lobes, e.g. Lanczos, can over- and undershoot.
+*/
+template <int BITS>
+static inline float clampComponent(float value)
+{
+    return value < 0.0f ? 0.0f : (value > (float)BIT_MASK(BITS) ? (float)BIT_MASK(BITS) : value);
+}
+
 /*!
 Vertically accumulate pixel colors to pixel while multiplying the new color with a factor. dest += src[i] * srcWeight[i];
 \param[in] dest Destination data pointer.
@@ -56,41 +110,55 @@ Vertically accumulate pixel colors to pixel while multiplying the new color with
 template <int INTYPE>
 static inline void accumulatePixel(uint8_t * dest, const uint8_t * src, size_t srcStride, const KernelWeights * srcWeights)
 {
-    const uint8_t * srcStart = src + srcWeights->start * srcStride;
+    //move to first pixel covered by the kernel
+    src += srcWeights->start * srcStride;
     const size_t srcCount =  srcWeights->end - srcWeights->start + 1;
-    PixelFormat<INTYPE>::Pixel outPixel;
+    typename PixelFormat<INTYPE>::Pixel outPixel = 0;
     //accumulate pixels and write to destination
     if (PixelFormat<INTYPE>::nrOfComponents == 1) {
         float value = 0.0f;
         for (size_t i = 0; i < srcCount; ++i) {
             //get pixel and color(s) from src
-            PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src);
+            typename PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src);
             value += PixelFormat<INTYPE>::getR(inPixel) * srcWeights->weights[i];
             //next pixel
             src += srcStride;
         }
-        PixelFormat<INTYPE>::setR(outPixel, (PixelFormat<INTYPE>::Color)(value * srcWeights->invSum));
+        PixelFormat<INTYPE>::setR(outPixel, (typename PixelFormat<INTYPE>::Color)clampComponent<PixelFormat<INTYPE>::bitsRed>(value * srcWeights->invSum));
+    }
+    else if (PixelFormat<INTYPE>::nrOfComponents == 2) {
+        float values[2] = {0.0f, 0.0f};
+        for (size_t i = 0; i < srcCount; ++i) {
+            //get pixel and gray and alpha from src
+            typename PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src);
+            values[0] += PixelFormat<INTYPE>::getR(inPixel) * srcWeights->weights[i];
+            values[1] += PixelFormat<INTYPE>::getA(inPixel) * srcWeights->weights[i];
+            //next pixel
+            src += srcStride;
+        }
+        PixelFormat<INTYPE>::setR(outPixel, (typename PixelFormat<INTYPE>::Color)clampComponent<PixelFormat<INTYPE>::bitsRed>(values[0] * srcWeights->invSum));
+        PixelFormat<INTYPE>::setA(outPixel, (typename PixelFormat<INTYPE>::Color)clampComponent<PixelFormat<INTYPE>::bitsAlpha>(values[1] * srcWeights->invSum));
     }
     else if (PixelFormat<INTYPE>::nrOfComponents == 3) {
         float values[3] = {0.0f, 0.0f, 0.0f};
         for (size_t i = 0; i < srcCount; ++i) {
             //get pixel and color(s) from src
-            PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src);
+            typename PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src);
             values[0] += PixelFormat<INTYPE>::getR(inPixel) * srcWeights->weights[i];
             values[1] += PixelFormat<INTYPE>::getG(inPixel) * srcWeights->weights[i];
             values[2] += PixelFormat<INTYPE>::getB(inPixel) * srcWeights->weights[i];
             //next pixel
             src += srcStride;
         }
-        PixelFormat<INTYPE>::setR(outPixel, (PixelFormat<INTYPE>::Color)(values[0] * srcWeights->invSum));
-        PixelFormat<INTYPE>::setG(outPixel, (PixelFormat<INTYPE>::Color)(values[1] * srcWeights->invSum));
-        PixelFormat<INTYPE>::setB(outPixel, (PixelFormat<INTYPE>::Color)(values[2] * srcWeights->invSum));
+        PixelFormat<INTYPE>::setR(outPixel, (typename PixelFormat<INTYPE>::Color)clampComponent<PixelFormat<INTYPE>::bitsRed>(values[0] * srcWeights->invSum));
+        PixelFormat<INTYPE>::setG(outPixel, (typename PixelFormat<INTYPE>::Color)clampComponent<PixelFormat<INTYPE>::bitsGreen>(values[1] * srcWeights->invSum));
+        PixelFormat<INTYPE>::setB(outPixel, (typename PixelFormat<INTYPE>::Color)clampComponent<PixelFormat<INTYPE>::bitsBlue>(values[2] * srcWeights->invSum));
     }
     else if (PixelFormat<INTYPE>::nrOfComponents == 4) {
         float values[4] = {0.0f, 0.0f, 0.0f, 0.0f};
         for (size_t i = 0; i < srcCount; ++i) {
             //get pixel and color(s) from src
-            PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src);
+            typename PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src);
             values[0] += PixelFormat<INTYPE>::getR(inPixel) * srcWeights->weights[i];
             values[1] += PixelFormat<INTYPE>::getG(inPixel) * srcWeights->weights[i];
             values[2] += PixelFormat<INTYPE>::getB(inPixel) * srcWeights->weights[i];
@@ -98,10 +166,10 @@ static inline void accumulatePixel(uint8_t * dest, const uint8_t * src, size_t s
             //next pixel
             src += srcStride;
         }
-        PixelFormat<INTYPE>::setR(outPixel, (PixelFormat<INTYPE>::Color)(values[0] * srcWeights->invSum));
-        PixelFormat<INTYPE>::setG(outPixel, (PixelFormat<INTYPE>::Color)(values[1] * srcWeights->invSum));
-        PixelFormat<INTYPE>::setB(outPixel, (PixelFormat<INTYPE>::Color)(values[2] * srcWeights->invSum));
-        PixelFormat<INTYPE>::setA(outPixel, (PixelFormat<INTYPE>::Color)(values[3] * srcWeights->invSum));
+        PixelFormat<INTYPE>::setR(outPixel, (typename PixelFormat<INTYPE>::Color)clampComponent<PixelFormat<INTYPE>::bitsRed>(values[0] * srcWeights->invSum));
+        PixelFormat<INTYPE>::setG(outPixel, (typename PixelFormat<INTYPE>::Color)clampComponent<PixelFormat<INTYPE>::bitsGreen>(values[1] * srcWeights->invSum));
+        PixelFormat<INTYPE>::setB(outPixel, (typename PixelFormat<INTYPE>::Color)clampComponent<PixelFormat<INTYPE>::bitsBlue>(values[2] * srcWeights->invSum));
+        PixelFormat<INTYPE>::setA(outPixel, (typename PixelFormat<INTYPE>::Color)clampComponent<PixelFormat<INTYPE>::bitsAlpha>(values[3] * srcWeights->invSum));
     }
     PixelFormat<INTYPE>::setPixel(dest, outPixel);
 }
@@ -119,3 +187,57 @@ static inline void accumulatePixel(uint8_t * dest, size_t destStride, size_t cou
 }
 
 void accumulateWeighted(uint8_t * dest, size_t destStride, size_t count, const uint8_t * src, size_t srcStride, const KernelWeights * srcWeights, PixelInfo::FormatType m_formatType);
+
+/*!
+Calculate a row of destination pixels as the weighted sum of whole source rows. All pixels in the row use the same weights.
+\param[in] dest Destination row data pointer.
+\param[in] count Number of pixels in the row.
+\param[in] src Pointer to the first source row. The kernel start offset is added internally.
+\param[in] srcRowStride Byte-stride to start of next source row.
+\param[in] srcWeights Kernel weights for this destination row.
+*/
+template <int INTYPE>
+static inline void accumulateRow(uint8_t * dest, size_t count, const uint8_t * src, size_t srcRowStride, const KernelWeights * srcWeights)
+{
+    for (size_t x = 0; x < count; ++x) {
+        //accumulate pixels vertically and write to destination
+        accumulatePixel<INTYPE>(dest, src, srcRowStride, srcWeights);
+        //next pixel in row
+        dest += PixelFormat<INTYPE>::bytesPerPixel;
+        src += PixelFormat<INTYPE>::bytesPerPixel;
+    }
+}
+
+void accumulateWeightedRow(uint8_t * dest, size_t count, const uint8_t * src, size_t srcRowStride, const KernelWeights * srcWeights, PixelInfo::FormatType formatType);
+
+/*!
+Accumulate pixels using fixed-point weights. This treats every byte of a pixel as a separate 8bit color component, so it works for all formats \sa ImageResample::supportsFixedPoint returns true for.
+\param[in] dest Destination data pointer.
+\param[in] destStride Byte-stride to start of next destination pixel.
+\param[in] count Number of destination pixels to calculate.
+\param[in] src Source data pointer.
+\param[in] srcStride Byte-stride to start of next source pixel.
+\param[in] srcWeights Array of kernel weights, one for every destination pixel.
+\param[in] bytesPerPixel Number of bytes and thus color components per pixel.
+*/
+void accumulateWeightedFixed(uint8_t * dest, size_t destStride, size_t count, const uint8_t * src, size_t srcStride, const KernelWeights * srcWeights, size_t bytesPerPixel);
+
+/*!
+Calculate a destination row as the weighted sum of whole source rows using fixed-point weights. Every byte is treated as a separate 8bit color component, so this is vectorized across the row.
+\param[in] dest Destination row data pointer.
+\param[in] rowBytes Number of bytes in the row.
+\param[in] src Pointer to the first source row. The kernel start offset is added internally.
+\param[in] srcRowStride Byte-stride to start of next source row.
+\param[in] srcWeights Kernel weights for this destination row.
+*/
+void accumulateWeightedRowFixed(uint8_t * dest, size_t rowBytes, const uint8_t * src, size_t srcRowStride, const KernelWeights * srcWeights);
+
+/*!
+Calculate one destination row by averaging 2x2 blocks of source pixels. The result is exact, (a + b + c + d + 2) / 4 for every 8bit color component.
+\param[in] dest Destination row data pointer.
+\param[in] destWidth Number of pixels in destination row. The source rows must have at least 2 * destWidth pixels.
+\param[in] src Pointer to first of the two source rows.
+\param[in] srcStride Byte-stride to start of the second source row.
+\param[in] bytesPerPixel Number of bytes and thus color components per pixel. Only formats \sa ImageResample::supportsFixedPoint returns true for are supported.
+*/
+void downsampleBox2x2(uint8_t * dest, size_t destWidth, const uint8_t * src, size_t srcStride, size_t bytesPerPixel);
@@ -0,0 +1,337 @@
+#include "ImageStatistics.h"
+#include "Image.h"
+#include "PixelAllocator.h"
+
+#include <math.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+
+//Colors are hashed into a bitmap of this many bits. The number of bits still zero gives the number of unique colors (linear counting).
+#define UNIQUE_HASH_BITS 16
+#define UNIQUE_HASH_SIZE (1 << UNIQUE_HASH_BITS)
+//Multipliers of the color hash. A multiply alone keeps the high bits of colors like 0xRRGGBB00 in the high bits of the hash,
+//which collides a lot for smooth gradients, so the hash is mixed like the MurmurHash3 finalizer: multiply, xor-shift, multiply.
+#define UNIQUE_HASH_MULTIPLIER0 0x9E3779B1
+#define UNIQUE_HASH_MULTIPLIER1 0x85EBCA6B
+
+//Red, green and blue of a R8G8B8A8 pixel differ if any of these bits of pixel ^ (pixel >> 8) are set.
+#define NOT_GRAY_MASK 0x00FFFF00
+
+/*!
+Update the statistics of a row of R8G8B8A8 pixels that can be calculated in SIMD registers.
+\param[in] minimum Bytewise minimum of all pixels so far.
+\param[in] maximum Bytewise maximum of all pixels so far.
+\param[in] notGray Bits set if red, green and blue of some pixel so far differ.
+\param[in] hashes Receives the bitmap index of every pixel.
+\param[in] pixels R8G8B8A8 pixels.
+\param[in] count Number of pixels.
+*/
+typedef void (*StatisticsRowFunction)(uint32_t & minimum, uint32_t & maximum, uint32_t & notGray, uint32_t * hashes, const uint32_t * pixels, size_t count);
+
+static inline uint32_t minBytes(uint32_t a, uint32_t b)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        const uint32_t x = (a >> shift) & 0xFF;
+        const uint32_t y = (b >> shift) & 0xFF;
+        result |= (x < y ? x : y) << shift;
+    }
+    return result;
+}
+
+static inline uint32_t maxBytes(uint32_t a, uint32_t b)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        const uint32_t x = (a >> shift) & 0xFF;
+        const uint32_t y = (b >> shift) & 0xFF;
+        result |= (x > y ? x : y) << shift;
+    }
+    return result;
+}
+
+static inline uint32_t colorHash(uint32_t pixel)
+{
+    uint32_t hash = pixel * (uint32_t)UNIQUE_HASH_MULTIPLIER0;
+    hash ^= hash >> 16;
+    return (hash * (uint32_t)UNIQUE_HASH_MULTIPLIER1) >> (32 - UNIQUE_HASH_BITS);
+}
+
+static void statisticsRow(uint32_t & minimum, uint32_t & maximum, uint32_t & notGray, uint32_t * hashes, const uint32_t * pixels, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t pixel = pixels[i];
+        minimum = minBytes(minimum, pixel);
+        maximum = maxBytes(maximum, pixel);
+        notGray |= (pixel ^ (pixel >> 8)) & NOT_GRAY_MASK;
+        hashes[i] = colorHash(pixel);
+    }
+}
+
+//Fold the lanes of SIMD registers into the scalar values.
+static void foldLanes(uint32_t & minimum, uint32_t & maximum, uint32_t & notGray, const uint32_t * minLanes, const uint32_t * maxLanes, const uint32_t * grayLanes, size_t nrOfLanes)
+{
+    for (size_t i = 0; i < nrOfLanes; ++i) {
+        minimum = minBytes(minimum, minLanes[i]);
+        maximum = maxBytes(maximum, maxLanes[i]);
+        notGray |= grayLanes[i];
+    }
+}
+
+#if defined(IMAGE_SIMD_X86)
+
+//SSE2 has no 32bit multiplication keeping the low bits. Multiply the even and odd lanes separately and put them back together.
+SIMD_TARGET("sse2") static inline __m128i mullo32_SSE2(__m128i a, __m128i b)
+{
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+SIMD_TARGET("sse2") static void statisticsRow_SSE2(uint32_t & minimum, uint32_t & maximum, uint32_t & notGray, uint32_t * hashes, const uint32_t * pixels, size_t count)
+{
+    const __m128i multiplier0 = _mm_set1_epi32((int)UNIQUE_HASH_MULTIPLIER0);
+    const __m128i multiplier1 = _mm_set1_epi32((int)UNIQUE_HASH_MULTIPLIER1);
+    const __m128i grayMask = _mm_set1_epi32(NOT_GRAY_MASK);
+    __m128i minimumLanes = _mm_set1_epi32((int)minimum);
+    __m128i maximumLanes = _mm_set1_epi32((int)maximum);
+    __m128i grayLanes = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128((const __m128i *)(pixels + i));
+        //the bytes of all lanes are the same components, so bytewise min / max works on all of them at once
+        minimumLanes = _mm_min_epu8(minimumLanes, p);
+        maximumLanes = _mm_max_epu8(maximumLanes, p);
+        grayLanes = _mm_or_si128(grayLanes, _mm_and_si128(_mm_xor_si128(p, _mm_srli_epi32(p, 8)), grayMask));
+        const __m128i hash = mullo32_SSE2(p, multiplier0);
+        _mm_storeu_si128((__m128i *)(hashes + i), _mm_srli_epi32(mullo32_SSE2(_mm_xor_si128(hash, _mm_srli_epi32(hash, 16)), multiplier1), 32 - UNIQUE_HASH_BITS));
+    }
+    uint32_t minLanes[4];
+    uint32_t maxLanes[4];
+    uint32_t notGrayLanes[4];
+    _mm_storeu_si128((__m128i *)minLanes, minimumLanes);
+    _mm_storeu_si128((__m128i *)maxLanes, maximumLanes);
+    _mm_storeu_si128((__m128i *)notGrayLanes, grayLanes);
+    foldLanes(minimum, maximum, notGray, minLanes, maxLanes, notGrayLanes, 4);
+    statisticsRow(minimum, maximum, notGray, hashes + i, pixels + i, count - i);
+}
+
+SIMD_TARGET("avx2") static void statisticsRow_AVX2(uint32_t & minimum, uint32_t & maximum, uint32_t & notGray, uint32_t * hashes, const uint32_t * pixels, size_t count)
+{
+    const __m256i multiplier0 = _mm256_set1_epi32((int)UNIQUE_HASH_MULTIPLIER0);
+    const __m256i multiplier1 = _mm256_set1_epi32((int)UNIQUE_HASH_MULTIPLIER1);
+    const __m256i grayMask = _mm256_set1_epi32(NOT_GRAY_MASK);
+    __m256i minimumLanes = _mm256_set1_epi32((int)minimum);
+    __m256i maximumLanes = _mm256_set1_epi32((int)maximum);
+    __m256i grayLanes = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i p = _mm256_loadu_si256((const __m256i *)(pixels + i));
+        minimumLanes = _mm256_min_epu8(minimumLanes, p);
+        maximumLanes = _mm256_max_epu8(maximumLanes, p);
+        grayLanes = _mm256_or_si256(grayLanes, _mm256_and_si256(_mm256_xor_si256(p, _mm256_srli_epi32(p, 8)), grayMask));
+        const __m256i hash = _mm256_mullo_epi32(p, multiplier0);
+        _mm256_storeu_si256((__m256i *)(hashes + i), _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_xor_si256(hash, _mm256_srli_epi32(hash, 16)), multiplier1), 32 - UNIQUE_HASH_BITS));
+    }
+    uint32_t minLanes[8];
+    uint32_t maxLanes[8];
+    uint32_t notGrayLanes[8];
+    _mm256_storeu_si256((__m256i *)minLanes, minimumLanes);
+    _mm256_storeu_si256((__m256i *)maxLanes, maximumLanes);
+    _mm256_storeu_si256((__m256i *)notGrayLanes, grayLanes);
+    foldLanes(minimum, maximum, notGray, minLanes, maxLanes, notGrayLanes, 8);
+    statisticsRow(minimum, maximum, notGray, hashes + i, pixels + i, count - i);
+}
+
+#endif
+
+#if defined(IMAGE_SIMD_NEON)
+
+static void statisticsRow_NEON(uint32_t & minimum, uint32_t & maximum, uint32_t & notGray, uint32_t * hashes, const uint32_t * pixels, size_t count)
+{
+    const uint32x4_t multiplier0 = vdupq_n_u32(UNIQUE_HASH_MULTIPLIER0);
+    const uint32x4_t multiplier1 = vdupq_n_u32(UNIQUE_HASH_MULTIPLIER1);
+    const uint32x4_t grayMask = vdupq_n_u32(NOT_GRAY_MASK);
+    uint8x16_t minimumLanes = vreinterpretq_u8_u32(vdupq_n_u32(minimum));
+    uint8x16_t maximumLanes = vreinterpretq_u8_u32(vdupq_n_u32(maximum));
+    uint32x4_t grayLanes = vdupq_n_u32(0);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint32x4_t p = vld1q_u32(pixels + i);
+        minimumLanes = vminq_u8(minimumLanes, vreinterpretq_u8_u32(p));
+        maximumLanes = vmaxq_u8(maximumLanes, vreinterpretq_u8_u32(p));
+        grayLanes = vorrq_u32(grayLanes, vandq_u32(veorq_u32(p, vshrq_n_u32(p, 8)), grayMask));
+        const uint32x4_t hash = vmulq_u32(p, multiplier0);
+        vst1q_u32(hashes + i, vshrq_n_u32(vmulq_u32(veorq_u32(hash, vshrq_n_u32(hash, 16)), multiplier1), 32 - UNIQUE_HASH_BITS));
+    }
+    uint32_t minLanes[4];
+    uint32_t maxLanes[4];
+    uint32_t notGrayLanes[4];
+    vst1q_u32(minLanes, vreinterpretq_u32_u8(minimumLanes));
+    vst1q_u32(maxLanes, vreinterpretq_u32_u8(maximumLanes));
+    vst1q_u32(notGrayLanes, grayLanes);
+    foldLanes(minimum, maximum, notGray, minLanes, maxLanes, notGrayLanes, 4);
+    statisticsRow(minimum, maximum, notGray, hashes + i, pixels + i, count - i);
+}
+
+#endif
+
+static StatisticsRowFunction getStatisticsRowFunction(const CpuFeatures & features)
+{
+#if defined(IMAGE_SIMD_X86)
+    if (features.avx2) {
+        return statisticsRow_AVX2;
+    }
+    if (features.sse2) {
+        return statisticsRow_SSE2;
+    }
+#endif
+#if defined(IMAGE_SIMD_NEON)
+    if (features.neon) {
+        return statisticsRow_NEON;
+    }
+#endif
+    return statisticsRow;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+//Statistics of a band of rows. Bands are calculated in parallel and summed up afterwards, so no thread has to wait for another one.
+struct StatisticsBand
+{
+    uint32_t minimum;
+    uint32_t maximum;
+    uint32_t notGray;
+    uint32_t histogram[4][256];
+    uint32_t colorBits[UNIQUE_HASH_SIZE / 32];
+};
+
+ImageStatistics calculateStatistics(const ConstImageView & view)
+{
+    return calculateStatistics(view, CpuFeatures::detected());
+}
+
+ImageStatistics calculateStatistics(const ConstImageView & view, const CpuFeatures & features)
+{
+    if (view.data == nullptr || view.width == 0 || view.height == 0) {
+        throw ImageException("calculateStatistics() - Invalid image data!");
+    }
+    const PixelInfo & info = PixelInfo::pixelInfo(view.formatType);
+    if (view.formatType <= PixelInfo::BAD_FORMAT || view.formatType >= PixelInfo::MAX_FORMAT || info.compressed || info.paletteEntries > 0) {
+        throw ImageException("calculateStatistics() - Invalid image format!");
+    }
+    const StatisticsRowFunction rowFunction = getStatisticsRowFunction(features);
+    //a few bands per core balance the load without making the final sum expensive
+    const size_t nrOfCores = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+    const size_t nrOfBands = view.height < 4 * nrOfCores ? view.height : 4 * nrOfCores;
+    std::vector<StatisticsBand> bands(nrOfBands);
+#pragma omp parallel
+    {
+        //rows in other formats are converted to R8G8B8A8 first. the buffer also holds the hashes of a row
+        uint32_t * buffer = (uint32_t *)PixelAllocator::allocate(2 * view.width * sizeof(uint32_t));
+        uint32_t * hashes = buffer + view.width;
+#pragma omp for schedule(dynamic)
+        for (int b = 0; b < (int)nrOfBands; ++b) {
+            StatisticsBand & band = bands[b];
+            memset(&band, 0, sizeof(StatisticsBand));
+            band.minimum = 0xFFFFFFFF;
+            for (size_t y = (b * view.height) / nrOfBands; y < ((b + 1) * view.height) / nrOfBands; ++y) {
+                const uint32_t * pixels = (const uint32_t *)view.row(y);
+                if (view.formatType != PixelInfo::R8G8B8A8) {
+                    convertFormat((uint8_t *)buffer, nullptr, PixelInfo::R8G8B8A8, view.row(y), nullptr, view.formatType, view.width);
+                    pixels = buffer;
+                }
+                rowFunction(band.minimum, band.maximum, band.notGray, hashes, pixels, view.width);
+                //scattered increments can not be vectorized. the row is still in the cache though
+                for (size_t x = 0; x < view.width; ++x) {
+                    const uint32_t pixel = pixels[x];
+                    band.histogram[0][pixel >> 24]++;
+                    band.histogram[1][(pixel >> 16) & 0xFF]++;
+                    band.histogram[2][(pixel >> 8) & 0xFF]++;
+                    band.histogram[3][pixel & 0xFF]++;
+                    band.colorBits[hashes[x] >> 5] |= 1u << (hashes[x] & 31);
+                }
+            }
+        }
+        PixelAllocator::release((uint8_t *)buffer);
+    }
+    //sum up the bands
+    ImageStatistics statistics;
+    memset(&statistics, 0, sizeof(ImageStatistics));
+    statistics.pixelCount = view.width * view.height;
+    uint32_t minimum = 0xFFFFFFFF;
+    uint32_t maximum = 0;
+    uint32_t notGray = 0;
+    std::vector<uint32_t> colorBits(UNIQUE_HASH_SIZE / 32, 0);
+    for (size_t b = 0; b < nrOfBands; ++b) {
+        minimum = minBytes(minimum, bands[b].minimum);
+        maximum = maxBytes(maximum, bands[b].maximum);
+        notGray |= bands[b].notGray;
+        for (size_t c = 0; c < 4; ++c) {
+            for (size_t i = 0; i < 256; ++i) {
+                statistics.histogram[c][i] += bands[b].histogram[c][i];
+            }
+        }
+        for (size_t i = 0; i < colorBits.size(); ++i) {
+            colorBits[i] |= bands[b].colorBits[i];
+        }
+    }
+    for (size_t c = 0; c < 4; ++c) {
+        statistics.minimum[c] = (uint8_t)(minimum >> (24 - 8 * c));
+        statistics.maximum[c] = (uint8_t)(maximum >> (24 - 8 * c));
+    }
+    statistics.grayscale = notGray == 0;
+    //alpha values other than 0 and 255 need a full alpha channel
+    statistics.alphaType = statistics.minimum[3] == 255 ? ImageStatistics::ALPHA_OPAQUE : ImageStatistics::ALPHA_BINARY;
+    for (size_t i = 1; i < 255; ++i) {
+        if (statistics.histogram[3][i] > 0) {
+            statistics.alphaType = ImageStatistics::ALPHA_FULL;
+            break;
+        }
+    }
+    //linear counting. a full bitmap only tells us there are a lot of colors
+    size_t zeroBits = 0;
+    for (size_t i = 0; i < colorBits.size(); ++i) {
+        uint32_t bits = ~colorBits[i];
+        for (; bits != 0; bits &= bits - 1) {
+            ++zeroBits;
+        }
+    }
+    const double estimate = (double)UNIQUE_HASH_SIZE * log((double)UNIQUE_HASH_SIZE / (double)(zeroBits > 0 ? zeroBits : 1));
+    statistics.uniqueColors = (size_t)(estimate + 0.5) < statistics.pixelCount ? (size_t)(estimate + 0.5) : statistics.pixelCount;
+    return statistics;
+}
+
+//Check if all values of a channel are stored exactly with 4 bits, i.e. are multiples of 17
+static bool fitsFourBits(const uint32_t * histogram)
+{
+    for (size_t i = 0; i < 256; ++i) {
+        if (histogram[i] > 0 && (i % 17) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+PixelInfo::FormatType compactFormat(const ImageStatistics & statistics)
+{
+    if (statistics.grayscale) {
+        return statistics.alphaType == ImageStatistics::ALPHA_OPAQUE ? PixelInfo::L8 : PixelInfo::L8A8;
+    }
+    switch (statistics.alphaType) {
+        case ImageStatistics::ALPHA_OPAQUE:
+            return PixelInfo::R5G6B5;
+        case ImageStatistics::ALPHA_BINARY:
+            return PixelInfo::R5G5B5A1;
+        default:
+            //4bit colors and alpha band soft gradients, so only use them if they lose nothing
+            for (size_t c = 0; c < 4; ++c) {
+                if (!fitsFourBits(statistics.histogram[c])) {
+                    return PixelInfo::R8G8B8A8;
+                }
+            }
+            return PixelInfo::R4G4B4A4;
+    }
+}
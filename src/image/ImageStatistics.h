@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ImageView.h"
+#include "CpuFeatures.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*!
+Statistics of the pixels of an image, e.g. to pick a texture format. Components are given in 8bit, whatever the format of the image is.
+*/
+struct ImageStatistics
+{
+    enum AlphaType { ALPHA_OPAQUE, //!<All pixels have an alpha of 255. Formats without alpha are always opaque.
+                     ALPHA_BINARY, //!<Pixels are either fully transparent or fully opaque, so 1bit alpha is enough.
+                     ALPHA_FULL, //!<Some pixels are partially transparent.
+    };
+
+    size_t pixelCount; //!< Number of pixels.
+    uint8_t minimum[4]; //!< Minimum red, green, blue and alpha.
+    uint8_t maximum[4]; //!< Maximum red, green, blue and alpha.
+    uint32_t histogram[4][256]; //!< Number of pixels with each value of red, green, blue and alpha.
+    AlphaType alphaType; //!< Kind of alpha channel the image needs.
+    bool grayscale; //!< True if red, green and blue are equal in all pixels.
+    size_t uniqueColors; //!< Estimated number of different R8G8B8A8 colors. Accurate to a few percent up to ~100000 colors, bigger counts are underestimated.
+};
+
+/*!
+Calculate the statistics of a view in a single pass. Rows are converted to R8G8B8A8 if needed and split between threads.
+Minimum, maximum, the grayscale check and the color hashes use SSE2, AVX2 or NEON if available.
+\param[in] view Input view. Palette and compressed formats are not supported.
+\return Returns the statistics of all pixels.
+\note Throws an ImageException if the view is invalid.
+*/
+ImageStatistics calculateStatistics(const ConstImageView & view);
+
+/*!
+Calculate the statistics of a view using only some CPU features. The result does not depend on the features, use this to test the SIMD code.
+*/
+ImageStatistics calculateStatistics(const ConstImageView & view, const CpuFeatures & features);
+
+/*!
+Get the smallest uncompressed format that is good enough for the pixels, e.g. to upload textures to OpenGL ES 2.0 in a native format.
+Grayscale images use L8 or L8A8 and stay exact. Color images use R5G6B5 or R5G5B5A1 depending on the kind of alpha they need.
+Color images with soft alpha use R4G4B4A4 only if all their values are stored exactly with 4 bits, else they keep R8G8B8A8.
+\param[in] statistics Statistics of the image.
+\return Returns L8, L8A8, R5G6B5, R5G5B5A1, R4G4B4A4 or R8G8B8A8.
+*/
+PixelInfo::FormatType compactFormat(const ImageStatistics & statistics);
@@ -1,7 +1,1664 @@
 #include "Image.h"
+#include "PixelFormatSIMD.h"
+#include "ResampleStream.h"
+#include "SummedAreaTable.h"
+#include "TextureAtlas.h"
+#include "ETC1Codec.h"
+#include "S3TCCodec.h"
+#include "KTXFile.h"
+#include "ImageStatistics.h"
+#include "MappedFile.h"
+#include "PixelAllocator.h"
 
-void main()
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+
+//count all bytes allocated through operator new, so we can check which code paths allocate
+static std::atomic<size_t> s_allocatedBytes(0);
+
+void * operator new(size_t size)
+{
+    s_allocatedBytes += size;
+    void * memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void * operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void * memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void * memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void * memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void * memory, size_t) noexcept
+{
+    free(memory);
+}
+
+//pixel buffers do not use operator new, so plug in an allocator counting them too
+class CountingAllocator : public PixelAllocator
+{
+public:
+    virtual void * allocateBlock(size_t size) override
+    {
+        s_allocatedBytes += size;
+        return systemAllocate(size);
+    }
+
+    virtual void freeBlock(void * block, size_t) override
+    {
+        systemFree(block);
+    }
+};
+
+static CountingAllocator s_countingAllocator;
+
+/*!
+Check a SIMD row conversion function bit-for-bit against the scalar convertPixel<> template.
+\param[in] features CPU features the SIMD function may use.
+\param[in] featureName Name of feature set for output.
+\return Returns false if the results differ.
+*/
+template <int OUTTYPE, int INTYPE>
+static bool testConvertRow(const CpuFeatures & features, const std::string & featureName)
+{
+    ConvertRowFunction rowFunction = getConvertRowFunction((PixelInfo::FormatType)OUTTYPE, (PixelInfo::FormatType)INTYPE, features);
+    if (rowFunction == nullptr) {
+        return true;
+    }
+    //use an odd pixel count and offsets to exercise the unaligned and scalar tail code paths
+    const size_t count = 1037;
+    std::vector<uint8_t> source(count * PixelFormat<INTYPE>::bytesPerPixel + 16);
+    std::vector<uint8_t> reference(count * PixelFormat<OUTTYPE>::bytesPerPixel + 16, 0);
+    std::vector<uint8_t> result(count * PixelFormat<OUTTYPE>::bytesPerPixel + 16, 0);
+    for (size_t i = 0; i < source.size(); ++i) {
+        source[i] = (uint8_t)(rand() & 0xFF);
+    }
+    bool passed = true;
+    for (size_t offset = 0; offset < 4; ++offset) {
+        const uint8_t * src = source.data() + offset;
+        for (size_t i = 0; i < count; ++i) {
+            convertPixel<OUTTYPE, INTYPE>(reference.data() + offset + i * PixelFormat<OUTTYPE>::bytesPerPixel, src + i * PixelFormat<INTYPE>::bytesPerPixel);
+        }
+        rowFunction(result.data() + offset, src, count);
+        passed &= memcmp(reference.data() + offset, result.data() + offset, count * PixelFormat<OUTTYPE>::bytesPerPixel) == 0;
+    }
+    std::cout << "Convert " << PixelFormat<INTYPE>::name() << " -> " << PixelFormat<OUTTYPE>::name() << " (" << featureName << "): " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+static bool testConvertRows(const CpuFeatures & features, const std::string & featureName)
+{
+    bool passed = true;
+    passed &= testConvertRow<PixelInfo::R8G8B8A8, PixelInfo::R8G8B8>(features, featureName);
+    passed &= testConvertRow<PixelInfo::R8G8B8, PixelInfo::R8G8B8A8>(features, featureName);
+    passed &= testConvertRow<PixelInfo::R8G8B8A8, PixelInfo::A8R8G8B8>(features, featureName);
+    passed &= testConvertRow<PixelInfo::A8R8G8B8, PixelInfo::R8G8B8A8>(features, featureName);
+    passed &= testConvertRow<PixelInfo::R5G6B5, PixelInfo::R8G8B8A8>(features, featureName);
+    passed &= testConvertRow<PixelInfo::R4G4B4A4, PixelInfo::R8G8B8A8>(features, featureName);
+    passed &= testConvertRow<PixelInfo::X1R5G5B5, PixelInfo::R8G8B8A8>(features, featureName);
+    return passed;
+}
+
+/*!
+Test the row conversion functions of every instruction set this CPU supports.
+*/
+static bool testPixelConversion()
+{
+    const CpuFeatures & detected = CpuFeatures::detected();
+    bool passed = true;
+    CpuFeatures features;
+    if (detected.sse2) {
+        features.sse2 = true;
+        passed &= testConvertRows(features, "SSE2");
+    }
+    if (detected.ssse3) {
+        features.ssse3 = true;
+        passed &= testConvertRows(features, "SSSE3");
+    }
+    if (detected.avx2) {
+        features.avx2 = true;
+        passed &= testConvertRows(features, "AVX2");
+    }
+    if (detected.neon) {
+        features.neon = true;
+        passed &= testConvertRows(features, "NEON");
+    }
+    //palette indices are looked up in the palette
+    uint32_t palette[256];
+    for (size_t i = 0; i < 256; ++i) {
+        palette[i] = (uint32_t)rand() << 8 | 0xFF;
+    }
+    std::vector<uint8_t> indices(5000);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        indices[i] = (uint8_t)(rand() & 0xFF);
+    }
+    std::vector<uint32_t> colors(indices.size());
+    std::vector<uint8_t> packed(indices.size() * 2);
+    convertFormat((uint8_t *)colors.data(), nullptr, PixelInfo::R8G8B8A8, indices.data(), (const uint8_t *)palette, PixelInfo::I8, indices.size());
+    convertFormat(packed.data(), nullptr, PixelInfo::R5G6B5, indices.data(), (const uint8_t *)palette, PixelInfo::I8, indices.size());
+    bool palettePassed = true;
+    for (size_t i = 0; i < indices.size() && palettePassed; ++i) {
+        uint8_t expected[2];
+        convertPixel<PixelInfo::R5G6B5, PixelInfo::R8G8B8A8>(expected, (const uint8_t *)&palette[indices[i]]);
+        palettePassed = colors[i] == palette[indices[i]] && memcmp(expected, packed.data() + i * 2, 2) == 0;
+    }
+    std::cout << "Convert I8 with palette -> R8G8B8A8, R5G6B5: " << (palettePassed ? "passed" : "FAILED") << std::endl;
+    passed &= palettePassed;
+    return passed;
+}
+
+/*!
+Check the fixed-point resampling path against the floating-point path. The float path truncates in both passes, the fixed-point path rounds, so we allow a difference of 2.
+*/
+static bool testFixedPointResample(PixelInfo::FormatType formatType, size_t srcWidth, size_t srcHeight, size_t destWidth, size_t destHeight, const ResampleFilter & filter = ResampleLinear(), const std::string & filterName = "Linear")
 {
+    const size_t bytesPerPixel = PixelInfo::pixelInfo(formatType).bytesPerPixel;
+    std::vector<uint8_t> source(srcWidth * srcHeight * bytesPerPixel);
+    for (size_t i = 0; i < source.size(); ++i) {
+        source[i] = (uint8_t)(rand() & 0xFF);
+    }
+    std::vector<uint8_t> floatResult(destWidth * destHeight * bytesPerPixel);
+    std::vector<uint8_t> fixedResult(destWidth * destHeight * bytesPerPixel);
+    ImageResample resampler(formatType);
+    resampler.setUseFixedPoint(false);
+    resampler.scaleImage(floatResult.data(), destWidth, destHeight, source.data(), srcWidth, srcHeight, filter);
+    resampler.setUseFixedPoint(true);
+    resampler.scaleImage(fixedResult.data(), destWidth, destHeight, source.data(), srcWidth, srcHeight, filter);
+    int maxDifference = 0;
+    for (size_t i = 0; i < floatResult.size(); ++i) {
+        const int difference = abs((int)floatResult[i] - (int)fixedResult[i]);
+        maxDifference = difference > maxDifference ? difference : maxDifference;
+    }
+    const bool passed = maxDifference <= 2;
+    std::cout << "Resample fixed-point " << filterName << " " << PixelInfo::pixelInfo(formatType).name << " " << srcWidth << "x" << srcHeight << " -> " << destWidth << "x" << destHeight << ": " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Check that the streaming resampler produces the same result as ImageResample::scaleImage.
+*/
+static bool testStreamResample(PixelInfo::FormatType formatType, size_t srcWidth, size_t srcHeight, size_t destWidth, size_t destHeight)
+{
+    const size_t bytesPerPixel = PixelInfo::pixelInfo(formatType).bytesPerPixel;
+    std::vector<uint8_t> source(srcWidth * srcHeight * bytesPerPixel);
+    for (size_t i = 0; i < source.size(); ++i) {
+        source[i] = (uint8_t)(rand() & 0xFF);
+    }
+    std::vector<uint8_t> reference(destWidth * destHeight * bytesPerPixel);
+    ImageResample resampler(formatType);
+    resampler.scaleImage(reference.data(), destWidth, destHeight, source.data(), srcWidth, srcHeight, ResampleLinear());
+    std::vector<uint8_t> result(destWidth * destHeight * bytesPerPixel, 0);
+    size_t rowsEmitted = 0;
+    ResampleStream stream(formatType, srcWidth, srcHeight, destWidth, destHeight, ResampleLinear(), [&](const uint8_t * row, size_t y) {
+        memcpy(result.data() + y * destWidth * bytesPerPixel, row, destWidth * bytesPerPixel);
+        ++rowsEmitted;
+    });
+    stream.pushRows(source.data(), srcHeight, srcWidth * bytesPerPixel);
+    const bool passed = stream.finished() && rowsEmitted == destHeight && memcmp(reference.data(), result.data(), result.size()) == 0;
+    std::cout << "Resample stream " << PixelInfo::pixelInfo(formatType).name << " " << srcWidth << "x" << srcHeight << " -> " << destWidth << "x" << destHeight << " (" << stream.ringSize() << " rows): " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Check that kernels share weight tables through the cache and that concurrent lookups work.
+*/
+static bool testWeightCache()
+{
+    ResampleKernel::clearCache();
+    ResampleKernel a;
+    ResampleKernel b;
+    bool passed = a.getWeigths(ResampleLanczos3(), 100, 1000) == b.getWeigths(ResampleLanczos3(), 100, 1000);
+    passed &= a.getWeigths(ResampleMitchell(), 100, 1000) != b.getWeigths(ResampleLanczos3(), 100, 1000);
+    //every destination pixel of a nearest neighbour kernel has exactly one source pixel
+    const KernelWeights * nearest = a.getWeigths(ResampleNearest(), 33, 100);
+    for (size_t i = 0; i < 33; ++i) {
+        passed &= nearest[i].start == nearest[i].end && nearest[i].fixedWeights[0] == (1 << FIXED_WEIGHT_BITS);
+    }
+    //hammer the cache from multiple threads with more size pairs than it holds
+    int failures = 0;
+#pragma omp parallel for reduction(+:failures)
+    for (int i = 0; i < 1000; ++i) {
+        ResampleKernel kernel;
+        const size_t destSize = 10 + (i % 50);
+        const KernelWeights * weights = kernel.getWeigths(ResampleCatmullRom(), destSize, 200);
+        int32_t sum = 0;
+        for (size_t j = 0; j <= weights[destSize / 2].end - weights[destSize / 2].start; ++j) {
+            sum += weights[destSize / 2].fixedWeights[j];
+        }
+        failures += sum != (1 << FIXED_WEIGHT_BITS) ? 1 : 0;
+    }
+    passed &= failures == 0;
+    std::cout << "Resample weight cache: " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+static bool testResample()
+{
+    bool passed = testWeightCache();
+    passed &= testFixedPointResample(PixelInfo::R8G8B8A8, 257, 131, 100, 50, ResampleLanczos3(), "Lanczos3");
+    passed &= testFixedPointResample(PixelInfo::R8G8B8A8, 57, 31, 200, 101, ResampleLanczos2(), "Lanczos2");
+    passed &= testFixedPointResample(PixelInfo::R8G8B8, 257, 131, 64, 77, ResampleMitchell(), "Mitchell");
+    passed &= testFixedPointResample(PixelInfo::L8, 57, 31, 300, 99, ResampleCatmullRom(), "CatmullRom");
+    passed &= testFixedPointResample(PixelInfo::R8G8B8A8, 257, 131, 100, 50, ResampleNearest(), "Nearest");
+    passed &= testStreamResample(PixelInfo::R8G8B8A8, 1000, 700, 123, 77);
+    passed &= testStreamResample(PixelInfo::R8G8B8, 57, 31, 200, 101);
+    passed &= testStreamResample(PixelInfo::R5G6B5, 257, 131, 64, 50);
+    passed &= testFixedPointResample(PixelInfo::R8G8B8A8, 257, 131, 100, 50);
+    passed &= testFixedPointResample(PixelInfo::R8G8B8A8, 57, 31, 200, 101);
+    passed &= testFixedPointResample(PixelInfo::R8G8B8, 257, 131, 64, 77);
+    passed &= testFixedPointResample(PixelInfo::L8, 257, 131, 300, 99);
+    passed &= testFixedPointResample(PixelInfo::L8A8, 64, 32, 20, 10);
+    passed &= testFixedPointResample(PixelInfo::L8A8, 57, 31, 200, 101, ResampleLanczos3(), "Lanczos3");
+    passed &= testStreamResample(PixelInfo::L8A8, 57, 31, 20, 10);
+    //a constant image must stay constant on the default path
+    Image constant(64, 32, PixelInfo::L8A8);
+    memset(constant.pixels(), 200, 64 * 32 * 2);
+    const Image constantScaled = constant.scaled(20, 10);
+    bool constantPassed = constantScaled.width() == 20 && constantScaled.height() == 10;
+    for (size_t i = 0; i < 20 * 10 * 2 && constantPassed; ++i) {
+        constantPassed = constantScaled.pixels()[i] == 200;
+    }
+    std::cout << "Resample constant L8A8 64x32 -> 20x10: " << (constantPassed ? "passed" : "FAILED") << std::endl;
+    passed &= constantPassed;
+    return passed;
+}
+
+/*!
+Check the mipmap chain against a reference 2x2 box filter and check the level count and sizes.
+*/
+static bool testMipChain(PixelInfo::FormatType formatType, size_t width, size_t height)
+{
+    const size_t bytesPerPixel = PixelInfo::pixelInfo(formatType).bytesPerPixel;
+    Image image(width, height, formatType);
+    for (size_t i = 0; i < width * height * bytesPerPixel; ++i) {
+        image.pixels()[i] = (uint8_t)(rand() & 0xFF);
+    }
+    const std::vector<Image> levels = image.generateMipChain();
+    bool passed = levels.back().width() == 1 && levels.back().height() == 1;
+    for (size_t level = 1; level < levels.size() && passed; ++level) {
+        const Image & src = levels[level - 1];
+        const Image & dest = levels[level];
+        passed &= dest.width() == (src.width() > 1 ? src.width() / 2 : 1) && dest.height() == (src.height() > 1 ? src.height() / 2 : 1);
+        //only exactly halved levels in 8bit component formats are checked against the box filter
+        if (src.width() != 2 * dest.width() || src.height() != 2 * dest.height() || !ImageResample::supportsFixedPoint(formatType)) {
+            continue;
+        }
+        const size_t srcStride = src.width() * bytesPerPixel;
+        for (size_t y = 0; y < dest.height(); ++y) {
+            for (size_t x = 0; x < dest.width() * bytesPerPixel; ++x) {
+                const uint8_t * s = src.pixels() + 2 * y * srcStride + (x / bytesPerPixel) * 2 * bytesPerPixel + (x % bytesPerPixel);
+                const uint8_t expected = (uint8_t)((s[0] + s[bytesPerPixel] + s[srcStride] + s[srcStride + bytesPerPixel] + 2) >> 2);
+                passed &= dest.pixels()[y * dest.width() * bytesPerPixel + x] == expected;
+            }
+        }
+    }
+    std::cout << "Mip chain " << PixelInfo::pixelInfo(formatType).name << " " << width << "x" << height << " (" << levels.size() << " levels): " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+static bool testMipChains()
+{
+    bool passed = true;
+    passed &= testMipChain(PixelInfo::R8G8B8A8, 256, 128);
+    passed &= testMipChain(PixelInfo::R8G8B8, 128, 256);
+    passed &= testMipChain(PixelInfo::L8, 512, 64);
+    passed &= testMipChain(PixelInfo::R8G8B8A8, 100, 37);
+    passed &= testMipChain(PixelInfo::R5G6B5, 64, 64);
+    passed &= testMipChain(PixelInfo::L8A8, 64, 32);
+    passed &= testMipChain(PixelInfo::L8A8, 100, 37);
+    passed &= testMipChain(PixelInfo::R5G5B5A1, 32, 32);
+    //palette indices must not be averaged
+    try {
+        Image(64, 64, PixelInfo::I8).generateMipChain();
+        passed = false;
+    }
+    catch (const ImageException &) {
+    }
+    std::cout << "Mip chain of palette image rejected: " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Save images as raw containers and load them back from memory and through a memory-mapping.
+*/
+static bool testRawContainer()
+{
+    Image rgba(37, 19, PixelInfo::R8G8B8A8);
+    Image indexed(64, 3, PixelInfo::I8);
+    for (size_t i = 0; i < 37 * 19 * 4; ++i) {
+        rgba.pixels()[i] = (uint8_t)(rand() & 0xFF);
+    }
+    for (size_t i = 0; i < 64 * 3; ++i) {
+        indexed.pixels()[i] = (uint8_t)(rand() & 0xFF);
+    }
+    for (size_t i = 0; i < 256 * 4; ++i) {
+        indexed.palette()[i] = (uint8_t)(rand() & 0xFF);
+    }
+    //the premultiplied flag is stored in the header
+    rgba.setPremultiplied(true);
+    bool passed = rgba.saveRaw("raw_test_0.rimg") && indexed.saveRaw("raw_test_1.rimg");
+    //build a small archive by concatenating both files
+    std::vector<uint8_t> archive;
+    size_t secondOffset = 0;
+    for (int i = 0; i < 2 && passed; ++i) {
+        MappedFile file(i == 0 ? "raw_test_0.rimg" : "raw_test_1.rimg");
+        secondOffset = i == 1 ? archive.size() : 0;
+        archive.insert(archive.end(), file.data(), file.data() + file.size());
+    }
+    FILE * archiveFile = fopen("raw_test.archive", "wb");
+    passed &= archiveFile != nullptr && fwrite(archive.data(), archive.size(), 1, archiveFile) == 1;
+    if (archiveFile != nullptr) {
+        fclose(archiveFile);
+    }
+    //load from file mapping, archive mapping and memory
+    Image mapped;
+    passed &= mapped.loadMapped("raw_test_0.rimg") && mapped.isMapped();
+    const Image & constMapped = mapped;
+    passed &= mapped.width() == 37 && mapped.height() == 19 && memcmp(constMapped.pixels(), rgba.pixels(), 37 * 19 * 4) == 0 && mapped.isMapped() && mapped.isPremultiplied();
+    Image fromMemory;
+    passed &= fromMemory.load(archive.data(), archive.size()) && !fromMemory.isMapped() && fromMemory.isPremultiplied();
+    passed &= memcmp(fromMemory.pixels(), rgba.pixels(), 37 * 19 * 4) == 0;
+    Image copy;
+    {
+        //the archive stays mapped as long as an image uses it
+        std::shared_ptr<MappedFile> archiveMapping = std::make_shared<MappedFile>("raw_test.archive");
+        Image fromArchive;
+        passed &= fromArchive.loadMapped(archiveMapping, secondOffset) && fromArchive.formatType() == PixelInfo::I8 && !fromArchive.isPremultiplied();
+        archiveMapping.reset();
+        const Image & constArchive = fromArchive;
+        passed &= memcmp(constArchive.pixels(), indexed.pixels(), 64 * 3) == 0 && memcmp(constArchive.palette(), indexed.palette(), 256 * 4) == 0;
+        //copies of mapped images share the mapping
+        copy = fromArchive;
+        passed &= copy.isMapped() && copy.isShared();
+    }
+    //writing makes a private copy of the mapped data
+    passed &= copy.isMapped() && !copy.isShared();
+    passed &= memcmp(copy.pixels(), indexed.pixels(), 64 * 3) == 0 && !copy.isMapped();
+    remove("raw_test_0.rimg");
+    remove("raw_test_1.rimg");
+    remove("raw_test.archive");
+    std::cout << "Raw image container: " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Check that resampling and converting sub-rectangle views gives the same result as working on a tightly packed copy.
+*/
+static bool testImageView()
+{
+    Image image(300, 200, PixelInfo::R8G8B8);
+    for (size_t i = 0; i < 300 * 200 * 3; ++i) {
+        image.pixels()[i] = (uint8_t)(rand() & 0xFF);
+    }
+    const ConstImageView crop = image.view(13, 7, 101, 53);
+    const Image cropCopy(crop);
+    bool passed = cropCopy.width() == 101 && cropCopy.height() == 53;
+    for (size_t y = 0; y < 53; ++y) {
+        passed &= memcmp(cropCopy.pixels() + y * 101 * 3, image.pixels() + (y + 7) * 300 * 3 + 13 * 3, 101 * 3) == 0;
+    }
+    //resample view into a view with 4-byte aligned rows
+    ImageResample resampler(PixelInfo::R8G8B8);
+    const size_t alignedPitch = (37 * 3 + 3) & ~3;
+    std::vector<uint8_t> alignedResult(alignedPitch * 29);
+    std::vector<uint8_t> reference(37 * 29 * 3);
+    resampler.scaleImage(ImageView(alignedResult.data(), 37, 29, PixelInfo::R8G8B8, alignedPitch), crop, ResampleLanczos3());
+    resampler.scaleImage(reference.data(), 37, 29, cropCopy.pixels(), 101, 53, ResampleLanczos3());
+    for (size_t y = 0; y < 29; ++y) {
+        passed &= memcmp(alignedResult.data() + y * alignedPitch, reference.data() + y * 37 * 3, 37 * 3) == 0;
+    }
+    //convert view
+    Image converted(101, 53, PixelInfo::R8G8B8A8);
+    convertFormat(converted.view(), crop);
+    const Image convertedReference(101, 53, PixelInfo::R8G8B8A8, cropCopy.pixels(), nullptr, PixelInfo::R8G8B8);
+    passed &= memcmp(converted.pixels(), convertedReference.pixels(), 101 * 53 * 4) == 0;
+    std::cout << "Image views: " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Compare the column-wise and the row-wise vertical fixed-point resampling pass.
+\param[in] srcWidth Width of source image.
+\param[in] srcHeight Height of source image.
+\param[in] destWidth Width of destination image. This is also the width of the horizontally scaled buffer.
+\param[in] destHeight Height of destination image.
+*/
+static bool benchmarkVerticalPass(size_t srcWidth, size_t srcHeight, size_t destWidth, size_t destHeight)
+{
+    const size_t bytesPerPixel = 4;
+    const size_t stride = destWidth * bytesPerPixel;
+    //this is the buffer after the horizontal pass
+    std::vector<uint8_t> scaleBuffer(stride * srcHeight);
+    for (size_t i = 0; i < scaleBuffer.size(); ++i) {
+        scaleBuffer[i] = (uint8_t)(rand() & 0xFF);
+    }
+    std::vector<uint8_t> columnResult(stride * destHeight);
+    std::vector<uint8_t> rowResult(stride * destHeight);
+    ResampleKernel kernel;
+    const KernelWeights * weights = kernel.getWeigths(ResampleLinear(), destHeight, srcHeight);
+    //repeat small images more often to get measurable times
+    const int iterations = (int)(1 + (64 * 1024 * 1024) / (srcWidth * srcHeight * bytesPerPixel));
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+#pragma omp parallel for
+        for (int x = 0; x < (int)destWidth; ++x) {
+            accumulateWeightedFixed(columnResult.data() + x * bytesPerPixel, stride, destHeight, scaleBuffer.data() + x * bytesPerPixel, stride, weights, bytesPerPixel);
+        }
+    }
+    const double columnTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+#pragma omp parallel for schedule(static)
+        for (int y = 0; y < (int)destHeight; ++y) {
+            accumulateWeightedRowFixed(rowResult.data() + y * stride, stride, scaleBuffer.data(), stride, &weights[y]);
+        }
+    }
+    const double rowTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    //both passes must produce the same result
+    const bool passed = memcmp(columnResult.data(), rowResult.data(), rowResult.size()) == 0;
+    std::cout << "Vertical pass " << srcWidth << "x" << srcHeight << " -> " << destWidth << "x" << destHeight << ": columns " << columnTime << "ms, rows " << rowTime << "ms, speedup " << columnTime / rowTime << "x " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+static bool benchmarkResample()
+{
+    bool passed = true;
+    passed &= benchmarkVerticalPass(3840, 2160, 1920, 1080);
+    passed &= benchmarkVerticalPass(512, 512, 64, 64);
+    return passed;
+}
+
+/*!
+Count the bytes allocated per frame when streaming frames to a texture. This does the CPU side of GLTexture2D::setPixels(),
+which uploads image.view() directly if the sizes match and a scaled copy otherwise.
+\param[in] frameWidth Width of the frames.
+\param[in] frameHeight Height of the frames.
+\param[in] textureWidth Width of the texture.
+\param[in] textureHeight Height of the texture.
+*/
+static bool benchmarkUploadAllocations(size_t frameWidth, size_t frameHeight, size_t textureWidth, size_t textureHeight)
+{
+    const int frames = 16;
+    const size_t frameSize = frameWidth * frameHeight * 4;
+    std::vector<uint8_t> decoded(frameSize);
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        decoded[i] = (uint8_t)(rand() & 0xFF);
+    }
+    Image decodedFrame(frameWidth, frameHeight, PixelInfo::R8G8B8A8, decoded.data(), nullptr, false);
+    //persistent images. the first frame allocates their buffers
+    Image frame(frameWidth, frameHeight, PixelInfo::R8G8B8A8);
+    Image staging(textureWidth, textureHeight, PixelInfo::R8G8B8A8);
+    const bool matched = frameWidth == textureWidth && frameHeight == textureHeight;
+    std::vector<uint8_t> texture(textureWidth * textureHeight * 4);
+    //copy a frame into the texture storage like glTexSubImage2D would
+    auto upload = [&texture](const ConstImageView & view) {
+        for (size_t y = 0; y < view.height; ++y) {
+            memcpy(texture.data() + y * view.width * 4, view.row(y), view.width * 4);
+        }
+    };
+    size_t reusedBytes = 0;
+    size_t scaledBytes = 0;
+    for (int i = 0; i <= frames; ++i) {
+        const size_t before = s_allocatedBytes;
+        frame = decodedFrame;
+        if (matched) {
+            //setPixels() takes a const image, so it never needs a private copy of the shared data
+            upload(((const Image &)frame).view());
+        }
+        else {
+            frame.scaleTo(staging);
+            upload(staging.view());
+        }
+        //do not count the warm-up frame that allocates the buffers
+        if (i > 0) {
+            reusedBytes += s_allocatedBytes - before;
+        }
+    }
+    for (int i = 0; i < frames; ++i) {
+        const size_t before = s_allocatedBytes;
+        Image copy = decodedFrame;
+        Image scaled = copy.scaled(textureWidth, textureHeight);
+        upload(scaled.view());
+        scaledBytes += s_allocatedBytes - before;
+    }
+    //the buffer reusing path must not allocate at all
+    const bool passed = reusedBytes == 0;
+    std::cout << "Upload " << frameWidth << "x" << frameHeight << " -> " << textureWidth << "x" << textureHeight << ": " << reusedBytes / frames << " bytes allocated per frame reusing buffers, ";
+    std::cout << scaledBytes / frames << " bytes per frame with temporary images " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+static bool benchmarkAllocations()
+{
+    PixelAllocator::setAllocator(&s_countingAllocator);
+    bool passed = true;
+    passed &= benchmarkUploadAllocations(512, 512, 512, 512);
+    passed &= benchmarkUploadAllocations(640, 480, 512, 512);
+    //moving an image must not copy its data
+    Image source(256, 256, PixelInfo::R8G8B8A8);
+    const uint8_t * data = source.pixels();
+    const size_t before = s_allocatedBytes;
+    Image moved(std::move(source));
+    Image assigned;
+    assigned = std::move(moved);
+    const bool moveOk = s_allocatedBytes == before && assigned.pixels() == data && source.pixels() == nullptr && moved.pixels() == nullptr;
+    std::cout << "Image move " << (moveOk ? "passed" : "FAILED") << std::endl;
+    PixelAllocator::setAllocator(nullptr);
+    return passed && moveOk;
+}
+
+/*!
+Scale one source image to many sizes from multiple threads at once, like when generating thumbnails, and compare with scaling serially.
+*/
+static bool testConcurrentScaling()
+{
+    const size_t sizes[][2] = {{320, 240}, {160, 120}, {128, 128}, {97, 61}, {64, 48}, {800, 600}, {33, 17}, {256, 192}};
+    const int nrOfSizes = sizeof(sizes) / sizeof(sizes[0]);
+    Image source(640, 480, PixelInfo::R8G8B8A8);
+    uint8_t * pixels = source.pixels();
+    for (size_t i = 0; i < 640 * 480 * 4; ++i) {
+        pixels[i] = (uint8_t)(rand() & 0xFF);
+    }
+    const Image & constSource = source;
+    //serial reference results and shared plans
+    std::vector<Image> references;
+    std::vector<std::shared_ptr<const ResamplePlan>> plans;
+    ImageResample resampler(PixelInfo::R8G8B8A8);
+    for (int i = 0; i < nrOfSizes; ++i) {
+        references.emplace_back(sizes[i][0], sizes[i][1], PixelInfo::R8G8B8A8);
+        resampler.scaleImage(references.back().view(), constSource.view(), ResampleLanczos3());
+        plans.push_back(std::make_shared<ResamplePlan>(PixelInfo::R8G8B8A8, 640, 480, sizes[i][0], sizes[i][1], ResampleLanczos3()));
+    }
+    //now scale concurrently using scaled() and the shared plans
+    const int tasks = 8 * nrOfSizes;
+    int failed = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:failed)
+    for (int i = 0; i < tasks; ++i) {
+        const int size = i % nrOfSizes;
+        const size_t byteSize = sizes[size][0] * sizes[size][1] * 4;
+        const Image thumbnail = constSource.scaled(sizes[size][0], sizes[size][1], Image::DONT_CARE, ResampleLanczos3());
+        Image planned(sizes[size][0], sizes[size][1], PixelInfo::R8G8B8A8);
+        constSource.scaleTo(planned, *plans[size]);
+        if (memcmp(thumbnail.pixels(), references[size].view().data, byteSize) != 0 || memcmp(((const Image &)planned).pixels(), references[size].view().data, byteSize) != 0) {
+            failed++;
+        }
+    }
+    const bool passed = failed == 0;
+    std::cout << "Concurrent scaling of " << tasks << " thumbnails: " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Compare scaling and converting in one pass with scaling first and converting the result afterwards.
+\param[in] srcFormat Source pixel format.
+\param[in] destFormat Destination pixel format.
+*/
+static bool testFusedConvert(PixelInfo::FormatType srcFormat, PixelInfo::FormatType destFormat, size_t srcWidth, size_t srcHeight, size_t destWidth, size_t destHeight)
+{
+    Image source(srcWidth, srcHeight, srcFormat);
+    uint8_t * pixels = source.pixels();
+    for (size_t i = 0; i < srcWidth * srcHeight * PixelInfo::pixelInfo(srcFormat).bytesPerPixel; ++i) {
+        pixels[i] = (uint8_t)(rand() & 0xFF);
+    }
+    const int iterations = 20;
+    Image twoPass;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        const Image scaled = source.scaled(destWidth, destHeight);
+        twoPass = Image(destWidth, destHeight, destFormat, scaled.pixels(), nullptr, srcFormat);
+    }
+    const double twoPassTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    Image fused;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fused = source.scaled(destWidth, destHeight, destFormat);
+    }
+    const double fusedTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    //scaleTo into an image of different format must give the same result
+    Image scaledTo(destWidth, destHeight, destFormat);
+    source.scaleTo(scaledTo);
+    const size_t byteSize = destWidth * destHeight * PixelInfo::pixelInfo(destFormat).bytesPerPixel;
+    const bool passed = fused.formatType() == destFormat && memcmp(twoPass.view().data, fused.view().data, byteSize) == 0 && memcmp(scaledTo.view().data, fused.view().data, byteSize) == 0;
+    std::cout << "Fused scale and convert " << PixelInfo::pixelInfo(srcFormat).name << " " << srcWidth << "x" << srcHeight << " -> " << PixelInfo::pixelInfo(destFormat).name << " " << destWidth << "x" << destHeight;
+    std::cout << ": two passes " << twoPassTime << "ms, fused " << fusedTime << "ms " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+static bool testFusedConverts()
+{
+    bool passed = true;
+    passed &= testFusedConvert(PixelInfo::R8G8B8, PixelInfo::R5G6B5, 1920, 1080, 1024, 512);
+    passed &= testFusedConvert(PixelInfo::R8G8B8A8, PixelInfo::R4G4B4A4, 640, 480, 800, 600);
+    passed &= testFusedConvert(PixelInfo::R5G6B5, PixelInfo::R8G8B8A8, 333, 251, 128, 97);
+    return passed;
+}
+
+/*!
+Check summed-area table downscaling against brute-force box averages and compare its speed to kernel resampling for big reductions.
+*/
+static bool testSummedArea()
+{
+    bool passed = true;
+    //box sums of random rectangles must match brute-force sums
+    Image source(1024, 768, PixelInfo::R8G8B8A8);
+    uint8_t * pixels = source.pixels();
+    for (size_t i = 0; i < 1024 * 768 * 4; ++i) {
+        pixels[i] = (uint8_t)(rand() & 0xFF);
+    }
+    const SummedAreaTable table(((const Image &)source).view());
+    for (int i = 0; i < 100 && passed; ++i) {
+        const size_t x0 = rand() % 1024;
+        const size_t y0 = rand() % 768;
+        const size_t x1 = x0 + 1 + rand() % (1024 - x0);
+        const size_t y1 = y0 + 1 + rand() % (768 - y0);
+        uint32_t sums[4];
+        table.boxSum(sums, x0, y0, x1, y1);
+        for (size_t c = 0; c < 4; ++c) {
+            uint32_t sum = 0;
+            for (size_t y = y0; y < y1; ++y) {
+                for (size_t x = x0; x < x1; ++x) {
+                    sum += pixels[(y * 1024 + x) * 4 + c];
+                }
+            }
+            passed &= sum == sums[c];
+        }
+    }
+    //integer ratios must give the exact rounded average of every block
+    const Image preview = source.scaledArea(64, 48);
+    const uint8_t * previewPixels = preview.pixels();
+    for (size_t y = 0; y < 48 && passed; ++y) {
+        for (size_t x = 0; x < 64; ++x) {
+            for (size_t c = 0; c < 4; ++c) {
+                uint32_t sum = 0;
+                for (size_t j = 0; j < 16; ++j) {
+                    for (size_t i = 0; i < 16; ++i) {
+                        sum += pixels[((y * 16 + j) * 1024 + x * 16 + i) * 4 + c];
+                    }
+                }
+                passed &= previewPixels[(y * 64 + x) * 4 + c] == (uint8_t)((sum + 128) / 256);
+            }
+        }
+    }
+    //nested boxes must keep a flat color and other formats are summed up as R8G8B8A8
+    Image flat(333, 251, PixelInfo::R5G6B5);
+    uint16_t * flatPixels = (uint16_t *)flat.pixels();
+    for (size_t i = 0; i < 333 * 251; ++i) {
+        flatPixels[i] = 0x7BEF;
+    }
+    const Image flatPreview = flat.scaledArea(20, 15, Image::DONT_CARE, 3);
+    const uint16_t * flatPreviewPixels = (const uint16_t *)flatPreview.pixels();
+    const Image flatWide(1, 1, PixelInfo::R8G8B8A8, (const uint8_t *)flatPixels, nullptr, PixelInfo::R5G6B5);
+    const Image flatRoundTrip(1, 1, PixelInfo::R5G6B5, flatWide.pixels(), nullptr, PixelInfo::R8G8B8A8);
+    for (size_t i = 0; i < 20 * 15; ++i) {
+        passed &= flatPreviewPixels[i] == *(const uint16_t *)flatRoundTrip.pixels();
+    }
+    std::cout << "Summed-area table sums and averages " << (passed ? "passed" : "FAILED") << std::endl;
+    //compare speed to kernel resampling. kernels get wider with the ratio, box lookups do not
+    Image scan(4096, 3072, PixelInfo::R8G8B8);
+    memset(scan.pixels(), 0x80, 4096 * 3072 * 3);
+    const Image & constScan = scan;
+    for (size_t ratio = 16; ratio <= 64; ratio *= 4) {
+        const size_t destWidth = 4096 / ratio;
+        const size_t destHeight = 3072 / ratio;
+        auto start = std::chrono::high_resolution_clock::now();
+        const Image lanczos = constScan.scaled(destWidth, destHeight, Image::DONT_CARE, ResampleLanczos3());
+        const double lanczosTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        start = std::chrono::high_resolution_clock::now();
+        const SummedAreaTable scanTable(constScan.view());
+        const double buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        Image box(destWidth, destHeight, PixelInfo::R8G8B8);
+        Image gaussian(destWidth, destHeight, PixelInfo::R8G8B8);
+        start = std::chrono::high_resolution_clock::now();
+        scanTable.scale(box.view());
+        const double boxTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        start = std::chrono::high_resolution_clock::now();
+        scanTable.scale(gaussian.view(), 3);
+        const double gaussianTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "4096x3072 -> " << destWidth << "x" << destHeight << ": Lanczos3 " << lanczosTime << "ms, table build " << buildTime << "ms, box " << boxTime << "ms, 3 boxes " << gaussianTime << "ms" << std::endl;
+    }
+    return passed;
+}
+
+/*!
+Check that copies share their data until they are modified and compare the cost of copies with deep copies.
+*/
+static bool testCopyOnWrite()
+{
+    bool passed = true;
+    Image original(1024, 1024, PixelInfo::R8G8B8A8);
+    uint8_t * pixels = original.pixels();
+    for (size_t i = 0; i < 1024 * 1024 * 4; ++i) {
+        pixels[i] = (uint8_t)(i & 0xFF);
+    }
+    const Image & constOriginal = original;
+    //copies share the data
+    Image copy(original);
+    Image assigned;
+    assigned = copy;
+    passed &= original.isShared() && copy.isShared() && ((const Image &)assigned).pixels() == constOriginal.pixels();
+    //writing to a copy detaches it, the original stays untouched
+    assigned.pixels()[0] = 0xAB;
+    passed &= !assigned.isShared() && copy.isShared() && constOriginal.pixels()[0] == 0 && ((const Image &)assigned).pixels()[1] == 1;
+    assigned.flipVertical();
+    passed &= constOriginal.pixels()[0] == 0;
+    //scaling into a shared image must not change the other images
+    Image small(64, 64, PixelInfo::R8G8B8A8);
+    Image smallCopy = small;
+    original.scaleTo(small);
+    passed &= !small.isShared() && !smallCopy.isShared();
+    //assigning to a different format converts
+    Image converted(0, 0, PixelInfo::R5G6B5);
+    converted = original;
+    passed &= converted.formatType() == PixelInfo::R5G6B5 && !converted.isShared() && converted.width() == 1024;
+    //compare passing images by value with deep copies
+    const int iterations = 100;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        Image deepCopy(constOriginal.view());
+        passed &= deepCopy.width() == 1024;
+    }
+    const double deepTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        Image sharedCopy(original);
+        passed &= sharedCopy.width() == 1024;
+    }
+    const double sharedTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    std::cout << "Copy-on-write 1024x1024: deep copy " << deepTime << "ms, shared copy " << sharedTime << "ms " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Check the size classes and alignment of the default pixel pool and that repeated decode and scale cycles reuse its blocks.
+*/
+static bool testPixelPool()
+{
+    bool passed = true;
+    //every size must fit its class and waste at most 25% for bigger blocks
+    for (size_t size = 1; size < ((size_t)1 << 30); size = size * 5 / 4 + 1) {
+        const int sizeClass = PixelPool::sizeClass(size);
+        const size_t classSize = PixelPool::classSize(sizeClass);
+        if (sizeClass < 0 || classSize < size || (size > 256 && classSize > size + size / 4) || (sizeClass > 0 && PixelPool::classSize(sizeClass - 1) >= size)) {
+            std::cout << "Pixel pool size class for " << size << " bytes is wrong: " << sizeClass << " (" << classSize << " bytes)" << std::endl;
+            passed = false;
+            break;
+        }
+    }
+    passed &= PixelPool::sizeClass(((size_t)1 << 30) + 1) == -1;
+    passed &= PixelPool::sizeClass(256 * 1024) == PixelPool::NR_OF_THREAD_CACHE_CLASSES - 1;
+    //decode and scale a few times. only the first cycle may allocate from the system
+    PixelPool pool;
+    PixelAllocator::setAllocator(&pool);
+    std::vector<uint8_t> decoded(333 * 251 * 3);
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        decoded[i] = (uint8_t)(rand() & 0xFF);
+    }
+    size_t warmAllocations = 0;
+    for (int cycle = 0; cycle < 8; ++cycle) {
+        Image frame(333, 251, PixelInfo::R8G8B8A8, (const uint8_t *)decoded.data(), nullptr, PixelInfo::R8G8B8);
+        Image scaled = frame.scaled(128, 97);
+        scaled.flipVertical();
+        Image crop(scaled.view(3, 5, 64, 33));
+        passed &= ((size_t)frame.pixels() % PIXEL_BUFFER_ALIGNMENT) == 0 && ((size_t)scaled.pixels() % PIXEL_BUFFER_ALIGNMENT) == 0 && ((size_t)crop.pixels() % PIXEL_BUFFER_ALIGNMENT) == 0;
+        if (cycle == 0) {
+            warmAllocations = pool.statistics().systemAllocations;
+        }
+    }
+    const bool reused = pool.statistics().systemAllocations == warmAllocations;
+    //allocate and free from many threads at once
+    const int count = 256;
+#pragma omp parallel for
+    for (int i = 0; i < count; ++i) {
+        uint8_t * buffer = PixelAllocator::allocate(64 + (i % 17) * 1000);
+        buffer[0] = (uint8_t)i;
+        PixelAllocator::release(buffer);
+    }
+    PixelAllocator::setAllocator(nullptr);
+    passed &= reused;
+    //blocks in thread caches count against the pool limit. use a new thread, so its cache is empty and belongs to the new pool
+    PixelPool smallPool(64 * 1024);
+    bool limited = false;
+    std::thread cacheThread([&smallPool, &limited]() {
+        std::vector<void *> blocks;
+        for (int i = 0; i < 8; ++i) {
+            blocks.push_back(smallPool.allocateBlock(32 * 1024));
+        }
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            smallPool.freeBlock(blocks[i], 32 * 1024);
+        }
+        limited = smallPool.statistics().pooledBytes == 64 * 1024;
+        //so only two of the blocks can be reused
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            blocks[i] = smallPool.allocateBlock(32 * 1024);
+        }
+        limited &= smallPool.statistics().poolHits == 2 && smallPool.statistics().pooledBytes == 0;
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            smallPool.freeBlock(blocks[i], 32 * 1024);
+        }
+        smallPool.trim();
+        limited &= smallPool.statistics().pooledBytes == 0;
+    });
+    cacheThread.join();
+    passed &= limited;
+    std::cout << "Pixel pool " << pool.statistics().systemAllocations << " system allocations, " << pool.statistics().poolHits << " reused: " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Pack lots of sprites with transparent borders into an atlas and check trimming, pixel contents, padding and that no regions overlap.
+*/
+static bool testTextureAtlas()
+{
+    bool passed = true;
+    const size_t nrOfSprites = 600;
+    const size_t padding = 2;
+    TextureAtlas atlas(1024, 1024, PixelInfo::R8G8B8A8, padding);
+    std::vector<size_t> borders(nrOfSprites);
+    size_t usedArea = 0;
+    for (size_t i = 0; i < nrOfSprites; ++i) {
+        //sprites with a transparent border and an opaque inside. every other sprite has no alpha, so it is not trimmed
+        const size_t width = 8 + rand() % 56;
+        const size_t height = 8 + rand() % 56;
+        const size_t border = (i % 2 == 0) ? rand() % 4 : 0;
+        borders[i] = border;
+        Image sprite(width, height, PixelInfo::R8G8B8A8);
+        uint32_t * pixels = (uint32_t *)sprite.pixels();
+        for (size_t y = 0; y < height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                const bool inside = x >= border && y >= border && x < width - border && y < height - border;
+                pixels[y * width + x] = inside ? (((uint32_t)(i * 7919 + y * width + x) << 8) | 0xFF) : 0;
+            }
+        }
+        if (i % 2 == 1) {
+            sprite = Image(width, height, PixelInfo::R8G8B8, (const uint8_t *)sprite.pixels(), nullptr, PixelInfo::R8G8B8A8);
+        }
+        usedArea += (width - 2 * border) * (height - 2 * border);
+        atlas.add("sprite" + std::to_string(i), sprite);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    atlas.build();
+    const double buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    const std::vector<Image> & pages = atlas.pages();
+    size_t pageArea = 0;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        pageArea += pages[i].width() * pages[i].height();
+    }
+    std::vector<TextureAtlas::Region> regions;
+    for (size_t i = 0; i < nrOfSprites && passed; ++i) {
+        const TextureAtlas::Region & region = atlas.region("sprite" + std::to_string(i));
+        regions.push_back(region);
+        const size_t border = borders[i];
+        passed &= region.trimX == border && region.trimY == border && region.width == region.sourceWidth - 2 * border && region.height == region.sourceHeight - 2 * border;
+        passed &= region.page < pages.size() && region.x >= padding && region.y >= padding;
+        if (!passed) {
+            std::cout << "Texture atlas region of sprite " << i << " is wrong" << std::endl;
+            break;
+        }
+        const Image & page = pages[region.page];
+        passed &= region.x + region.width + padding <= page.width() && region.y + region.height + padding <= page.height();
+        passed &= region.u0 == (float)region.x / (float)page.width() && region.v1 == (float)(region.y + region.height) / (float)page.height();
+        //compare inside pixels. RGB was written in the top 24 bits of every sprite pixel
+        const ConstImageView view = page.view();
+        for (size_t y = 0; y < region.height && passed; ++y) {
+            const uint32_t * row = (const uint32_t *)view.row(region.y + y);
+            for (size_t x = 0; x < region.width; ++x) {
+                const uint32_t expected = (((uint32_t)(i * 7919 + (y + border) * region.sourceWidth + x + border) << 8) | 0xFF);
+                if (row[region.x + x] != expected) {
+                    std::cout << "Texture atlas pixel " << x << "," << y << " of sprite " << i << " is wrong" << std::endl;
+                    passed = false;
+                    break;
+                }
+            }
+        }
+        //padding is extruded from the edges, corners included
+        const uint32_t * firstRow = (const uint32_t *)view.row(region.y);
+        const uint32_t * aboveRow = (const uint32_t *)view.row(region.y - padding);
+        passed &= firstRow[region.x - padding] == firstRow[region.x] && aboveRow[region.x - padding] == firstRow[region.x];
+        passed &= aboveRow[region.x + region.width + padding - 1] == firstRow[region.x + region.width - 1];
+    }
+    //regions including their padding must not overlap
+    for (size_t i = 0; i < regions.size() && passed; ++i) {
+        for (size_t j = i + 1; j < regions.size(); ++j) {
+            const TextureAtlas::Region & a = regions[i];
+            const TextureAtlas::Region & b = regions[j];
+            if (a.page == b.page && a.x - padding < b.x + b.width + padding && b.x - padding < a.x + a.width + padding && a.y - padding < b.y + b.height + padding && b.y - padding < a.y + a.height + padding) {
+                std::cout << "Texture atlas regions of sprite " << i << " and " << j << " overlap" << std::endl;
+                passed = false;
+                break;
+            }
+        }
+    }
+    passed &= atlas.contains("sprite0") && !atlas.contains("sprite");
+    std::cout << "Texture atlas " << nrOfSprites << " sprites on " << pages.size() << " pages, " << (100 * usedArea / pageArea) << "% used, built in " << buildTime << "ms " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+//Peak signal-to-noise ratio of the RGB components of two R8G8B8A8 images of the same size.
+static double psnrRGB(const Image & a, const Image & b)
+{
+    const uint32_t * pixelsA = (const uint32_t *)a.pixels();
+    const uint32_t * pixelsB = (const uint32_t *)b.pixels();
+    double sum = 0.0;
+    for (size_t i = 0; i < a.width() * a.height(); ++i) {
+        for (int shift = 8; shift <= 24; shift += 8) {
+            const double difference = (double)((pixelsA[i] >> shift) & 0xFF) - (double)((pixelsB[i] >> shift) & 0xFF);
+            sum += difference * difference;
+        }
+    }
+    const double mse = sum / (double)(a.width() * a.height() * 3);
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 100.0;
+}
+
+/*!
+Build a test image for block codecs: smooth gradients with some noise, optionally with a radial alpha gradient.
+*/
+static Image codecTestImage(size_t width, size_t height, bool alphaGradient)
+{
+    Image source(width, height, PixelInfo::R8G8B8A8);
+    uint32_t * sourcePixels = (uint32_t *)source.pixels();
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            const uint32_t r = (uint32_t)((x * 255) / width);
+            const uint32_t g = (uint32_t)((y * 255) / height);
+            const uint32_t b = (uint32_t)(((x + y) * 127) / (width + height)) + (rand() % 8);
+            uint32_t a = 0xFF;
+            if (alphaGradient) {
+                const double distance = sqrt((double)((x - width / 2) * (x - width / 2) + (y - height / 2) * (y - height / 2))) / (double)(width / 2);
+                a = distance >= 1.0 ? 0 : (uint32_t)(255.0 * (1.0 - distance));
+            }
+            sourcePixels[y * width + x] = (r << 24) | (g << 16) | (b << 8) | a;
+        }
+    }
+    return source;
+}
+
+//Encoder entry point with explicit CPU features, so the scalar path can be forced.
+typedef void (*BlockEncodeFunction)(uint8_t * dest, const ConstImageView & source, PixelInfo::FormatType formatType, Image::CompressionQuality quality, const CpuFeatures & features);
+
+struct BlockCodecResult
+{
+    Image fast; //!< Source compressed with COMPRESS_FAST.
+    Image quality; //!< Source compressed with COMPRESS_QUALITY.
+    double fastTime; //!< Encoding time in ms.
+    double qualityTime; //!< Encoding time in ms.
+    double fastPsnr; //!< PSNR of the decoded RGB colors in dB.
+    double qualityPsnr; //!< PSNR of the decoded RGB colors in dB.
+};
+
+/*!
+Common checks for block codecs: encode in both qualities, check the PSNR, check that the SIMD encoder gives the same blocks as the scalar encoder
+and that partial blocks at the edges round-trip to another source format.
+*/
+static bool testBlockCodec(BlockCodecResult & result, const Image & source, PixelInfo::FormatType formatType, BlockEncodeFunction encode)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    result.fast = source.compressed(formatType);
+    result.fastTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    start = std::chrono::high_resolution_clock::now();
+    result.quality = source.compressed(formatType, Image::COMPRESS_QUALITY);
+    result.qualityTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    result.fastPsnr = psnrRGB(source, result.fast.decompressed());
+    result.qualityPsnr = psnrRGB(source, result.quality.decompressed());
+    bool passed = result.fast.formatType() == formatType && result.quality.formatType() == formatType;
+    passed &= result.fastPsnr > 35.0 && result.qualityPsnr >= result.fastPsnr;
+    //the SIMD code must not change the result
+    std::vector<uint8_t> scalarBlocks(PixelInfo::dataSize(formatType, source.width(), source.height()));
+    encode(scalarBlocks.data(), source.view(), formatType, Image::COMPRESS_FAST, CpuFeatures());
+    passed &= memcmp(scalarBlocks.data(), ((const Image &)result.fast).pixels(), scalarBlocks.size()) == 0;
+    encode(scalarBlocks.data(), source.view(), formatType, Image::COMPRESS_QUALITY, CpuFeatures());
+    passed &= memcmp(scalarBlocks.data(), ((const Image &)result.quality).pixels(), scalarBlocks.size()) == 0;
+    //partial blocks at the edges and other source formats
+    const Image odd(source.view(100, 100, 37, 21));
+    const Image oddDecoded = odd.compressed(formatType, Image::COMPRESS_QUALITY).decompressed(PixelInfo::R8G8B8);
+    passed &= oddDecoded.width() == 37 && oddDecoded.height() == 21 && oddDecoded.formatType() == PixelInfo::R8G8B8;
+    return passed;
+}
+
+static void encodeETC1WithFeatures(uint8_t * dest, const ConstImageView & source, PixelInfo::FormatType /*formatType*/, Image::CompressionQuality quality, const CpuFeatures & features)
+{
+    encodeETC1(dest, source, quality, features);
+}
+
+/*!
+Decode handmade ETC1 blocks, check the encoder with the common block codec checks and store compressed images in raw containers.
+*/
+static bool testETC1()
+{
+    bool passed = true;
+    //individual colors, no flip, all pixels use +a. left half is (F,8,0) with table 0, right half (0,1,F) with table 7
+    const uint8_t individualBlock[8] = {0xF0, 0x81, 0x0F, 0x1C, 0x00, 0x00, 0x00, 0x00};
+    //differential colors (16,0,31) and delta (-1,3,-4), flipped, tables 1 and 2. pixel (1,0) uses -b
+    const uint8_t differentialBlock[8] = {0x87, 0x03, 0xFC, 0x2B, 0x00, 0x10, 0x00, 0x10};
+    uint32_t pixels[16];
+    decodeETC1Block(pixels, individualBlock);
+    passed &= pixels[0] == 0xFF8A02FF && pixels[5] == 0xFF8A02FF && pixels[2] == 0x2F40FFFF && pixels[15] == 0x2F40FFFF;
+    decodeETC1Block(pixels, differentialBlock);
+    passed &= pixels[0] == 0x8905FFFF && pixels[1] == 0x7300EEFF && pixels[7] == 0x8905FFFF && pixels[8] == 0x8421E7FF && pixels[15] == 0x8421E7FF;
+    if (!passed) {
+        std::cout << "ETC1 reference block decoding FAILED" << std::endl;
+        return false;
+    }
+    const size_t width = 512;
+    const size_t height = 512;
+    const Image source = codecTestImage(width, height, false);
+    BlockCodecResult etc1;
+    passed &= testBlockCodec(etc1, source, PixelInfo::ETC1_R8G8B8, encodeETC1WithFeatures);
+    passed &= PixelInfo::dataSize(PixelInfo::ETC1_R8G8B8, width, height) == width * height / 2;
+    const auto start = std::chrono::high_resolution_clock::now();
+    const Image decoded = etc1.fast.decompressed();
+    const double decodeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    passed &= decoded.width() == width && decoded.height() == height;
+    //compressed images can be stored in raw containers
+    Image loaded;
+    passed &= etc1.fast.saveRaw("etc1_test.rimg") && loaded.loadMapped("etc1_test.rimg");
+    const Image & constLoaded = loaded;
+    passed &= loaded.formatType() == PixelInfo::ETC1_R8G8B8 && loaded.width() == width && memcmp(constLoaded.pixels(), ((const Image &)etc1.fast).pixels(), PixelInfo::dataSize(PixelInfo::ETC1_R8G8B8, width, height)) == 0;
+    remove("etc1_test.rimg");
+    std::cout << "ETC1 " << width << "x" << height << ": fast " << etc1.fastTime << "ms (" << etc1.fastPsnr << "dB), quality " << etc1.qualityTime << "ms (" << etc1.qualityPsnr << "dB), decode " << decodeTime << "ms " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Decode handmade BC1 and BC3 blocks, check both encoders with the common block codec checks and check the BC3 alpha on a radial alpha gradient.
+*/
+static bool testS3TC()
+{
+    bool passed = true;
+    //red and blue end points, pixels 0-3 use indices 0-3
+    const uint8_t fourColorBlock[8] = {0x00, 0xF8, 0x1F, 0x00, 0xE4, 0x00, 0x00, 0x00};
+    //color0 < color1 has a color halfway between the end points and transparent black
+    const uint8_t threeColorBlock[8] = {0x1F, 0x00, 0x00, 0xF8, 0xE4, 0x00, 0x00, 0x00};
+    //alpha 255 and 0 with 6 interpolated values, followed by a black color block
+    const uint8_t eightAlphaBlock[16] = {0xFF, 0x00, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0, 0, 0, 0, 0, 0, 0, 0};
+    //alpha 40 and 200 with 4 interpolated values plus 0 and 255. pixels 0-2 use indices 6, 7 and 2
+    const uint8_t sixAlphaBlock[16] = {0x28, 0xC8, 0xBE, 0x00, 0x00, 0x00, 0x00, 0x00, 0, 0, 0, 0, 0, 0, 0, 0};
+    uint32_t pixels[16];
+    decodeS3TCBlock(pixels, fourColorBlock, PixelInfo::BC1_R5G6B5);
+    passed &= pixels[0] == 0xFF0000FF && pixels[1] == 0x0000FFFF && pixels[2] == 0xAA0055FF && pixels[3] == 0x5500AAFF && pixels[15] == 0xFF0000FF;
+    decodeS3TCBlock(pixels, threeColorBlock, PixelInfo::BC1_R5G6B5);
+    passed &= pixels[0] == 0x0000FFFF && pixels[1] == 0xFF0000FF && pixels[2] == 0x7F007FFF && pixels[3] == 0x00000000;
+    decodeS3TCBlock(pixels, eightAlphaBlock, PixelInfo::BC3_R5G6B5A8);
+    passed &= pixels[0] == 0x000000FF && pixels[1] == 0x00000000 && pixels[2] == 0x000000DA && pixels[15] == 0x000000FF;
+    decodeS3TCBlock(pixels, sixAlphaBlock, PixelInfo::BC3_R5G6B5A8);
+    passed &= pixels[0] == 0x00000000 && pixels[1] == 0x000000FF && pixels[2] == 0x00000048 && pixels[15] == 0x00000028;
+    if (!passed) {
+        std::cout << "S3TC reference block decoding FAILED" << std::endl;
+        return false;
+    }
+    const size_t width = 512;
+    const size_t height = 512;
+    const Image source = codecTestImage(width, height, true);
+    BlockCodecResult bc1;
+    BlockCodecResult bc3;
+    passed &= testBlockCodec(bc1, source, PixelInfo::BC1_R5G6B5, encodeS3TC);
+    passed &= testBlockCodec(bc3, source, PixelInfo::BC3_R5G6B5A8, encodeS3TC);
+    passed &= PixelInfo::dataSize(PixelInfo::BC1_R5G6B5, width, height) == width * height / 2 && PixelInfo::dataSize(PixelInfo::BC3_R5G6B5A8, width, height) == width * height;
+    //alpha of BC3 must be close to the original
+    const Image alphaDecoded = bc3.fast.decompressed();
+    const uint32_t * alphaPixels = (const uint32_t *)alphaDecoded.pixels();
+    const uint32_t * sourcePixels = (const uint32_t *)source.pixels();
+    int maxAlphaError = 0;
+    for (size_t i = 0; i < width * height; ++i) {
+        const int error = abs((int)(alphaPixels[i] & 0xFF) - (int)(sourcePixels[i] & 0xFF));
+        maxAlphaError = error > maxAlphaError ? error : maxAlphaError;
+    }
+    passed &= maxAlphaError <= 4;
+    std::cout << "S3TC " << width << "x" << height << ": BC1 fast " << bc1.fastTime << "ms (" << bc1.fastPsnr << "dB), quality " << bc1.qualityTime << "ms (" << bc1.qualityPsnr << "dB), BC3 " << bc3.fastTime << "ms (alpha error <= " << maxAlphaError << ") " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Write and read KTX files with mip chains in padded, packed and compressed formats, from a file mapping, an archive mapping and memory.
+*/
+static bool testKTX()
+{
+    bool passed = true;
+    //37 pixels of R8G8B8 need padded rows, R8G8B8A8 rows are packed and used from the mapping directly
+    const PixelInfo::FormatType formatTypes[] = { PixelInfo::R8G8B8, PixelInfo::R8G8B8A8, PixelInfo::R5G6B5, PixelInfo::X1R5G5B5, PixelInfo::BC1_R5G6B5 };
+    //the X bit of X1R5G5B5 is undefined, so GL must not read it as alpha
+    KTXFormat x1r5g5b5Format;
+    passed &= ktxFormat(x1r5g5b5Format, PixelInfo::X1R5G5B5) && x1r5g5b5Format.glBaseInternalFormat == 0x1907; //GL_RGB
+    for (size_t f = 0; f < sizeof(formatTypes) / sizeof(PixelInfo::FormatType) && passed; ++f) {
+        Image source(37, 20, PixelInfo::R8G8B8A8);
+        for (size_t i = 0; i < 37 * 20 * 4; ++i) {
+            source.pixels()[i] = (uint8_t)(rand() & 0xFF);
+        }
+        std::vector<Image> levels = source.generateMipChain();
+        for (size_t i = 0; i < levels.size(); ++i) {
+            if (PixelInfo::pixelInfo(formatTypes[f]).compressed) {
+                levels[i] = levels[i].compressed(formatTypes[f]);
+            }
+            else if (formatTypes[f] != levels[i].formatType()) {
+                levels[i] = Image(levels[i].width(), levels[i].height(), formatTypes[f], ((const Image &)levels[i]).pixels(), nullptr, levels[i].formatType());
+            }
+        }
+        passed &= saveKTX("ktx_test.ktx", levels, Image::TOP_DOWN);
+        Image::Orientation orientation = Image::BOTTOM_UP;
+        const std::vector<Image> loaded = loadKTX("ktx_test.ktx", &orientation);
+        passed &= orientation == Image::TOP_DOWN && loaded.size() == levels.size();
+        for (size_t i = 0; i < loaded.size() && passed; ++i) {
+            const size_t dataSize = PixelInfo::dataSize(formatTypes[f], levels[i].width(), levels[i].height());
+            const bool packed = PixelInfo::pixelInfo(formatTypes[f]).compressed || (levels[i].width() * PixelInfo::pixelInfo(formatTypes[f]).bytesPerPixel) % 4 == 0;
+            passed &= loaded[i].formatType() == formatTypes[f] && loaded[i].width() == levels[i].width() && loaded[i].height() == levels[i].height() && loaded[i].isMapped() == packed;
+            passed &= memcmp(loaded[i].pixels(), levels[i].pixels(), dataSize) == 0;
+        }
+        //level 0 starts 16-byte aligned, so SIMD code can use the mapped data
+        passed &= loaded.front().isMapped() == false || ((size_t)loaded.front().pixels() % 16) == 0;
+    }
+    //a KTX file behind some other data in an archive and in memory
+    std::vector<uint8_t> archive(100, 0);
+    {
+        MappedFile file("ktx_test.ktx");
+        archive.insert(archive.end(), file.data(), file.data() + file.size());
+    }
+    FILE * archiveFile = fopen("ktx_test.archive", "wb");
+    passed &= archiveFile != nullptr && fwrite(archive.data(), archive.size(), 1, archiveFile) == 1;
+    if (archiveFile != nullptr) {
+        fclose(archiveFile);
+    }
+    const std::vector<Image> fromFile = loadKTX("ktx_test.ktx");
+    const std::vector<Image> fromArchive = loadKTX(std::make_shared<MappedFile>("ktx_test.archive"), 100);
+    const std::vector<Image> fromMemory = loadKTX(archive.data() + 100, archive.size() - 100);
+    passed &= fromArchive.size() == fromFile.size() && fromMemory.size() == fromFile.size() && fromArchive.back().isMapped() && !fromMemory.back().isMapped();
+    for (size_t i = 0; i < fromFile.size() && passed; ++i) {
+        const size_t dataSize = PixelInfo::dataSize(fromFile[i].formatType(), fromFile[i].width(), fromFile[i].height());
+        passed &= memcmp(fromArchive[i].pixels(), fromFile[i].pixels(), dataSize) == 0 && memcmp(fromMemory[i].pixels(), fromFile[i].pixels(), dataSize) == 0;
+    }
+    //the premultiplied key is stored and level 0 stays 16-byte aligned behind it
+    {
+        Image sprite(16, 8, PixelInfo::R8G8B8A8);
+        for (size_t i = 0; i < 16 * 8 * 4; ++i) {
+            sprite.pixels()[i] = (uint8_t)(rand() & 0xFF);
+        }
+        sprite.premultiplyAlpha();
+        passed &= saveKTX("ktx_premultiplied.ktx", sprite.generateMipChain());
+        const std::vector<Image> loaded = loadKTX("ktx_premultiplied.ktx");
+        passed &= loaded.size() == 5 && loaded.front().isMapped() && ((size_t)loaded.front().pixels() % 16) == 0;
+        for (size_t i = 0; i < loaded.size(); ++i) {
+            passed &= loaded[i].isPremultiplied();
+        }
+        passed &= !fromFile.front().isPremultiplied();
+        remove("ktx_premultiplied.ktx");
+    }
+    //broken files must be rejected: more mip levels than a 37x20 chain has and a bad identifier
+    const uint32_t nrOfMipLevels = 40;
+    memcpy(archive.data() + 100 + 56, &nrOfMipLevels, 4);
+    for (int broken = 0; broken < 2; ++broken) {
+        archive[100 + 1] = broken == 1 ? 'X' : archive[100 + 1];
+        try {
+            loadKTX(archive.data() + 100, archive.size() - 100);
+            passed = false;
+        }
+        catch (const ImageException &) {
+        }
+    }
+    remove("ktx_test.ktx");
+    remove("ktx_test.archive");
+    std::cout << "KTX container: " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Compare image statistics with a scalar reference, check alpha and grayscale classification, the unique color estimate and that SIMD and scalar code agree.
+*/
+static bool testStatistics()
+{
+    bool passed = true;
+    //random colors with binary alpha, so minimum and maximum are hit somewhere
+    const size_t width = 1023;
+    const size_t height = 517;
+    Image rgba(width, height, PixelInfo::R8G8B8A8);
+    uint32_t * pixels = (uint32_t *)rgba.pixels();
+    for (size_t i = 0; i < width * height; ++i) {
+        pixels[i] = ((uint32_t)(rand() % 200 + 20) << 24) | ((uint32_t)(rand() & 0xFF) << 16) | ((uint32_t)(rand() % 100) << 8) | ((rand() & 1) ? 0xFF : 0x00);
+    }
+    std::vector<uint32_t> histogram(4 * 256, 0);
+    uint8_t minimum[4] = {255, 255, 255, 255};
+    uint8_t maximum[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < width * height; ++i) {
+        for (size_t c = 0; c < 4; ++c) {
+            const uint8_t value = (uint8_t)(pixels[i] >> (24 - 8 * c));
+            histogram[c * 256 + value]++;
+            minimum[c] = value < minimum[c] ? value : minimum[c];
+            maximum[c] = value > maximum[c] ? value : maximum[c];
+        }
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    const ImageStatistics simd = rgba.statistics();
+    const double simdTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    start = std::chrono::high_resolution_clock::now();
+    const ImageStatistics scalar = calculateStatistics(rgba.view(), CpuFeatures());
+    const double scalarTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    passed &= simd.pixelCount == width * height && simd.alphaType == ImageStatistics::ALPHA_BINARY && !simd.grayscale;
+    passed &= memcmp(simd.minimum, minimum, 4) == 0 && memcmp(simd.maximum, maximum, 4) == 0 && memcmp(simd.histogram, histogram.data(), 4 * 256 * sizeof(uint32_t)) == 0;
+    passed &= memcmp(simd.minimum, scalar.minimum, 4) == 0 && memcmp(simd.maximum, scalar.maximum, 4) == 0 && memcmp(simd.histogram, scalar.histogram, sizeof(simd.histogram)) == 0;
+    passed &= simd.alphaType == scalar.alphaType && simd.grayscale == scalar.grayscale && simd.uniqueColors == scalar.uniqueColors;
+    //200 gray levels without alpha are opaque and have few colors
+    Image gray(640, 480, PixelInfo::R8G8B8);
+    for (size_t i = 0; i < 640 * 480; ++i) {
+        const uint8_t value = (uint8_t)(i % 200);
+        gray.pixels()[i * 3] = value;
+        gray.pixels()[i * 3 + 1] = value;
+        gray.pixels()[i * 3 + 2] = value;
+    }
+    const ImageStatistics grayStatistics = gray.statistics();
+    passed &= grayStatistics.grayscale && grayStatistics.alphaType == ImageStatistics::ALPHA_OPAQUE && grayStatistics.minimum[0] == 0 && grayStatistics.maximum[2] == 199;
+    passed &= grayStatistics.uniqueColors >= 196 && grayStatistics.uniqueColors <= 204;
+    //partial alpha in a sub-rectangle and an estimate of many colors
+    Image colors(256, 256, PixelInfo::R8G8B8A8);
+    uint32_t * colorPixels = (uint32_t *)colors.pixels();
+    for (size_t i = 0; i < 256 * 256; ++i) {
+        colorPixels[i] = ((uint32_t)i << 8) | (i % 256 == 10 ? 0x80 : 0xFF);
+    }
+    const ImageStatistics colorStatistics = calculateStatistics(colors.view(0, 0, 200, 150));
+    const double expected = 200.0 * 150.0;
+    passed &= colorStatistics.alphaType == ImageStatistics::ALPHA_FULL && fabs((double)colorStatistics.uniqueColors - expected) / expected < 0.05;
+    //palette images are described by their colors, not their indices
+    Image indexed(4, 4, PixelInfo::I8);
+    memset(indexed.palette(), 0, 256 * 4);
+    ((uint32_t *)indexed.palette())[0] = 0xFF0000FF;
+    ((uint32_t *)indexed.palette())[1] = 0x0000FF80;
+    for (size_t i = 0; i < 16; ++i) {
+        indexed.pixels()[i] = (uint8_t)(i & 1);
+    }
+    const ImageStatistics indexedStatistics = indexed.statistics();
+    passed &= !indexedStatistics.grayscale && indexedStatistics.maximum[0] == 0xFF && indexedStatistics.maximum[2] == 0xFF && indexedStatistics.minimum[3] == 0x80 && indexedStatistics.histogram[1][0] == 16;
+    passed &= compactFormat(indexedStatistics) != PixelInfo::L8 && compactFormat(indexedStatistics) != PixelInfo::L8A8;
+    std::cout << "Image statistics " << width << "x" << height << ": SIMD " << simdTime << "ms, scalar " << scalarTime << "ms, " << simd.uniqueColors << " colors estimated " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Check that the compact format picked from the statistics matches the content and that gray and 1bit alpha survive the conversion to it.
+*/
+static bool testCompactFormat()
+{
+    bool passed = true;
+    const size_t width = 97;
+    const size_t height = 61;
+    Image gray(width, height, PixelInfo::R8G8B8A8);
+    Image grayAlpha(width, height, PixelInfo::R8G8B8A8);
+    Image color(width, height, PixelInfo::R8G8B8A8);
+    Image colorKey(width, height, PixelInfo::R8G8B8A8);
+    Image colorAlpha(width, height, PixelInfo::R8G8B8A8);
+    Image fourBitAlpha(width, height, PixelInfo::R8G8B8A8);
+    for (size_t i = 0; i < width * height; ++i) {
+        const uint32_t value = (uint32_t)(rand() & 0xFF);
+        const uint32_t rgb = ((uint32_t)(rand() & 0xFF) << 24) | ((uint32_t)(rand() & 0xFF) << 16) | ((uint32_t)(rand() & 0xFF) << 8);
+        ((uint32_t *)gray.pixels())[i] = (value << 24) | (value << 16) | (value << 8) | 0xFF;
+        ((uint32_t *)grayAlpha.pixels())[i] = (value << 24) | (value << 16) | (value << 8) | (uint32_t)(i & 0xFF);
+        ((uint32_t *)color.pixels())[i] = rgb | 0xFF;
+        ((uint32_t *)colorKey.pixels())[i] = rgb | ((i & 4) ? 0xFF : 0x00);
+        ((uint32_t *)colorAlpha.pixels())[i] = rgb | (uint32_t)(i & 0xFF);
+        ((uint32_t *)fourBitAlpha.pixels())[i] = ((uint32_t)(rand() & 0xF) * 0x11000000) | ((uint32_t)(rand() & 0xF) * 0x110000) | ((uint32_t)(rand() & 0xF) * 0x1100) | ((uint32_t)(i & 0xF) * 0x11);
+    }
+    passed &= compactFormat(gray.statistics()) == PixelInfo::L8 && compactFormat(grayAlpha.statistics()) == PixelInfo::L8A8;
+    passed &= compactFormat(color.statistics()) == PixelInfo::R5G6B5 && compactFormat(colorKey.statistics()) == PixelInfo::R5G5B5A1 && compactFormat(colorAlpha.statistics()) == PixelInfo::R8G8B8A8;
+    passed &= compactFormat(fourBitAlpha.statistics()) == PixelInfo::R4G4B4A4;
+    //gray formats are exact, 1bit alpha keeps the color key
+    const Image images[3] = {gray, grayAlpha, colorKey};
+    for (size_t j = 0; j < 3; ++j) {
+        const PixelInfo::FormatType formatType = compactFormat(images[j].statistics());
+        const Image compact(width, height, formatType, images[j].pixels(), nullptr, images[j].formatType());
+        const Image restored(width, height, PixelInfo::R8G8B8A8, compact.pixels(), nullptr, formatType);
+        for (size_t i = 0; i < width * height; ++i) {
+            const uint32_t original = ((const uint32_t *)images[j].pixels())[i];
+            const uint32_t pixel = ((const uint32_t *)restored.pixels())[i];
+            if (formatType == PixelInfo::R5G5B5A1) {
+                passed &= (pixel & 0xFF) == (original & 0xFF);
+                //scaling to 5 bits and back truncates twice
+                for (size_t c = 8; c < 32; c += 8) {
+                    passed &= abs((int)((pixel >> c) & 0xFF) - (int)((original >> c) & 0xFF)) <= 9;
+                }
+            }
+            else {
+                passed &= pixel == original;
+            }
+        }
+    }
+    //the byte order matches GL_LUMINANCE_ALPHA
+    const Image luminanceAlpha(width, height, PixelInfo::L8A8, (const uint8_t *)grayAlpha.pixels(), nullptr, grayAlpha.formatType());
+    passed &= luminanceAlpha.pixels()[0] == grayAlpha.pixels()[3] && luminanceAlpha.pixels()[1] == grayAlpha.pixels()[0];
+    std::cout << "Compact formats from image statistics: " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Check the SIMD premultiply and unpremultiply row functions of one feature set bit-for-bit against the scalar templates, also in place.
+*/
+static bool testPremultiplyRows(const CpuFeatures & features, const std::string & featureName)
+{
+    ConvertRowFunction premultiplyRow = getPremultiplyRowFunction(PixelInfo::R8G8B8A8, features);
+    ConvertRowFunction unpremultiplyRow = getUnpremultiplyRowFunction(PixelInfo::R8G8B8A8, features);
+    if (premultiplyRow == nullptr || unpremultiplyRow == nullptr) {
+        return true;
+    }
+    //random data also has colors bigger than alpha, which unpremultiplying must clamp
+    const size_t count = 1037;
+    std::vector<uint8_t> source(count * 4 + 16);
+    for (size_t i = 0; i < source.size(); ++i) {
+        source[i] = (uint8_t)(rand() & 0xFF);
+    }
+    std::vector<uint8_t> reference(source.size(), 0);
+    std::vector<uint8_t> result(source.size(), 0);
+    bool passed = true;
+    for (size_t offset = 0; offset < 4; ++offset) {
+        const uint8_t * src = source.data() + offset;
+        for (size_t i = 0; i < count; ++i) {
+            premultiplyPixel<PixelInfo::R8G8B8A8>(reference.data() + offset + i * 4, src + i * 4);
+        }
+        premultiplyRow(result.data() + offset, src, count);
+        passed &= memcmp(reference.data() + offset, result.data() + offset, count * 4) == 0;
+        for (size_t i = 0; i < count; ++i) {
+            unpremultiplyPixel<PixelInfo::R8G8B8A8>(reference.data() + offset + i * 4, src + i * 4);
+        }
+        memcpy(result.data() + offset, src, count * 4);
+        unpremultiplyRow(result.data() + offset, result.data() + offset, count);
+        passed &= memcmp(reference.data() + offset, result.data() + offset, count * 4) == 0;
+    }
+    std::cout << "Premultiply / unpremultiply R8G8B8A8 (" << featureName << "): " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Check premultiplied alpha: rounding, SIMD against scalar, round trips, the image flag and that filtering in premultiplied space leaves no dark fringes around sprites.
+*/
+static bool testPremultiply()
+{
+    const CpuFeatures & detected = CpuFeatures::detected();
+    bool passed = true;
+    CpuFeatures features;
+    if (detected.sse2) {
+        features.sse2 = true;
+        passed &= testPremultiplyRows(features, "SSE2");
+    }
+    if (detected.avx2) {
+        features.avx2 = true;
+        passed &= testPremultiplyRows(features, "AVX2");
+    }
+    if (detected.neon) {
+        features.neon = true;
+        passed &= testPremultiplyRows(features, "NEON");
+    }
+    //all 8bit colors and alphas round to nearest, opaque pixels stay exact and transparent pixels become black
+    Image all(256, 256, PixelInfo::R8G8B8A8);
+    uint32_t * allPixels = (uint32_t *)all.pixels();
+    for (uint32_t a = 0; a < 256; ++a) {
+        for (uint32_t c = 0; c < 256; ++c) {
+            allPixels[a * 256 + c] = (c << 24) | ((255 - c) << 16) | (c << 8) | a;
+        }
+    }
+    Image premultiplied = all;
+    premultiplied.premultiplyAlpha();
+    passed &= premultiplied.isPremultiplied() && !all.isPremultiplied() && premultiplied.pixels() != all.pixels();
+    const uint32_t * premultipliedPixels = (const uint32_t *)((const Image &)premultiplied).pixels();
+    for (uint32_t a = 0; a < 256; ++a) {
+        for (uint32_t c = 0; c < 256; ++c) {
+            const uint32_t pixel = premultipliedPixels[a * 256 + c];
+            passed &= (pixel >> 24) == (c * a + 127) / 255 && ((pixel >> 16) & 0xFF) == ((255 - c) * a + 127) / 255 && (pixel & 0xFF) == a;
+        }
+    }
+    Image restored = premultiplied;
+    restored.unpremultiplyAlpha();
+    const uint32_t * restoredPixels = (const uint32_t *)((const Image &)restored).pixels();
+    for (uint32_t c = 0; c < 256; ++c) {
+        passed &= restoredPixels[255 * 256 + c] == allPixels[255 * 256 + c] && restoredPixels[c] == 0;
+    }
+    //the same rounding for other formats with alpha
+    const uint16_t la = 200 | (100 << 8);
+    uint16_t laPremultiplied = 0;
+    premultiplyPixels((uint8_t *)&laPremultiplied, (const uint8_t *)&la, PixelInfo::L8A8, 1);
+    const uint16_t rgba4444 = 0xF8A8;
+    uint16_t rgba4444Premultiplied = 0;
+    premultiplyPixels((uint8_t *)&rgba4444Premultiplied, (const uint8_t *)&rgba4444, PixelInfo::R4G4B4A4, 1);
+    passed &= laPremultiplied == ((200 * 100 + 127) / 255 | (100 << 8)) && rgba4444Premultiplied == 0x8458;
+    //white sprite on transparent black. straight filtering darkens the edges, premultiplied filtering keeps them white
+    const size_t size = 64;
+    Image sprite(size, size, PixelInfo::R8G8B8A8);
+    uint32_t * spritePixels = (uint32_t *)sprite.pixels();
+    for (size_t y = 0; y < size; ++y) {
+        for (size_t x = 0; x < size; ++x) {
+            spritePixels[y * size + x] = (x >= 16 && x < 48 && y >= 16 && y < 48) ? 0xFFFFFFFF : 0x00000000;
+        }
+    }
+    const Image straight = sprite.scaled(21, 21);
+    const Image filtered = sprite.scaled(21, 21, Image::DONT_CARE, ResampleLinear(), true);
+    bool straightFringe = false;
+    const uint32_t * straightPixels = (const uint32_t *)straight.pixels();
+    const uint32_t * filteredPixels = (const uint32_t *)filtered.pixels();
+    for (size_t i = 0; i < 21 * 21; ++i) {
+        straightFringe |= (straightPixels[i] & 0xFF) > 0 && (straightPixels[i] >> 24) < 250;
+        passed &= (filteredPixels[i] & 0xFF) == (straightPixels[i] & 0xFF);
+        passed &= (filteredPixels[i] & 0xFF) == 0 || (filteredPixels[i] >> 8) == 0xFFFFFF;
+    }
+    passed &= straightFringe && !filtered.isPremultiplied();
+    //mipmaps filtered in premultiplied space, level 0 is the original image
+    const std::vector<Image> levels = sprite.generateMipChain(ResampleLinear(), true);
+    passed &= levels[0].pixels() == ((const Image &)sprite).pixels();
+    for (size_t level = 1; level < levels.size(); ++level) {
+        const uint32_t * levelPixels = (const uint32_t *)levels[level].pixels();
+        passed &= !levels[level].isPremultiplied();
+        for (size_t i = 0; i < levels[level].width() * levels[level].height(); ++i) {
+            passed &= (levelPixels[i] & 0xFF) == 0 || (levelPixels[i] >> 8) == 0xFFFFFF;
+        }
+    }
+    //premultiplied images keep their flag when scaled and are filtered as they are
+    Image premultipliedSprite = sprite;
+    premultipliedSprite.premultiplyAlpha();
+    const Image premultipliedScaled = premultipliedSprite.scaled(21, 21, Image::DONT_CARE, ResampleLinear(), true);
+    passed &= premultipliedScaled.isPremultiplied();
+    std::cout << "Premultiplied alpha: " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Check that lazily loaded images have their dimensions right away, decode exactly once on first access and match eagerly loaded images.
+\param[in] path Image file to load.
+*/
+static bool testLazyDecode(const std::string & path)
+{
+    Image eager;
+    eager.load(path);
+    const size_t byteSize = eager.width() * eager.height() * PixelInfo::pixelInfo(eager.formatType()).bytesPerPixel;
+    //the header is enough for the layout
+    Image lazy;
+    lazy.load(path, Image::DECODE_LAZY);
+    bool passed = lazy.width() == eager.width() && lazy.height() == eager.height() && lazy.formatType() == eager.formatType();
+    //copies share the pending decode
+    const Image lazyCopy(lazy);
+    const bool deferred = !lazy.isDecoded() && !lazyCopy.isDecoded();
+    //decode from multiple threads at once. all must see the same data
+    std::atomic<int> mismatches(0);
+    const uint8_t * firstPixels = lazyCopy.pixels();
+#pragma omp parallel for
+    for (int i = 0; i < 8; ++i) {
+        if (lazyCopy.view().data != firstPixels) {
+            mismatches++;
+        }
+    }
+    passed &= lazy.isDecoded() && mismatches == 0 && memcmp(((const Image &)lazy).pixels(), eager.pixels(), byteSize) == 0;
+    //writing detaches like for any other shared image
+    lazy.pixels()[0] ^= 0xFF;
+    passed &= memcmp(lazyCopy.pixels(), eager.pixels(), byteSize) == 0;
+    //prefetch on a background thread
+    Image prefetched;
+    prefetched.load(path, Image::DECODE_PREFETCH);
+    for (int i = 0; i < 1000 && !prefetched.isDecoded(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    passed &= memcmp(((const Image &)prefetched).pixels(), eager.pixels(), byteSize) == 0;
+    //the prefetch thread does not count as a copy, so writing right away allocates the decoded pixels only
+    {
+        PixelAllocator::setAllocator(&s_countingAllocator);
+        s_allocatedBytes = 0;
+        Image written;
+        written.load(path, Image::DECODE_PREFETCH);
+        written.pixels()[0] ^= 0xFF;
+        passed &= s_allocatedBytes < 2 * byteSize;
+        PixelAllocator::setAllocator(nullptr);
+    }
+    //compare the time for loading many images just to get their sizes
+    const int count = 100;
+    std::vector<Image> images(count);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < count; ++i) {
+        images[i].load(path);
+    }
+    const double eagerTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < count; ++i) {
+        images[i].load(path, Image::DECODE_LAZY);
+    }
+    const double lazyTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Lazy decode of " << path << ": " << (deferred ? "deferred" : "not deferred, format can not read headers only") << ", loading " << count << " images eager " << eagerTime << "ms, lazy " << lazyTime << "ms ";
+    std::cout << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Check that converting and flipping while loading gives the same result as loading, flipping and converting afterwards.
+\param[in] path Image file to load.
+*/
+static bool testFusedLoad(const std::string & path)
+{
+    const int iterations = 200;
+    Image separate;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        Image loaded;
+        loaded.load(path);
+        loaded.flipVertical();
+        separate = Image(loaded.width(), loaded.height(), PixelInfo::R5G6B5, ((const Image &)loaded).pixels(), nullptr, loaded.formatType());
+    }
+    const double separateTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    Image fused;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fused.load(path, PixelInfo::R5G6B5, Image::TOP_DOWN);
+    }
+    const double fusedTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    const size_t byteSize = fused.width() * fused.height() * 2;
+    bool passed = fused.formatType() == PixelInfo::R5G6B5 && fused.width() == separate.width() && memcmp(((const Image &)fused).pixels(), ((const Image &)separate).pixels(), byteSize) == 0;
+    //lazily loaded images convert while decoding too
+    Image lazy;
+    lazy.load(path, PixelInfo::R5G6B5, Image::TOP_DOWN, Image::DECODE_LAZY);
+    passed &= lazy.formatType() == PixelInfo::R5G6B5 && memcmp(((const Image &)lazy).pixels(), ((const Image &)separate).pixels(), byteSize) == 0;
+    std::cout << "Load, flip and convert " << path << " to R5G6B5: separate passes " << separateTime << "ms, fused " << fusedTime << "ms " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Check that scaling while loading gives the same result as loading and scaling afterwards.
+\param[in] path Image file to load.
+*/
+static bool testLoadScaled(const std::string & path, size_t maxWidth, size_t maxHeight)
+{
+    Image full;
+    full.load(path);
+    Image reduced;
+    reduced.load(path, maxWidth, maxHeight, ResampleLanczos3());
+    size_t width = full.width();
+    size_t height = full.height();
+    if (width > maxWidth || height > maxHeight) {
+        const double scale = (double)maxWidth / width < (double)maxHeight / height ? (double)maxWidth / width : (double)maxHeight / height;
+        width = (size_t)(width * scale + 0.5);
+        height = (size_t)(height * scale + 0.5);
+    }
+    bool passed = reduced.width() == width && reduced.height() == height && reduced.formatType() == full.formatType();
+    if (passed) {
+        const Image reference = full.scaled(width, height, Image::DONT_CARE, ResampleLanczos3());
+        passed = memcmp(reference.pixels(), ((const Image &)reduced).pixels(), width * height * PixelInfo::pixelInfo(reduced.formatType()).bytesPerPixel) == 0;
+    }
+    std::cout << "Load " << path << " scaled to fit " << maxWidth << "x" << maxHeight << " (" << reduced.width() << "x" << reduced.height() << "): " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+/*!
+Compare texture startup from a PNG, which is decoded, converted and mip-mapped, with mapping a KTX file baked from it.
+\param[in] path Image file to load.
+\param[in] formatType Texture format.
+*/
+static bool benchmarkKTX(const std::string & path, PixelInfo::FormatType formatType)
+{
+    const int iterations = 50;
+    std::vector<Image> pngLevels;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        Image loaded;
+        loaded.load(path, PixelInfo::pixelInfo(formatType).compressed ? PixelInfo::R8G8B8A8 : formatType);
+        pngLevels = loaded.generateMipChain();
+        if (PixelInfo::pixelInfo(formatType).compressed) {
+            for (size_t level = 0; level < pngLevels.size(); ++level) {
+                pngLevels[level] = pngLevels[level].compressed(formatType);
+            }
+        }
+    }
+    const double pngTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    bool passed = saveKTX("ktx_benchmark.ktx", pngLevels);
+    //touch all bytes, so the mapped pages are actually read like an upload would
+    size_t checksum = 0;
+    std::vector<Image> ktxLevels;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        ktxLevels = loadKTX("ktx_benchmark.ktx");
+        for (size_t level = 0; level < ktxLevels.size(); ++level) {
+            const size_t dataSize = PixelInfo::dataSize(formatType, ktxLevels[level].width(), ktxLevels[level].height());
+            //read through a const image. non-const pixels() would copy the mapped data
+            const uint8_t * data = ((const Image &)ktxLevels[level]).pixels();
+            for (size_t j = 0; j < dataSize; j += 64) {
+                checksum += data[j];
+            }
+        }
+    }
+    const double ktxTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    passed &= ktxLevels.size() == pngLevels.size() && checksum > 0;
+    for (size_t level = 0; level < ktxLevels.size() && passed; ++level) {
+        passed &= memcmp(((const Image &)ktxLevels[level]).pixels(), ((const Image &)pngLevels[level]).pixels(), PixelInfo::dataSize(formatType, pngLevels[level].width(), pngLevels[level].height())) == 0;
+    }
+    remove("ktx_benchmark.ktx");
+    std::cout << "Texture startup " << path << " as " << PixelInfo::pixelInfo(formatType).name << " with " << pngLevels.size() << " mips: PNG " << pngTime << "ms, KTX " << ktxTime << "ms, speedup " << pngTime / ktxTime << "x " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+int main()
+{
+    if (!testPixelConversion() || !testResample() || !testMipChains() || !testRawContainer() || !testImageView() || !testConcurrentScaling() || !testFusedConverts() || !testSummedArea() || !testCopyOnWrite() || !testPixelPool() || !testTextureAtlas() || !testETC1() || !testS3TC() || !testKTX() || !testStatistics() || !testCompactFormat() || !testPremultiply() || !benchmarkResample() || !benchmarkAllocations()) {
+        return -1;
+    }
+
+    if (!testLazyDecode("lena_512_24.png") || !testFusedLoad("lena_512_24.png") || !testLoadScaled("lena_512_24.png", 200, 100) || !testLoadScaled("lena_512_24.png", 1024, 1024)) {
+        return -1;
+    }
+
+    if (!benchmarkKTX("lena_512_24.png", PixelInfo::R5G6B5) || !benchmarkKTX("lena_512_32.png", PixelInfo::BC3_R5G6B5A8)) {
+        return -1;
+    }
+
     Image png;
     png.load("lena_512_24.png");
     Image image1 = png.scaled(64, 77);
@@ -9,4 +1666,5 @@ void main()
     Image image2(0, 0, PixelInfo::R5G6B5);
     image2 = image1;
 	image2.save("2.png");
-}
\ No newline at end of file
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "ImageView.h"
+#include "Image.h"
+
+#include <string.h>
+
+
+ConstImageView ConstImageView::subView(size_t x, size_t y, size_t w, size_t h) const
+{
+    if (x + w > width || y + h > height) {
+        throw ImageException("ConstImageView::subView() - Sub-rectangle out of bounds!");
+    }
+    return ConstImageView(data + y * pitch + x * PixelInfo::pixelInfo(formatType).bytesPerPixel, w, h, formatType, pitch);
+}
+
+ImageView ImageView::subView(size_t x, size_t y, size_t w, size_t h) const
+{
+    if (x + w > width || y + h > height) {
+        throw ImageException("ImageView::subView() - Sub-rectangle out of bounds!");
+    }
+    return ImageView(data + y * pitch + x * PixelInfo::pixelInfo(formatType).bytesPerPixel, w, h, formatType, pitch);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+void convertFormat(const ImageView & dest, const ConstImageView & source)
+{
+    if (dest.width != source.width || dest.height != source.height) {
+        throw ImageException("convertFormat() - View sizes must match!");
+    }
+    if (dest.data == nullptr || source.data == nullptr) {
+        return;
+    }
+    //tightly packed views can be converted in one go
+    if (dest.isContiguous() && source.isContiguous()) {
+        convertFormat(dest.data, nullptr, dest.formatType, source.data, nullptr, source.formatType, dest.width * dest.height);
+        return;
+    }
+#pragma omp parallel for
+    for (int y = 0; y < (int)dest.height; ++y) {
+        convertFormat(dest.row(y), nullptr, dest.formatType, source.row(y), nullptr, source.formatType, dest.width);
+    }
+}
+
+void copyPixels(const ImageView & dest, const ConstImageView & source)
+{
+    if (dest.width != source.width || dest.height != source.height || dest.formatType != source.formatType) {
+        throw ImageException("copyPixels() - View sizes and formats must match!");
+    }
+    if (dest.data == nullptr || source.data == nullptr) {
+        return;
+    }
+    if (dest.isContiguous() && source.isContiguous()) {
+        memcpy(dest.data, source.data, dest.rowBytes() * dest.height);
+        return;
+    }
+    const size_t rowBytes = dest.rowBytes();
+    for (size_t y = 0; y < dest.height; ++y) {
+        memcpy(dest.row(y), source.row(y), rowBytes);
+    }
+}
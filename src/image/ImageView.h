@@ -0,0 +1,104 @@
+#pragma once
+
+#include "PixelInfo.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/*!
+Non-owning read-only view of image data. Rows may be padded or the view may be a sub-rectangle of a bigger image, so always use pitch to go to the next row.
+*/
+struct ConstImageView
+{
+    const uint8_t * data; //!< Pointer to first pixel of the view.
+    size_t width; //!< Width of view in pixels.
+    size_t height; //!< Height of view in pixels.
+    size_t pitch; //!< Byte-stride from the start of one row to the start of the next row.
+    PixelInfo::FormatType formatType; //!< Pixel format of data.
+
+    /*!
+    Construct an empty view.
+    */
+    ConstImageView() : data(nullptr), width(0), height(0), pitch(0), formatType(PixelInfo::BAD_FORMAT) {}
+
+    /*!
+    Construct a view of existing data.
+    \param[in] d Pointer to first pixel.
+    \param[in] w Width in pixels.
+    \param[in] h Height in pixels.
+    \param[in] format Pixel format of data.
+    \param[in] p Byte-stride between rows. Pass 0 for tightly packed rows.
+    */
+    ConstImageView(const uint8_t * d, size_t w, size_t h, PixelInfo::FormatType format, size_t p = 0)
+        : data(d), width(w), height(h), pitch(p != 0 ? p : w * PixelInfo::pixelInfo(format).bytesPerPixel), formatType(format) {}
+
+    /*!
+    Get pointer to a row.
+    \param[in] y Row index.
+    \return Returns a pointer to the first pixel of row y.
+    */
+    const uint8_t * row(size_t y) const { return data + y * pitch; }
+
+    /*!
+    Get number of bytes of pixel data in a row, without padding.
+    */
+    size_t rowBytes() const { return width * PixelInfo::pixelInfo(formatType).bytesPerPixel; }
+
+    /*!
+    Check if the rows are tightly packed, so the data can be treated as one block.
+    */
+    bool isContiguous() const { return pitch == rowBytes(); }
+
+    /*!
+    Get a view of a sub-rectangle of this view. No data is copied.
+    \param[in] x Left pixel of sub-rectangle.
+    \param[in] y Top row of sub-rectangle.
+    \param[in] w Width of sub-rectangle.
+    \param[in] h Height of sub-rectangle.
+    \return Returns a view sharing the data and pitch of this view.
+    \note Throws an ImageException if the sub-rectangle is not inside the view.
+    */
+    ConstImageView subView(size_t x, size_t y, size_t w, size_t h) const;
+};
+
+/*!
+Non-owning writable view of image data. \sa ConstImageView.
+*/
+struct ImageView
+{
+    uint8_t * data; //!< Pointer to first pixel of the view.
+    size_t width; //!< Width of view in pixels.
+    size_t height; //!< Height of view in pixels.
+    size_t pitch; //!< Byte-stride from the start of one row to the start of the next row.
+    PixelInfo::FormatType formatType; //!< Pixel format of data.
+
+    ImageView() : data(nullptr), width(0), height(0), pitch(0), formatType(PixelInfo::BAD_FORMAT) {}
+
+    ImageView(uint8_t * d, size_t w, size_t h, PixelInfo::FormatType format, size_t p = 0)
+        : data(d), width(w), height(h), pitch(p != 0 ? p : w * PixelInfo::pixelInfo(format).bytesPerPixel), formatType(format) {}
+
+    operator ConstImageView() const { return ConstImageView(data, width, height, formatType, pitch); }
+
+    uint8_t * row(size_t y) const { return data + y * pitch; }
+    size_t rowBytes() const { return width * PixelInfo::pixelInfo(formatType).bytesPerPixel; }
+    bool isContiguous() const { return pitch == rowBytes(); }
+    ImageView subView(size_t x, size_t y, size_t w, size_t h) const;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+/*!
+Convert the pixels of one view to the format of another view. Both views must have the same size.
+\param[in] dest Output view. Its format is the output format.
+\param[in] source Input view.
+\note Throws an ImageException if the sizes do not match. Palettes are not converted.
+*/
+void convertFormat(const ImageView & dest, const ConstImageView & source);
+
+/*!
+Copy the pixels of one view to another view of the same size and format.
+\param[in] dest Output view.
+\param[in] source Input view.
+*/
+void copyPixels(const ImageView & dest, const ConstImageView & source);
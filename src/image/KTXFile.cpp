@@ -0,0 +1,372 @@
+#include "KTXFile.h"
+#include "MappedFile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+//KTX files start with this identifier, followed by the header. All values are in the byte order given by the endianness field.
+static const uint8_t KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+#define KTX_ENDIANNESS 0x04030201
+#define KTX_ORIENTATION_KEY "KTXorientation"
+#define KTX_PREMULTIPLIED_KEY "premultipliedAlpha" //!< Not part of the KTX specification. Value "true" if color components are premultiplied with alpha.
+
+struct KTXHeader
+{
+    uint8_t identifier[12]; //!< Always KTX_IDENTIFIER.
+    uint32_t endianness; //!< KTX_ENDIANNESS in the byte order of the file.
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth; //!< 0 for 2D textures.
+    uint32_t numberOfArrayElements; //!< 0 if this is not an array texture.
+    uint32_t numberOfFaces; //!< 1 if this is not a cube map.
+    uint32_t numberOfMipmapLevels; //!< 0 means the loader should generate mipmaps, so only level 0 is stored.
+    uint32_t bytesOfKeyValueData; //!< Size of key / value pairs following the header.
+};
+
+//OpenGL enums used in KTX headers. The image library does not include OpenGL headers.
+#define KTX_GL_UNSIGNED_BYTE 0x1401
+#define KTX_GL_UNSIGNED_SHORT_4_4_4_4 0x8033
+#define KTX_GL_UNSIGNED_SHORT_5_5_5_1 0x8034
+#define KTX_GL_UNSIGNED_INT_8_8_8_8 0x8035
+#define KTX_GL_UNSIGNED_SHORT_5_6_5 0x8363
+#define KTX_GL_UNSIGNED_SHORT_1_5_5_5_REV 0x8366
+#define KTX_GL_RGB 0x1907
+#define KTX_GL_RGBA 0x1908
+#define KTX_GL_LUMINANCE 0x1909
+#define KTX_GL_LUMINANCE_ALPHA 0x190A
+#define KTX_GL_BGR 0x80E0
+#define KTX_GL_BGRA 0x80E1
+#define KTX_GL_LUMINANCE8 0x8040
+#define KTX_GL_LUMINANCE8_ALPHA8 0x8045
+#define KTX_GL_RGB5 0x8050
+#define KTX_GL_RGB8 0x8051
+#define KTX_GL_RGBA4 0x8056
+#define KTX_GL_RGB5_A1 0x8057
+#define KTX_GL_RGBA8 0x8058
+#define KTX_GL_RGB565 0x8D62
+#define KTX_GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG 0x8C00
+#define KTX_GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG 0x8C01
+#define KTX_GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG 0x8C02
+#define KTX_GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG 0x8C03
+#define KTX_GL_ETC1_RGB8_OES 0x8D64
+#define KTX_GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define KTX_GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
+//Our pixel formats are stored as little-endian 8, 16, 24 or 32bit values, so the byte order of 8bit formats is reversed to what GL_RGB(A) expects.
+//Packed types or BGR(A) describe them exactly. The X bit of X1R5G5B5 is undefined, so it uses an internal format without alpha.
+struct KTXFormatEntry
+{
+    PixelInfo::FormatType formatType;
+    KTXFormat format;
+};
+
+static const KTXFormatEntry s_ktxFormats[] = {
+    { PixelInfo::R8G8B8A8, { KTX_GL_UNSIGNED_INT_8_8_8_8, 4, KTX_GL_RGBA, KTX_GL_RGBA8, KTX_GL_RGBA } },
+    { PixelInfo::A8R8G8B8, { KTX_GL_UNSIGNED_BYTE, 1, KTX_GL_BGRA, KTX_GL_RGBA8, KTX_GL_RGBA } },
+    { PixelInfo::R8G8B8X8, { KTX_GL_UNSIGNED_INT_8_8_8_8, 4, KTX_GL_RGBA, KTX_GL_RGB8, KTX_GL_RGB } },
+    { PixelInfo::X8R8G8B8, { KTX_GL_UNSIGNED_BYTE, 1, KTX_GL_BGRA, KTX_GL_RGB8, KTX_GL_RGB } },
+    { PixelInfo::R4G4B4A4, { KTX_GL_UNSIGNED_SHORT_4_4_4_4, 2, KTX_GL_RGBA, KTX_GL_RGBA4, KTX_GL_RGBA } },
+    { PixelInfo::R8G8B8, { KTX_GL_UNSIGNED_BYTE, 1, KTX_GL_BGR, KTX_GL_RGB8, KTX_GL_RGB } },
+    { PixelInfo::X1R5G5B5, { KTX_GL_UNSIGNED_SHORT_1_5_5_5_REV, 2, KTX_GL_BGRA, KTX_GL_RGB5, KTX_GL_RGB } },
+    { PixelInfo::R5G6B5, { KTX_GL_UNSIGNED_SHORT_5_6_5, 2, KTX_GL_RGB, KTX_GL_RGB565, KTX_GL_RGB } },
+    { PixelInfo::PVRTC1_R4G4B4, { 0, 1, 0, KTX_GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, KTX_GL_RGB } },
+    { PixelInfo::PVRTC1_R2G2B2, { 0, 1, 0, KTX_GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG, KTX_GL_RGB } },
+    { PixelInfo::PVRTC1_R4G4B4A4, { 0, 1, 0, KTX_GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG, KTX_GL_RGBA } },
+    { PixelInfo::PVRTC1_R2G2B2A2, { 0, 1, 0, KTX_GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG, KTX_GL_RGBA } },
+    { PixelInfo::ETC1_R8G8B8, { 0, 1, 0, KTX_GL_ETC1_RGB8_OES, KTX_GL_RGB } },
+    { PixelInfo::BC1_R5G6B5, { 0, 1, 0, KTX_GL_COMPRESSED_RGB_S3TC_DXT1_EXT, KTX_GL_RGB } },
+    { PixelInfo::BC3_R5G6B5A8, { 0, 1, 0, KTX_GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, KTX_GL_RGBA } },
+    { PixelInfo::R5G5B5A1, { KTX_GL_UNSIGNED_SHORT_5_5_5_1, 2, KTX_GL_RGBA, KTX_GL_RGB5_A1, KTX_GL_RGBA } },
+    { PixelInfo::L8, { KTX_GL_UNSIGNED_BYTE, 1, KTX_GL_LUMINANCE, KTX_GL_LUMINANCE8, KTX_GL_LUMINANCE } },
+    { PixelInfo::L8A8, { KTX_GL_UNSIGNED_BYTE, 1, KTX_GL_LUMINANCE_ALPHA, KTX_GL_LUMINANCE8_ALPHA8, KTX_GL_LUMINANCE_ALPHA } }
+};
+
+bool ktxFormat(KTXFormat & format, PixelInfo::FormatType formatType)
+{
+    for (size_t i = 0; i < sizeof(s_ktxFormats) / sizeof(KTXFormatEntry); ++i) {
+        if (s_ktxFormats[i].formatType == formatType) {
+            format = s_ktxFormats[i].format;
+            return true;
+        }
+    }
+    return false;
+}
+
+static PixelInfo::FormatType formatTypeFromHeader(const KTXHeader & header)
+{
+    for (size_t i = 0; i < sizeof(s_ktxFormats) / sizeof(KTXFormatEntry); ++i) {
+        const KTXFormat & format = s_ktxFormats[i].format;
+        if (format.glType == header.glType && format.glFormat == header.glFormat && format.glInternalFormat == header.glInternalFormat) {
+            return s_ktxFormats[i].formatType;
+        }
+    }
+    return PixelInfo::BAD_FORMAT;
+}
+
+//Size of a row of a level in the file. Uncompressed rows are padded to 4 bytes.
+static size_t rowPitch(PixelInfo::FormatType formatType, size_t width)
+{
+    return (width * PixelInfo::pixelInfo(formatType).bytesPerPixel + 3) & ~(size_t)3;
+}
+
+//Size of a level in the file without the mip padding.
+static size_t levelSize(PixelInfo::FormatType formatType, size_t width, size_t height)
+{
+    if (PixelInfo::pixelInfo(formatType).compressed) {
+        return PixelInfo::dataSize(formatType, width, height);
+    }
+    return rowPitch(formatType, width) * height;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+//Position of a mip level in a KTX file.
+struct KTXLevel
+{
+    size_t width;
+    size_t height;
+    size_t offset; //!< Offset of level data from the start of the file.
+    size_t pitch; //!< Bytes per row in the file. 0 for compressed levels.
+};
+
+//Check the header and find all levels of a KTX file. Returns the pixel format of the levels.
+static PixelInfo::FormatType parseKTX(std::vector<KTXLevel> & levels, Image::Orientation & orientation, bool & premultiplied, const uint8_t * data, size_t size)
+{
+    KTXHeader header;
+    if (data == nullptr || size < sizeof(KTXHeader)) {
+        throw ImageException("loadKTX() - Invalid KTX data!");
+    }
+    memcpy(&header, data, sizeof(KTXHeader));
+    if (memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0) {
+        throw ImageException("loadKTX() - Not a KTX file!");
+    }
+    if (header.endianness != KTX_ENDIANNESS) {
+        throw ImageException("loadKTX() - Big-endian KTX files are not supported!");
+    }
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.numberOfArrayElements != 0 || header.numberOfFaces != 1) {
+        throw ImageException("loadKTX() - Only 2D KTX textures are supported!");
+    }
+    const PixelInfo::FormatType formatType = formatTypeFromHeader(header);
+    if (formatType == PixelInfo::BAD_FORMAT) {
+        throw ImageException("loadKTX() - Unsupported KTX pixel format!");
+    }
+    if ((size_t)header.bytesOfKeyValueData > size - sizeof(KTXHeader)) {
+        throw ImageException("loadKTX() - Invalid KTX key / value data!");
+    }
+    //find the orientation and alpha mode in the key / value pairs. every pair is padded to 4 bytes
+    orientation = Image::TOP_DOWN;
+    premultiplied = false;
+    const uint8_t * keyValue = data + sizeof(KTXHeader);
+    const uint8_t * keyValueEnd = keyValue + header.bytesOfKeyValueData;
+    while (keyValue + 4 <= keyValueEnd) {
+        uint32_t pairSize = 0;
+        memcpy(&pairSize, keyValue, 4);
+        if (pairSize > (size_t)(keyValueEnd - keyValue) - 4) {
+            throw ImageException("loadKTX() - Invalid KTX key / value data!");
+        }
+        const char * pair = (const char *)keyValue + 4;
+        const size_t keyLength = strnlen(pair, pairSize);
+        if (keyLength < pairSize) {
+            const std::string key(pair, keyLength);
+            const std::string value(pair + keyLength + 1, strnlen(pair + keyLength + 1, pairSize - keyLength - 1));
+            if (key == KTX_ORIENTATION_KEY) {
+                orientation = value.find("T=u") != std::string::npos ? Image::BOTTOM_UP : Image::TOP_DOWN;
+            }
+            else if (key == KTX_PREMULTIPLIED_KEY) {
+                premultiplied = value == "true";
+            }
+        }
+        keyValue += 4 + ((pairSize + 3) & ~(uint32_t)3);
+    }
+    //a full mip chain ends at 1x1, so there can be at most floor(log2(max(width, height))) + 1 levels
+    uint32_t maxLevels = 1;
+    for (uint32_t maxSize = header.pixelWidth > header.pixelHeight ? header.pixelWidth : header.pixelHeight; maxSize > 1; maxSize >>= 1) {
+        ++maxLevels;
+    }
+    if (header.numberOfMipmapLevels > maxLevels) {
+        throw ImageException("loadKTX() - Invalid number of KTX mip levels!");
+    }
+    //every level is its size, the data and padding to 4 bytes
+    const size_t nrOfLevels = header.numberOfMipmapLevels > 0 ? header.numberOfMipmapLevels : 1;
+    const bool compressed = PixelInfo::pixelInfo(formatType).compressed;
+    size_t offset = sizeof(KTXHeader) + header.bytesOfKeyValueData;
+    levels.clear();
+    for (size_t i = 0; i < nrOfLevels; ++i) {
+        KTXLevel level;
+        level.width = (header.pixelWidth >> i) > 0 ? (header.pixelWidth >> i) : 1;
+        level.height = (header.pixelHeight >> i) > 0 ? (header.pixelHeight >> i) : 1;
+        level.pitch = compressed ? 0 : rowPitch(formatType, level.width);
+        uint32_t imageSize = 0;
+        if (offset > size || size - offset < 4) {
+            throw ImageException("loadKTX() - KTX file is truncated!");
+        }
+        level.offset = offset + 4;
+        memcpy(&imageSize, data + offset, 4);
+        //compare against the remaining bytes, so a huge image size can not wrap around the offset
+        if (imageSize != levelSize(formatType, level.width, level.height) || imageSize > size - level.offset) {
+            throw ImageException("loadKTX() - Invalid KTX level size!");
+        }
+        levels.push_back(level);
+        offset = (level.offset + imageSize + 3) & ~(size_t)3;
+    }
+    return formatType;
+}
+
+//Copy a level out of the file and remove the row padding.
+static Image copyLevel(const uint8_t * data, const KTXLevel & level, PixelInfo::FormatType formatType)
+{
+    Image image(level.width, level.height, formatType);
+    if (level.pitch == 0) {
+        memcpy(image.pixels(), data + level.offset, PixelInfo::dataSize(formatType, level.width, level.height));
+    }
+    else {
+        ImageView view = image.view();
+        for (size_t y = 0; y < level.height; ++y) {
+            memcpy(view.row(y), data + level.offset + y * level.pitch, view.rowBytes());
+        }
+    }
+    return image;
+}
+
+std::vector<Image> loadKTX(const std::string & path, Image::Orientation * orientation)
+{
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(path)) {
+        throw ImageException("loadKTX() - Failed to map file!");
+    }
+    return loadKTX(file, 0, orientation);
+}
+
+std::vector<Image> loadKTX(const std::shared_ptr<MappedFile> & file, size_t offset, Image::Orientation * orientation)
+{
+    if (file == nullptr || !file->isOpen() || offset >= file->size()) {
+        throw ImageException("loadKTX() - Invalid mapped file!");
+    }
+    std::vector<KTXLevel> levels;
+    Image::Orientation fileOrientation;
+    bool premultiplied = false;
+    const PixelInfo::FormatType formatType = parseKTX(levels, fileOrientation, premultiplied, file->data() + offset, file->size() - offset);
+    std::vector<Image> images(levels.size());
+    for (size_t i = 0; i < levels.size(); ++i) {
+        //tightly packed levels are used in place. padded rows need a copy, because images have no row pitch
+        if (levels[i].pitch == 0 || levels[i].pitch == levels[i].width * PixelInfo::pixelInfo(formatType).bytesPerPixel) {
+            images[i].loadMapped(file, offset + levels[i].offset, levels[i].width, levels[i].height, formatType);
+        }
+        else {
+            images[i] = copyLevel(file->data() + offset, levels[i], formatType);
+        }
+        images[i].setPremultiplied(premultiplied);
+    }
+    if (orientation != nullptr) {
+        *orientation = fileOrientation;
+    }
+    return images;
+}
+
+std::vector<Image> loadKTX(const uint8_t * data, size_t size, Image::Orientation * orientation)
+{
+    std::vector<KTXLevel> levels;
+    Image::Orientation fileOrientation;
+    bool premultiplied = false;
+    const PixelInfo::FormatType formatType = parseKTX(levels, fileOrientation, premultiplied, data, size);
+    std::vector<Image> images;
+    images.reserve(levels.size());
+    for (size_t i = 0; i < levels.size(); ++i) {
+        images.push_back(copyLevel(data, levels[i], formatType));
+        images.back().setPremultiplied(premultiplied);
+    }
+    if (orientation != nullptr) {
+        *orientation = fileOrientation;
+    }
+    return images;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+//Append a key / value pair with its size and padding. The value is padded with NULs until the pair is a multiple of alignment bytes long.
+static void appendKeyValue(std::string & keyValueData, const std::string & key, const std::string & value, size_t alignment)
+{
+    std::string pair = key + '\0' + value + '\0';
+    while ((4 + ((pair.size() + 3) & ~(size_t)3)) % alignment != 0) {
+        pair += '\0';
+    }
+    const uint32_t pairSize = (uint32_t)pair.size();
+    keyValueData.append((const char *)&pairSize, 4);
+    keyValueData.append(pair);
+    keyValueData.append(((pairSize + 3) & ~(uint32_t)3) - pairSize, '\0');
+}
+
+bool saveKTX(const std::string & path, const std::vector<Image> & levels, Image::Orientation orientation)
+{
+    if (levels.empty() || levels.front().width() == 0 || levels.front().height() == 0) {
+        throw ImageException("saveKTX() - No image data!");
+    }
+    const PixelInfo::FormatType formatType = levels.front().formatType();
+    KTXFormat format;
+    if (!ktxFormat(format, formatType)) {
+        throw ImageException("saveKTX() - Unsupported pixel format!");
+    }
+    for (size_t i = 1; i < levels.size(); ++i) {
+        const size_t width = levels[i - 1].width() > 1 ? levels[i - 1].width() / 2 : 1;
+        const size_t height = levels[i - 1].height() > 1 ? levels[i - 1].height() / 2 : 1;
+        if (levels[i].formatType() != formatType || levels[i].width() != width || levels[i].height() != height) {
+            throw ImageException("saveKTX() - Levels are not a mip chain!");
+        }
+    }
+    KTXHeader header;
+    memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    header.endianness = KTX_ENDIANNESS;
+    header.glType = format.glType;
+    header.glTypeSize = format.glTypeSize;
+    header.glFormat = format.glFormat;
+    header.glInternalFormat = format.glInternalFormat;
+    header.glBaseInternalFormat = format.glBaseInternalFormat;
+    header.pixelWidth = (uint32_t)levels.front().width();
+    header.pixelHeight = (uint32_t)levels.front().height();
+    header.pixelDepth = 0;
+    header.numberOfArrayElements = 0;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (uint32_t)levels.size();
+    //the orientation pair and the premultiplied pair. with their padding the data of level 0 starts 16-byte aligned
+    std::string keyValueData;
+    appendKeyValue(keyValueData, KTX_ORIENTATION_KEY, orientation == Image::BOTTOM_UP ? "S=r,T=u" : "S=r,T=d", 4);
+    if (levels.front().isPremultiplied()) {
+        appendKeyValue(keyValueData, KTX_PREMULTIPLIED_KEY, "true", 16);
+    }
+    header.bytesOfKeyValueData = (uint32_t)keyValueData.size();
+    FILE * file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw ImageException("saveKTX() - Failed to open file!");
+    }
+    const uint8_t padding[4] = {0};
+    bool worked = fwrite(&header, sizeof(KTXHeader), 1, file) == 1;
+    worked &= fwrite(keyValueData.data(), keyValueData.size(), 1, file) == 1;
+    for (size_t i = 0; i < levels.size() && worked; ++i) {
+        const Image & level = levels[i];
+        const uint32_t imageSize = (uint32_t)levelSize(formatType, level.width(), level.height());
+        worked &= fwrite(&imageSize, 4, 1, file) == 1;
+        if (PixelInfo::pixelInfo(formatType).compressed) {
+            worked &= fwrite(level.pixels(), imageSize, 1, file) == 1;
+        }
+        else {
+            //pad every row to 4 bytes
+            const ConstImageView view = level.view();
+            const size_t rowPadding = rowPitch(formatType, level.width()) - view.rowBytes();
+            for (size_t y = 0; y < level.height() && worked; ++y) {
+                worked &= fwrite(view.row(y), view.rowBytes(), 1, file) == 1;
+                worked &= rowPadding == 0 || fwrite(padding, rowPadding, 1, file) == 1;
+            }
+        }
+        //levels are padded to 4 bytes. all formats we write are a multiple of 4 bytes already, but be safe
+        const size_t mipPadding = ((imageSize + 3) & ~(size_t)3) - imageSize;
+        worked &= mipPadding == 0 || fwrite(padding, mipPadding, 1, file) == 1;
+    }
+    fclose(file);
+    return worked;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Image.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/*!
+Reader and writer for KTX (version 1) texture containers. A KTX file stores the OpenGL format of the texture and all its mip levels,
+so textures can be uploaded without decoding, converting or scaling anything at startup.
+Only little-endian 2D textures without arrays or cube faces are supported. Rows of uncompressed levels are padded to 4 bytes as KTX requires.
+*/
+
+/*!
+OpenGL format of a texture as stored in the KTX header. Compressed formats have glType and glFormat set to 0.
+*/
+struct KTXFormat
+{
+    uint32_t glType; //!< Pixel data type, e.g. GL_UNSIGNED_SHORT_5_6_5.
+    uint32_t glTypeSize; //!< Size of glType in bytes for endianness conversion. 1 for compressed data.
+    uint32_t glFormat; //!< Pixel data format, e.g. GL_RGB.
+    uint32_t glInternalFormat; //!< Sized internal format for desktop OpenGL or compressed internal format.
+    uint32_t glBaseInternalFormat; //!< Unsized internal format. OpenGL ES 2.0 needs this as internal format for uncompressed data.
+};
+
+/*!
+Get the OpenGL format a pixel format is stored with in KTX files.
+\param[in] format Receives the OpenGL format.
+\param[in] formatType Pixel format.
+\return Returns false if the pixel format can not be stored in KTX files, e.g. palette formats.
+*/
+bool ktxFormat(KTXFormat & format, PixelInfo::FormatType formatType);
+
+/*!
+Save mip levels to a KTX file.
+\param[in] path Path to file to save.
+\param[in] levels Mip levels, e.g. from Image::generateMipChain(). All levels must have the same format and level n must be half the size of level n-1, but at least 1 pixel.
+\param[in] orientation Optional. Row order of the levels. Stored as the KTXorientation key.
+\return Returns true if the file could be saved.
+\note Premultiplied levels are marked with the premultipliedAlpha key, so the loaded images are premultiplied again.
+\note Throws an ImageException if the levels do not form a mip chain, the format is not supported or the file can not be opened.
+*/
+bool saveKTX(const std::string & path, const std::vector<Image> & levels, Image::Orientation orientation = Image::BOTTOM_UP);
+
+/*!
+Map a KTX file into memory and use its mip levels directly without copying.
+\param[in] path Path to KTX file.
+\param[out] orientation Optional. Receives the row order of the levels from the KTXorientation key. Files without that key are assumed to be TOP_DOWN like the KTX specification suggests.
+\return Returns all mip levels stored in the file.
+\note Levels whose rows are padded in the file are copied into tightly packed images. The file must not change as long as the images use it.
+Throws an ImageException if the file can not be mapped or is invalid.
+*/
+std::vector<Image> loadKTX(const std::string & path, Image::Orientation * orientation = nullptr);
+
+/*!
+Use the mip levels of a KTX file in an already mapped file without copying, e.g. in a packed archive.
+\param[in] file Mapped file. The images keep the mapping alive as long as they use its data.
+\param[in] offset Byte offset of the KTX file in the mapped file.
+\param[out] orientation Optional. Receives the row order of the levels.
+\return Returns all mip levels stored in the file.
+*/
+std::vector<Image> loadKTX(const std::shared_ptr<MappedFile> & file, size_t offset = 0, Image::Orientation * orientation = nullptr);
+
+/*!
+Copy the mip levels of a KTX file in memory.
+\param[in] data Pointer to KTX file in memory.
+\param[in] size Size of KTX file in memory.
+\param[out] orientation Optional. Receives the row order of the levels.
+\return Returns all mip levels stored in the file.
+*/
+std::vector<Image> loadKTX(const uint8_t * data, size_t size, Image::Orientation * orientation = nullptr);
@@ -0,0 +1,118 @@
+#include "MappedFile.h"
+#include "Image.h"
+
+#if defined(WIN32) || defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile()
+#if defined(WIN32) || defined(_WIN32)
+    : m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(nullptr)
+#else
+    : m_file(-1)
+#endif
+    , m_data(nullptr)
+    , m_size(0)
+{
+}
+
+MappedFile::MappedFile(const std::string & path)
+#if defined(WIN32) || defined(_WIN32)
+    : m_file(INVALID_HANDLE_VALUE)
+    , m_mapping(nullptr)
+#else
+    : m_file(-1)
+#endif
+    , m_data(nullptr)
+    , m_size(0)
+{
+    if (!open(path)) {
+        throw ImageException("MappedFile::MappedFile() - Failed to map file \"" + path + "\"!");
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string & path)
+{
+    close();
+#if defined(WIN32) || defined(_WIN32)
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+    //map copy-on-write, so the data can be modified without changing the file
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (m_mapping == nullptr) {
+        close();
+        return false;
+    }
+    m_data = (uint8_t *)MapViewOfFile(m_mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (m_data == nullptr) {
+        close();
+        return false;
+    }
+    m_size = (size_t)fileSize.QuadPart;
+#else
+    m_file = ::open(path.c_str(), O_RDONLY);
+    if (m_file < 0) {
+        return false;
+    }
+    struct stat fileInfo;
+    if (fstat(m_file, &fileInfo) != 0 || fileInfo.st_size <= 0) {
+        close();
+        return false;
+    }
+    //map copy-on-write, so the data can be modified without changing the file
+    void * data = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_file, 0);
+    if (data == MAP_FAILED) {
+        close();
+        return false;
+    }
+    m_data = (uint8_t *)data;
+    m_size = (size_t)fileInfo.st_size;
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+#if defined(WIN32) || defined(_WIN32)
+    if (m_data != nullptr) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping != nullptr) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_data != nullptr) {
+        munmap(m_data, m_size);
+    }
+    if (m_file >= 0) {
+        ::close(m_file);
+        m_file = -1;
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+
+/*!
+Read-only file mapped into memory. The mapping is private / copy-on-write, so the mapped data may be modified without touching the file.
+Share it through a std::shared_ptr to keep it alive as long as images use its data.
+*/
+class MappedFile
+{
+#if defined(WIN32) || defined(_WIN32)
+    void * m_file;
+    void * m_mapping;
+#else
+    int m_file;
+#endif
+    uint8_t * m_data;
+    size_t m_size;
+
+    MappedFile(const MappedFile & b);
+    MappedFile & operator=(const MappedFile & b);
+
+public:
+    /*!
+    Constructor. Does not map anything.
+    */
+    MappedFile();
+
+    /*!
+    Map a file into memory.
+    \param[in] path Path to file to map.
+    \note Throws an ImageException if the file can not be mapped.
+    */
+    MappedFile(const std::string & path);
+
+    /*!
+    Destructor. Unmaps the file.
+    */
+    ~MappedFile();
+
+    /*!
+    Map a file into memory. A previously mapped file is unmapped.
+    \param[in] path Path to file to map.
+    \return Returns true if the file could be mapped.
+    */
+    bool open(const std::string & path);
+
+    /*!
+    Unmap the file. Pointers retrieved from data() are invalid afterwards.
+    */
+    void close();
+
+    /*!
+    Check if a file is mapped.
+    \return Returns true if a file is mapped.
+    */
+    bool isOpen() const { return m_data != nullptr; }
+
+    /*!
+    Get pointer to mapped data.
+    \return Returns a pointer to the start of the file in memory or nullptr if no file is mapped.
+    */
+    const uint8_t * data() const { return (const uint8_t *)m_data; }
+
+    /*!
+    Get pointer to mapped data. Writing to the data does not change the file.
+    \return Returns a pointer to the start of the file in memory or nullptr if no file is mapped.
+    */
+    uint8_t * data() { return m_data; }
+
+    /*!
+    Get size of mapped file.
+    \return Returns the size of the file in bytes.
+    */
+    size_t size() const { return m_size; }
+};
@@ -0,0 +1,311 @@
+#include "PixelAllocator.h"
+
+#include <stdlib.h>
+#include <new>
+#include <set>
+#if defined(WIN32) || defined(_WIN32)
+    #include <malloc.h>
+#endif
+
+
+//Every buffer starts with this header. It is padded to PIXEL_BUFFER_ALIGNMENT bytes, so the pixel data stays aligned.
+struct BlockHeader
+{
+    PixelAllocator * allocator; //!< Allocator the block came from.
+    size_t size; //!< Size of the block including the header.
+};
+
+static std::atomic<PixelAllocator *> s_allocator(nullptr);
+
+//Pools currently alive. Thread caches check this before returning blocks to a pool.
+//These are allocated once and never freed, so they are still there when thread caches are destroyed at exit.
+static std::mutex & poolRegistryMutex()
+{
+    static std::mutex * mutex = new std::mutex();
+    return *mutex;
+}
+
+static std::set<PixelPool *> & poolRegistry()
+{
+    static std::set<PixelPool *> * registry = new std::set<PixelPool *>();
+    return *registry;
+}
+
+static PixelPool & defaultPool()
+{
+    static PixelPool * pool = new PixelPool();
+    return *pool;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+uint8_t * PixelAllocator::allocate(size_t size)
+{
+    PixelAllocator & current = allocator();
+    const size_t blockSize = size + PIXEL_BUFFER_ALIGNMENT;
+    uint8_t * block = (uint8_t *)current.allocateBlock(blockSize);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    BlockHeader * header = (BlockHeader *)block;
+    header->allocator = &current;
+    header->size = blockSize;
+    return block + PIXEL_BUFFER_ALIGNMENT;
+}
+
+void PixelAllocator::release(void * data)
+{
+    if (data != nullptr) {
+        uint8_t * block = (uint8_t *)data - PIXEL_BUFFER_ALIGNMENT;
+        const BlockHeader * header = (const BlockHeader *)block;
+        header->allocator->freeBlock(block, header->size);
+    }
+}
+
+void PixelAllocator::setAllocator(PixelAllocator * allocator)
+{
+    s_allocator = allocator;
+}
+
+PixelAllocator & PixelAllocator::allocator()
+{
+    PixelAllocator * current = s_allocator;
+    return current != nullptr ? *current : defaultPool();
+}
+
+void * PixelAllocator::systemAllocate(size_t size)
+{
+#if defined(WIN32) || defined(_WIN32)
+    return _aligned_malloc(size, PIXEL_BUFFER_ALIGNMENT);
+#else
+    void * block = nullptr;
+    return posix_memalign(&block, PIXEL_BUFFER_ALIGNMENT, size) == 0 ? block : nullptr;
+#endif
+}
+
+void PixelAllocator::systemFree(void * block)
+{
+#if defined(WIN32) || defined(_WIN32)
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------
+
+//Set to false when the thread cache is destroyed at thread exit, so buffers freed later go to the shared lists
+static thread_local bool t_cacheAlive = true;
+
+/*!
+Small free lists for one thread. They belong to the pool the thread last freed a block to and need no locking.
+*/
+struct ThreadCache
+{
+    PixelPool * owner;
+    void * blocks[PixelPool::NR_OF_THREAD_CACHE_CLASSES][PixelPool::THREAD_CACHE_BLOCKS];
+    size_t counts[PixelPool::NR_OF_THREAD_CACHE_CLASSES];
+
+    ThreadCache() : owner(nullptr)
+    {
+        for (int i = 0; i < PixelPool::NR_OF_THREAD_CACHE_CLASSES; ++i) {
+            counts[i] = 0;
+        }
+    }
+
+    ~ThreadCache()
+    {
+        flush();
+        t_cacheAlive = false;
+    }
+
+    //Give all blocks back to the owner or to the system if the owner is gone
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(poolRegistryMutex());
+        const bool ownerAlive = owner != nullptr && poolRegistry().count(owner) > 0;
+        for (int i = 0; i < PixelPool::NR_OF_THREAD_CACHE_CLASSES; ++i) {
+            for (size_t j = 0; j < counts[i]; ++j) {
+                if (ownerAlive) {
+                    //the block is counted by the owner already and is counted again in the shared list
+                    owner->m_pooledBytes -= PixelPool::classSize(i);
+                    owner->freeShared(blocks[i][j], i);
+                }
+                else {
+                    PixelAllocator::systemFree(blocks[i][j]);
+                }
+            }
+        }
+        for (int i = 0; i < PixelPool::NR_OF_THREAD_CACHE_CLASSES; ++i) {
+            counts[i] = 0;
+        }
+        owner = nullptr;
+    }
+};
+
+static thread_local ThreadCache t_cache;
+
+//-------------------------------------------------------------------------------------------------
+
+PixelPool::PixelPool(size_t maxPooledBytes)
+    : m_maxPooledBytes(maxPooledBytes)
+    , m_pooledBytes(0)
+    , m_systemAllocations(0)
+    , m_poolHits(0)
+{
+    std::lock_guard<std::mutex> lock(poolRegistryMutex());
+    poolRegistry().insert(this);
+}
+
+PixelPool::~PixelPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(poolRegistryMutex());
+        poolRegistry().erase(this);
+    }
+    trim();
+}
+
+int PixelPool::sizeClass(size_t size)
+{
+    //64, 128, 192, 256
+    if (size <= 256) {
+        return size <= 64 ? 0 : (int)((size - 1) / 64);
+    }
+    //find highest bit, so 2^e < size <= 2^(e+1)
+    int e = 0;
+    for (size_t value = size - 1; value > 1; value >>= 1) {
+        ++e;
+    }
+    if (e >= 8 + (NR_OF_CLASSES - 4) / 4) {
+        return -1;
+    }
+    //split range into four classes
+    const size_t step = (size_t)1 << (e - 2);
+    const size_t k = ((size - ((size_t)1 << e)) + step - 1) / step;
+    return 4 + 4 * (e - 8) + (int)k - 1;
+}
+
+size_t PixelPool::classSize(int sizeClass)
+{
+    if (sizeClass < 4) {
+        return (size_t)(sizeClass + 1) * 64;
+    }
+    const int e = 8 + (sizeClass - 4) / 4;
+    const size_t k = (size_t)((sizeClass - 4) % 4) + 1;
+    return ((size_t)1 << e) + k * ((size_t)1 << (e - 2));
+}
+
+void * PixelPool::allocateBlock(size_t size)
+{
+    const int index = sizeClass(size);
+    if (index < 0) {
+        //too big to be pooled
+        m_systemAllocations++;
+        return systemAllocate(size);
+    }
+    //try the thread cache first. that needs no locking
+    if (index < NR_OF_THREAD_CACHE_CLASSES && t_cacheAlive && t_cache.owner == this && t_cache.counts[index] > 0) {
+        m_pooledBytes -= classSize(index);
+        m_poolHits++;
+        return t_cache.blocks[index][--t_cache.counts[index]];
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<void *> & freeList = m_freeLists[index];
+        if (!freeList.empty()) {
+            void * block = freeList.back();
+            freeList.pop_back();
+            m_pooledBytes -= classSize(index);
+            m_poolHits++;
+            return block;
+        }
+    }
+    m_systemAllocations++;
+    return systemAllocate(classSize(index));
+}
+
+void PixelPool::freeBlock(void * block, size_t size)
+{
+    if (block == nullptr) {
+        return;
+    }
+    const int index = sizeClass(size);
+    if (index < 0) {
+        systemFree(block);
+        return;
+    }
+    //small blocks go to the thread cache. it is handed over to this pool if it has no blocks of another pool
+    if (index < NR_OF_THREAD_CACHE_CLASSES && t_cacheAlive) {
+        if (t_cache.owner != this) {
+            bool empty = true;
+            for (int i = 0; i < NR_OF_THREAD_CACHE_CLASSES && empty; ++i) {
+                empty = t_cache.counts[i] == 0;
+            }
+            if (empty) {
+                t_cache.owner = this;
+            }
+        }
+        if (t_cache.owner == this && t_cache.counts[index] < THREAD_CACHE_BLOCKS && reserve(classSize(index))) {
+            t_cache.blocks[index][t_cache.counts[index]++] = block;
+            return;
+        }
+    }
+    freeShared(block, index);
+}
+
+void PixelPool::freeShared(void * block, int sizeClass)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (reserve(classSize(sizeClass))) {
+            m_freeLists[sizeClass].push_back(block);
+            return;
+        }
+    }
+    systemFree(block);
+}
+
+bool PixelPool::reserve(size_t size)
+{
+    //thread caches reserve without locking, so this must be a compare and swap loop
+    size_t current = m_pooledBytes;
+    do {
+        if (current + size > m_maxPooledBytes) {
+            return false;
+        }
+    } while (!m_pooledBytes.compare_exchange_weak(current, current + size));
+    return true;
+}
+
+void PixelPool::trim()
+{
+    if (t_cacheAlive && t_cache.owner == this) {
+        for (int i = 0; i < NR_OF_THREAD_CACHE_CLASSES; ++i) {
+            for (size_t j = 0; j < t_cache.counts[i]; ++j) {
+                systemFree(t_cache.blocks[i][j]);
+                m_pooledBytes -= classSize(i);
+            }
+            t_cache.counts[i] = 0;
+        }
+        t_cache.owner = nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < NR_OF_CLASSES; ++i) {
+        for (size_t j = 0; j < m_freeLists[i].size(); ++j) {
+            systemFree(m_freeLists[i][j]);
+        }
+        m_pooledBytes -= m_freeLists[i].size() * classSize(i);
+        m_freeLists[i].clear();
+    }
+}
+
+PixelPool::Statistics PixelPool::statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Statistics result;
+    result.systemAllocations = m_systemAllocations;
+    result.poolHits = m_poolHits;
+    result.pooledBytes = m_pooledBytes;
+    return result;
+}
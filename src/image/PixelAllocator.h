@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+
+//Alignment of all pixel buffers in bytes. This is the cache line size of most CPUs and enough for any SIMD load.
+#define PIXEL_BUFFER_ALIGNMENT 64
+
+/*!
+Allocator for pixel, palette and scratch buffers. Derive from this and pass an instance to \sa setAllocator to plug in your own memory management.
+Every buffer remembers the allocator it came from, so the allocator can be changed at any time. Allocators must outlive their buffers though.
+*/
+class PixelAllocator
+{
+public:
+    virtual ~PixelAllocator() {}
+
+    /*!
+    Allocate a block of memory.
+    \param[in] size Size of block in bytes.
+    \return Returns a pointer to memory aligned to PIXEL_BUFFER_ALIGNMENT bytes or nullptr if the allocation failed.
+    */
+    virtual void * allocateBlock(size_t size) = 0;
+
+    /*!
+    Free a block of memory allocated with \sa allocateBlock.
+    \param[in] block Pointer to block.
+    \param[in] size Size of block in bytes as passed to \sa allocateBlock.
+    */
+    virtual void freeBlock(void * block, size_t size) = 0;
+
+    /*!
+    Allocate a pixel buffer from the current allocator.
+    \param[in] size Size of buffer in bytes.
+    \return Returns a pointer to memory aligned to PIXEL_BUFFER_ALIGNMENT bytes.
+    \note Throws std::bad_alloc if the allocation failed.
+    */
+    static uint8_t * allocate(size_t size);
+
+    /*!
+    Release a buffer allocated with \sa allocate. It is returned to the allocator it was allocated from.
+    \param[in] data Pointer to buffer. May be nullptr.
+    */
+    static void release(void * data);
+
+    /*!
+    Set the allocator used for new buffers.
+    \param[in] allocator New allocator. Pass nullptr to use the default \sa PixelPool again.
+    */
+    static void setAllocator(PixelAllocator * allocator);
+
+    /*!
+    Get the allocator used for new buffers.
+    \return Returns the current allocator.
+    */
+    static PixelAllocator & allocator();
+
+    /*!
+    Allocate aligned memory from the system heap.
+    \param[in] size Size of block in bytes.
+    \return Returns a pointer to memory aligned to PIXEL_BUFFER_ALIGNMENT bytes or nullptr if the allocation failed.
+    */
+    static void * systemAllocate(size_t size);
+
+    /*!
+    Free memory allocated with \sa systemAllocate.
+    \param[in] block Pointer to block. May be nullptr.
+    */
+    static void systemFree(void * block);
+};
+
+//-------------------------------------------------------------------------------------------------
+
+/*!
+Default pixel allocator. It rounds sizes up to size classes and keeps freed blocks in free lists per class, so repeated decode and scale cycles reuse memory instead of going to the system heap.
+Small blocks are additionally cached per thread, so they can be reused without locking. Cached blocks count against the pool limit too.
+*/
+class PixelPool : public PixelAllocator
+{
+public:
+    struct Statistics
+    {
+        size_t systemAllocations; //!< Number of blocks allocated from the system heap.
+        size_t poolHits; //!< Number of allocations served from a free list or a thread cache.
+        size_t pooledBytes; //!< Bytes currently held in the shared free lists and thread caches.
+    };
+
+    /*!
+    Constructor.
+    \param[in] maxPooledBytes Maximum number of bytes kept in the shared free lists and thread caches. Blocks freed beyond that are returned to the system.
+    */
+    PixelPool(size_t maxPooledBytes = 256 * 1024 * 1024);
+
+    /*!
+    Destructor. Returns all pooled blocks to the system. Blocks still cached by other threads are freed when those threads exit.
+    */
+    ~PixelPool();
+
+    virtual void * allocateBlock(size_t size) override;
+    virtual void freeBlock(void * block, size_t size) override;
+
+    /*!
+    Return all blocks in the shared free lists and the thread cache of the calling thread to the system.
+    */
+    void trim();
+
+    /*!
+    Get allocation statistics.
+    \return Returns the current statistics.
+    */
+    Statistics statistics() const;
+
+    /*!
+    Get the size class index of a size.
+    \param[in] size Size of block in bytes.
+    \return Returns the index of the size class or -1 if the block is too big to be pooled.
+    */
+    static int sizeClass(size_t size);
+
+    /*!
+    Get the block size of a size class.
+    \param[in] sizeClass Size class index.
+    \return Returns the size of blocks in this class in bytes.
+    */
+    static size_t classSize(int sizeClass);
+
+    //Four classes per power of two up to 1GB, so at most 25% of a block are wasted.
+    static const int NR_OF_CLASSES = 4 + 4 * 22;
+    //Classes cached per thread. These are all blocks up to 256KB.
+    static const int NR_OF_THREAD_CACHE_CLASSES = 44;
+    //Number of blocks per size class cached per thread.
+    static const size_t THREAD_CACHE_BLOCKS = 4;
+
+private:
+    friend struct ThreadCache;
+
+    PixelPool(const PixelPool & b);
+    PixelPool & operator=(const PixelPool & b);
+
+    /*!
+    Put a block into the shared free list of its class or return it to the system if the pool is full.
+    */
+    void freeShared(void * block, int sizeClass);
+
+    /*!
+    Count a freed block against the pool limit.
+    \return Returns false if the pool is full and the block must be returned to the system.
+    */
+    bool reserve(size_t size);
+
+    mutable std::mutex m_mutex;
+    std::vector<void *> m_freeLists[NR_OF_CLASSES];
+    size_t m_maxPooledBytes;
+    std::atomic<size_t> m_pooledBytes; //!< Bytes in the shared free lists and the thread caches.
+    std::atomic<size_t> m_systemAllocations;
+    std::atomic<size_t> m_poolHits;
+};
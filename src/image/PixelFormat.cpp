@@ -1,4 +1,7 @@
 #include "PixelFormat.h"
+#include "PixelFormatSIMD.h"
+
+#include <string.h>
 
 const PixelInfo PixelInfo::pixelInfos[] = {
     { FormatType::BAD_FORMAT, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, false, "bad format" },
@@ -15,21 +18,101 @@ const PixelInfo PixelInfo::pixelInfos[] = {
     { FormatType::PVRTC1_R4G4B4,   0, 0, 0, 3, 4, 4, 4, 0,  8, 4, 0, 0, 0, true, "PVR1_R4G4B4" },
     { FormatType::PVRTC1_R2G2B2,   0, 0, 0, 3, 2, 2, 2, 0,  4, 2, 0, 0, 0, true, "PVR1_R2G2B2" },
     { FormatType::PVRTC1_R4G4B4A4, 0, 0, 0, 4, 4, 4, 4, 4, 12, 8, 4, 0, 0, true, "PVR1_R4G4B4A4" },
-    { FormatType::PVRTC1_R2G2B2A2, 0, 0, 0, 4, 2, 2, 2, 2,  6, 4, 2, 0, 0, true, "PVR1_R2G2B2A2" }
+    { FormatType::PVRTC1_R2G2B2A2, 0, 0, 0, 4, 2, 2, 2, 2,  6, 4, 2, 0, 0, true, "PVR1_R2G2B2A2" },
+    { FormatType::ETC1_R8G8B8,     0, 0, 0, 3, 8, 8, 8, 0, 16, 8, 0, 0, 0, true, "ETC1_R8G8B8" },
+    { FormatType::BC1_R5G6B5,      0, 0, 0, 3, 5, 6, 5, 0, 11, 5, 0, 0, 0, true, "BC1_R5G6B5" },
+    { FormatType::BC3_R5G6B5A8,    0, 0, 0, 4, 5, 6, 5, 8, 19, 13, 8, 0, 0, true, "BC3_R5G6B5A8" },
+    { FormatType::R5G5B5A1, 16, 2, 1, 4, 5, 5, 5, 1, 11,  6,  1,  0,     0, false, "R5G5B5A1" },
+    { FormatType::L8,        8, 1, 1, 1, 8, 0, 0, 0,  0,  0,  0,  0,     0, false, "L8" },
+    { FormatType::L8A8,     16, 2, 1, 2, 8, 0, 0, 8,  0,  0,  0,  8,     0, false, "L8A8" }
 };
 
+size_t PixelInfo::dataSize(const FormatType & type, size_t width, size_t height)
+{
+    switch (type) {
+        //PVRTC1 needs at least 2x2 blocks of 4x4 (4bpp) or 8x4 (2bpp) pixels
+        case PVRTC1_R4G4B4:
+        case PVRTC1_R4G4B4A4:
+            return ((width > 8 ? width : 8) * (height > 8 ? height : 8) * 4 + 7) / 8;
+        case PVRTC1_R2G2B2:
+        case PVRTC1_R2G2B2A2:
+            return ((width > 16 ? width : 16) * (height > 8 ? height : 8) * 2 + 7) / 8;
+        //8 or 16 bytes per 4x4 block. partial blocks at the edges are stored completely
+        case ETC1_R8G8B8:
+        case BC1_R5G6B5:
+            return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+        case BC3_R5G6B5A8:
+            return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+        default:
+            return width * height * pixelInfo(type).bytesPerPixel;
+    }
+}
+
+//Look up palette colors in chunks, then convert them to the destination format
+static void expandPalette(uint8_t * dest, PixelInfo::FormatType destType, const uint8_t * source, const uint8_t * sourcePalette, PixelInfo::FormatType sourceType, size_t count)
+{
+    const size_t chunkSize = 4096;
+    const size_t destBytesPerPixel = PixelInfo::pixelInfo(destType).bytesPerPixel;
+    const size_t sourceBytesPerPixel = PixelInfo::pixelInfo(sourceType).bytesPerPixel;
+    const int nrOfChunks = (int)((count + chunkSize - 1) / chunkSize);
+#pragma omp parallel for
+    for (int chunk = 0; chunk < nrOfChunks; ++chunk) {
+        const size_t start = chunk * chunkSize;
+        const size_t chunkCount = (count - start) < chunkSize ? (count - start) : chunkSize;
+        const uint8_t * indices = source + start * sourceBytesPerPixel;
+        uint8_t * colors = destType == PixelInfo::R8G8B8A8 ? dest + start * destBytesPerPixel : nullptr;
+        uint32_t buffer[chunkSize];
+        if (colors == nullptr) {
+            colors = (uint8_t *)buffer;
+        }
+        for (size_t i = 0; i < chunkCount; ++i) {
+            size_t index = indices[i * sourceBytesPerPixel];
+            if (sourceBytesPerPixel == 2) {
+                uint16_t index16;
+                memcpy(&index16, indices + i * 2, 2);
+                index = index16;
+            }
+            memcpy(colors + i * 4, sourcePalette + index * 4, 4);
+        }
+        if (destType != PixelInfo::R8G8B8A8) {
+            convertFormat(dest + start * destBytesPerPixel, nullptr, destType, colors, nullptr, PixelInfo::R8G8B8A8, chunkCount);
+        }
+    }
+}
+
 void convertFormat(uint8_t * dest, uint8_t * destPalette, PixelInfo::FormatType destType, const uint8_t * source, const uint8_t * sourcePalette, PixelInfo::FormatType sourceType, size_t count)
 {
     //check if we have data
     if (dest == nullptr || source == nullptr || count == 0 || destType == PixelInfo::BAD_FORMAT || sourceType == PixelInfo::BAD_FORMAT ) {
         return;
     }
+    //palette indices are looked up if we have a palette and the destination has none
+    if (sourcePalette != nullptr && sourceType != destType && PixelInfo::pixelInfo(sourceType).paletteEntries > 0 && PixelInfo::pixelInfo(destType).paletteEntries == 0) {
+        expandPalette(dest, destType, source, sourcePalette, sourceType, count);
+        return;
+    }
     const size_t destSize = count * PixelInfo::pixelInfo(destType).bytesPerPixel;
     //if source is destination format, just copy
     if (sourceType == destType) {
         memcpy(dest, source, destSize);
         return;
     }
+    //check if we have a fast SIMD row conversion for this pair
+    ConvertRowFunction rowFunction = getConvertRowFunction(destType, sourceType);
+    if (rowFunction != nullptr) {
+        //split data into chunks and convert them in parallel
+        const size_t chunkSize = 16384;
+        const size_t destBytesPerPixel = PixelInfo::pixelInfo(destType).bytesPerPixel;
+        const size_t sourceBytesPerPixel = PixelInfo::pixelInfo(sourceType).bytesPerPixel;
+        const int nrOfChunks = (int)((count + chunkSize - 1) / chunkSize);
+#pragma omp parallel for
+        for (int chunk = 0; chunk < nrOfChunks; ++chunk) {
+            const size_t start = chunk * chunkSize;
+            const size_t chunkCount = (count - start) < chunkSize ? (count - start) : chunkSize;
+            rowFunction(dest + start * destBytesPerPixel, source + start * sourceBytesPerPixel, chunkCount);
+        }
+        return;
+    }
     //else check what the destination format is
     switch (destType) {
         case PixelInfo::R8G8B8A8:
@@ -52,6 +135,12 @@ void convertFormat(uint8_t * dest, uint8_t * destPalette, PixelInfo::FormatType
             convertToFormat_I8(dest, source, sourceType, count); break;
         case PixelInfo::I16:
             convertToFormat_I16(dest, source, sourceType, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertToFormat_R5G5B5A1(dest, source, sourceType, count); break;
+        case PixelInfo::L8:
+            convertToFormat_L8(dest, source, sourceType, count); break;
+        case PixelInfo::L8A8:
+            convertToFormat_L8A8(dest, source, sourceType, count); break;
         default:
             //TODO: Error handling.
             break;
@@ -79,6 +168,12 @@ void convertToFormat_R8G8B8A8(uint8_t * dest, const uint8_t * source, PixelInfo:
             convertPixel<PixelInfo::R8G8B8A8, PixelInfo::I8>(dest, source, count); break;
         case PixelInfo::I16:
             convertPixel<PixelInfo::R8G8B8A8, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::R8G8B8A8, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::R8G8B8A8, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::R8G8B8A8, PixelInfo::L8A8>(dest, source, count); break;
     }
 }
 
@@ -103,6 +198,12 @@ void convertToFormat_A8R8G8B8(uint8_t * dest, const uint8_t * source, PixelInfo:
             convertPixel<PixelInfo::A8R8G8B8, PixelInfo::I8>(dest, source, count); break;
         case PixelInfo::I16:
             convertPixel<PixelInfo::A8R8G8B8, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::A8R8G8B8, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::A8R8G8B8, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::A8R8G8B8, PixelInfo::L8A8>(dest, source, count); break;
     }
 }
 
@@ -127,6 +228,12 @@ void convertToFormat_R8G8B8X8(uint8_t * dest, const uint8_t * source, PixelInfo:
             convertPixel<PixelInfo::R8G8B8X8, PixelInfo::I8>(dest, source, count); break;
         case PixelInfo::I16:
             convertPixel<PixelInfo::R8G8B8X8, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::R8G8B8X8, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::R8G8B8X8, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::R8G8B8X8, PixelInfo::L8A8>(dest, source, count); break;
     }
 }
 
@@ -151,6 +258,12 @@ void convertToFormat_X8R8G8B8(uint8_t * dest, const uint8_t * source, PixelInfo:
             convertPixel<PixelInfo::X8R8G8B8, PixelInfo::I8>(dest, source, count); break;
         case PixelInfo::I16:
             convertPixel<PixelInfo::X8R8G8B8, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::X8R8G8B8, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::X8R8G8B8, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::X8R8G8B8, PixelInfo::L8A8>(dest, source, count); break;
     }
 }
 
@@ -175,6 +288,12 @@ void convertToFormat_R4G4B4A4(uint8_t * dest, const uint8_t * source, PixelInfo:
             convertPixel<PixelInfo::R4G4B4A4, PixelInfo::I8>(dest, source, count); break;
         case PixelInfo::I16:
             convertPixel<PixelInfo::R4G4B4A4, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::R4G4B4A4, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::R4G4B4A4, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::R4G4B4A4, PixelInfo::L8A8>(dest, source, count); break;
     }
 }
 
@@ -199,6 +318,12 @@ void convertToFormat_R8G8B8(uint8_t * dest, const uint8_t * source, PixelInfo::F
             convertPixel<PixelInfo::R8G8B8, PixelInfo::I8>(dest, source, count); break;
         case PixelInfo::I16:
             convertPixel<PixelInfo::R8G8B8, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::R8G8B8, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::R8G8B8, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::R8G8B8, PixelInfo::L8A8>(dest, source, count); break;
     }
 }
 
@@ -223,6 +348,12 @@ void convertToFormat_X1R5G5B5(uint8_t * dest, const uint8_t * source, PixelInfo:
             convertPixel<PixelInfo::X1R5G5B5, PixelInfo::I8>(dest, source, count); break;
         case PixelInfo::I16:
             convertPixel<PixelInfo::X1R5G5B5, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::X1R5G5B5, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::X1R5G5B5, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::X1R5G5B5, PixelInfo::L8A8>(dest, source, count); break;
     }
 }
 
@@ -247,6 +378,12 @@ void convertToFormat_R5G6B5(uint8_t * dest, const uint8_t * source, PixelInfo::F
             convertPixel<PixelInfo::R5G6B5, PixelInfo::I8>(dest, source, count); break;
         case PixelInfo::I16:
             convertPixel<PixelInfo::R5G6B5, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::R5G6B5, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::R5G6B5, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::R5G6B5, PixelInfo::L8A8>(dest, source, count); break;
     }
 }
 
@@ -271,6 +408,12 @@ void convertToFormat_I8(uint8_t * dest, const uint8_t * source, PixelInfo::Forma
             convertPixel<PixelInfo::I8, PixelInfo::R5G6B5>(dest, source, count); break;
         case PixelInfo::I16:
             convertPixel<PixelInfo::I8, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::I8, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::I8, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::I8, PixelInfo::L8A8>(dest, source, count); break;
     }
 }
 
@@ -295,5 +438,224 @@ void convertToFormat_I16(uint8_t * dest, const uint8_t * source, PixelInfo::Form
             convertPixel<PixelInfo::I16, PixelInfo::R5G6B5>(dest, source, count); break;
         case PixelInfo::I8:
             convertPixel<PixelInfo::I16, PixelInfo::I8>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::I16, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::I16, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::I16, PixelInfo::L8A8>(dest, source, count); break;
+    }
+}
+
+void convertToFormat_R5G5B5A1(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType sourceType, size_t count)
+{
+    switch (sourceType) {
+        case PixelInfo::R8G8B8A8:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::R8G8B8A8>(dest, source, count); break;
+        case PixelInfo::A8R8G8B8:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::A8R8G8B8>(dest, source, count); break;
+        case PixelInfo::R8G8B8X8:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::R8G8B8X8>(dest, source, count); break;
+        case PixelInfo::X8R8G8B8:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::X8R8G8B8>(dest, source, count); break;
+        case PixelInfo::R4G4B4A4:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::R4G4B4A4>(dest, source, count); break;
+        case PixelInfo::R8G8B8:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::R8G8B8>(dest, source, count); break;
+        case PixelInfo::X1R5G5B5:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::X1R5G5B5>(dest, source, count); break;
+        case PixelInfo::R5G6B5:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::R5G6B5>(dest, source, count); break;
+        case PixelInfo::I8:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::I8>(dest, source, count); break;
+        case PixelInfo::I16:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::L8>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::R5G5B5A1, PixelInfo::L8A8>(dest, source, count); break;
+    }
+}
+
+void convertToFormat_L8(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType sourceType, size_t count)
+{
+    switch (sourceType) {
+        case PixelInfo::R8G8B8A8:
+            convertPixel<PixelInfo::L8, PixelInfo::R8G8B8A8>(dest, source, count); break;
+        case PixelInfo::A8R8G8B8:
+            convertPixel<PixelInfo::L8, PixelInfo::A8R8G8B8>(dest, source, count); break;
+        case PixelInfo::R8G8B8X8:
+            convertPixel<PixelInfo::L8, PixelInfo::R8G8B8X8>(dest, source, count); break;
+        case PixelInfo::X8R8G8B8:
+            convertPixel<PixelInfo::L8, PixelInfo::X8R8G8B8>(dest, source, count); break;
+        case PixelInfo::R4G4B4A4:
+            convertPixel<PixelInfo::L8, PixelInfo::R4G4B4A4>(dest, source, count); break;
+        case PixelInfo::R8G8B8:
+            convertPixel<PixelInfo::L8, PixelInfo::R8G8B8>(dest, source, count); break;
+        case PixelInfo::X1R5G5B5:
+            convertPixel<PixelInfo::L8, PixelInfo::X1R5G5B5>(dest, source, count); break;
+        case PixelInfo::R5G6B5:
+            convertPixel<PixelInfo::L8, PixelInfo::R5G6B5>(dest, source, count); break;
+        case PixelInfo::I8:
+            convertPixel<PixelInfo::L8, PixelInfo::I8>(dest, source, count); break;
+        case PixelInfo::I16:
+            convertPixel<PixelInfo::L8, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::L8, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            convertPixel<PixelInfo::L8, PixelInfo::L8A8>(dest, source, count); break;
+    }
+}
+
+void convertToFormat_L8A8(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType sourceType, size_t count)
+{
+    switch (sourceType) {
+        case PixelInfo::R8G8B8A8:
+            convertPixel<PixelInfo::L8A8, PixelInfo::R8G8B8A8>(dest, source, count); break;
+        case PixelInfo::A8R8G8B8:
+            convertPixel<PixelInfo::L8A8, PixelInfo::A8R8G8B8>(dest, source, count); break;
+        case PixelInfo::R8G8B8X8:
+            convertPixel<PixelInfo::L8A8, PixelInfo::R8G8B8X8>(dest, source, count); break;
+        case PixelInfo::X8R8G8B8:
+            convertPixel<PixelInfo::L8A8, PixelInfo::X8R8G8B8>(dest, source, count); break;
+        case PixelInfo::R4G4B4A4:
+            convertPixel<PixelInfo::L8A8, PixelInfo::R4G4B4A4>(dest, source, count); break;
+        case PixelInfo::R8G8B8:
+            convertPixel<PixelInfo::L8A8, PixelInfo::R8G8B8>(dest, source, count); break;
+        case PixelInfo::X1R5G5B5:
+            convertPixel<PixelInfo::L8A8, PixelInfo::X1R5G5B5>(dest, source, count); break;
+        case PixelInfo::R5G6B5:
+            convertPixel<PixelInfo::L8A8, PixelInfo::R5G6B5>(dest, source, count); break;
+        case PixelInfo::I8:
+            convertPixel<PixelInfo::L8A8, PixelInfo::I8>(dest, source, count); break;
+        case PixelInfo::I16:
+            convertPixel<PixelInfo::L8A8, PixelInfo::I16>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            convertPixel<PixelInfo::L8A8, PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8:
+            convertPixel<PixelInfo::L8A8, PixelInfo::L8>(dest, source, count); break;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+template <int FORMATTYPE>
+static void premultiplyPixels(uint8_t * dest, const uint8_t * source, size_t count)
+{
+    //only split big runs between threads, like convertPixel<> does
+    if (count > 16384) {
+#pragma omp parallel for
+        for (int i = 0; i < (int)count; ++i) {
+            premultiplyPixel<FORMATTYPE>(dest + i * PixelFormat<FORMATTYPE>::bytesPerPixel, source + i * PixelFormat<FORMATTYPE>::bytesPerPixel);
+        }
+    }
+    else {
+        for (size_t i = 0; i < count; ++i) {
+            premultiplyPixel<FORMATTYPE>(dest + i * PixelFormat<FORMATTYPE>::bytesPerPixel, source + i * PixelFormat<FORMATTYPE>::bytesPerPixel);
+        }
+    }
+}
+
+template <int FORMATTYPE>
+static void unpremultiplyPixels(uint8_t * dest, const uint8_t * source, size_t count)
+{
+    if (count > 16384) {
+#pragma omp parallel for
+        for (int i = 0; i < (int)count; ++i) {
+            unpremultiplyPixel<FORMATTYPE>(dest + i * PixelFormat<FORMATTYPE>::bytesPerPixel, source + i * PixelFormat<FORMATTYPE>::bytesPerPixel);
+        }
+    }
+    else {
+        for (size_t i = 0; i < count; ++i) {
+            unpremultiplyPixel<FORMATTYPE>(dest + i * PixelFormat<FORMATTYPE>::bytesPerPixel, source + i * PixelFormat<FORMATTYPE>::bytesPerPixel);
+        }
+    }
+}
+
+/*!
+Run a SIMD row function on chunks of pixels in parallel.
+*/
+static void runRowFunction(ConvertRowFunction rowFunction, uint8_t * dest, const uint8_t * source, size_t bytesPerPixel, size_t count)
+{
+    const size_t chunkSize = 16384;
+    const int nrOfChunks = (int)((count + chunkSize - 1) / chunkSize);
+#pragma omp parallel for
+    for (int chunk = 0; chunk < nrOfChunks; ++chunk) {
+        const size_t start = chunk * chunkSize;
+        const size_t chunkCount = (count - start) < chunkSize ? (count - start) : chunkSize;
+        rowFunction(dest + start * bytesPerPixel, source + start * bytesPerPixel, chunkCount);
+    }
+}
+
+void premultiplyPixels(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType formatType, size_t count)
+{
+    //check if we have data
+    if (dest == nullptr || source == nullptr || count == 0) {
+        return;
+    }
+    const PixelInfo & info = PixelInfo::pixelInfo(formatType);
+    if (info.compressed || info.paletteEntries > 0 || info.bytesPerPixel == 0) {
+        return;
+    }
+    ConvertRowFunction rowFunction = getPremultiplyRowFunction(formatType);
+    if (rowFunction != nullptr) {
+        runRowFunction(rowFunction, dest, source, info.bytesPerPixel, count);
+        return;
+    }
+    switch (formatType) {
+        case PixelInfo::R8G8B8A8:
+            premultiplyPixels<PixelInfo::R8G8B8A8>(dest, source, count); break;
+        case PixelInfo::A8R8G8B8:
+            premultiplyPixels<PixelInfo::A8R8G8B8>(dest, source, count); break;
+        case PixelInfo::R4G4B4A4:
+            premultiplyPixels<PixelInfo::R4G4B4A4>(dest, source, count); break;
+        case PixelInfo::X1R5G5B5:
+            premultiplyPixels<PixelInfo::X1R5G5B5>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            premultiplyPixels<PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            premultiplyPixels<PixelInfo::L8A8>(dest, source, count); break;
+        default:
+            //no alpha, nothing to multiply
+            if (dest != source) {
+                memcpy(dest, source, count * info.bytesPerPixel);
+            }
+            break;
+    }
+}
+
+void unpremultiplyPixels(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType formatType, size_t count)
+{
+    //check if we have data
+    if (dest == nullptr || source == nullptr || count == 0) {
+        return;
+    }
+    const PixelInfo & info = PixelInfo::pixelInfo(formatType);
+    if (info.compressed || info.paletteEntries > 0 || info.bytesPerPixel == 0) {
+        return;
+    }
+    ConvertRowFunction rowFunction = getUnpremultiplyRowFunction(formatType);
+    if (rowFunction != nullptr) {
+        runRowFunction(rowFunction, dest, source, info.bytesPerPixel, count);
+        return;
+    }
+    switch (formatType) {
+        case PixelInfo::R8G8B8A8:
+            unpremultiplyPixels<PixelInfo::R8G8B8A8>(dest, source, count); break;
+        case PixelInfo::A8R8G8B8:
+            unpremultiplyPixels<PixelInfo::A8R8G8B8>(dest, source, count); break;
+        case PixelInfo::R4G4B4A4:
+            unpremultiplyPixels<PixelInfo::R4G4B4A4>(dest, source, count); break;
+        case PixelInfo::X1R5G5B5:
+            unpremultiplyPixels<PixelInfo::X1R5G5B5>(dest, source, count); break;
+        case PixelInfo::R5G5B5A1:
+            unpremultiplyPixels<PixelInfo::R5G5B5A1>(dest, source, count); break;
+        case PixelInfo::L8A8:
+            unpremultiplyPixels<PixelInfo::L8A8>(dest, source, count); break;
+        default:
+            if (dest != source) {
+                memcpy(dest, source, count * info.bytesPerPixel);
+            }
+            break;
     }
 }
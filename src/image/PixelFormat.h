@@ -65,13 +65,19 @@ struct PixelFormat
 
 //-------------------------------------------------------------------------------------------------
 
-//We need to specialize here for R8G8B8, because it's a 3-byte format
+//We need to specialize here for R8G8B8, because it's a 3-byte format. Byte order matches the little-endian 32bit formats
 template <>
-static inline void PixelFormat<PixelInfo::FormatType::R8G8B8>::setPixel(uint8_t * dest, const PixelFormat<PixelInfo::FormatType::R8G8B8>::Pixel & pixel)
+inline PixelFormat<PixelInfo::FormatType::R8G8B8>::Pixel PixelFormat<PixelInfo::FormatType::R8G8B8>::getPixel(const uint8_t * src)
 {
-    dest[0] = pixel >> 16;
+    return ((Pixel)src[2] << 16) | ((Pixel)src[1] << 8) | (Pixel)src[0];
+}
+
+template <>
+inline void PixelFormat<PixelInfo::FormatType::R8G8B8>::setPixel(uint8_t * dest, const PixelFormat<PixelInfo::FormatType::R8G8B8>::Pixel & pixel)
+{
+    dest[0] = pixel;
     dest[1] = pixel >> 8;
-    dest[2] = pixel;
+    dest[2] = pixel >> 16;
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -88,7 +94,7 @@ Scale a color value from the value read from the pixel up to the full range of t
 template <class TYPE, int BITS>
 static inline TYPE scaleUp(const TYPE & value)
 {
-    return (std::numeric_limits<typename TYPE>::max() * (uint32_t)value) / BIT_MASK(BITS);
+    return (std::numeric_limits<TYPE>::max() * (uint32_t)value) / BIT_MASK(BITS);
 }
 
 /*!
@@ -123,62 +129,56 @@ Convert between two pixel formats with proper scaling of colors.
 template <int OUTTYPE, int INTYPE>
 static inline void convertPixel(uint8_t * dest, const uint8_t * src)
 {
-    PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src);
-    PixelFormat<OUTTYPE>::Pixel outPixel;
-    if (PixelFormat<INTYPE>::nrOfComponents == 1) {
-        PixelFormat<OUTTYPE>::Color r = scaleInOut<PixelFormat<OUTTYPE>::Color, PixelFormat<OUTTYPE>::bitsRed, PixelFormat<INTYPE>::Color, PixelFormat<INTYPE>::bitsRed>(PixelFormat<INTYPE>::getR(inPixel));
+    typedef typename PixelFormat<OUTTYPE>::Color OutColor;
+    typedef typename PixelFormat<INTYPE>::Color InColor;
+    //alpha is only read from formats that have it, but must not divide by 0 in the branches that are not taken
+    enum { inBitsAlpha = PixelFormat<INTYPE>::bitsAlpha > 0 ? (int)PixelFormat<INTYPE>::bitsAlpha : 1 };
+    typename PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src);
+    typename PixelFormat<OUTTYPE>::Pixel outPixel = 0;
+    if (PixelFormat<INTYPE>::nrOfComponents <= 2) {
+        //gray value with optional alpha
+        OutColor r = scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsRed, InColor, PixelFormat<INTYPE>::bitsRed>(PixelFormat<INTYPE>::getR(inPixel));
+        OutColor a = PixelFormat<INTYPE>::nrOfComponents == 2 ? scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsAlpha, InColor, inBitsAlpha>(PixelFormat<INTYPE>::getA(inPixel)) : (OutColor)BIT_MASK(PixelFormat<OUTTYPE>::bitsAlpha);
         if (PixelFormat<OUTTYPE>::nrOfComponents == 1) {
             PixelFormat<OUTTYPE>::setR(outPixel, r);
         }
-        else if (PixelFormat<OUTTYPE>::nrOfComponents == 3) {
-            PixelFormat<OUTTYPE>::setR(outPixel, r);
-            PixelFormat<OUTTYPE>::setG(outPixel, r);
-            PixelFormat<OUTTYPE>::setB(outPixel, r);
-        }
-        else if (PixelFormat<OUTTYPE>::nrOfComponents == 4) {
+        else if (PixelFormat<OUTTYPE>::nrOfComponents == 2) {
             PixelFormat<OUTTYPE>::setR(outPixel, r);
-            PixelFormat<OUTTYPE>::setG(outPixel, r);
-            PixelFormat<OUTTYPE>::setB(outPixel, r);
-            PixelFormat<OUTTYPE>::setA(outPixel, std::numeric_limits<PixelFormat<OUTTYPE>::Color>::max());
-        }
-    }
-    else if (PixelFormat<INTYPE>::nrOfComponents == 3) {
-        PixelFormat<OUTTYPE>::Color r = scaleInOut<PixelFormat<OUTTYPE>::Color, PixelFormat<OUTTYPE>::bitsRed, PixelFormat<INTYPE>::Color, PixelFormat<INTYPE>::bitsRed>(PixelFormat<INTYPE>::getR(inPixel));
-        PixelFormat<OUTTYPE>::Color g = scaleInOut<PixelFormat<OUTTYPE>::Color, PixelFormat<OUTTYPE>::bitsGreen, PixelFormat<INTYPE>::Color, PixelFormat<INTYPE>::bitsGreen>(PixelFormat<INTYPE>::getG(inPixel));
-        PixelFormat<OUTTYPE>::Color b = scaleInOut<PixelFormat<OUTTYPE>::Color, PixelFormat<OUTTYPE>::bitsBlue, PixelFormat<INTYPE>::Color, PixelFormat<INTYPE>::bitsBlue>(PixelFormat<INTYPE>::getB(inPixel));
-        if (PixelFormat<OUTTYPE>::nrOfComponents == 1) {
-            PixelFormat<OUTTYPE>::setR(outPixel, (PixelFormat<OUTTYPE>::Color)(0.2126f * r + 0.7152f * g + 0.0722f * b));
+            PixelFormat<OUTTYPE>::setA(outPixel, a);
         }
         else if (PixelFormat<OUTTYPE>::nrOfComponents == 3) {
             PixelFormat<OUTTYPE>::setR(outPixel, r);
-            PixelFormat<OUTTYPE>::setG(outPixel, g);
-            PixelFormat<OUTTYPE>::setB(outPixel, b);
+            PixelFormat<OUTTYPE>::setG(outPixel, scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsGreen, InColor, PixelFormat<INTYPE>::bitsRed>(PixelFormat<INTYPE>::getR(inPixel)));
+            PixelFormat<OUTTYPE>::setB(outPixel, scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsBlue, InColor, PixelFormat<INTYPE>::bitsRed>(PixelFormat<INTYPE>::getR(inPixel)));
         }
         else if (PixelFormat<OUTTYPE>::nrOfComponents == 4) {
             PixelFormat<OUTTYPE>::setR(outPixel, r);
-            PixelFormat<OUTTYPE>::setG(outPixel, g);
-            PixelFormat<OUTTYPE>::setB(outPixel, b);
-            PixelFormat<OUTTYPE>::setA(outPixel, std::numeric_limits<PixelFormat<OUTTYPE>::Color>::max());
+            PixelFormat<OUTTYPE>::setG(outPixel, scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsGreen, InColor, PixelFormat<INTYPE>::bitsRed>(PixelFormat<INTYPE>::getR(inPixel)));
+            PixelFormat<OUTTYPE>::setB(outPixel, scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsBlue, InColor, PixelFormat<INTYPE>::bitsRed>(PixelFormat<INTYPE>::getR(inPixel)));
+            PixelFormat<OUTTYPE>::setA(outPixel, a);
         }
     }
-    else if (PixelFormat<INTYPE>::nrOfComponents == 4) {
-        PixelFormat<OUTTYPE>::Color r = scaleInOut<PixelFormat<OUTTYPE>::Color, PixelFormat<OUTTYPE>::bitsRed, PixelFormat<INTYPE>::Color, PixelFormat<INTYPE>::bitsRed>(PixelFormat<INTYPE>::getR(inPixel));
-        PixelFormat<OUTTYPE>::Color g = scaleInOut<PixelFormat<OUTTYPE>::Color, PixelFormat<OUTTYPE>::bitsGreen, PixelFormat<INTYPE>::Color, PixelFormat<INTYPE>::bitsGreen>(PixelFormat<INTYPE>::getG(inPixel));
-        PixelFormat<OUTTYPE>::Color b = scaleInOut<PixelFormat<OUTTYPE>::Color, PixelFormat<OUTTYPE>::bitsBlue, PixelFormat<INTYPE>::Color, PixelFormat<INTYPE>::bitsBlue>(PixelFormat<INTYPE>::getB(inPixel));
-        if (PixelFormat<OUTTYPE>::nrOfComponents == 1) {
-            PixelFormat<OUTTYPE>::setR(outPixel, (PixelFormat<OUTTYPE>::Color)(0.2126f * r + 0.7152f * g + 0.0722f * b));
-        }
-        else if (PixelFormat<OUTTYPE>::nrOfComponents == 3) {
-            PixelFormat<OUTTYPE>::setR(outPixel, r);
-            PixelFormat<OUTTYPE>::setG(outPixel, g);
-            PixelFormat<OUTTYPE>::setB(outPixel, b);
+    else {
+        if (PixelFormat<OUTTYPE>::nrOfComponents <= 2) {
+            //gray formats only have a red component. scale all colors to its range and round, so gray input stays exact
+            const float r = scaleInOut<uint32_t, PixelFormat<OUTTYPE>::bitsRed, InColor, PixelFormat<INTYPE>::bitsRed>(PixelFormat<INTYPE>::getR(inPixel));
+            const float g = scaleInOut<uint32_t, PixelFormat<OUTTYPE>::bitsRed, InColor, PixelFormat<INTYPE>::bitsGreen>(PixelFormat<INTYPE>::getG(inPixel));
+            const float b = scaleInOut<uint32_t, PixelFormat<OUTTYPE>::bitsRed, InColor, PixelFormat<INTYPE>::bitsBlue>(PixelFormat<INTYPE>::getB(inPixel));
+            PixelFormat<OUTTYPE>::setR(outPixel, (OutColor)(0.2126f * r + 0.7152f * g + 0.0722f * b + 0.5f));
+            if (PixelFormat<OUTTYPE>::nrOfComponents == 2) {
+                PixelFormat<OUTTYPE>::setA(outPixel, PixelFormat<INTYPE>::nrOfComponents == 4 ? scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsAlpha, InColor, inBitsAlpha>(PixelFormat<INTYPE>::getA(inPixel)) : (OutColor)BIT_MASK(PixelFormat<OUTTYPE>::bitsAlpha));
+            }
         }
-        else if (PixelFormat<OUTTYPE>::nrOfComponents == 4) {
-            PixelFormat<OUTTYPE>::Color a = scaleInOut<PixelFormat<OUTTYPE>::Color, PixelFormat<OUTTYPE>::bitsAlpha, PixelFormat<INTYPE>::Color, PixelFormat<INTYPE>::bitsAlpha>(PixelFormat<INTYPE>::getA(inPixel));
+        else {
+            OutColor r = scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsRed, InColor, PixelFormat<INTYPE>::bitsRed>(PixelFormat<INTYPE>::getR(inPixel));
+            OutColor g = scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsGreen, InColor, PixelFormat<INTYPE>::bitsGreen>(PixelFormat<INTYPE>::getG(inPixel));
+            OutColor b = scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsBlue, InColor, PixelFormat<INTYPE>::bitsBlue>(PixelFormat<INTYPE>::getB(inPixel));
             PixelFormat<OUTTYPE>::setR(outPixel, r);
             PixelFormat<OUTTYPE>::setG(outPixel, g);
             PixelFormat<OUTTYPE>::setB(outPixel, b);
-            PixelFormat<OUTTYPE>::setA(outPixel, a);
+            if (PixelFormat<OUTTYPE>::nrOfComponents == 4) {
+                PixelFormat<OUTTYPE>::setA(outPixel, PixelFormat<INTYPE>::nrOfComponents == 4 ? scaleInOut<OutColor, PixelFormat<OUTTYPE>::bitsAlpha, InColor, inBitsAlpha>(PixelFormat<INTYPE>::getA(inPixel)) : std::numeric_limits<OutColor>::max());
+            }
         }
     }
     PixelFormat<OUTTYPE>::setPixel(dest, outPixel);
@@ -197,9 +197,17 @@ static inline void convertPixel(uint8_t * dest, const uint8_t * src, size_t coun
     if (dest == nullptr || src == nullptr || count == 0) {
         return;
     }
+    //only split big runs between threads. single rows, e.g. while loading, are not worth starting a parallel region for
+    if (count > 16384) {
 #pragma omp parallel for
-    for (int i = 0; i < count; ++i) {
-        convertPixel<OUTTYPE, INTYPE>(dest + i * PixelFormat<OUTTYPE>::bytesPerPixel, src + i * PixelFormat<INTYPE>::bytesPerPixel);
+        for (int i = 0; i < count; ++i) {
+            convertPixel<OUTTYPE, INTYPE>(dest + i * PixelFormat<OUTTYPE>::bytesPerPixel, src + i * PixelFormat<INTYPE>::bytesPerPixel);
+        }
+    }
+    else {
+        for (size_t i = 0; i < count; ++i) {
+            convertPixel<OUTTYPE, INTYPE>(dest + i * PixelFormat<OUTTYPE>::bytesPerPixel, src + i * PixelFormat<INTYPE>::bytesPerPixel);
+        }
     }
 }
 
@@ -212,6 +220,7 @@ Convert colors from one pixel format to another.
 \param[in] sourcePalette Input color palette pointer or nullptr.
 \param[in] sourceFormat Input color pixel format.
 \param[in] count Number of consecutive pixels to convert.
+\note If the source has a palette in R8G8B8A8 format and the destination has none, the colors are looked up in the palette. Without a palette indices are converted like gray values.
 */
 void convertFormat(uint8_t * dest, uint8_t * destPalette, PixelInfo::FormatType destType, const uint8_t * source, const uint8_t * sourcePalette, PixelInfo::FormatType sourceType, size_t count);
 void convertToFormat_R8G8B8A8(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType sourceType, size_t count);
@@ -224,6 +233,100 @@ void convertToFormat_X1R5G5B5(uint8_t * dest, const uint8_t * source, PixelInfo:
 void convertToFormat_R5G6B5(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType sourceType, size_t count);
 void convertToFormat_I8(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType sourceType, size_t count);
 void convertToFormat_I16(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType sourceType, size_t count);
+void convertToFormat_R5G5B5A1(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType sourceType, size_t count);
+void convertToFormat_L8(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType sourceType, size_t count);
+void convertToFormat_L8A8(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType sourceType, size_t count);
+
+//-------------------------------------------------------------------------------------------------
+
+/*!
+Get the 16.16 fixed-point factor unpremultiplyPixel uses to undo a premultiplication with alpha, e.g. 255 * 65536 / a for 8bit alpha.
+\param[in] alpha Alpha value of the pixel.
+\return Returns the rounded factor or 0 if alpha is 0.
+*/
+template <int ALPHABITS>
+static inline uint32_t unpremultiplyScale(const uint32_t alpha)
+{
+    return alpha > 0 ? ((uint32_t)BIT_MASK(ALPHABITS) * 65536 + alpha / 2) / alpha : 0;
+}
+
+/*!
+Multiply the color components of a pixel with its alpha value, rounding to the nearest value.
+\param[in] dest Destination data pointer. May be the same as src.
+\param[in] src Source data pointer.
+*/
+template <int FORMATTYPE>
+static inline void premultiplyPixel(uint8_t * dest, const uint8_t * src)
+{
+    typedef PixelFormat<FORMATTYPE> Format;
+    typedef typename Format::Color Color;
+    enum { alphaMax = BIT_MASK(Format::bitsAlpha > 0 ? (int)Format::bitsAlpha : 1) };
+    const typename Format::Pixel inPixel = Format::getPixel(src);
+    const uint32_t a = Format::getA(inPixel);
+    typename Format::Pixel outPixel = 0;
+    Format::setR(outPixel, (Color)(((uint32_t)Format::getR(inPixel) * a + alphaMax / 2) / alphaMax));
+    Format::setG(outPixel, (Color)(((uint32_t)Format::getG(inPixel) * a + alphaMax / 2) / alphaMax));
+    Format::setB(outPixel, (Color)(((uint32_t)Format::getB(inPixel) * a + alphaMax / 2) / alphaMax));
+    Format::setA(outPixel, (Color)a);
+    Format::setPixel(dest, outPixel);
+}
+
+/*!
+Divide the color components of a premultiplied pixel by its alpha value. Pixels with an alpha of 0 become transparent black.
+Uses the rounded 16.16 reciprocal from unpremultiplyScale(), so the SIMD versions can use a table and stay bit-exact.
+\param[in] dest Destination data pointer. May be the same as src.
+\param[in] src Source data pointer.
+*/
+template <int FORMATTYPE>
+static inline void unpremultiplyPixel(uint8_t * dest, const uint8_t * src)
+{
+    typedef PixelFormat<FORMATTYPE> Format;
+    typedef typename Format::Color Color;
+    enum { alphaBits = Format::bitsAlpha > 0 ? (int)Format::bitsAlpha : 1 };
+    const typename Format::Pixel inPixel = Format::getPixel(src);
+    const uint32_t a = Format::getA(inPixel);
+    const uint32_t scale = unpremultiplyScale<alphaBits>(a);
+    const uint32_t r = ((uint32_t)Format::getR(inPixel) * scale + 32768) >> 16;
+    const uint32_t g = ((uint32_t)Format::getG(inPixel) * scale + 32768) >> 16;
+    const uint32_t b = ((uint32_t)Format::getB(inPixel) * scale + 32768) >> 16;
+    typename Format::Pixel outPixel = 0;
+    Format::setR(outPixel, (Color)(r < BIT_MASK(Format::bitsRed) ? r : BIT_MASK(Format::bitsRed)));
+    Format::setG(outPixel, (Color)(g < BIT_MASK(Format::bitsGreen) ? g : BIT_MASK(Format::bitsGreen)));
+    Format::setB(outPixel, (Color)(b < BIT_MASK(Format::bitsBlue) ? b : BIT_MASK(Format::bitsBlue)));
+    Format::setA(outPixel, (Color)a);
+    Format::setPixel(dest, outPixel);
+}
+
+/*!
+Check if premultiplyPixels() and unpremultiplyPixels() change the pixels of a format. This is true for uncompressed formats with alpha that do not use a palette.
+*/
+static inline bool supportsPremultipliedAlpha(PixelInfo::FormatType formatType)
+{
+    const PixelInfo & info = PixelInfo::pixelInfo(formatType);
+    return info.bitsAlpha > 0 && (info.nrOfComponents == 2 || info.nrOfComponents == 4) && info.paletteEntries == 0 && !info.compressed;
+}
+
+/*!
+Multiply the color components of pixels with their alpha value, e.g. to filter or blend them with GL_ONE, GL_ONE_MINUS_SRC_ALPHA.
+Splits big runs between threads and uses SSE2, AVX2 or NEON for R8G8B8A8 if available.
+\param[in] dest Destination data pointer. May be the same as source to convert in place.
+\param[in] source Source data pointer.
+\param[in] formatType Pixel format of source and destination.
+\param[in] count Number of consecutive pixels to convert.
+\note Formats without alpha are copied unchanged. Palette and compressed formats are not supported and dest is not touched.
+*/
+void premultiplyPixels(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType formatType, size_t count);
+
+/*!
+Divide the color components of premultiplied pixels by their alpha value. Reverses premultiplyPixels() up to rounding, which is exact for opaque pixels.
+Colors of pixels with an alpha of 0 are lost and become black.
+\param[in] dest Destination data pointer. May be the same as source to convert in place.
+\param[in] source Source data pointer.
+\param[in] formatType Pixel format of source and destination.
+\param[in] count Number of consecutive pixels to convert.
+\note Formats without alpha are copied unchanged. Palette and compressed formats are not supported and dest is not touched.
+*/
+void unpremultiplyPixels(uint8_t * dest, const uint8_t * source, PixelInfo::FormatType formatType, size_t count);
 
 //-------------------------------------------------------------------------------------------------
 
@@ -233,7 +336,7 @@ Calculate range of colors in data. Returns the min/max value of all color compon
 \param[in] count Number of pixels to check.
 */
 template <int INTYPE>
-static inline typename ColorRange<INTYPE> calculateColorRange(const uint8_t * src, size_t count)
+static inline ColorRange<INTYPE> calculateColorRange(const uint8_t * src, size_t count)
 {
     ColorRange<INTYPE> range;
     range.min = 0;
@@ -245,21 +348,21 @@ static inline typename ColorRange<INTYPE> calculateColorRange(const uint8_t * sr
     //check hoiw many color components we have
     if (PixelFormat<INTYPE>::nrOfComponents == 1) {
         //set up overall min/max
-        PixelFormat<INTYPE>::Color rmin; PixelFormat<INTYPE>::Color rmax;
-        rmin = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
+        typename PixelFormat<INTYPE>::Color rmin; typename PixelFormat<INTYPE>::Color rmax;
+        rmin = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
         rmax = 0;
         //and min/max per thread
-        PixelFormat<INTYPE>::Color rtmin; PixelFormat<INTYPE>::Color rtmax;
+        typename PixelFormat<INTYPE>::Color rtmin; typename PixelFormat<INTYPE>::Color rtmax;
 #pragma omp parallel private (rtmin, rtmax)
         {
             //set up per-thread values for min/max
-            rtmin = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
+            rtmin = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
             rtmax = 0;
 #pragma omp for
             for (int i = 0; i < count; ++i) {
                 //get pixel and color from pixel
-                PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src + i * PixelFormat<INTYPE>::bytesPerPixel);
-                PixelFormat<INTYPE>::Color r = PixelFormat<INTYPE>::getR(inPixel);
+                typename PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src + i * PixelFormat<INTYPE>::bytesPerPixel);
+                typename PixelFormat<INTYPE>::Color r = PixelFormat<INTYPE>::getR(inPixel);
                 //check if smaller/larger than current min/max
                 rtmin = r < rtmin ? r : rtmin; rtmax = r > rtmax ? r : rtmax;
             }
@@ -271,29 +374,29 @@ static inline typename ColorRange<INTYPE> calculateColorRange(const uint8_t * sr
     }
     else if (PixelFormat<INTYPE>::nrOfComponents == 3) {
         //set up overall min/max
-        PixelFormat<INTYPE>::Color min[3]; PixelFormat<INTYPE>::Color max[3];
-        min[0] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
-        min[1] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
-        min[2] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
+        typename PixelFormat<INTYPE>::Color min[3]; typename PixelFormat<INTYPE>::Color max[3];
+        min[0] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
+        min[1] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
+        min[2] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
         max[0] = 0;
         max[1] = 0;
         max[2] = 0;
         //and min/max per thread
-        PixelFormat<INTYPE>::Color tmin[3]; PixelFormat<INTYPE>::Color tmax[3];
+        typename PixelFormat<INTYPE>::Color tmin[3]; typename PixelFormat<INTYPE>::Color tmax[3];
 #pragma omp parallel private (tmin, tmax)
         {
             //set up per-thread values for min/max
-            tmin[0] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
-            tmin[1] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
-            tmin[2] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
+            tmin[0] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
+            tmin[1] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
+            tmin[2] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
             tmax[0] = 0;
             tmax[1] = 0;
             tmax[2] = 0;
 #pragma omp for
             for (int i = 0; i < count; ++i) {
                 //get pixel and color from pixel
-                PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src + i * PixelFormat<INTYPE>::bytesPerPixel);
-                PixelFormat<INTYPE>::Color color[3];
+                typename PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src + i * PixelFormat<INTYPE>::bytesPerPixel);
+                typename PixelFormat<INTYPE>::Color color[3];
                 color[0] = PixelFormat<INTYPE>::getR(inPixel);
                 color[1] = PixelFormat<INTYPE>::getG(inPixel);
                 color[2] = PixelFormat<INTYPE>::getB(inPixel);
@@ -314,24 +417,24 @@ static inline typename ColorRange<INTYPE> calculateColorRange(const uint8_t * sr
     }
     else if (PixelFormat<INTYPE>::nrOfComponents == 4) {
         //set up overall min/max
-        PixelFormat<INTYPE>::Color min[4]; PixelFormat<INTYPE>::Color max[4];
-        min[0] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
-        min[1] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
-        min[2] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
-        min[3] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
+        typename PixelFormat<INTYPE>::Color min[4]; typename PixelFormat<INTYPE>::Color max[4];
+        min[0] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
+        min[1] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
+        min[2] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
+        min[3] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
         max[0] = 0;
         max[1] = 0;
         max[2] = 0;
         max[3] = 0;
         //and min/max per thread
-        PixelFormat<INTYPE>::Color tmin[4]; PixelFormat<INTYPE>::Color tmax[4];
+        typename PixelFormat<INTYPE>::Color tmin[4]; typename PixelFormat<INTYPE>::Color tmax[4];
 #pragma omp parallel private (tmin, tmax)
         {
             //set up per-thread values for min/max
-            tmin[0] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
-            tmin[1] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
-            tmin[2] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
-            tmin[3] = std::numeric_limits<PixelFormat<INTYPE>::Color>::max();
+            tmin[0] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
+            tmin[1] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
+            tmin[2] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
+            tmin[3] = std::numeric_limits<typename PixelFormat<INTYPE>::Color>::max();
             tmax[0] = 0;
             tmax[1] = 0;
             tmax[2] = 0;
@@ -339,8 +442,8 @@ static inline typename ColorRange<INTYPE> calculateColorRange(const uint8_t * sr
 #pragma omp for
             for (int i = 0; i < count; ++i) {
                 //get pixel and color from pixel
-                PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src + i * PixelFormat<INTYPE>::bytesPerPixel);
-                PixelFormat<INTYPE>::Color color[4];
+                typename PixelFormat<INTYPE>::Pixel inPixel = PixelFormat<INTYPE>::getPixel(src + i * PixelFormat<INTYPE>::bytesPerPixel);
+                typename PixelFormat<INTYPE>::Color color[4];
                 color[0] = PixelFormat<INTYPE>::getR(inPixel);
                 color[1] = PixelFormat<INTYPE>::getG(inPixel);
                 color[2] = PixelFormat<INTYPE>::getB(inPixel);
@@ -0,0 +1,643 @@
+#include "PixelFormatSIMD.h"
+#include "PixelFormat.h"
+
+//All kernels below are bit-exact with the scalar convertPixel<OUTTYPE, INTYPE> template, which also handles the tail pixels.
+//Memory layout of the formats on little-endian machines:
+//R8G8B8A8 = bytes A,B,G,R. A8R8G8B8 = bytes B,G,R,A. R8G8B8 = bytes B,G,R.
+//Color scaling in scaleInOut is (OUTMAX * value) / INMAX with truncation. For INMAX = 255 we use the exact identity
+//floor(x / 255) = (x + 1 + (x >> 8)) >> 8, which holds for all x < 65535.
+
+/*!
+Convert the remaining pixels of a row with the scalar reference template.
+*/
+template <int OUTTYPE, int INTYPE>
+static inline void convertTail(uint8_t * dest, const uint8_t * src, size_t start, size_t count)
+{
+    for (size_t i = start; i < count; ++i) {
+        convertPixel<OUTTYPE, INTYPE>(dest + i * PixelFormat<OUTTYPE>::bytesPerPixel, src + i * PixelFormat<INTYPE>::bytesPerPixel);
+    }
+}
+
+/*!
+Premultiply / unpremultiply the remaining pixels of a row with the scalar reference templates.
+*/
+template <int FORMATTYPE>
+static inline void premultiplyTail(uint8_t * dest, const uint8_t * src, size_t start, size_t count)
+{
+    for (size_t i = start; i < count; ++i) {
+        premultiplyPixel<FORMATTYPE>(dest + i * PixelFormat<FORMATTYPE>::bytesPerPixel, src + i * PixelFormat<FORMATTYPE>::bytesPerPixel);
+    }
+}
+
+template <int FORMATTYPE>
+static inline void unpremultiplyTail(uint8_t * dest, const uint8_t * src, size_t start, size_t count)
+{
+    for (size_t i = start; i < count; ++i) {
+        unpremultiplyPixel<FORMATTYPE>(dest + i * PixelFormat<FORMATTYPE>::bytesPerPixel, src + i * PixelFormat<FORMATTYPE>::bytesPerPixel);
+    }
+}
+
+#if defined(IMAGE_SIMD_X86) || defined(IMAGE_SIMD_NEON)
+
+/*!
+Table of the 16.16 reciprocals unpremultiplyPixel<> uses for 8bit alpha. There is no SIMD integer division, so we look them up.
+*/
+static const uint32_t * unpremultiplyScales()
+{
+    struct ScaleTable
+    {
+        uint32_t scale[256];
+        ScaleTable() { for (uint32_t a = 0; a < 256; ++a) { scale[a] = unpremultiplyScale<8>(a); } }
+    };
+    static const ScaleTable table;
+    return table.scale;
+}
+
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+#if defined(IMAGE_SIMD_X86)
+
+SIMD_TARGET("sse2") static inline __m128i div255_SSE2(__m128i x)
+{
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+/*!
+Split 8 R8G8B8A8 pixels into 16bit R, G, B, A component vectors.
+*/
+SIMD_TARGET("sse2") static inline void unpackR8G8B8A8_SSE2(const uint8_t * src, __m128i & r, __m128i & g, __m128i & b, __m128i & a)
+{
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    const __m128i p0 = _mm_loadu_si128((const __m128i *)src);
+    const __m128i p1 = _mm_loadu_si128((const __m128i *)(src + 16));
+    r = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+    b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    a = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+}
+
+SIMD_TARGET("sse2") static void convertRow_R5G6B5_R8G8B8A8_SSE2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i r, g, b, a;
+        unpackR8G8B8A8_SSE2(src + i * 4, r, g, b, a);
+        r = div255_SSE2(_mm_mullo_epi16(r, _mm_set1_epi16(31)));
+        g = div255_SSE2(_mm_mullo_epi16(g, _mm_set1_epi16(63)));
+        b = div255_SSE2(_mm_mullo_epi16(b, _mm_set1_epi16(31)));
+        const __m128i out = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), b);
+        _mm_storeu_si128((__m128i *)(dest + i * 2), out);
+    }
+    convertTail<PixelInfo::R5G6B5, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+SIMD_TARGET("sse2") static void convertRow_R4G4B4A4_R8G8B8A8_SSE2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i r, g, b, a;
+        unpackR8G8B8A8_SSE2(src + i * 4, r, g, b, a);
+        r = div255_SSE2(_mm_mullo_epi16(r, _mm_set1_epi16(15)));
+        g = div255_SSE2(_mm_mullo_epi16(g, _mm_set1_epi16(15)));
+        b = div255_SSE2(_mm_mullo_epi16(b, _mm_set1_epi16(15)));
+        a = div255_SSE2(_mm_mullo_epi16(a, _mm_set1_epi16(15)));
+        const __m128i out = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 12), _mm_slli_epi16(g, 8)), _mm_or_si128(_mm_slli_epi16(b, 4), a));
+        _mm_storeu_si128((__m128i *)(dest + i * 2), out);
+    }
+    convertTail<PixelInfo::R4G4B4A4, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+SIMD_TARGET("sse2") static void convertRow_X1R5G5B5_R8G8B8A8_SSE2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i r, g, b, a;
+        unpackR8G8B8A8_SSE2(src + i * 4, r, g, b, a);
+        r = div255_SSE2(_mm_mullo_epi16(r, _mm_set1_epi16(31)));
+        g = div255_SSE2(_mm_mullo_epi16(g, _mm_set1_epi16(31)));
+        b = div255_SSE2(_mm_mullo_epi16(b, _mm_set1_epi16(31)));
+        a = div255_SSE2(a);
+        const __m128i out = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(a, 15), _mm_slli_epi16(r, 10)), _mm_or_si128(_mm_slli_epi16(g, 5), b));
+        _mm_storeu_si128((__m128i *)(dest + i * 2), out);
+    }
+    convertTail<PixelInfo::X1R5G5B5, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+SIMD_TARGET("sse2") static void convertRow_R8G8B8A8_A8R8G8B8_SSE2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dest + i * 4), _mm_or_si128(_mm_slli_epi32(p, 8), _mm_srli_epi32(p, 24)));
+    }
+    convertTail<PixelInfo::R8G8B8A8, PixelInfo::A8R8G8B8>(dest, src, i, count);
+}
+
+SIMD_TARGET("sse2") static void convertRow_A8R8G8B8_R8G8B8A8_SSE2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dest + i * 4), _mm_or_si128(_mm_srli_epi32(p, 8), _mm_slli_epi32(p, 24)));
+    }
+    convertTail<PixelInfo::A8R8G8B8, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+SIMD_TARGET("ssse3") static void convertRow_R8G8B8A8_R8G8B8_SSSE3(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m128i alpha = _mm_set1_epi32(0xFF);
+    size_t i = 0;
+    //we load 16 bytes, but use only 12, so make sure we don't read past the end
+    for (; i + 6 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128((const __m128i *)(src + i * 3));
+        _mm_storeu_si128((__m128i *)(dest + i * 4), _mm_or_si128(_mm_shuffle_epi8(p, shuffle), alpha));
+    }
+    convertTail<PixelInfo::R8G8B8A8, PixelInfo::R8G8B8>(dest, src, i, count);
+}
+
+SIMD_TARGET("ssse3") static void convertRow_R8G8B8_R8G8B8A8_SSSE3(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    const __m128i shuffle = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    size_t i = 0;
+    //we store 16 bytes, but only 12 are valid, so make sure we don't write past the end
+    for (; i + 6 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        _mm_storeu_si128((__m128i *)(dest + i * 3), _mm_shuffle_epi8(p, shuffle));
+    }
+    convertTail<PixelInfo::R8G8B8, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+SIMD_TARGET("avx2") static inline __m256i div255_AVX2(__m256i x)
+{
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)), _mm256_srli_epi16(x, 8)), 8);
+}
+
+/*!
+Split 16 R8G8B8A8 pixels into 16bit R, G, B, A component vectors.
+*/
+SIMD_TARGET("avx2") static inline void unpackR8G8B8A8_AVX2(const uint8_t * src, __m256i & r, __m256i & g, __m256i & b, __m256i & a)
+{
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    const __m256i p0 = _mm256_loadu_si256((const __m256i *)src);
+    const __m256i p1 = _mm256_loadu_si256((const __m256i *)(src + 32));
+    //packs works per 128bit lane, so we need to restore the pixel order afterwards
+    r = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_srli_epi32(p0, 24), _mm256_srli_epi32(p1, 24)), 0xD8);
+    g = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask), _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask)), 0xD8);
+    b = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask), _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask)), 0xD8);
+    a = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask)), 0xD8);
+}
+
+SIMD_TARGET("avx2") static void convertRow_R5G6B5_R8G8B8A8_AVX2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i r, g, b, a;
+        unpackR8G8B8A8_AVX2(src + i * 4, r, g, b, a);
+        r = div255_AVX2(_mm256_mullo_epi16(r, _mm256_set1_epi16(31)));
+        g = div255_AVX2(_mm256_mullo_epi16(g, _mm256_set1_epi16(63)));
+        b = div255_AVX2(_mm256_mullo_epi16(b, _mm256_set1_epi16(31)));
+        const __m256i out = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, 11), _mm256_slli_epi16(g, 5)), b);
+        _mm256_storeu_si256((__m256i *)(dest + i * 2), out);
+    }
+    convertTail<PixelInfo::R5G6B5, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+SIMD_TARGET("avx2") static void convertRow_R4G4B4A4_R8G8B8A8_AVX2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i r, g, b, a;
+        unpackR8G8B8A8_AVX2(src + i * 4, r, g, b, a);
+        r = div255_AVX2(_mm256_mullo_epi16(r, _mm256_set1_epi16(15)));
+        g = div255_AVX2(_mm256_mullo_epi16(g, _mm256_set1_epi16(15)));
+        b = div255_AVX2(_mm256_mullo_epi16(b, _mm256_set1_epi16(15)));
+        a = div255_AVX2(_mm256_mullo_epi16(a, _mm256_set1_epi16(15)));
+        const __m256i out = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, 12), _mm256_slli_epi16(g, 8)), _mm256_or_si256(_mm256_slli_epi16(b, 4), a));
+        _mm256_storeu_si256((__m256i *)(dest + i * 2), out);
+    }
+    convertTail<PixelInfo::R4G4B4A4, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+SIMD_TARGET("avx2") static void convertRow_X1R5G5B5_R8G8B8A8_AVX2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i r, g, b, a;
+        unpackR8G8B8A8_AVX2(src + i * 4, r, g, b, a);
+        r = div255_AVX2(_mm256_mullo_epi16(r, _mm256_set1_epi16(31)));
+        g = div255_AVX2(_mm256_mullo_epi16(g, _mm256_set1_epi16(31)));
+        b = div255_AVX2(_mm256_mullo_epi16(b, _mm256_set1_epi16(31)));
+        a = div255_AVX2(a);
+        const __m256i out = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(a, 15), _mm256_slli_epi16(r, 10)), _mm256_or_si256(_mm256_slli_epi16(g, 5), b));
+        _mm256_storeu_si256((__m256i *)(dest + i * 2), out);
+    }
+    convertTail<PixelInfo::X1R5G5B5, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+SIMD_TARGET("avx2") static void convertRow_R8G8B8A8_A8R8G8B8_AVX2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i p = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+        _mm256_storeu_si256((__m256i *)(dest + i * 4), _mm256_or_si256(_mm256_slli_epi32(p, 8), _mm256_srli_epi32(p, 24)));
+    }
+    convertTail<PixelInfo::R8G8B8A8, PixelInfo::A8R8G8B8>(dest, src, i, count);
+}
+
+SIMD_TARGET("avx2") static void convertRow_A8R8G8B8_R8G8B8A8_AVX2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i p = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+        _mm256_storeu_si256((__m256i *)(dest + i * 4), _mm256_or_si256(_mm256_srli_epi32(p, 8), _mm256_slli_epi32(p, 24)));
+    }
+    convertTail<PixelInfo::A8R8G8B8, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+SIMD_TARGET("avx2") static void convertRow_R8G8B8A8_R8G8B8_AVX2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    //move bytes 12-27 to the upper lane, then shuffle like the SSSE3 version in both lanes
+    const __m256i permute = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+    const __m256i shuffle = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m256i alpha = _mm256_set1_epi32(0xFF);
+    size_t i = 0;
+    //we load 32 bytes, but use only 24, so make sure we don't read past the end
+    for (; i + 11 <= count; i += 8) {
+        const __m256i p = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(src + i * 3)), permute);
+        _mm256_storeu_si256((__m256i *)(dest + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(p, shuffle), alpha));
+    }
+    convertTail<PixelInfo::R8G8B8A8, PixelInfo::R8G8B8>(dest, src, i, count);
+}
+
+SIMD_TARGET("avx2") static void convertRow_R8G8B8_R8G8B8A8_AVX2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    //pack 12 bytes at the bottom of each lane, then move the upper lane bytes down to bytes 12-23
+    const __m256i shuffle = _mm256_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1, 1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    const __m256i permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    size_t i = 0;
+    //we store 32 bytes, but only 24 are valid, so make sure we don't write past the end
+    for (; i + 11 <= count; i += 8) {
+        const __m256i p = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src + i * 4)), shuffle);
+        _mm256_storeu_si256((__m256i *)(dest + i * 3), _mm256_permutevar8x32_epi32(p, permute));
+    }
+    convertTail<PixelInfo::R8G8B8, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+//Premultiplication works on the 32bit pixels directly. R and B are multiplied in the two 16bit halves of one lane, G in the upper half of another.
+//Rounding division by 255 is (t + (t >> 8)) >> 8 with t = x + 128, which equals (x + 127) / 255 for all x <= 255 * 255.
+
+SIMD_TARGET("sse2") static inline __m128i mulDiv255Round_SSE2(__m128i x, __m128i a)
+{
+    const __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, a), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+SIMD_TARGET("sse2") static void premultiplyRow_R8G8B8A8_SSE2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    const __m128i maskA = _mm_set1_epi32(0xFF);
+    const __m128i maskRB = _mm_set1_epi32(0x00FF00FF);
+    const __m128i maskG = _mm_set1_epi32(0x00FF0000);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        const __m128i a = _mm_and_si128(p, maskA);
+        const __m128i a16 = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+        const __m128i rb = mulDiv255Round_SSE2(_mm_and_si128(_mm_srli_epi32(p, 8), maskRB), a16);
+        const __m128i g = mulDiv255Round_SSE2(_mm_and_si128(p, maskG), a16);
+        _mm_storeu_si128((__m128i *)(dest + i * 4), _mm_or_si128(_mm_or_si128(_mm_slli_epi32(rb, 8), g), a));
+    }
+    premultiplyTail<PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+//SSE2 has no 32bit multiplication keeping the low bits. Multiply the even and odd lanes separately and put them back together.
+SIMD_TARGET("sse2") static inline __m128i mullo32_SSE2(__m128i a, __m128i b)
+{
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/*!
+Scale 32bit color values by 16.16 factors, round and clamp to 255. Results are < 2^16, so a signed compare works for clamping.
+*/
+SIMD_TARGET("sse2") static inline __m128i unpremultiply_SSE2(__m128i c, __m128i scale)
+{
+    const __m128i max = _mm_set1_epi32(0xFF);
+    const __m128i x = _mm_srli_epi32(_mm_add_epi32(mullo32_SSE2(c, scale), _mm_set1_epi32(32768)), 16);
+    const __m128i clamp = _mm_cmpgt_epi32(x, max);
+    return _mm_or_si128(_mm_andnot_si128(clamp, x), _mm_and_si128(clamp, max));
+}
+
+SIMD_TARGET("sse2") static void unpremultiplyRow_R8G8B8A8_SSE2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    const uint32_t * scales = unpremultiplyScales();
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i p = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        const uint8_t * alpha = src + i * 4;
+        const __m128i scale = _mm_setr_epi32(scales[alpha[0]], scales[alpha[4]], scales[alpha[8]], scales[alpha[12]]);
+        const __m128i r = unpremultiply_SSE2(_mm_srli_epi32(p, 24), scale);
+        const __m128i g = unpremultiply_SSE2(_mm_and_si128(_mm_srli_epi32(p, 16), mask), scale);
+        const __m128i b = unpremultiply_SSE2(_mm_and_si128(_mm_srli_epi32(p, 8), mask), scale);
+        const __m128i out = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 24), _mm_slli_epi32(g, 16)), _mm_or_si128(_mm_slli_epi32(b, 8), _mm_and_si128(p, mask)));
+        _mm_storeu_si128((__m128i *)(dest + i * 4), out);
+    }
+    unpremultiplyTail<PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+SIMD_TARGET("avx2") static inline __m256i mulDiv255Round_AVX2(__m256i x, __m256i a)
+{
+    const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(x, a), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+SIMD_TARGET("avx2") static void premultiplyRow_R8G8B8A8_AVX2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    const __m256i maskA = _mm256_set1_epi32(0xFF);
+    const __m256i maskRB = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i maskG = _mm256_set1_epi32(0x00FF0000);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i p = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+        const __m256i a = _mm256_and_si256(p, maskA);
+        const __m256i a16 = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+        const __m256i rb = mulDiv255Round_AVX2(_mm256_and_si256(_mm256_srli_epi32(p, 8), maskRB), a16);
+        const __m256i g = mulDiv255Round_AVX2(_mm256_and_si256(p, maskG), a16);
+        _mm256_storeu_si256((__m256i *)(dest + i * 4), _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(rb, 8), g), a));
+    }
+    premultiplyTail<PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+SIMD_TARGET("avx2") static inline __m256i unpremultiply_AVX2(__m256i c, __m256i scale)
+{
+    const __m256i x = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(c, scale), _mm256_set1_epi32(32768)), 16);
+    return _mm256_min_epu32(x, _mm256_set1_epi32(0xFF));
+}
+
+SIMD_TARGET("avx2") static void unpremultiplyRow_R8G8B8A8_AVX2(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    const int * scales = (const int *)unpremultiplyScales();
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i p = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+        const __m256i a = _mm256_and_si256(p, mask);
+        const __m256i scale = _mm256_i32gather_epi32(scales, a, 4);
+        const __m256i r = unpremultiply_AVX2(_mm256_srli_epi32(p, 24), scale);
+        const __m256i g = unpremultiply_AVX2(_mm256_and_si256(_mm256_srli_epi32(p, 16), mask), scale);
+        const __m256i b = unpremultiply_AVX2(_mm256_and_si256(_mm256_srli_epi32(p, 8), mask), scale);
+        const __m256i out = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r, 24), _mm256_slli_epi32(g, 16)), _mm256_or_si256(_mm256_slli_epi32(b, 8), a));
+        _mm256_storeu_si256((__m256i *)(dest + i * 4), out);
+    }
+    unpremultiplyTail<PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+#endif //IMAGE_SIMD_X86
+
+//-------------------------------------------------------------------------------------------------
+
+#if defined(IMAGE_SIMD_NEON)
+
+static inline uint16x8_t div255_NEON(uint16x8_t x)
+{
+    return vshrq_n_u16(vaddq_u16(vaddq_u16(x, vdupq_n_u16(1)), vshrq_n_u16(x, 8)), 8);
+}
+
+//vld4_u8 on R8G8B8A8 data delivers the planes A, B, G, R in val[0..3]
+
+static void convertRow_R5G6B5_R8G8B8A8_NEON(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8x8x4_t p = vld4_u8(src + i * 4);
+        const uint16x8_t r = div255_NEON(vmull_u8(p.val[3], vdup_n_u8(31)));
+        const uint16x8_t g = div255_NEON(vmull_u8(p.val[2], vdup_n_u8(63)));
+        const uint16x8_t b = div255_NEON(vmull_u8(p.val[1], vdup_n_u8(31)));
+        vst1q_u16((uint16_t *)(dest + i * 2), vorrq_u16(vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 5)), b));
+    }
+    convertTail<PixelInfo::R5G6B5, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+static void convertRow_R4G4B4A4_R8G8B8A8_NEON(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8x8x4_t p = vld4_u8(src + i * 4);
+        const uint16x8_t r = div255_NEON(vmull_u8(p.val[3], vdup_n_u8(15)));
+        const uint16x8_t g = div255_NEON(vmull_u8(p.val[2], vdup_n_u8(15)));
+        const uint16x8_t b = div255_NEON(vmull_u8(p.val[1], vdup_n_u8(15)));
+        const uint16x8_t a = div255_NEON(vmull_u8(p.val[0], vdup_n_u8(15)));
+        vst1q_u16((uint16_t *)(dest + i * 2), vorrq_u16(vorrq_u16(vshlq_n_u16(r, 12), vshlq_n_u16(g, 8)), vorrq_u16(vshlq_n_u16(b, 4), a)));
+    }
+    convertTail<PixelInfo::R4G4B4A4, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+static void convertRow_X1R5G5B5_R8G8B8A8_NEON(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8x8x4_t p = vld4_u8(src + i * 4);
+        const uint16x8_t r = div255_NEON(vmull_u8(p.val[3], vdup_n_u8(31)));
+        const uint16x8_t g = div255_NEON(vmull_u8(p.val[2], vdup_n_u8(31)));
+        const uint16x8_t b = div255_NEON(vmull_u8(p.val[1], vdup_n_u8(31)));
+        const uint16x8_t a = div255_NEON(vmovl_u8(p.val[0]));
+        vst1q_u16((uint16_t *)(dest + i * 2), vorrq_u16(vorrq_u16(vshlq_n_u16(a, 15), vshlq_n_u16(r, 10)), vorrq_u16(vshlq_n_u16(g, 5), b)));
+    }
+    convertTail<PixelInfo::X1R5G5B5, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+static void convertRow_R8G8B8A8_A8R8G8B8_NEON(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8x8x4_t p = vld4_u8(src + i * 4);
+        uint8x8x4_t o;
+        o.val[0] = p.val[3]; o.val[1] = p.val[0]; o.val[2] = p.val[1]; o.val[3] = p.val[2];
+        vst4_u8(dest + i * 4, o);
+    }
+    convertTail<PixelInfo::R8G8B8A8, PixelInfo::A8R8G8B8>(dest, src, i, count);
+}
+
+static void convertRow_A8R8G8B8_R8G8B8A8_NEON(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8x8x4_t p = vld4_u8(src + i * 4);
+        uint8x8x4_t o;
+        o.val[0] = p.val[1]; o.val[1] = p.val[2]; o.val[2] = p.val[3]; o.val[3] = p.val[0];
+        vst4_u8(dest + i * 4, o);
+    }
+    convertTail<PixelInfo::A8R8G8B8, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+static void convertRow_R8G8B8A8_R8G8B8_NEON(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8x8x3_t p = vld3_u8(src + i * 3);
+        uint8x8x4_t o;
+        o.val[0] = vdup_n_u8(0xFF); o.val[1] = p.val[0]; o.val[2] = p.val[1]; o.val[3] = p.val[2];
+        vst4_u8(dest + i * 4, o);
+    }
+    convertTail<PixelInfo::R8G8B8A8, PixelInfo::R8G8B8>(dest, src, i, count);
+}
+
+static void convertRow_R8G8B8_R8G8B8A8_NEON(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8x8x4_t p = vld4_u8(src + i * 4);
+        uint8x8x3_t o;
+        o.val[0] = p.val[1]; o.val[1] = p.val[2]; o.val[2] = p.val[3];
+        vst3_u8(dest + i * 3, o);
+    }
+    convertTail<PixelInfo::R8G8B8, PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+static inline uint8x8_t mulDiv255Round_NEON(uint8x8_t x, uint8x8_t a)
+{
+    const uint16x8_t t = vaddq_u16(vmull_u8(x, a), vdupq_n_u16(128));
+    return vmovn_u16(vshrq_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8));
+}
+
+static void premultiplyRow_R8G8B8A8_NEON(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t p = vld4_u8(src + i * 4);
+        p.val[1] = mulDiv255Round_NEON(p.val[1], p.val[0]);
+        p.val[2] = mulDiv255Round_NEON(p.val[2], p.val[0]);
+        p.val[3] = mulDiv255Round_NEON(p.val[3], p.val[0]);
+        vst4_u8(dest + i * 4, p);
+    }
+    premultiplyTail<PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+static inline uint16x4_t unpremultiply_NEON(uint16x4_t c, uint32x4_t scale)
+{
+    const uint32x4_t x = vshrq_n_u32(vaddq_u32(vmulq_u32(vmovl_u16(c), scale), vdupq_n_u32(32768)), 16);
+    return vmovn_u32(vminq_u32(x, vdupq_n_u32(0xFF)));
+}
+
+static void unpremultiplyRow_R8G8B8A8_NEON(uint8_t * dest, const uint8_t * src, size_t count)
+{
+    const uint32_t * scales = unpremultiplyScales();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t p = vld4_u8(src + i * 4);
+        const uint8_t * alpha = src + i * 4;
+        const uint32_t scaleLo[4] = { scales[alpha[0]], scales[alpha[4]], scales[alpha[8]], scales[alpha[12]] };
+        const uint32_t scaleHi[4] = { scales[alpha[16]], scales[alpha[20]], scales[alpha[24]], scales[alpha[28]] };
+        const uint32x4_t lo = vld1q_u32(scaleLo);
+        const uint32x4_t hi = vld1q_u32(scaleHi);
+        for (int c = 1; c < 4; ++c) {
+            const uint16x8_t wide = vmovl_u8(p.val[c]);
+            p.val[c] = vmovn_u16(vcombine_u16(unpremultiply_NEON(vget_low_u16(wide), lo), unpremultiply_NEON(vget_high_u16(wide), hi)));
+        }
+        vst4_u8(dest + i * 4, p);
+    }
+    unpremultiplyTail<PixelInfo::R8G8B8A8>(dest, src, i, count);
+}
+
+#endif //IMAGE_SIMD_NEON
+
+//-------------------------------------------------------------------------------------------------
+
+ConvertRowFunction getConvertRowFunction(PixelInfo::FormatType destType, PixelInfo::FormatType sourceType, const CpuFeatures & features)
+{
+#if defined(IMAGE_SIMD_X86)
+    if (features.avx2) {
+        if (destType == PixelInfo::R8G8B8A8 && sourceType == PixelInfo::R8G8B8) return convertRow_R8G8B8A8_R8G8B8_AVX2;
+        if (destType == PixelInfo::R8G8B8 && sourceType == PixelInfo::R8G8B8A8) return convertRow_R8G8B8_R8G8B8A8_AVX2;
+        if (destType == PixelInfo::R8G8B8A8 && sourceType == PixelInfo::A8R8G8B8) return convertRow_R8G8B8A8_A8R8G8B8_AVX2;
+        if (destType == PixelInfo::A8R8G8B8 && sourceType == PixelInfo::R8G8B8A8) return convertRow_A8R8G8B8_R8G8B8A8_AVX2;
+        if (destType == PixelInfo::R5G6B5 && sourceType == PixelInfo::R8G8B8A8) return convertRow_R5G6B5_R8G8B8A8_AVX2;
+        if (destType == PixelInfo::R4G4B4A4 && sourceType == PixelInfo::R8G8B8A8) return convertRow_R4G4B4A4_R8G8B8A8_AVX2;
+        if (destType == PixelInfo::X1R5G5B5 && sourceType == PixelInfo::R8G8B8A8) return convertRow_X1R5G5B5_R8G8B8A8_AVX2;
+    }
+    if (features.ssse3) {
+        if (destType == PixelInfo::R8G8B8A8 && sourceType == PixelInfo::R8G8B8) return convertRow_R8G8B8A8_R8G8B8_SSSE3;
+        if (destType == PixelInfo::R8G8B8 && sourceType == PixelInfo::R8G8B8A8) return convertRow_R8G8B8_R8G8B8A8_SSSE3;
+    }
+    if (features.sse2) {
+        if (destType == PixelInfo::R8G8B8A8 && sourceType == PixelInfo::A8R8G8B8) return convertRow_R8G8B8A8_A8R8G8B8_SSE2;
+        if (destType == PixelInfo::A8R8G8B8 && sourceType == PixelInfo::R8G8B8A8) return convertRow_A8R8G8B8_R8G8B8A8_SSE2;
+        if (destType == PixelInfo::R5G6B5 && sourceType == PixelInfo::R8G8B8A8) return convertRow_R5G6B5_R8G8B8A8_SSE2;
+        if (destType == PixelInfo::R4G4B4A4 && sourceType == PixelInfo::R8G8B8A8) return convertRow_R4G4B4A4_R8G8B8A8_SSE2;
+        if (destType == PixelInfo::X1R5G5B5 && sourceType == PixelInfo::R8G8B8A8) return convertRow_X1R5G5B5_R8G8B8A8_SSE2;
+    }
+#endif
+#if defined(IMAGE_SIMD_NEON)
+    if (features.neon) {
+        if (destType == PixelInfo::R8G8B8A8 && sourceType == PixelInfo::R8G8B8) return convertRow_R8G8B8A8_R8G8B8_NEON;
+        if (destType == PixelInfo::R8G8B8 && sourceType == PixelInfo::R8G8B8A8) return convertRow_R8G8B8_R8G8B8A8_NEON;
+        if (destType == PixelInfo::R8G8B8A8 && sourceType == PixelInfo::A8R8G8B8) return convertRow_R8G8B8A8_A8R8G8B8_NEON;
+        if (destType == PixelInfo::A8R8G8B8 && sourceType == PixelInfo::R8G8B8A8) return convertRow_A8R8G8B8_R8G8B8A8_NEON;
+        if (destType == PixelInfo::R5G6B5 && sourceType == PixelInfo::R8G8B8A8) return convertRow_R5G6B5_R8G8B8A8_NEON;
+        if (destType == PixelInfo::R4G4B4A4 && sourceType == PixelInfo::R8G8B8A8) return convertRow_R4G4B4A4_R8G8B8A8_NEON;
+        if (destType == PixelInfo::X1R5G5B5 && sourceType == PixelInfo::R8G8B8A8) return convertRow_X1R5G5B5_R8G8B8A8_NEON;
+    }
+#endif
+    return nullptr;
+}
+
+ConvertRowFunction getConvertRowFunction(PixelInfo::FormatType destType, PixelInfo::FormatType sourceType)
+{
+    return getConvertRowFunction(destType, sourceType, CpuFeatures::detected());
+}
+
+ConvertRowFunction getPremultiplyRowFunction(PixelInfo::FormatType formatType, const CpuFeatures & features)
+{
+#if defined(IMAGE_SIMD_X86)
+    if (features.avx2) {
+        if (formatType == PixelInfo::R8G8B8A8) return premultiplyRow_R8G8B8A8_AVX2;
+    }
+    if (features.sse2) {
+        if (formatType == PixelInfo::R8G8B8A8) return premultiplyRow_R8G8B8A8_SSE2;
+    }
+#endif
+#if defined(IMAGE_SIMD_NEON)
+    if (features.neon) {
+        if (formatType == PixelInfo::R8G8B8A8) return premultiplyRow_R8G8B8A8_NEON;
+    }
+#endif
+    return nullptr;
+}
+
+ConvertRowFunction getPremultiplyRowFunction(PixelInfo::FormatType formatType)
+{
+    return getPremultiplyRowFunction(formatType, CpuFeatures::detected());
+}
+
+ConvertRowFunction getUnpremultiplyRowFunction(PixelInfo::FormatType formatType, const CpuFeatures & features)
+{
+#if defined(IMAGE_SIMD_X86)
+    if (features.avx2) {
+        if (formatType == PixelInfo::R8G8B8A8) return unpremultiplyRow_R8G8B8A8_AVX2;
+    }
+    if (features.sse2) {
+        if (formatType == PixelInfo::R8G8B8A8) return unpremultiplyRow_R8G8B8A8_SSE2;
+    }
+#endif
+#if defined(IMAGE_SIMD_NEON)
+    if (features.neon) {
+        if (formatType == PixelInfo::R8G8B8A8) return unpremultiplyRow_R8G8B8A8_NEON;
+    }
+#endif
+    return nullptr;
+}
+
+ConvertRowFunction getUnpremultiplyRowFunction(PixelInfo::FormatType formatType)
+{
+    return getUnpremultiplyRowFunction(formatType, CpuFeatures::detected());
+}
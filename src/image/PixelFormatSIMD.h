@@ -0,0 +1,59 @@
+#pragma once
+
+#include "PixelInfo.h"
+#include "CpuFeatures.h"
+
+#include <stddef.h>
+
+
+/*!
+Function converting a row of consecutive pixels from one format to another.
+\param[in] dest Destination data pointer.
+\param[in] src Source data pointer.
+\param[in] count Number of pixels to convert.
+*/
+typedef void (*ConvertRowFunction)(uint8_t * dest, const uint8_t * src, size_t count);
+
+/*!
+Get the fastest SIMD row conversion function for a pair of formats on this CPU.
+\param[in] destType Output color pixel format.
+\param[in] sourceType Input color pixel format.
+\return Returns a SIMD row conversion function or nullptr if there is none for this pair and the scalar convertPixel<> template should be used.
+\note The results are bit-exact with convertPixel<OUTTYPE, INTYPE>.
+*/
+ConvertRowFunction getConvertRowFunction(PixelInfo::FormatType destType, PixelInfo::FormatType sourceType);
+
+/*!
+Get the SIMD row conversion function for a pair of formats using a specific set of CPU features.
+\param[in] destType Output color pixel format.
+\param[in] sourceType Input color pixel format.
+\param[in] features CPU features that may be used. Useful to test / benchmark specific instruction sets.
+\return Returns a SIMD row conversion function or nullptr if there is none for this pair and feature set.
+*/
+ConvertRowFunction getConvertRowFunction(PixelInfo::FormatType destType, PixelInfo::FormatType sourceType, const CpuFeatures & features);
+
+/*!
+Get the fastest SIMD function multiplying the colors of a row of pixels with their alpha on this CPU.
+\param[in] formatType Pixel format of the row. Source and destination may be the same.
+\return Returns a SIMD row function or nullptr if there is none for this format and the scalar premultiplyPixel<> template should be used.
+\note The results are bit-exact with premultiplyPixel<FORMATTYPE>.
+*/
+ConvertRowFunction getPremultiplyRowFunction(PixelInfo::FormatType formatType);
+
+/*!
+Get the SIMD premultiply row function for a format using a specific set of CPU features.
+*/
+ConvertRowFunction getPremultiplyRowFunction(PixelInfo::FormatType formatType, const CpuFeatures & features);
+
+/*!
+Get the fastest SIMD function dividing the colors of a row of premultiplied pixels by their alpha on this CPU.
+\param[in] formatType Pixel format of the row. Source and destination may be the same.
+\return Returns a SIMD row function or nullptr if there is none for this format and the scalar unpremultiplyPixel<> template should be used.
+\note The results are bit-exact with unpremultiplyPixel<FORMATTYPE>.
+*/
+ConvertRowFunction getUnpremultiplyRowFunction(PixelInfo::FormatType formatType);
+
+/*!
+Get the SIMD unpremultiply row function for a format using a specific set of CPU features.
+*/
+ConvertRowFunction getUnpremultiplyRowFunction(PixelInfo::FormatType formatType, const CpuFeatures & features);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 #include <limits>
 #include <string>
 #include <type_traits>
@@ -11,6 +12,8 @@ struct PixelInfo
     enum FormatType { BAD_FORMAT, R8G8B8A8, A8R8G8B8, R8G8B8X8, X8R8G8B8, R4G4B4A4, R8G8B8, X1R5G5B5, R5G6B5, /*true color RGB, RGBA*/
         I8, I16, /*paletted types*/
         PVRTC1_R4G4B4, PVRTC1_R2G2B2, PVRTC1_R4G4B4A4, PVRTC1_R2G2B2A2, /*compressed RGB, RGBA formats*/
+        ETC1_R8G8B8, BC1_R5G6B5, BC3_R5G6B5A8, /*compressed 4x4 block formats*/
+        R5G5B5A1, L8, L8A8, /*OpenGL ES 2.0 packed RGBA, luminance and luminance-alpha*/
         MAX_FORMAT }; //!<The truecolor pixel formats we support.
 
     const FormatType type; //!< Type identifier of pixel format.
@@ -43,6 +46,26 @@ struct PixelInfo
         return pixelInfos[type];
     }
 
+    /*!
+    Check if a format stores color values directly in every pixel, so pixels can be read and filtered one by one.
+    \param type Pixel format type to check.
+    \return Returns false for BAD_FORMAT, unknown, compressed and palette formats.
+    */
+    static inline bool isDirectColor(const FormatType & type)
+    {
+        const PixelInfo & info = pixelInfo(type);
+        return info.type != BAD_FORMAT && !info.compressed && info.paletteEntries == 0;
+    }
+
+    /*!
+    Calculate the size of image data at runtime. This also works for compressed formats, which have no bytes per pixel.
+    \param type Pixel format type of data.
+    \param width Width of image in pixels.
+    \param height Height of image in pixels.
+    \return Returns the number of bytes needed for the pixel data, without palette.
+    */
+    static size_t dataSize(const FormatType & type, size_t width, size_t height);
+
 private:
     static const PixelInfo pixelInfos[]; //!< List of pixel format information structures.
 }; //!< Pixel format information. This is for RUNTIME information. The PixelFormat<> template class is for STATIC information.
@@ -163,7 +186,7 @@ struct TypeFactory<PixelInfo::FormatType::X8R8G8B8>
 template <>
 struct TypeFactory<PixelInfo::FormatType::R4G4B4A4>
 {
-    typedef uint32_t PixelType; //!< The data type one pixel of this format has.
+    typedef uint16_t PixelType; //!< The data type one pixel of this format has.
     typedef uint8_t ColorType; //!< The data type one color component of this format has.
     typedef uint32_t TempColorType; //!< The "safe" data type one intermediate color component of this format has. Use this for interpolation.
 
@@ -419,3 +442,165 @@ struct TypeFactory<PixelInfo::FormatType::PVRTC1_R2G2B2A2>
     static const inline PixelInfo::FormatType type() { return PixelInfo::FormatType::PVRTC1_R2G2B2A2; }
     static const inline std::string name() { return "PVRTC1_R2G2B2A2"; }
 };
+
+//ETC1 stores 4x4 pixel blocks in 64 bits. The color bits are those of the decoded pixels.
+template <>
+struct TypeFactory<PixelInfo::FormatType::ETC1_R8G8B8>
+{
+    typedef uint8_t PixelType;
+    typedef uint8_t ColorType;
+    typedef uint8_t TempColorType;
+
+    enum { bitsPerPixel = 0 };
+    enum { bytesPerPixel = 0 };
+    enum { bytesPerColor = 0 };
+    enum { nrOfComponents = 3 };
+    enum { bitsRed = 8 };
+    enum { bitsGreen = 8 };
+    enum { bitsBlue = 8 };
+    enum { bitsAlpha = 0 };
+    enum { shiftRed = 16 };
+    enum { shiftGreen = 8 };
+    enum { shiftBlue = 0 };
+    enum { shiftAlpha = 0 };
+    enum { paletteEntries = 0 };
+    enum { compressed = 1 };
+
+    static const inline PixelInfo::FormatType type() { return PixelInfo::FormatType::ETC1_R8G8B8; }
+    static const inline std::string name() { return "ETC1_R8G8B8"; }
+};
+
+//BC1 (DXT1) stores 4x4 pixel blocks in 64 bits: two R5G6B5 end point colors and 2bit indices.
+template <>
+struct TypeFactory<PixelInfo::FormatType::BC1_R5G6B5>
+{
+    typedef uint8_t PixelType;
+    typedef uint8_t ColorType;
+    typedef uint8_t TempColorType;
+
+    enum { bitsPerPixel = 0 };
+    enum { bytesPerPixel = 0 };
+    enum { bytesPerColor = 0 };
+    enum { nrOfComponents = 3 };
+    enum { bitsRed = 5 };
+    enum { bitsGreen = 6 };
+    enum { bitsBlue = 5 };
+    enum { bitsAlpha = 0 };
+    enum { shiftRed = 11 };
+    enum { shiftGreen = 5 };
+    enum { shiftBlue = 0 };
+    enum { shiftAlpha = 0 };
+    enum { paletteEntries = 0 };
+    enum { compressed = 1 };
+
+    static const inline PixelInfo::FormatType type() { return PixelInfo::FormatType::BC1_R5G6B5; }
+    static const inline std::string name() { return "BC1_R5G6B5"; }
+};
+
+//BC3 (DXT5) stores 4x4 pixel blocks in 128 bits: a block of 8bit end point alphas and 3bit indices, followed by a BC1 color block.
+template <>
+struct TypeFactory<PixelInfo::FormatType::BC3_R5G6B5A8>
+{
+    typedef uint8_t PixelType;
+    typedef uint8_t ColorType;
+    typedef uint8_t TempColorType;
+
+    enum { bitsPerPixel = 0 };
+    enum { bytesPerPixel = 0 };
+    enum { bytesPerColor = 0 };
+    enum { nrOfComponents = 4 };
+    enum { bitsRed = 5 };
+    enum { bitsGreen = 6 };
+    enum { bitsBlue = 5 };
+    enum { bitsAlpha = 8 };
+    enum { shiftRed = 19 };
+    enum { shiftGreen = 13 };
+    enum { shiftBlue = 8 };
+    enum { shiftAlpha = 0 };
+    enum { paletteEntries = 0 };
+    enum { compressed = 1 };
+
+    static const inline PixelInfo::FormatType type() { return PixelInfo::FormatType::BC3_R5G6B5A8; }
+    static const inline std::string name() { return "BC3_R5G6B5A8"; }
+};
+
+//R5G5B5A1 matches GL_UNSIGNED_SHORT_5_5_5_1 with alpha in the lowest bit.
+template <>
+struct TypeFactory<PixelInfo::FormatType::R5G5B5A1>
+{
+    typedef uint16_t PixelType;
+    typedef uint8_t ColorType;
+    typedef uint32_t TempColorType;
+
+    enum { bitsPerPixel = 16 };
+    enum { bytesPerPixel = 2 };
+    enum { bytesPerColor = 1 };
+    enum { nrOfComponents = 4 };
+    enum { bitsRed = 5 };
+    enum { bitsGreen = 5 };
+    enum { bitsBlue = 5 };
+    enum { bitsAlpha = 1 };
+    enum { shiftRed = 11 };
+    enum { shiftGreen = 6 };
+    enum { shiftBlue = 1 };
+    enum { shiftAlpha = 0 };
+    enum { paletteEntries = 0 };
+    enum { compressed = 0 };
+
+    static const inline PixelInfo::FormatType type() { return PixelInfo::FormatType::R5G5B5A1; }
+    static const inline std::string name() { return "R5G5B5A1"; }
+};
+
+//L8 is a gray value like I8, but without a palette. It matches GL_LUMINANCE.
+template <>
+struct TypeFactory<PixelInfo::FormatType::L8>
+{
+    typedef uint8_t PixelType;
+    typedef uint8_t ColorType;
+    typedef uint32_t TempColorType;
+
+    enum { bitsPerPixel = 8 };
+    enum { bytesPerPixel = 1 };
+    enum { bytesPerColor = 1 };
+    enum { nrOfComponents = 1 };
+    enum { bitsRed = 8 };
+    enum { bitsGreen = 0 };
+    enum { bitsBlue = 0 };
+    enum { bitsAlpha = 0 };
+    enum { shiftRed = 0 };
+    enum { shiftGreen = 0 };
+    enum { shiftBlue = 0 };
+    enum { shiftAlpha = 0 };
+    enum { paletteEntries = 0 };
+    enum { compressed = 0 };
+
+    static const inline PixelInfo::FormatType type() { return PixelInfo::FormatType::L8; }
+    static const inline std::string name() { return "L8"; }
+};
+
+//L8A8 stores the gray value in the first and alpha in the second byte. It matches GL_LUMINANCE_ALPHA.
+template <>
+struct TypeFactory<PixelInfo::FormatType::L8A8>
+{
+    typedef uint16_t PixelType;
+    typedef uint8_t ColorType;
+    typedef uint32_t TempColorType;
+
+    enum { bitsPerPixel = 16 };
+    enum { bytesPerPixel = 2 };
+    enum { bytesPerColor = 1 };
+    enum { nrOfComponents = 2 };
+    enum { bitsRed = 8 };
+    enum { bitsGreen = 0 };
+    enum { bitsBlue = 0 };
+    enum { bitsAlpha = 8 };
+    enum { shiftRed = 0 };
+    enum { shiftGreen = 0 };
+    enum { shiftBlue = 0 };
+    enum { shiftAlpha = 8 };
+    enum { paletteEntries = 0 };
+    enum { compressed = 0 };
+
+    static const inline PixelInfo::FormatType type() { return PixelInfo::FormatType::L8A8; }
+    static const inline std::string name() { return "L8A8"; }
+};
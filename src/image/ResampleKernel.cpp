@@ -1,60 +1,147 @@
 #include "ResampleKernel.h"
 
+#include <list>
+#include <mutex>
+
+
+//Process-wide LRU cache of weight tables. The most recently used entry is at the front of the list.
+//The list is short, so a linear search is faster than any map.
+struct KernelCacheEntry
+{
+    ResampleFilter filter;
+    size_t destSize;
+    size_t srcSize;
+    std::shared_ptr<const KernelWeightTable> table;
+};
+
+static std::mutex s_cacheMutex;
+static std::list<KernelCacheEntry> s_cache;
+static size_t s_cacheCapacity = 32;
+
 
 ResampleKernel::ResampleKernel()
-    : m_weightStorage(nullptr)
-    , m_weights(nullptr)
+    : m_destSize(0)
+    , m_srcSize(0)
 {
 }
 
-ResampleKernel::~ResampleKernel()
+const KernelWeights * ResampleKernel::getWeigths(ResampleFilter kernel, size_t destSize, size_t srcSize)
 {
-    delete [] m_weights;
-    delete [] m_weightStorage;
+    //check if we already use that table
+    if (m_table && m_kernel == kernel && m_destSize == destSize && m_srcSize == srcSize) {
+        return m_table->weights.data();
+    }
+    m_kernel = kernel;
+    m_destSize = destSize;
+    m_srcSize = srcSize;
+    m_table = weightTable(kernel, destSize, srcSize);
+    return m_table->weights.data();
 }
 
-const KernelWeights * ResampleKernel::getWeigths(ResampleFilter kernel, size_t destSize, size_t srcSize)
+std::shared_ptr<const KernelWeightTable> ResampleKernel::weightTable(const ResampleFilter & kernel, size_t destSize, size_t srcSize)
 {
-    //check if we need to re-calculate
-    if (m_weights == nullptr || m_kernel != kernel || m_destSize != destSize || m_srcSize != srcSize)
+    //look the table up in the cache
     {
-        //yes. store new values
-        m_kernel = kernel;
-        m_destSize = destSize;
-        m_srcSize = srcSize;
-        //setup some helpers
-        const float scale = (float)srcSize / (float)destSize;
-        const float pixelScale = scale > 1.0f ? scale : 1.0f;
-        const float sampleSize = ceil(pixelScale * m_kernel.support);
-        //now allocate weights and weights storage arrays
-        m_weightStorage = new float[destSize * ((size_t)sampleSize + 2) * 2];
-        size_t weightStorageIndex = 0;
-        //we need one set of weights for every pixel in destination image
-        m_weights = new KernelWeights[destSize];
-        //now calculate weights
-        for (size_t x = 0; x < destSize; ++x) {
-            //calculate center of destination pixel in source image
-            const float sourceX = ((float)x + 0.5f) * scale - 0.5f;
-            //calculate start and end of current sampling range
-            const size_t startX = ceil(sourceX - sampleSize) > 0.0 ? (size_t)ceil(sourceX - sampleSize) : 0;
-            const size_t endX = floor(sourceX + sampleSize) <= (srcSize - 1) ? (size_t)floor(sourceX + sampleSize) : (srcSize - 1);
-            //put into structure
-            m_weights[x].start = startX;
-            m_weights[x].end = endX;
-            //store to start of weights in global weight storage array
-            m_weights[x].weights = &m_weightStorage[weightStorageIndex];
-            //calculate individual weights and sum
-            float weightSum = 0.0f;
-            for (size_t weightX = startX; weightX <= endX; ++weightX) {
-                const float w = m_kernel.function(((float)weightX - sourceX) / pixelScale);
-                //store weigth and update sum
-                m_weightStorage[weightStorageIndex++] = w;
-                weightSum += w;
+        std::lock_guard<std::mutex> lock(s_cacheMutex);
+        for (auto it = s_cache.begin(); it != s_cache.end(); ++it) {
+            if (it->filter == kernel && it->destSize == destSize && it->srcSize == srcSize) {
+                //move to front, because it was used most recently
+                s_cache.splice(s_cache.begin(), s_cache, it);
+                return it->table;
             }
-            //store inverse sum
-            m_weights[x].invSum = 1.0f / weightSum;
         }
     }
-    //else values are already calculated and cached.
-    return (const KernelWeights *)m_weights;
+    //not found. calculate outside of the lock, so other threads are not blocked
+    std::shared_ptr<const KernelWeightTable> table = calculateWeights(kernel, destSize, srcSize);
+    std::lock_guard<std::mutex> lock(s_cacheMutex);
+    //another thread might have inserted the same table in the meantime. use that one then
+    for (auto it = s_cache.begin(); it != s_cache.end(); ++it) {
+        if (it->filter == kernel && it->destSize == destSize && it->srcSize == srcSize) {
+            return it->table;
+        }
+    }
+    if (s_cacheCapacity > 0) {
+        KernelCacheEntry entry = {kernel, destSize, srcSize, table};
+        s_cache.push_front(entry);
+        while (s_cache.size() > s_cacheCapacity) {
+            s_cache.pop_back();
+        }
+    }
+    return table;
+}
+
+std::shared_ptr<const KernelWeightTable> ResampleKernel::calculateWeights(const ResampleFilter & kernel, size_t destSize, size_t srcSize)
+{
+    std::shared_ptr<KernelWeightTable> table = std::make_shared<KernelWeightTable>();
+    //setup some helpers
+    const float scale = (float)srcSize / (float)destSize;
+    const float pixelScale = scale > 1.0f ? scale : 1.0f;
+    const float sampleSize = ceil(pixelScale * kernel.support);
+    //allocate weights and weights storage arrays
+    const size_t storageSize = destSize * ((size_t)sampleSize + 2) * 2;
+    table->weightStorage.resize(storageSize);
+    table->fixedWeightStorage.resize(storageSize);
+    size_t weightStorageIndex = 0;
+    //we need one set of weights for every pixel in destination image
+    table->weights.resize(destSize);
+    //now calculate weights
+    for (size_t x = 0; x < destSize; ++x) {
+        KernelWeights & weights = table->weights[x];
+        //calculate center of destination pixel in source image
+        const float sourceX = ((float)x + 0.5f) * scale - 0.5f;
+        //calculate start and end of current sampling range
+        size_t startX = ceil(sourceX - sampleSize) > 0.0 ? (size_t)ceil(sourceX - sampleSize) : 0;
+        size_t endX = floor(sourceX + sampleSize) <= (srcSize - 1) ? (size_t)floor(sourceX + sampleSize) : (srcSize - 1);
+        if (kernel.support <= 0.0f) {
+            //no support. use the nearest pixel only
+            startX = floor(sourceX + 0.5f) > 0.0f ? (size_t)floor(sourceX + 0.5f) : 0;
+            startX = startX < srcSize ? startX : (srcSize - 1);
+            endX = startX;
+        }
+        //put into structure
+        weights.start = startX;
+        weights.end = endX;
+        //store to start of weights in global weight storage array
+        weights.weights = &table->weightStorage[weightStorageIndex];
+        weights.fixedWeights = &table->fixedWeightStorage[weightStorageIndex];
+        //calculate individual weights and sum
+        float weightSum = 0.0f;
+        for (size_t weightX = startX; weightX <= endX; ++weightX) {
+            const float w = kernel.support <= 0.0f ? 1.0f : kernel.function(((float)weightX - sourceX) / pixelScale);
+            //store weigth and update sum
+            table->weightStorage[weightStorageIndex++] = w;
+            weightSum += w;
+        }
+        //store inverse sum
+        weights.invSum = 1.0f / weightSum;
+        //calculate normalized fixed-point weights
+        const size_t count = endX - startX + 1;
+        const int32_t one = 1 << FIXED_WEIGHT_BITS;
+        int32_t fixedSum = 0;
+        size_t largest = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const float w = weights.weights[i] * weights.invSum;
+            weights.fixedWeights[i] = (int16_t)floor(w * (float)one + 0.5f);
+            fixedSum += weights.fixedWeights[i];
+            largest = weights.fixedWeights[i] > weights.fixedWeights[largest] ? i : largest;
+        }
+        //put the rounding error into the largest weight, so the weights sum up to exactly one
+        weights.fixedWeights[largest] += (int16_t)(one - fixedSum);
+    }
+    return table;
+}
+
+void ResampleKernel::setCacheCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(s_cacheMutex);
+    s_cacheCapacity = capacity;
+    while (s_cache.size() > s_cacheCapacity) {
+        s_cache.pop_back();
+    }
+}
+
+void ResampleKernel::clearCache()
+{
+    std::lock_guard<std::mutex> lock(s_cacheMutex);
+    s_cache.clear();
 }
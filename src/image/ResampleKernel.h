@@ -1,12 +1,35 @@
 #pragma once
 
 #include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <vector>
 
 
-inline float FunctionNearest(const float & x) { return x; }
+inline float FunctionNearest(const float & x) { float value = fabs(x); return value <= 0.5f ? 1.0f : 0.0f; }
 inline float FunctionLinear(const float & x) { float value = fabs(x); return value < 1.0f ? 1.0f - value : 0.0f; }
 inline float FunctionBox(const float & x) { float value = fabs(x); return value <= 0.5f ? 1.0f : 0.0f; }
 
+inline float FunctionSinc(const float & x) { if (x == 0.0f) { return 1.0f; } const float value = 3.14159265f * x; return sinf(value) / value; }
+inline float FunctionLanczos2(const float & x) { float value = fabs(x); return value < 2.0f ? FunctionSinc(value) * FunctionSinc(value / 2.0f) : 0.0f; }
+inline float FunctionLanczos3(const float & x) { float value = fabs(x); return value < 3.0f ? FunctionSinc(value) * FunctionSinc(value / 3.0f) : 0.0f; }
+
+//Cubic filter family from Mitchell and Netravali, "Reconstruction Filters in Computer Graphics", 1988.
+inline float FunctionCubic(const float & x, const float B, const float C)
+{
+    const float value = fabs(x);
+    if (value < 1.0f) {
+        return ((12.0f - 9.0f * B - 6.0f * C) * value * value * value + (-18.0f + 12.0f * B + 6.0f * C) * value * value + (6.0f - 2.0f * B)) / 6.0f;
+    }
+    else if (value < 2.0f) {
+        return ((-B - 6.0f * C) * value * value * value + (6.0f * B + 30.0f * C) * value * value + (-12.0f * B - 48.0f * C) * value + (8.0f * B + 24.0f * C)) / 6.0f;
+    }
+    return 0.0f;
+}
+inline float FunctionMitchell(const float & x) { return FunctionCubic(x, 1.0f / 3.0f, 1.0f / 3.0f); }
+inline float FunctionCatmullRom(const float & x) { return FunctionCubic(x, 0.0f, 0.5f); }
+
 struct ResampleFilter
 {
     float support;
@@ -18,6 +41,7 @@ struct ResampleFilter
     bool operator!=(const ResampleFilter & b) const { return (support != b.support || function != b.function); }
 };
 
+//A support of 0 makes the kernel pick exactly one source pixel
 struct ResampleNearest : public ResampleFilter
 {
     ResampleNearest() : ResampleFilter(FunctionNearest, 0.0f) {}
@@ -33,11 +57,35 @@ struct ResampleBox : public ResampleFilter
     ResampleBox() : ResampleFilter(FunctionBox, 0.5f) {}
 };
 
+struct ResampleLanczos2 : public ResampleFilter
+{
+    ResampleLanczos2() : ResampleFilter(FunctionLanczos2, 2.0f) {}
+};
+
+struct ResampleLanczos3 : public ResampleFilter
+{
+    ResampleLanczos3() : ResampleFilter(FunctionLanczos3, 3.0f) {}
+};
+
+struct ResampleMitchell : public ResampleFilter
+{
+    ResampleMitchell() : ResampleFilter(FunctionMitchell, 2.0f) {}
+};
+
+struct ResampleCatmullRom : public ResampleFilter
+{
+    ResampleCatmullRom() : ResampleFilter(FunctionCatmullRom, 2.0f) {}
+};
+
 //-------------------------------------------------------------------------------------------------
 
+//Number of fractional bits of the fixed-point weights. Fixed-point weights for a pixel sum up to exactly 1 << FIXED_WEIGHT_BITS.
+#define FIXED_WEIGHT_BITS 14
+
 struct KernelWeights
 {
     float * weights; //!< Weigths for each pixel for a block of pixels. See size.
+    int16_t * fixedWeights; //!< Normalized fixed-point weights with FIXED_WEIGHT_BITS fractional bits. Used by the integer resampling path.
     float invSum; //!< Inverse sum of all weights.
     size_t start; //!< Start of range to calculate weights. This is always >= 0.
     size_t end; //!< end of range to calculate weights. This is always < \sa destSize passed in constructor.
@@ -45,14 +93,28 @@ struct KernelWeights
 
 //-------------------------------------------------------------------------------------------------
 
+/*!
+Immutable set of weights for one filter and size pair. Tables are shared between all kernels through the weight cache.
+*/
+struct KernelWeightTable
+{
+    std::vector<float> weightStorage; //!< Float weights of all destination pixels.
+    std::vector<int16_t> fixedWeightStorage; //!< Fixed-point weights of all destination pixels.
+    std::vector<KernelWeights> weights; //!< One entry per destination pixel pointing into the storage arrays.
+};
+
 class ResampleKernel
 {
 private:
     ResampleFilter m_kernel;
     size_t m_destSize;
     size_t m_srcSize;
-    float * m_weightStorage;
-    KernelWeights * m_weights;
+    std::shared_ptr<const KernelWeightTable> m_table; //!< Keeps the table alive, even if it is evicted from the cache.
+
+    /*!
+    Calculate a new weight table.
+    */
+    static std::shared_ptr<const KernelWeightTable> calculateWeights(const ResampleFilter & filter, size_t destSize, size_t srcSize);
 
 public:
     /*!
@@ -61,16 +123,34 @@ public:
     ResampleKernel();
 
     /*!
-    Destructor. Frees all stuff.
+    Retrieve weigths for kernel and sizes set. The weights are taken from a process-wide cache and only calculated if need be.
+    \param[in] filter Resampling filter structure.
+    \param[in] destSize Destination size of image. Either horizontal or vertical.
+    \param[in] srcSize Source size of image. Either horizontal or vertical.
+    \return Returns \sa destSize filled \sa Weights structures for resampling. They stay valid until the next call or until the kernel is destroyed.
     */
-    ~ResampleKernel();
+    const KernelWeights * getWeigths(ResampleFilter filter, size_t destSize, size_t srcSize);
 
     /*!
-    Retrieve weigths for kernel and sizes set. The weights will be cached and re-calculated if need be.
+    Retrieve the weight table for a filter and sizes from the process-wide cache. It is only calculated if need be.
     \param[in] filter Resampling filter structure.
     \param[in] destSize Destination size of image. Either horizontal or vertical.
     \param[in] srcSize Source size of image. Either horizontal or vertical.
-    \return Returns \sa destSize filled \sa Weights structures for resampling.
+    \return Returns the immutable weight table. It can be shared between threads and stays valid even if it is evicted from the cache.
+    \note This is thread-safe.
     */
-    const KernelWeights * getWeigths(ResampleFilter filter, size_t destSize, size_t srcSize);
+    static std::shared_ptr<const KernelWeightTable> weightTable(const ResampleFilter & filter, size_t destSize, size_t srcSize);
+
+    /*!
+    Set the maximum number of weight tables kept in the process-wide cache. The least recently used tables are evicted first.
+    \param[in] capacity Maximum number of tables. Pass 0 to disable caching.
+    \note This is thread-safe.
+    */
+    static void setCacheCapacity(size_t capacity);
+
+    /*!
+    Remove all weight tables from the process-wide cache.
+    \note This is thread-safe. Kernels still using a table keep it alive.
+    */
+    static void clearCache();
 };
@@ -0,0 +1,146 @@
+#include "ResamplePlan.h"
+#include "PixelAllocator.h"
+#include "Image.h"
+#include "PixelFormatSIMD.h"
+
+
+//Scratch buffer of the calling thread. It only grows and lives until the thread exits,
+//so it is taken from the system heap and not from a PixelAllocator that might be gone by then.
+struct ThreadScratch
+{
+    uint8_t * data;
+    size_t size;
+
+    ThreadScratch() : data(nullptr), size(0) {}
+    ~ThreadScratch() { PixelAllocator::systemFree(data); }
+};
+
+static thread_local ThreadScratch t_scratch;
+
+
+ResamplePlan::ResamplePlan(PixelInfo::FormatType formatType, size_t srcWidth, size_t srcHeight, size_t destWidth, size_t destHeight, const ResampleFilter & filter, bool useFixedPoint, PixelInfo::FormatType destFormatType, bool filterPremultiplied)
+    : m_formatType(formatType)
+    , m_destFormatType(destFormatType != PixelInfo::BAD_FORMAT ? destFormatType : formatType)
+    , m_srcWidth(srcWidth)
+    , m_srcHeight(srcHeight)
+    , m_destWidth(destWidth)
+    , m_destHeight(destHeight)
+    , m_filter(filter)
+    , m_useFixedPoint(useFixedPoint && ImageResample::supportsFixedPoint(formatType))
+    , m_filterPremultiplied(filterPremultiplied && supportsPremultipliedAlpha(formatType))
+{
+    if (m_srcWidth == 0 || m_srcHeight == 0 || m_destWidth == 0 || m_destHeight == 0) {
+        throw ImageException("ResamplePlan::ResamplePlan() - Invalid image dimensions!");
+    }
+    if (m_formatType == PixelInfo::BAD_FORMAT || PixelInfo::pixelInfo(m_formatType).compressed || m_destFormatType == PixelInfo::BAD_FORMAT || PixelInfo::pixelInfo(m_destFormatType).compressed) {
+        throw ImageException("ResamplePlan::ResamplePlan() - Invalid image format!");
+    }
+    m_horizontalTable = ResampleKernel::weightTable(m_filter, m_destWidth, m_srcWidth);
+    m_verticalTable = ResampleKernel::weightTable(m_filter, m_destHeight, m_srcHeight);
+}
+
+size_t ResamplePlan::scratchSize() const
+{
+    return m_destWidth * m_srcHeight * PixelInfo::pixelInfo(m_formatType).bytesPerPixel;
+}
+
+void ResamplePlan::execute(const ImageView & dest, const ConstImageView & src) const
+{
+    //grow the scratch buffer of this thread if need be
+    const size_t size = scratchSize();
+    if (t_scratch.size < size) {
+        PixelAllocator::systemFree(t_scratch.data);
+        t_scratch.data = (uint8_t *)PixelAllocator::systemAllocate(size);
+        if (t_scratch.data == nullptr) {
+            t_scratch.size = 0;
+            throw ImageException("ResamplePlan::execute() - Failed to allocate scratch buffer!");
+        }
+        t_scratch.size = size;
+    }
+    execute(dest, src, t_scratch.data);
+}
+
+void ResamplePlan::execute(const ImageView & dest, const ConstImageView & src, uint8_t * scratch) const
+{
+    if (dest.data == nullptr || src.data == nullptr || scratch == nullptr) {
+        throw ImageException("ResamplePlan::execute() - Invalid image data!");
+    }
+    if (dest.width != m_destWidth || dest.height != m_destHeight || src.width != m_srcWidth || src.height != m_srcHeight) {
+        throw ImageException("ResamplePlan::execute() - Image dimensions do not match plan!");
+    }
+    if (dest.formatType != m_destFormatType || src.formatType != m_formatType) {
+        throw ImageException("ResamplePlan::execute() - Image formats do not match plan!");
+    }
+    const size_t bytesPerPixel = PixelInfo::pixelInfo(m_formatType).bytesPerPixel;
+    const KernelWeights * horizontalWeights = m_horizontalTable->weights.data();
+    const KernelWeights * verticalWeights = m_verticalTable->weights.data();
+    //first rescale horizontally
+#pragma omp parallel
+    {
+        //when filtering in premultiplied space every source row is premultiplied into a buffer first
+        uint8_t * premultipliedRow = m_filterPremultiplied ? PixelAllocator::allocate(m_srcWidth * bytesPerPixel) : nullptr;
+#pragma omp for
+        for (int y = 0; y < (int)m_srcHeight; ++y) {
+            //calculate new scanlines
+            uint8_t * destScanLine = scratch + y * m_destWidth * bytesPerPixel;
+            const uint8_t * srcScanLine = src.row(y);
+            if (premultipliedRow != nullptr) {
+                premultiplyPixels(premultipliedRow, srcScanLine, m_formatType, m_srcWidth);
+                srcScanLine = premultipliedRow;
+            }
+            //loop horizontally
+            if (m_useFixedPoint) {
+                accumulateWeightedFixed(destScanLine, bytesPerPixel, m_destWidth, srcScanLine, bytesPerPixel, horizontalWeights, bytesPerPixel);
+            }
+            else {
+                accumulateWeighted(destScanLine, bytesPerPixel, m_destWidth, srcScanLine, bytesPerPixel, horizontalWeights, m_formatType);
+            }
+        }
+        PixelAllocator::release(premultipliedRow);
+    }
+    const size_t verticalStride = bytesPerPixel * m_destWidth;
+    //now rescale vertically. every destination row is a weighted sum of whole rows from the scale buffer,
+    //so we read memory linearly. static scheduling gives every thread a contiguous band of rows
+    if (m_destFormatType == m_formatType) {
+#pragma omp parallel for schedule(static)
+        for (int y = 0; y < (int)m_destHeight; ++y) {
+            uint8_t * destScanLine = dest.row(y);
+            if (m_useFixedPoint) {
+                accumulateWeightedRowFixed(destScanLine, verticalStride, scratch, verticalStride, &verticalWeights[y]);
+            }
+            else {
+                accumulateWeightedRow(destScanLine, m_destWidth, scratch, verticalStride, &verticalWeights[y], m_formatType);
+            }
+            if (m_filterPremultiplied) {
+                unpremultiplyPixels(destScanLine, destScanLine, m_formatType, m_destWidth);
+            }
+        }
+    }
+    else {
+        //scale every row into a small buffer that stays in the cache and convert it to the destination from there
+        ConvertRowFunction rowFunction = getConvertRowFunction(m_destFormatType, m_formatType);
+#pragma omp parallel
+        {
+            uint8_t * rowBuffer = PixelAllocator::allocate(verticalStride);
+#pragma omp for schedule(static)
+            for (int y = 0; y < (int)m_destHeight; ++y) {
+                if (m_useFixedPoint) {
+                    accumulateWeightedRowFixed(rowBuffer, verticalStride, scratch, verticalStride, &verticalWeights[y]);
+                }
+                else {
+                    accumulateWeightedRow(rowBuffer, m_destWidth, scratch, verticalStride, &verticalWeights[y], m_formatType);
+                }
+                if (m_filterPremultiplied) {
+                    unpremultiplyPixels(rowBuffer, rowBuffer, m_formatType, m_destWidth);
+                }
+                if (rowFunction != nullptr) {
+                    rowFunction(dest.row(y), rowBuffer, m_destWidth);
+                }
+                else {
+                    convertFormat(dest.row(y), nullptr, m_destFormatType, rowBuffer, nullptr, m_formatType, m_destWidth);
+                }
+            }
+            PixelAllocator::release(rowBuffer);
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "ImageResample.h"
+
+#include <memory>
+
+
+/*!
+Immutable description of one resampling operation: format, source and destination size, filter and the weight tables for both directions.
+A plan is never modified after construction, so it can be shared between threads and executed concurrently.
+Execution needs a scratch buffer for the horizontally scaled rows. Either pass one in or let the plan use a buffer private to the calling thread.
+*/
+class ResamplePlan
+{
+    PixelInfo::FormatType m_formatType;
+    PixelInfo::FormatType m_destFormatType;
+    size_t m_srcWidth;
+    size_t m_srcHeight;
+    size_t m_destWidth;
+    size_t m_destHeight;
+    ResampleFilter m_filter;
+    bool m_useFixedPoint;
+    bool m_filterPremultiplied;
+    std::shared_ptr<const KernelWeightTable> m_horizontalTable;
+    std::shared_ptr<const KernelWeightTable> m_verticalTable;
+
+public:
+    /*!
+    Constructor. Retrieves the weight tables from the process-wide weight cache.
+    \param[in] formatType Color pixel format of source and destination.
+    \param[in] srcWidth Input width.
+    \param[in] srcHeight Input height.
+    \param[in] destWidth Output width.
+    \param[in] destHeight Output height.
+    \param[in] filter Resampling filter structure. See ResampleKernel.h for information.
+    \param[in] useFixedPoint Pass false to always use the floating-point path. \sa ImageResample::setUseFixedPoint.
+    \param[in] destFormatType Optional. Color pixel format of destination. Rows are converted right after they were scaled vertically, so the destination is only written once.
+    Pass BAD_FORMAT to use the source format.
+    \param[in] filterPremultiplied Optional. Pass true to filter straight alpha input in premultiplied space. Source rows are multiplied with their alpha before filtering and
+    the result is divided by it again, so fully transparent pixels do not bleed their color into the edges. Has no effect on formats without alpha.
+    \note Throws an ImageException if the sizes or the formats are invalid.
+    */
+    ResamplePlan(PixelInfo::FormatType formatType, size_t srcWidth, size_t srcHeight, size_t destWidth, size_t destHeight, const ResampleFilter & filter = ResampleLinear(), bool useFixedPoint = true, PixelInfo::FormatType destFormatType = PixelInfo::BAD_FORMAT, bool filterPremultiplied = false);
+
+    /*!
+    Scale source view to destination view using a scratch buffer private to the calling thread.
+    \param[in] dest Output view. Must have the destination size and format of the plan.
+    \param[in] src Input view. Must have the source size and format of the plan.
+    \note Throws an ImageException if the views do not match the plan. Concurrent calls from different threads are safe.
+    */
+    void execute(const ImageView & dest, const ConstImageView & src) const;
+
+    /*!
+    Scale source view to destination view.
+    \param[in] dest Output view. Must have the destination size and format of the plan.
+    \param[in] src Input view. Must have the source size and format of the plan.
+    \param[in] scratch Scratch buffer of at least \sa scratchSize bytes. Must not be used by other calls at the same time.
+    \note Throws an ImageException if the views do not match the plan.
+    */
+    void execute(const ImageView & dest, const ConstImageView & src, uint8_t * scratch) const;
+
+    /*!
+    Get size of scratch buffer needed for execution.
+    \return Returns the size of the scratch buffer in bytes.
+    */
+    size_t scratchSize() const;
+
+    PixelInfo::FormatType formatType() const { return m_formatType; }
+    PixelInfo::FormatType destFormatType() const { return m_destFormatType; }
+    size_t srcWidth() const { return m_srcWidth; }
+    size_t srcHeight() const { return m_srcHeight; }
+    size_t destWidth() const { return m_destWidth; }
+    size_t destHeight() const { return m_destHeight; }
+    const ResampleFilter & filter() const { return m_filter; }
+    bool useFixedPoint() const { return m_useFixedPoint; }
+    bool filterPremultiplied() const { return m_filterPremultiplied; }
+};
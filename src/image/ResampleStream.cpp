@@ -0,0 +1,109 @@
+#include "ResampleStream.h"
+#include "Image.h"
+#include "PixelAllocator.h"
+
+#include <string.h>
+
+
+ResampleStream::ResampleStream(PixelInfo::FormatType formatType, size_t srcWidth, size_t srcHeight, size_t destWidth, size_t destHeight, const ResampleFilter & filter, RowCallback callback, bool useFixedPoint)
+    : m_formatType(formatType)
+    , m_srcWidth(srcWidth)
+    , m_srcHeight(srcHeight)
+    , m_destWidth(destWidth)
+    , m_destHeight(destHeight)
+    , m_bytesPerPixel(0)
+    , m_useFixedPoint(useFixedPoint && ImageResample::supportsFixedPoint(formatType))
+    , m_horizontalWeights(nullptr)
+    , m_verticalWeights(nullptr)
+    , m_callback(callback)
+    , m_ring(nullptr)
+    , m_ringSize(0)
+    , m_destRow(nullptr)
+    , m_srcRow(0)
+    , m_destRowIndex(0)
+{
+    if (m_srcWidth == 0 || m_srcHeight == 0 || m_destWidth == 0 || m_destHeight == 0) {
+        throw ImageException("ResampleStream::ResampleStream() - Invalid image dimensions!");
+    }
+    if (m_formatType == PixelInfo::BAD_FORMAT || PixelInfo::pixelInfo(m_formatType).compressed) {
+        throw ImageException("ResampleStream::ResampleStream() - Invalid image format!");
+    }
+    m_bytesPerPixel = PixelInfo::pixelInfo(m_formatType).bytesPerPixel;
+    m_horizontalWeights = m_horizontalKernel.getWeigths(filter, m_destWidth, m_srcWidth);
+    m_verticalWeights = m_verticalKernel.getWeigths(filter, m_destHeight, m_srcHeight);
+    //the ring needs to hold the taps of the widest vertical kernel
+    for (size_t y = 0; y < m_destHeight; ++y) {
+        const size_t taps = m_verticalWeights[y].end - m_verticalWeights[y].start + 1;
+        m_ringSize = taps > m_ringSize ? taps : m_ringSize;
+    }
+    //allocate two copies of the ring, so taps wrapping around the end are still contiguous in memory
+    const size_t rowBytes = m_destWidth * m_bytesPerPixel;
+    m_ring = PixelAllocator::allocate(2 * m_ringSize * rowBytes);
+    m_destRow = PixelAllocator::allocate(rowBytes);
+}
+
+ResampleStream::~ResampleStream()
+{
+    PixelAllocator::release(m_ring);
+    PixelAllocator::release(m_destRow);
+}
+
+void ResampleStream::pushRow(const uint8_t * srcRow)
+{
+    if (m_srcRow >= m_srcHeight) {
+        throw ImageException("ResampleStream::pushRow() - All source rows have already been pushed!");
+    }
+    //scale row horizontally into ring slot
+    const size_t rowBytes = m_destWidth * m_bytesPerPixel;
+    const size_t slot = m_srcRow % m_ringSize;
+    uint8_t * ringRow = m_ring + slot * rowBytes;
+    if (m_useFixedPoint) {
+        accumulateWeightedFixed(ringRow, m_bytesPerPixel, m_destWidth, srcRow, m_bytesPerPixel, m_horizontalWeights, m_bytesPerPixel);
+    }
+    else {
+        accumulateWeighted(ringRow, m_bytesPerPixel, m_destWidth, srcRow, m_bytesPerPixel, m_horizontalWeights, m_formatType);
+    }
+    //store the mirror copy in the second half of the ring
+    memcpy(ringRow + m_ringSize * rowBytes, ringRow, rowBytes);
+    ++m_srcRow;
+    emitRows();
+}
+
+void ResampleStream::pushRows(const uint8_t * src, size_t count, size_t srcStride)
+{
+    for (size_t i = 0; i < count; ++i) {
+        pushRow(src);
+        src += srcStride;
+    }
+}
+
+void ResampleStream::emitRows()
+{
+    const size_t rowBytes = m_destWidth * m_bytesPerPixel;
+    //emit all destination rows whose last tap has arrived
+    while (m_destRowIndex < m_destHeight && m_verticalWeights[m_destRowIndex].end < m_srcRow) {
+        //the taps start..end are contiguous in the ring starting at the slot of the first tap
+        KernelWeights weights = m_verticalWeights[m_destRowIndex];
+        const uint8_t * firstRow = m_ring + (weights.start % m_ringSize) * rowBytes;
+        weights.end -= weights.start;
+        weights.start = 0;
+        if (m_useFixedPoint) {
+            accumulateWeightedRowFixed(m_destRow, rowBytes, firstRow, rowBytes, &weights);
+        }
+        else {
+            accumulateWeightedRow(m_destRow, m_destWidth, firstRow, rowBytes, &weights, m_formatType);
+        }
+        m_callback(m_destRow, m_destRowIndex);
+        ++m_destRowIndex;
+    }
+}
+
+bool ResampleStream::finished() const
+{
+    return m_srcRow >= m_srcHeight;
+}
+
+size_t ResampleStream::ringSize() const
+{
+    return m_ringSize;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "ImageResample.h"
+
+#include <functional>
+
+
+/*!
+Streaming resampler. Source rows are pushed one by one, scaled horizontally and stored in a small ring of rows sized to the vertical kernel support.
+Destination rows are emitted through a callback as soon as all of their source rows are available, so the whole source image never needs to be in memory.
+Peak memory is proportional to destination width times the number of vertical filter taps.
+*/
+class ResampleStream
+{
+public:
+    /*!
+    Callback receiving finished destination rows.
+    \param[in] row Pointer to destination row data. Only valid during the call.
+    \param[in] y Index of destination row. Rows are emitted in ascending order.
+    */
+    typedef std::function<void(const uint8_t * row, size_t y)> RowCallback;
+
+private:
+    PixelInfo::FormatType m_formatType;
+    size_t m_srcWidth;
+    size_t m_srcHeight;
+    size_t m_destWidth;
+    size_t m_destHeight;
+    size_t m_bytesPerPixel;
+    bool m_useFixedPoint;
+    ResampleKernel m_horizontalKernel;
+    ResampleKernel m_verticalKernel;
+    const KernelWeights * m_horizontalWeights;
+    const KernelWeights * m_verticalWeights;
+    RowCallback m_callback;
+    uint8_t * m_ring; //!< Ring of horizontally scaled rows. Every row is stored twice, so the taps of a destination row are always contiguous.
+    size_t m_ringSize; //!< Number of rows in ring.
+    uint8_t * m_destRow;
+    size_t m_srcRow; //!< Number of source rows pushed so far.
+    size_t m_destRowIndex; //!< Index of next destination row to emit.
+
+    ResampleStream(const ResampleStream & b);
+    ResampleStream & operator=(const ResampleStream & b);
+
+    void emitRows();
+
+public:
+    /*!
+    Constructor.
+    \param[in] formatType Color pixel format of source and destination rows.
+    \param[in] srcWidth Input width.
+    \param[in] srcHeight Input height.
+    \param[in] destWidth Output width.
+    \param[in] destHeight Output height.
+    \param[in] filter Resampling filter structure. See ResampleKernel.h for information.
+    \param[in] callback Function receiving the destination rows.
+    \param[in] useFixedPoint Pass false to always use the floating-point path. \sa ImageResample::setUseFixedPoint.
+    */
+    ResampleStream(PixelInfo::FormatType formatType, size_t srcWidth, size_t srcHeight, size_t destWidth, size_t destHeight, const ResampleFilter & filter, RowCallback callback, bool useFixedPoint = true);
+
+    /*!
+    Destructor. Frees the ring buffer.
+    */
+    ~ResampleStream();
+
+    /*!
+    Push the next source row. This may emit one or more destination rows.
+    \param[in] srcRow Source row data with srcWidth pixels.
+    \note Throws an ImageException if more than srcHeight rows are pushed.
+    */
+    void pushRow(const uint8_t * srcRow);
+
+    /*!
+    Push multiple consecutive source rows.
+    \param[in] src Data of first source row.
+    \param[in] count Number of rows to push.
+    \param[in] srcStride Byte-stride to start of next source row.
+    */
+    void pushRows(const uint8_t * src, size_t count, size_t srcStride);
+
+    /*!
+    Check if all destination rows have been emitted.
+    \return Returns true if all srcHeight source rows were pushed.
+    */
+    bool finished() const;
+
+    /*!
+    Retrieve the number of rows in the ring buffer.
+    \return Returns the maximum number of vertical filter taps.
+    */
+    size_t ringSize() const;
+};
@@ -0,0 +1,659 @@
+#include "S3TCCodec.h"
+#include "PixelAllocator.h"
+
+#include <math.h>
+#include <string.h>
+
+
+/*!
+Find the closest of 4 palette colors for all 16 pixels of a block.
+\param[in] indices Receives the 2bit palette index of every pixel. Pixel 0 is in the lowest bits.
+\param[in] pixels 16 red, 16 green and 16 blue values.
+\param[in] palette 4 colors as red, green, blue. Every value must be in [0,255].
+\return Returns the summed squared error of the block.
+*/
+typedef uint32_t (*ColorIndicesFunction)(uint32_t & indices, const int16_t * pixels, const int16_t * palette);
+
+static uint32_t colorIndices(uint32_t & indices, const int16_t * pixels, const int16_t * palette)
+{
+    uint32_t sum = 0;
+    indices = 0;
+    for (int i = 0; i < 16; ++i) {
+        uint32_t best = 0xFFFFFFFF;
+        uint32_t bestIndex = 0;
+        for (int m = 0; m < 4; ++m) {
+            const int dr = pixels[i] - palette[3 * m];
+            const int dg = pixels[16 + i] - palette[3 * m + 1];
+            const int db = pixels[32 + i] - palette[3 * m + 2];
+            const uint32_t error = (uint32_t)(dr * dr + dg * dg + db * db);
+            if (error < best) {
+                best = error;
+                bestIndex = m;
+            }
+        }
+        sum += best;
+        indices |= bestIndex << (2 * i);
+    }
+    return sum;
+}
+
+#if defined(IMAGE_SIMD_X86)
+
+SIMD_TARGET("sse2") static uint32_t colorIndices_SSE2(uint32_t & indices, const int16_t * pixels, const int16_t * palette)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    indices = 0;
+    for (int half = 0; half < 2; ++half) {
+        const __m128i r = _mm_loadu_si128((const __m128i *)(pixels + 8 * half));
+        const __m128i g = _mm_loadu_si128((const __m128i *)(pixels + 16 + 8 * half));
+        const __m128i b = _mm_loadu_si128((const __m128i *)(pixels + 32 + 8 * half));
+        __m128i bestLo = _mm_set1_epi32(0x7FFFFFFF);
+        __m128i bestHi = bestLo;
+        __m128i indexLo = zero;
+        __m128i indexHi = zero;
+        for (int m = 0; m < 4; ++m) {
+            const __m128i dr = _mm_sub_epi16(r, _mm_set1_epi16(palette[3 * m]));
+            const __m128i dg = _mm_sub_epi16(g, _mm_set1_epi16(palette[3 * m + 1]));
+            const __m128i db = _mm_sub_epi16(b, _mm_set1_epi16(palette[3 * m + 2]));
+            //madd squares and adds pairs of 16bit values, so interleave red with green and blue with zero
+            const __m128i rgLo = _mm_unpacklo_epi16(dr, dg);
+            const __m128i rgHi = _mm_unpackhi_epi16(dr, dg);
+            const __m128i bLo = _mm_unpacklo_epi16(db, zero);
+            const __m128i bHi = _mm_unpackhi_epi16(db, zero);
+            const __m128i errorLo = _mm_add_epi32(_mm_madd_epi16(rgLo, rgLo), _mm_madd_epi16(bLo, bLo));
+            const __m128i errorHi = _mm_add_epi32(_mm_madd_epi16(rgHi, rgHi), _mm_madd_epi16(bHi, bHi));
+            //SSE2 has no 32bit minimum. errors are positive, so a signed compare works
+            const __m128i lessLo = _mm_cmplt_epi32(errorLo, bestLo);
+            const __m128i lessHi = _mm_cmplt_epi32(errorHi, bestHi);
+            const __m128i index = _mm_set1_epi32(m);
+            bestLo = _mm_or_si128(_mm_and_si128(lessLo, errorLo), _mm_andnot_si128(lessLo, bestLo));
+            bestHi = _mm_or_si128(_mm_and_si128(lessHi, errorHi), _mm_andnot_si128(lessHi, bestHi));
+            indexLo = _mm_or_si128(_mm_and_si128(lessLo, index), _mm_andnot_si128(lessLo, indexLo));
+            indexHi = _mm_or_si128(_mm_and_si128(lessHi, index), _mm_andnot_si128(lessHi, indexHi));
+        }
+        sum = _mm_add_epi32(sum, _mm_add_epi32(bestLo, bestHi));
+        uint16_t halfIndices[8];
+        _mm_storeu_si128((__m128i *)halfIndices, _mm_packs_epi32(indexLo, indexHi));
+        for (int i = 0; i < 8; ++i) {
+            indices |= (uint32_t)halfIndices[i] << (2 * (8 * half + i));
+        }
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(sum);
+}
+
+#endif
+
+#if defined(IMAGE_SIMD_NEON)
+
+static uint32_t colorIndices_NEON(uint32_t & indices, const int16_t * pixels, const int16_t * palette)
+{
+    uint32x4_t sum = vdupq_n_u32(0);
+    indices = 0;
+    for (int half = 0; half < 2; ++half) {
+        const int16x8_t r = vld1q_s16(pixels + 8 * half);
+        const int16x8_t g = vld1q_s16(pixels + 16 + 8 * half);
+        const int16x8_t b = vld1q_s16(pixels + 32 + 8 * half);
+        uint32x4_t bestLo = vdupq_n_u32(0xFFFFFFFF);
+        uint32x4_t bestHi = bestLo;
+        uint32x4_t indexLo = vdupq_n_u32(0);
+        uint32x4_t indexHi = indexLo;
+        for (int m = 0; m < 4; ++m) {
+            const int16x8_t dr = vsubq_s16(r, vdupq_n_s16(palette[3 * m]));
+            const int16x8_t dg = vsubq_s16(g, vdupq_n_s16(palette[3 * m + 1]));
+            const int16x8_t db = vsubq_s16(b, vdupq_n_s16(palette[3 * m + 2]));
+            int32x4_t errorLo = vmull_s16(vget_low_s16(dr), vget_low_s16(dr));
+            errorLo = vmlal_s16(errorLo, vget_low_s16(dg), vget_low_s16(dg));
+            errorLo = vmlal_s16(errorLo, vget_low_s16(db), vget_low_s16(db));
+            int32x4_t errorHi = vmull_s16(vget_high_s16(dr), vget_high_s16(dr));
+            errorHi = vmlal_s16(errorHi, vget_high_s16(dg), vget_high_s16(dg));
+            errorHi = vmlal_s16(errorHi, vget_high_s16(db), vget_high_s16(db));
+            const uint32x4_t lessLo = vcltq_u32(vreinterpretq_u32_s32(errorLo), bestLo);
+            const uint32x4_t lessHi = vcltq_u32(vreinterpretq_u32_s32(errorHi), bestHi);
+            const uint32x4_t index = vdupq_n_u32(m);
+            bestLo = vbslq_u32(lessLo, vreinterpretq_u32_s32(errorLo), bestLo);
+            bestHi = vbslq_u32(lessHi, vreinterpretq_u32_s32(errorHi), bestHi);
+            indexLo = vbslq_u32(lessLo, index, indexLo);
+            indexHi = vbslq_u32(lessHi, index, indexHi);
+        }
+        sum = vaddq_u32(sum, vaddq_u32(bestLo, bestHi));
+        uint32_t halfIndices[8];
+        vst1q_u32(halfIndices, indexLo);
+        vst1q_u32(halfIndices + 4, indexHi);
+        for (int i = 0; i < 8; ++i) {
+            indices |= halfIndices[i] << (2 * (8 * half + i));
+        }
+    }
+    const uint64x2_t total = vpaddlq_u32(sum);
+    return (uint32_t)(vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1));
+}
+
+#endif
+
+static ColorIndicesFunction getColorIndicesFunction(const CpuFeatures & features)
+{
+#if defined(IMAGE_SIMD_X86)
+    if (features.sse2) {
+        return colorIndices_SSE2;
+    }
+#endif
+#if defined(IMAGE_SIMD_NEON)
+    if (features.neon) {
+        return colorIndices_NEON;
+    }
+#endif
+    return colorIndices;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static inline int clamp255(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+static inline uint16_t quantize565(const int * color)
+{
+    return (uint16_t)((((color[0] * 31 + 127) / 255) << 11) | (((color[1] * 63 + 127) / 255) << 5) | ((color[2] * 31 + 127) / 255));
+}
+
+static inline uint16_t quantize565(const float * color)
+{
+    int rounded[3];
+    for (int c = 0; c < 3; ++c) {
+        rounded[c] = clamp255((int)floorf(color[c] + 0.5f));
+    }
+    return quantize565(rounded);
+}
+
+//Expand a R5G6B5 color to 8bit by replicating the upper bits.
+static inline void expand565(int * color, uint16_t value)
+{
+    const int r = (value >> 11) & 31;
+    const int g = (value >> 5) & 63;
+    const int b = value & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+struct ColorEncoding
+{
+    uint32_t error;
+    uint16_t colors[2]; //!< End point colors. colors[0] > colors[1] selects the 4 color mode in BC1.
+    uint32_t indices;
+};
+
+static void tryColors(ColorEncoding & best, const int16_t * pixels, uint16_t color0, uint16_t color1, ColorIndicesFunction indicesFunction)
+{
+    if (color0 < color1) {
+        const uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+    //4 color mode: the end points and the colors at 1/3 and 2/3 between them. if both end points are equal all pixels use index 0
+    int ends[2][3];
+    expand565(ends[0], color0);
+    expand565(ends[1], color1);
+    int16_t palette[12];
+    for (int c = 0; c < 3; ++c) {
+        palette[c] = (int16_t)ends[0][c];
+        palette[3 + c] = (int16_t)ends[1][c];
+        palette[6 + c] = (int16_t)((2 * ends[0][c] + ends[1][c]) / 3);
+        palette[9 + c] = (int16_t)((ends[0][c] + 2 * ends[1][c]) / 3);
+    }
+    uint32_t indices = 0;
+    const uint32_t error = indicesFunction(indices, pixels, palette);
+    if (error < best.error) {
+        best.error = error;
+        best.colors[0] = color0;
+        best.colors[1] = color1;
+        best.indices = indices;
+    }
+}
+
+//Use the diagonal of the bounding box of all colors, inset a bit, so the end points are not wasted on outliers.
+static void encodeColorsFast(ColorEncoding & best, const int16_t * pixels, ColorIndicesFunction indicesFunction)
+{
+    int minColor[3];
+    int maxColor[3];
+    int axis = 0;
+    for (int c = 0; c < 3; ++c) {
+        minColor[c] = 255;
+        maxColor[c] = 0;
+        for (int i = 0; i < 16; ++i) {
+            minColor[c] = pixels[16 * c + i] < minColor[c] ? pixels[16 * c + i] : minColor[c];
+            maxColor[c] = pixels[16 * c + i] > maxColor[c] ? pixels[16 * c + i] : maxColor[c];
+        }
+        axis = (maxColor[c] - minColor[c]) > (maxColor[axis] - minColor[axis]) ? c : axis;
+    }
+    //pick the diagonal that runs along the colors. flip components that decrease while the widest one increases
+    for (int c = 0; c < 3; ++c) {
+        int covariance = 0;
+        for (int i = 0; i < 16 && c != axis; ++i) {
+            covariance += (2 * pixels[16 * axis + i] - minColor[axis] - maxColor[axis]) * (2 * pixels[16 * c + i] - minColor[c] - maxColor[c]);
+        }
+        if (covariance < 0) {
+            const int swap = minColor[c];
+            minColor[c] = maxColor[c];
+            maxColor[c] = swap;
+        }
+    }
+    for (int c = 0; c < 3; ++c) {
+        const int inset = (maxColor[c] - minColor[c]) / 16;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
+    }
+    tryColors(best, pixels, quantize565(maxColor), quantize565(minColor), indicesFunction);
+}
+
+//Fit the end points to the principal axis of the colors, refine them with a least squares fit to the pixel indices and search their neighbourhood.
+static void encodeColorsQuality(ColorEncoding & best, const int16_t * pixels, ColorIndicesFunction indicesFunction)
+{
+    encodeColorsFast(best, pixels, indicesFunction);
+    if (best.error == 0) {
+        return;
+    }
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int c = 0; c < 3; ++c) {
+        for (int i = 0; i < 16; ++i) {
+            mean[c] += pixels[16 * c + i];
+        }
+        mean[c] /= 16.0f;
+    }
+    float covariance[3][3] = {{0.0f}};
+    for (int i = 0; i < 16; ++i) {
+        const float d[3] = {pixels[i] - mean[0], pixels[16 + i] - mean[1], pixels[32 + i] - mean[2]};
+        for (int c0 = 0; c0 < 3; ++c0) {
+            for (int c1 = 0; c1 < 3; ++c1) {
+                covariance[c0][c1] += d[c0] * d[c1];
+            }
+        }
+    }
+    //power iteration, starting with the row of the strongest component
+    int start = 0;
+    for (int c = 1; c < 3; ++c) {
+        start = covariance[c][c] > covariance[start][start] ? c : start;
+    }
+    float axis[3] = {covariance[start][0], covariance[start][1], covariance[start][2]};
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[3];
+        float maxValue = 0.0f;
+        for (int c = 0; c < 3; ++c) {
+            next[c] = covariance[c][0] * axis[0] + covariance[c][1] * axis[1] + covariance[c][2] * axis[2];
+            maxValue = fabsf(next[c]) > maxValue ? fabsf(next[c]) : maxValue;
+        }
+        if (maxValue <= 0.0f) {
+            break;
+        }
+        for (int c = 0; c < 3; ++c) {
+            axis[c] = next[c] / maxValue;
+        }
+    }
+    const float length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    if (length2 > 0.0f) {
+        float minT = 0.0f;
+        float maxT = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            const float t = ((pixels[i] - mean[0]) * axis[0] + (pixels[16 + i] - mean[1]) * axis[1] + (pixels[32 + i] - mean[2]) * axis[2]) / length2;
+            minT = t < minT ? t : minT;
+            maxT = t > maxT ? t : maxT;
+        }
+        float ends[2][3];
+        for (int c = 0; c < 3; ++c) {
+            ends[0][c] = mean[c] + axis[c] * maxT;
+            ends[1][c] = mean[c] + axis[c] * minT;
+        }
+        tryColors(best, pixels, quantize565(ends[0]), quantize565(ends[1]), indicesFunction);
+    }
+    //least squares fit of the end points to the pixels with the current indices. weights of end point 0 are 1, 0, 2/3, 1/3
+    static const float s_weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    for (int iteration = 0; iteration < 2; ++iteration) {
+        float aa = 0.0f;
+        float bb = 0.0f;
+        float ab = 0.0f;
+        float ax[3] = {0.0f, 0.0f, 0.0f};
+        float bx[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; ++i) {
+            const float a = s_weights[(best.indices >> (2 * i)) & 3];
+            const float b = 1.0f - a;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            for (int c = 0; c < 3; ++c) {
+                ax[c] += a * pixels[16 * c + i];
+                bx[c] += b * pixels[16 * c + i];
+            }
+        }
+        const float determinant = aa * bb - ab * ab;
+        if (determinant < 1e-3f) {
+            //all pixels use the same end point
+            break;
+        }
+        float ends[2][3];
+        for (int c = 0; c < 3; ++c) {
+            ends[0][c] = (ax[c] * bb - bx[c] * ab) / determinant;
+            ends[1][c] = (bx[c] * aa - ax[c] * ab) / determinant;
+        }
+        const uint32_t previousError = best.error;
+        tryColors(best, pixels, quantize565(ends[0]), quantize565(ends[1]), indicesFunction);
+        if (best.error >= previousError) {
+            break;
+        }
+    }
+    //rounding to R5G6B5 is not always best. try moving every end point component by one step
+    static const uint16_t s_steps[3] = {1 << 11, 1 << 5, 1};
+    static const uint16_t s_masks[3] = {0xF800, 0x07E0, 0x001F};
+    bool improved = true;
+    for (int pass = 0; pass < 4 && improved && best.error > 0; ++pass) {
+        improved = false;
+        const ColorEncoding current = best;
+        for (int e = 0; e < 2; ++e) {
+            for (int c = 0; c < 3; ++c) {
+                const uint16_t value = current.colors[e] & s_masks[c];
+                uint16_t colors[2] = {current.colors[0], current.colors[1]};
+                if (value < s_masks[c]) {
+                    colors[e] = (uint16_t)((colors[e] & ~s_masks[c]) | (value + s_steps[c]));
+                    const uint32_t previousError = best.error;
+                    tryColors(best, pixels, colors[0], colors[1], indicesFunction);
+                    improved |= best.error < previousError;
+                }
+                colors[e] = current.colors[e];
+                if (value > 0) {
+                    colors[e] = (uint16_t)((colors[e] & ~s_masks[c]) | (value - s_steps[c]));
+                    const uint32_t previousError = best.error;
+                    tryColors(best, pixels, colors[0], colors[1], indicesFunction);
+                    improved |= best.error < previousError;
+                }
+            }
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+/*!
+Alphas selectable in a BC3 alpha block. alpha0 > alpha1 interpolates 6 values between them,
+otherwise 4 values are interpolated and the last indices are 0 and 255.
+*/
+static void alphaPalette(int * palette, int alpha0, int alpha1)
+{
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    if (alpha0 > alpha1) {
+        for (int i = 1; i <= 6; ++i) {
+            palette[1 + i] = ((7 - i) * alpha0 + i * alpha1) / 7;
+        }
+    }
+    else {
+        for (int i = 1; i <= 4; ++i) {
+            palette[1 + i] = ((5 - i) * alpha0 + i * alpha1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static uint32_t alphaIndices(uint64_t & indices, const int * alphas, int alpha0, int alpha1)
+{
+    int palette[8];
+    alphaPalette(palette, alpha0, alpha1);
+    uint32_t sum = 0;
+    indices = 0;
+    for (int i = 0; i < 16; ++i) {
+        int best = 0x7FFFFFFF;
+        int bestIndex = 0;
+        for (int m = 0; m < 8; ++m) {
+            const int error = (alphas[i] - palette[m]) * (alphas[i] - palette[m]);
+            if (error < best) {
+                best = error;
+                bestIndex = m;
+            }
+        }
+        sum += best;
+        indices |= (uint64_t)bestIndex << (3 * i);
+    }
+    return sum;
+}
+
+static void encodeAlpha(uint8_t * block, const uint32_t * pixels, Image::CompressionQuality quality)
+{
+    int alphas[16];
+    int minAlpha = 255;
+    int maxAlpha = 0;
+    int minInner = 255;
+    int maxInner = 0;
+    for (int i = 0; i < 16; ++i) {
+        alphas[i] = (int)(pixels[i] & 0xFF);
+        minAlpha = alphas[i] < minAlpha ? alphas[i] : minAlpha;
+        maxAlpha = alphas[i] > maxAlpha ? alphas[i] : maxAlpha;
+        if (alphas[i] > 0 && alphas[i] < 255) {
+            minInner = alphas[i] < minInner ? alphas[i] : minInner;
+            maxInner = alphas[i] > maxInner ? alphas[i] : maxInner;
+        }
+    }
+    int alpha0 = maxAlpha;
+    int alpha1 = minAlpha;
+    uint64_t indices = 0;
+    uint32_t error = alphaIndices(indices, alphas, alpha0, alpha1);
+    if (quality == Image::COMPRESS_QUALITY && error > 0) {
+        //the 4 alpha mode has exact 0 and 255, which suits blocks with transparent and opaque pixels plus a few in between
+        if (minInner <= maxInner) {
+            uint64_t innerIndices = 0;
+            const uint32_t innerError = alphaIndices(innerIndices, alphas, minInner, maxInner);
+            if (innerError < error) {
+                error = innerError;
+                indices = innerIndices;
+                alpha0 = minInner;
+                alpha1 = maxInner;
+            }
+        }
+        //move the end points inwards while the error gets smaller
+        for (int step = 1; step < 16 && maxAlpha - step > minAlpha + step && alpha0 > alpha1; ++step) {
+            uint64_t insetIndices = 0;
+            const uint32_t insetError = alphaIndices(insetIndices, alphas, maxAlpha - step, minAlpha + step);
+            if (insetError >= error) {
+                break;
+            }
+            error = insetError;
+            indices = insetIndices;
+            alpha0 = maxAlpha - step;
+            alpha1 = minAlpha + step;
+        }
+    }
+    block[0] = (uint8_t)alpha0;
+    block[1] = (uint8_t)alpha1;
+    for (int i = 0; i < 6; ++i) {
+        block[2 + i] = (uint8_t)(indices >> (8 * i));
+    }
+}
+
+static void decodeAlpha(uint32_t * pixels, const uint8_t * block)
+{
+    int palette[8];
+    alphaPalette(palette, block[0], block[1]);
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; ++i) {
+        indices |= (uint64_t)block[2 + i] << (8 * i);
+    }
+    for (int i = 0; i < 16; ++i) {
+        pixels[i] = (pixels[i] & 0xFFFFFF00) | (uint32_t)palette[(indices >> (3 * i)) & 7];
+    }
+}
+
+//BC1 blocks with color0 <= color1 have only 3 colors plus transparent black. The color blocks of BC3 always have 4 colors.
+static void decodeColors(uint32_t * pixels, const uint8_t * block, bool alwaysFourColors)
+{
+    const uint16_t color0 = (uint16_t)(block[0] | (block[1] << 8));
+    const uint16_t color1 = (uint16_t)(block[2] | (block[3] << 8));
+    const uint32_t indices = (uint32_t)block[4] | ((uint32_t)block[5] << 8) | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+    int ends[2][3];
+    expand565(ends[0], color0);
+    expand565(ends[1], color1);
+    uint32_t palette[4];
+    palette[0] = ((uint32_t)ends[0][0] << 24) | ((uint32_t)ends[0][1] << 16) | ((uint32_t)ends[0][2] << 8) | 0xFF;
+    palette[1] = ((uint32_t)ends[1][0] << 24) | ((uint32_t)ends[1][1] << 16) | ((uint32_t)ends[1][2] << 8) | 0xFF;
+    if (color0 > color1 || alwaysFourColors) {
+        palette[2] = 0xFF;
+        palette[3] = 0xFF;
+        for (int c = 0; c < 3; ++c) {
+            palette[2] |= (uint32_t)((2 * ends[0][c] + ends[1][c]) / 3) << (24 - 8 * c);
+            palette[3] |= (uint32_t)((ends[0][c] + 2 * ends[1][c]) / 3) << (24 - 8 * c);
+        }
+    }
+    else {
+        palette[2] = 0xFF;
+        for (int c = 0; c < 3; ++c) {
+            palette[2] |= (uint32_t)((ends[0][c] + ends[1][c]) / 2) << (24 - 8 * c);
+        }
+        palette[3] = 0;
+    }
+    for (int i = 0; i < 16; ++i) {
+        pixels[i] = palette[(indices >> (2 * i)) & 3];
+    }
+}
+
+static void encodeBlock(uint8_t * block, const uint32_t * pixels, PixelInfo::FormatType formatType, Image::CompressionQuality quality, ColorIndicesFunction indicesFunction)
+{
+    uint8_t * colorBlock = block;
+    if (formatType == PixelInfo::BC3_R5G6B5A8) {
+        encodeAlpha(block, pixels, quality);
+        colorBlock = block + 8;
+    }
+    int16_t components[48];
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            components[16 * c + i] = (int16_t)((pixels[i] >> (24 - 8 * c)) & 0xFF);
+        }
+    }
+    ColorEncoding best;
+    best.error = 0xFFFFFFFF;
+    if (quality == Image::COMPRESS_QUALITY) {
+        encodeColorsQuality(best, components, indicesFunction);
+    }
+    else {
+        encodeColorsFast(best, components, indicesFunction);
+    }
+    //blocks are little-endian
+    colorBlock[0] = (uint8_t)best.colors[0];
+    colorBlock[1] = (uint8_t)(best.colors[0] >> 8);
+    colorBlock[2] = (uint8_t)best.colors[1];
+    colorBlock[3] = (uint8_t)(best.colors[1] >> 8);
+    for (int i = 0; i < 4; ++i) {
+        colorBlock[4 + i] = (uint8_t)(best.indices >> (8 * i));
+    }
+}
+
+static size_t blockSize(PixelInfo::FormatType formatType)
+{
+    return formatType == PixelInfo::BC1_R5G6B5 ? 8 : (formatType == PixelInfo::BC3_R5G6B5A8 ? 16 : 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+void encodeS3TCBlock(uint8_t * block, const uint32_t * pixels, PixelInfo::FormatType formatType, Image::CompressionQuality quality, const CpuFeatures & features)
+{
+    if (blockSize(formatType) == 0) {
+        throw ImageException("encodeS3TCBlock() - Unsupported compressed format!");
+    }
+    encodeBlock(block, pixels, formatType, quality, getColorIndicesFunction(features));
+}
+
+void decodeS3TCBlock(uint32_t * pixels, const uint8_t * block, PixelInfo::FormatType formatType)
+{
+    if (formatType == PixelInfo::BC1_R5G6B5) {
+        decodeColors(pixels, block, false);
+    }
+    else if (formatType == PixelInfo::BC3_R5G6B5A8) {
+        decodeColors(pixels, block + 8, true);
+        decodeAlpha(pixels, block);
+    }
+    else {
+        throw ImageException("decodeS3TCBlock() - Unsupported compressed format!");
+    }
+}
+
+void encodeS3TC(uint8_t * dest, const ConstImageView & source, PixelInfo::FormatType formatType, Image::CompressionQuality quality)
+{
+    encodeS3TC(dest, source, formatType, quality, CpuFeatures::detected());
+}
+
+void encodeS3TC(uint8_t * dest, const ConstImageView & source, PixelInfo::FormatType formatType, Image::CompressionQuality quality, const CpuFeatures & features)
+{
+    if (dest == nullptr || source.data == nullptr || source.width == 0 || source.height == 0) {
+        throw ImageException("encodeS3TC() - Invalid image data!");
+    }
+    if (!PixelInfo::isDirectColor(source.formatType)) {
+        throw ImageException("encodeS3TC() - Invalid image format!");
+    }
+    const size_t bytesPerBlock = blockSize(formatType);
+    if (bytesPerBlock == 0) {
+        throw ImageException("encodeS3TC() - Unsupported compressed format!");
+    }
+    const ColorIndicesFunction indicesFunction = getColorIndicesFunction(features);
+    const size_t blocksX = (source.width + 3) / 4;
+    const size_t blocksY = (source.height + 3) / 4;
+    const size_t rowLength = blocksX * 4;
+#pragma omp parallel
+    {
+        //every thread converts the 4 rows of a block row to R8G8B8A8 and repeats the edge pixels in partial blocks
+        uint32_t * rows = (uint32_t *)PixelAllocator::allocate(4 * rowLength * sizeof(uint32_t));
+#pragma omp for schedule(dynamic)
+        for (int by = 0; by < (int)blocksY; ++by) {
+            for (size_t r = 0; r < 4; ++r) {
+                const size_t y = (by * 4 + r) < source.height ? (by * 4 + r) : (source.height - 1);
+                uint32_t * row = rows + r * rowLength;
+                convertFormat((uint8_t *)row, nullptr, PixelInfo::R8G8B8A8, source.row(y), nullptr, source.formatType, source.width);
+                for (size_t x = source.width; x < rowLength; ++x) {
+                    row[x] = row[source.width - 1];
+                }
+            }
+            for (size_t bx = 0; bx < blocksX; ++bx) {
+                uint32_t pixels[16];
+                for (size_t r = 0; r < 4; ++r) {
+                    memcpy(pixels + r * 4, rows + r * rowLength + bx * 4, 4 * sizeof(uint32_t));
+                }
+                encodeBlock(dest + (by * blocksX + bx) * bytesPerBlock, pixels, formatType, quality, indicesFunction);
+            }
+        }
+        PixelAllocator::release((uint8_t *)rows);
+    }
+}
+
+void decodeS3TC(const ImageView & dest, const uint8_t * source, PixelInfo::FormatType formatType)
+{
+    if (source == nullptr || dest.data == nullptr || dest.width == 0 || dest.height == 0) {
+        throw ImageException("decodeS3TC() - Invalid image data!");
+    }
+    if (!PixelInfo::isDirectColor(dest.formatType)) {
+        throw ImageException("decodeS3TC() - Invalid image format!");
+    }
+    const size_t bytesPerBlock = blockSize(formatType);
+    if (bytesPerBlock == 0) {
+        throw ImageException("decodeS3TC() - Unsupported compressed format!");
+    }
+    const size_t blocksX = (dest.width + 3) / 4;
+    const size_t blocksY = (dest.height + 3) / 4;
+    const size_t rowLength = blocksX * 4;
+#pragma omp parallel
+    {
+        uint32_t * rows = (uint32_t *)PixelAllocator::allocate(4 * rowLength * sizeof(uint32_t));
+#pragma omp for
+        for (int by = 0; by < (int)blocksY; ++by) {
+            for (size_t bx = 0; bx < blocksX; ++bx) {
+                uint32_t pixels[16];
+                decodeS3TCBlock(pixels, source + (by * blocksX + bx) * bytesPerBlock, formatType);
+                for (size_t r = 0; r < 4; ++r) {
+                    memcpy(rows + r * rowLength + bx * 4, pixels + r * 4, 4 * sizeof(uint32_t));
+                }
+            }
+            //convert the rows inside the image to the destination format
+            for (size_t r = 0; r < 4 && (by * 4 + r) < dest.height; ++r) {
+                convertFormat(dest.row(by * 4 + r), nullptr, dest.formatType, (const uint8_t *)(rows + r * rowLength), nullptr, PixelInfo::R8G8B8A8, dest.width);
+            }
+        }
+        PixelAllocator::release((uint8_t *)rows);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Image.h"
+#include "CpuFeatures.h"
+
+
+/*!
+Encoder and decoder for BC1 and BC3 (S3TC, also known as DXT1 and DXT5), the compressed texture formats of desktop OpenGL (EXT_texture_compression_s3tc).
+Every 4x4 pixel block stores two R5G6B5 end point colors and a 2bit index per pixel selecting one of 4 colors on the line between them.
+BC1 uses 64 bits per block and compresses RGB data 6:1, RGBA 8:1. Alpha is dropped.
+BC3 adds 64 bits with two 8bit end point alphas and a 3bit index per pixel, so RGBA data is compressed 4:1.
+Blocks are encoded and decoded in parallel. Pixel indices and errors are calculated with SSE2 or NEON if available.
+*/
+
+/*!
+Encode one 4x4 block.
+\param[in] block Receives the 8 (BC1) or 16 (BC3) bytes of the block.
+\param[in] pixels 16 R8G8B8A8 pixels in row order.
+\param[in] formatType BC1_R5G6B5 or BC3_R5G6B5A8.
+\param[in] quality How hard the encoder searches for the best encoding.
+\param[in] features CPU features the encoder may use.
+\note Throws an ImageException if the format is not supported.
+*/
+void encodeS3TCBlock(uint8_t * block, const uint32_t * pixels, PixelInfo::FormatType formatType, Image::CompressionQuality quality, const CpuFeatures & features);
+
+/*!
+Decode one 4x4 block.
+\param[in] pixels Receives 16 R8G8B8A8 pixels in row order.
+\param[in] block The 8 (BC1) or 16 (BC3) bytes of the block.
+\param[in] formatType BC1_R5G6B5 or BC3_R5G6B5A8.
+\note Throws an ImageException if the format is not supported.
+*/
+void decodeS3TCBlock(uint32_t * pixels, const uint8_t * block, PixelInfo::FormatType formatType);
+
+/*!
+Encode a view to BC1 or BC3 blocks. Partial blocks at the right and bottom edge are padded by repeating the edge pixels.
+\param[in] dest Output data. Must have PixelInfo::dataSize(formatType, width, height) bytes.
+\param[in] source Input view. Palette and compressed formats are not supported.
+\param[in] formatType BC1_R5G6B5 or BC3_R5G6B5A8.
+\param[in] quality Optional. How hard the encoder searches for the best encoding.
+\note Throws an ImageException if the view or format is invalid.
+*/
+void encodeS3TC(uint8_t * dest, const ConstImageView & source, PixelInfo::FormatType formatType, Image::CompressionQuality quality = Image::COMPRESS_FAST);
+
+/*!
+Encode a view to BC1 or BC3 blocks using only some CPU features. The result does not depend on the features, use this to test the SIMD code.
+*/
+void encodeS3TC(uint8_t * dest, const ConstImageView & source, PixelInfo::FormatType formatType, Image::CompressionQuality quality, const CpuFeatures & features);
+
+/*!
+Decode BC1 or BC3 blocks to a view.
+\param[in] dest Output view. Its size is the size of the image. Palette and compressed formats are not supported.
+\param[in] source BC1 or BC3 data of the image.
+\param[in] formatType BC1_R5G6B5 or BC3_R5G6B5A8.
+\note Throws an ImageException if the view or format is invalid.
+*/
+void decodeS3TC(const ImageView & dest, const uint8_t * source, PixelInfo::FormatType formatType);
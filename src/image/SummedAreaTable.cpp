@@ -0,0 +1,204 @@
+#include "SummedAreaTable.h"
+#include "Image.h"
+#include "ImageResample.h"
+#include "PixelAllocator.h"
+#include "PixelFormatSIMD.h"
+
+#include <math.h>
+#include <vector>
+
+
+//Number of table entries per band when adding up rows. Bands are summed up independently by different threads.
+#define SAT_BAND_SIZE 1024
+
+/*!
+Calculate the source ranges of all boxes of all destination pixels in one direction.
+\param[in] bounds Receives start and end of every box. nrOfBoxes pairs per destination pixel.
+*/
+static size_t calculateBounds(std::vector<size_t> & bounds, size_t nrOfBoxes, size_t destSize, size_t srcSize)
+{
+    bounds.resize(2 * nrOfBoxes * destSize);
+    const double scale = (double)srcSize / (double)destSize;
+    size_t maxSize = 0;
+    for (size_t d = 0; d < destSize; ++d) {
+        const double center = ((double)d + 0.5) * scale;
+        for (size_t i = 0; i < nrOfBoxes; ++i) {
+            //box widths go from 1/(n+1) to 2n/(n+1) of the destination pixel size. a single box covers exactly one destination pixel
+            const double halfWidth = 0.5 * scale * (double)(2 * (i + 1)) / (double)(nrOfBoxes + 1);
+            const double start = floor(center - halfWidth + 0.5);
+            const double end = floor(center + halfWidth + 0.5);
+            size_t first = start < 0.0 ? 0 : (size_t)start;
+            size_t last = end > (double)srcSize ? srcSize : (size_t)end;
+            //make sure we cover at least one pixel when upscaling
+            if (first >= srcSize) {
+                first = srcSize - 1;
+            }
+            if (last <= first) {
+                last = first + 1;
+            }
+            bounds[2 * (d * nrOfBoxes + i)] = first;
+            bounds[2 * (d * nrOfBoxes + i) + 1] = last;
+            maxSize = (last - first) > maxSize ? (last - first) : maxSize;
+        }
+    }
+    return maxSize;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+SummedAreaTable::SummedAreaTable(const ConstImageView & src)
+    : m_table(nullptr)
+    , m_width(src.width)
+    , m_height(src.height)
+    , m_formatType(src.formatType)
+    , m_tableFormatType(src.formatType)
+    , m_nrOfComponents(0)
+{
+    if (src.data == nullptr || m_width == 0 || m_height == 0) {
+        throw ImageException("SummedAreaTable::SummedAreaTable() - Invalid image data!");
+    }
+    if (!PixelInfo::isDirectColor(m_formatType)) {
+        throw ImageException("SummedAreaTable::SummedAreaTable() - Invalid image format!");
+    }
+    //formats with other than 8bit components are summed up as R8G8B8A8
+    if (!ImageResample::supportsFixedPoint(m_formatType)) {
+        m_tableFormatType = PixelInfo::R8G8B8A8;
+    }
+    m_nrOfComponents = PixelInfo::pixelInfo(m_tableFormatType).bytesPerPixel;
+    const size_t stride = (m_width + 1) * m_nrOfComponents;
+    m_table = (uint32_t *)PixelAllocator::allocate(stride * (m_height + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < stride; ++i) {
+        m_table[i] = 0;
+    }
+    //sum up every row horizontally
+    const bool convert = m_tableFormatType != m_formatType;
+    ConvertRowFunction rowFunction = convert ? getConvertRowFunction(m_tableFormatType, m_formatType) : nullptr;
+#pragma omp parallel
+    {
+        uint8_t * rowBuffer = convert ? PixelAllocator::allocate(m_width * m_nrOfComponents) : nullptr;
+#pragma omp for
+        for (int y = 0; y < (int)m_height; ++y) {
+            const uint8_t * srcRow = src.row(y);
+            if (convert) {
+                if (rowFunction != nullptr) {
+                    rowFunction(rowBuffer, srcRow, m_width);
+                }
+                else {
+                    convertFormat(rowBuffer, nullptr, m_tableFormatType, srcRow, nullptr, m_formatType, m_width);
+                }
+                srcRow = rowBuffer;
+            }
+            uint32_t * tableRow = m_table + (y + 1) * stride;
+            for (size_t c = 0; c < m_nrOfComponents; ++c) {
+                tableRow[c] = 0;
+            }
+            const size_t rowEntries = m_width * m_nrOfComponents;
+            for (size_t i = 0; i < rowEntries; ++i) {
+                tableRow[i + m_nrOfComponents] = tableRow[i] + srcRow[i];
+            }
+        }
+        PixelAllocator::release(rowBuffer);
+    }
+    //now add every row to the one below. columns do not depend on each other, so every thread sums up a band of columns
+    const int nrOfBands = (int)((stride + SAT_BAND_SIZE - 1) / SAT_BAND_SIZE);
+#pragma omp parallel for
+    for (int band = 0; band < nrOfBands; ++band) {
+        const size_t start = band * SAT_BAND_SIZE;
+        const size_t end = (start + SAT_BAND_SIZE) < stride ? (start + SAT_BAND_SIZE) : stride;
+        for (size_t y = 2; y <= m_height; ++y) {
+            uint32_t * tableRow = m_table + y * stride;
+            const uint32_t * prevRow = tableRow - stride;
+            for (size_t i = start; i < end; ++i) {
+                tableRow[i] += prevRow[i];
+            }
+        }
+    }
+}
+
+SummedAreaTable::~SummedAreaTable()
+{
+    PixelAllocator::release(m_table);
+}
+
+void SummedAreaTable::boxSum(uint32_t * sums, size_t x0, size_t y0, size_t x1, size_t y1) const
+{
+    const size_t stride = (m_width + 1) * m_nrOfComponents;
+    const uint32_t * top = m_table + y0 * stride;
+    const uint32_t * bottom = m_table + y1 * stride;
+    x0 *= m_nrOfComponents;
+    x1 *= m_nrOfComponents;
+    //unsigned arithmetic wraps around, so this is exact even if the entries overflowed
+    for (size_t c = 0; c < m_nrOfComponents; ++c) {
+        sums[c] = bottom[x1 + c] - bottom[x0 + c] - top[x1 + c] + top[x0 + c];
+    }
+}
+
+void SummedAreaTable::scale(const ImageView & dest, size_t nrOfBoxes) const
+{
+    if (dest.data == nullptr || dest.width == 0 || dest.height == 0) {
+        throw ImageException("SummedAreaTable::scale() - Invalid image data!");
+    }
+    if (!PixelInfo::isDirectColor(dest.formatType)) {
+        throw ImageException("SummedAreaTable::scale() - Invalid image format!");
+    }
+    if (nrOfBoxes == 0 || nrOfBoxes > MAX_BOXES) {
+        throw ImageException("SummedAreaTable::scale() - Invalid number of boxes!");
+    }
+    //calculate box ranges for all rows and columns once
+    std::vector<size_t> xBounds;
+    std::vector<size_t> yBounds;
+    const size_t maxWidth = calculateBounds(xBounds, nrOfBoxes, dest.width, m_width);
+    const size_t maxHeight = calculateBounds(yBounds, nrOfBoxes, dest.height, m_height);
+    if ((uint64_t)maxWidth * (uint64_t)maxHeight > (uint64_t)0xFFFFFFFF / 255) {
+        throw ImageException("SummedAreaTable::scale() - Box too big for summed-area table!");
+    }
+    const bool convert = dest.formatType != m_tableFormatType;
+    ConvertRowFunction rowFunction = convert ? getConvertRowFunction(dest.formatType, m_tableFormatType) : nullptr;
+    const float invBoxes = 1.0f / (float)nrOfBoxes;
+#pragma omp parallel
+    {
+        uint8_t * rowBuffer = convert ? PixelAllocator::allocate(dest.width * m_nrOfComponents) : nullptr;
+#pragma omp for schedule(static)
+        for (int y = 0; y < (int)dest.height; ++y) {
+            uint8_t * destRow = convert ? rowBuffer : dest.row(y);
+            const size_t * rowBounds = &yBounds[2 * y * nrOfBoxes];
+            uint32_t sums[4];
+            for (size_t x = 0; x < dest.width; ++x) {
+                const size_t * columnBounds = &xBounds[2 * x * nrOfBoxes];
+                if (nrOfBoxes == 1) {
+                    //plain box. average with correct rounding
+                    boxSum(sums, columnBounds[0], rowBounds[0], columnBounds[1], rowBounds[1]);
+                    const uint64_t area = (uint64_t)(columnBounds[1] - columnBounds[0]) * (uint64_t)(rowBounds[1] - rowBounds[0]);
+                    for (size_t c = 0; c < m_nrOfComponents; ++c) {
+                        destRow[c] = (uint8_t)(((uint64_t)sums[c] + area / 2) / area);
+                    }
+                }
+                else {
+                    //add up the averages of all nested boxes
+                    float values[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                    for (size_t i = 0; i < nrOfBoxes; ++i) {
+                        boxSum(sums, columnBounds[2 * i], rowBounds[2 * i], columnBounds[2 * i + 1], rowBounds[2 * i + 1]);
+                        const float invArea = 1.0f / ((float)(columnBounds[2 * i + 1] - columnBounds[2 * i]) * (float)(rowBounds[2 * i + 1] - rowBounds[2 * i]));
+                        for (size_t c = 0; c < m_nrOfComponents; ++c) {
+                            values[c] += (float)sums[c] * invArea;
+                        }
+                    }
+                    for (size_t c = 0; c < m_nrOfComponents; ++c) {
+                        const float value = values[c] * invBoxes + 0.5f;
+                        destRow[c] = (uint8_t)(value > 255.0f ? 255.0f : value);
+                    }
+                }
+                destRow += m_nrOfComponents;
+            }
+            if (convert) {
+                if (rowFunction != nullptr) {
+                    rowFunction(dest.row(y), rowBuffer, dest.width);
+                }
+                else {
+                    convertFormat(dest.row(y), nullptr, dest.formatType, rowBuffer, nullptr, m_tableFormatType, dest.width);
+                }
+            }
+        }
+        PixelAllocator::release(rowBuffer);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ImageView.h"
+
+
+/*!
+Summed-area table (integral image) of a source image. It is built once in O(width x height) and then every box average
+over the source costs four lookups per color component, no matter how big the box is. This makes large reductions,
+e.g. 16x-64x previews, much cheaper than kernel resampling whose cost grows with the reduction ratio.
+Every table entry is a 32bit sum per 8bit color component. Sums wrap around, but box sums are still exact as long as a box
+has less than 2^32 / 255 pixels. The table needs 4 bytes per component, so it is about four times the size of an 8bit source.
+Formats without 8bit color components are converted to R8G8B8A8 while building the table. Palette formats are not supported.
+The table is never modified after construction, so multiple threads can scale from it at once.
+*/
+class SummedAreaTable
+{
+    uint32_t * m_table; //!< (width + 1) x (height + 1) entries with nrOfComponents sums each. The first row and column are zero.
+    size_t m_width;
+    size_t m_height;
+    PixelInfo::FormatType m_formatType; //!< Format of the source image.
+    PixelInfo::FormatType m_tableFormatType; //!< Format the sums are stored in. Either the source format or R8G8B8A8.
+    size_t m_nrOfComponents;
+
+    SummedAreaTable(const SummedAreaTable & b);
+    SummedAreaTable & operator=(const SummedAreaTable & b);
+
+public:
+    //Maximum number of nested boxes per destination pixel. \sa scale.
+    static const size_t MAX_BOXES = 8;
+
+    /*!
+    Constructor. Builds the table from a source view.
+    \param[in] src Source view.
+    \note Throws an ImageException if the view is empty or has a palette or compressed format.
+    */
+    SummedAreaTable(const ConstImageView & src);
+
+    /*!
+    Destructor. Frees the table.
+    */
+    ~SummedAreaTable();
+
+    /*!
+    Scale the source to the destination view by averaging the source pixels covered by every destination pixel.
+    \param[in] dest Output view. Should be smaller than the source. Its format may differ from the source format.
+    \param[in] nrOfBoxes Number of nested boxes per destination pixel. 1 gives a plain box filter. With more boxes their widths are spread from a fraction
+    to a multiple of the destination pixel size and their averages are added, which gives a stepped bell-shaped kernel approximating a Gaussian.
+    3 boxes suppress most of the aliasing of a plain box. Cost grows with the number of boxes, but not with the reduction ratio.
+    \note Throws an ImageException if the view is invalid or a box would be too big for the 32bit sums.
+    */
+    void scale(const ImageView & dest, size_t nrOfBoxes = 1) const;
+
+    /*!
+    Get sums of all color components over a rectangle of source pixels.
+    \param[in] sums Receives one sum per color component of \sa tableFormatType.
+    \param[in] x0 Left edge of rectangle.
+    \param[in] y0 Top edge of rectangle.
+    \param[in] x1 Right edge of rectangle. Exclusive.
+    \param[in] y1 Bottom edge of rectangle. Exclusive.
+    */
+    void boxSum(uint32_t * sums, size_t x0, size_t y0, size_t x1, size_t y1) const;
+
+    size_t width() const { return m_width; }
+    size_t height() const { return m_height; }
+    PixelInfo::FormatType formatType() const { return m_formatType; }
+    PixelInfo::FormatType tableFormatType() const { return m_tableFormatType; }
+};
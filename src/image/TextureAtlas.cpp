@@ -0,0 +1,365 @@
+#include "TextureAtlas.h"
+#include "PixelAllocator.h"
+#include "PixelFormatSIMD.h"
+
+#include <string.h>
+#include <algorithm>
+
+
+//Free rectangle lists shorter than this are searched by a single thread.
+#define ATLAS_PARALLEL_RECTS 256
+
+struct AtlasRect
+{
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+
+    AtlasRect(size_t rx = 0, size_t ry = 0, size_t w = 0, size_t h = 0) : x(rx), y(ry), width(w), height(h) {}
+    bool contains(const AtlasRect & b) const { return b.x >= x && b.y >= y && b.x + b.width <= x + width && b.y + b.height <= y + height; }
+    bool intersects(const AtlasRect & b) const { return b.x < x + width && x < b.x + b.width && b.y < y + height && y < b.y + b.height; }
+    bool operator==(const AtlasRect & b) const { return x == b.x && y == b.y && width == b.width && height == b.height; }
+};
+
+//MaxRects bin. Keeps a list of maximal free rectangles, which may overlap each other.
+struct AtlasPage
+{
+    std::vector<AtlasRect> freeRects;
+    size_t usedWidth;
+    size_t usedHeight;
+
+    AtlasPage(size_t width, size_t height) : usedWidth(0), usedHeight(0) { freeRects.push_back(AtlasRect(0, 0, width, height)); }
+
+    /*!
+    Find the free rectangle leaving the least space along its shorter side ("best short side fit").
+    \return Returns the index of the free rectangle or -1 if the size fits nowhere. Ties go to the lower index, so the result does not depend on the number of threads.
+    */
+    int findPosition(size_t width, size_t height) const
+    {
+        int bestIndex = -1;
+        size_t bestShort = (size_t)-1;
+        size_t bestLong = (size_t)-1;
+#pragma omp parallel if (freeRects.size() > ATLAS_PARALLEL_RECTS)
+        {
+            int threadIndex = -1;
+            size_t threadShort = (size_t)-1;
+            size_t threadLong = (size_t)-1;
+#pragma omp for
+            for (int i = 0; i < (int)freeRects.size(); ++i) {
+                const AtlasRect & rect = freeRects[i];
+                if (rect.width >= width && rect.height >= height) {
+                    const size_t leftX = rect.width - width;
+                    const size_t leftY = rect.height - height;
+                    const size_t shortSide = leftX < leftY ? leftX : leftY;
+                    const size_t longSide = leftX < leftY ? leftY : leftX;
+                    if (shortSide < threadShort || (shortSide == threadShort && longSide < threadLong)) {
+                        threadIndex = i;
+                        threadShort = shortSide;
+                        threadLong = longSide;
+                    }
+                }
+            }
+#pragma omp critical
+            if (threadIndex >= 0 && (threadShort < bestShort || (threadShort == bestShort && (threadLong < bestLong || (threadLong == bestLong && threadIndex < bestIndex))))) {
+                bestIndex = threadIndex;
+                bestShort = threadShort;
+                bestLong = threadLong;
+            }
+        }
+        return bestIndex;
+    }
+
+    //Mark a rectangle as used and split all free rectangles overlapping it into their maximal leftovers.
+    void place(const AtlasRect & used)
+    {
+        const size_t oldCount = freeRects.size();
+        std::vector<AtlasRect> rects;
+        std::vector<bool> isNew;
+        rects.reserve(oldCount + 8);
+        for (size_t i = 0; i < oldCount; ++i) {
+            const AtlasRect & rect = freeRects[i];
+            if (!rect.intersects(used)) {
+                rects.push_back(rect);
+                isNew.push_back(false);
+                continue;
+            }
+            if (used.x > rect.x) {
+                rects.push_back(AtlasRect(rect.x, rect.y, used.x - rect.x, rect.height));
+                isNew.push_back(true);
+            }
+            if (used.x + used.width < rect.x + rect.width) {
+                rects.push_back(AtlasRect(used.x + used.width, rect.y, rect.x + rect.width - used.x - used.width, rect.height));
+                isNew.push_back(true);
+            }
+            if (used.y > rect.y) {
+                rects.push_back(AtlasRect(rect.x, rect.y, rect.width, used.y - rect.y));
+                isNew.push_back(true);
+            }
+            if (used.y + used.height < rect.y + rect.height) {
+                rects.push_back(AtlasRect(rect.x, used.y + used.height, rect.width, rect.y + rect.height - used.y - used.height));
+                isNew.push_back(true);
+            }
+        }
+        //drop rectangles contained in others. old rectangles never contain each other, so only pairs with a new one need checking
+        std::vector<size_t> newIndices;
+        for (size_t i = 0; i < rects.size(); ++i) {
+            if (isNew[i]) {
+                newIndices.push_back(i);
+            }
+        }
+        std::vector<char> removed(rects.size(), 0);
+#pragma omp parallel for if (rects.size() > ATLAS_PARALLEL_RECTS)
+        for (int i = 0; i < (int)rects.size(); ++i) {
+            const size_t nrOfCandidates = isNew[i] ? rects.size() : newIndices.size();
+            for (size_t c = 0; c < nrOfCandidates; ++c) {
+                const size_t j = isNew[i] ? c : newIndices[c];
+                //of two equal rectangles the first one is kept
+                if ((int)j != i && rects[j].contains(rects[i]) && (!(rects[j] == rects[i]) || (int)j < i)) {
+                    removed[i] = 1;
+                    break;
+                }
+            }
+        }
+        freeRects.clear();
+        for (size_t i = 0; i < rects.size(); ++i) {
+            if (!removed[i]) {
+                freeRects.push_back(rects[i]);
+            }
+        }
+        usedWidth = (used.x + used.width) > usedWidth ? (used.x + used.width) : usedWidth;
+        usedHeight = (used.y + used.height) > usedHeight ? (used.y + used.height) : usedHeight;
+    }
+};
+
+static size_t nextPowerOfTwo(size_t value)
+{
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+TextureAtlas::TextureAtlas(size_t maxWidth, size_t maxHeight, PixelInfo::FormatType formatType, size_t padding, bool extrude, bool trim)
+    : m_maxWidth(maxWidth)
+    , m_maxHeight(maxHeight)
+    , m_padding(padding)
+    , m_extrude(extrude)
+    , m_trim(trim)
+    , m_formatType(formatType)
+{
+    if (!PixelInfo::isDirectColor(m_formatType)) {
+        throw ImageException("TextureAtlas::TextureAtlas() - Invalid atlas format!");
+    }
+}
+
+void TextureAtlas::add(const std::string & name, const Image & image)
+{
+    if (m_names.find(name) != m_names.end()) {
+        throw ImageException("TextureAtlas::add() - Image \"" + name + "\" already added!");
+    }
+    if (image.width() == 0 || image.height() == 0 || !PixelInfo::isDirectColor(image.formatType())) {
+        throw ImageException("TextureAtlas::add() - Invalid image!");
+    }
+    if (image.width() + 2 * m_padding > m_maxWidth || image.height() + 2 * m_padding > m_maxHeight) {
+        throw ImageException("TextureAtlas::add() - Image \"" + name + "\" too big for atlas page!");
+    }
+    Entry entry;
+    entry.name = name;
+    entry.image = image;
+    memset(&entry.region, 0, sizeof(Region));
+    m_names[name] = m_entries.size();
+    m_entries.push_back(entry);
+}
+
+bool TextureAtlas::contains(const std::string & name) const
+{
+    return m_names.find(name) != m_names.end();
+}
+
+const TextureAtlas::Region & TextureAtlas::region(const std::string & name) const
+{
+    std::map<std::string, size_t>::const_iterator it = m_names.find(name);
+    if (it == m_names.end()) {
+        throw ImageException("TextureAtlas::region() - No image \"" + name + "\" in atlas!");
+    }
+    return m_entries[it->second].region;
+}
+
+void TextureAtlas::trimEntry(Entry & entry) const
+{
+    const Image & image = entry.image;
+    Region & region = entry.region;
+    region.sourceWidth = image.width();
+    region.sourceHeight = image.height();
+    region.trimX = 0;
+    region.trimY = 0;
+    region.width = image.width();
+    region.height = image.height();
+    if (!m_trim || PixelInfo::pixelInfo(image.formatType()).bitsAlpha == 0) {
+        return;
+    }
+    //convert rows to R8G8B8A8 to find the bounds of all pixels with non-zero alpha
+    const ConstImageView source = image.view();
+    const bool convert = source.formatType != PixelInfo::R8G8B8A8;
+    ConvertRowFunction rowFunction = convert ? getConvertRowFunction(PixelInfo::R8G8B8A8, source.formatType) : nullptr;
+    uint32_t * rowBuffer = convert ? (uint32_t *)PixelAllocator::allocate(source.width * 4) : nullptr;
+    size_t minX = source.width;
+    size_t maxX = 0;
+    size_t minY = source.height;
+    size_t maxY = 0;
+    for (size_t y = 0; y < source.height; ++y) {
+        const uint32_t * row = (const uint32_t *)source.row(y);
+        if (convert) {
+            if (rowFunction != nullptr) {
+                rowFunction((uint8_t *)rowBuffer, source.row(y), source.width);
+            }
+            else {
+                convertFormat((uint8_t *)rowBuffer, nullptr, PixelInfo::R8G8B8A8, source.row(y), nullptr, source.formatType, source.width);
+            }
+            row = rowBuffer;
+        }
+        //alpha is in the lowest 8 bits
+        size_t first = 0;
+        while (first < source.width && (row[first] & 0xFF) == 0) {
+            ++first;
+        }
+        if (first == source.width) {
+            continue;
+        }
+        size_t last = source.width - 1;
+        while ((row[last] & 0xFF) == 0) {
+            --last;
+        }
+        minX = first < minX ? first : minX;
+        maxX = last > maxX ? last : maxX;
+        minY = y < minY ? y : minY;
+        maxY = y;
+    }
+    PixelAllocator::release((uint8_t *)rowBuffer);
+    if (minY > maxY) {
+        //fully transparent. keep a single pixel, so the image still has a region
+        region.width = 1;
+        region.height = 1;
+        return;
+    }
+    region.trimX = minX;
+    region.trimY = minY;
+    region.width = maxX - minX + 1;
+    region.height = maxY - minY + 1;
+}
+
+void TextureAtlas::pack()
+{
+    //place big images first. they are the hardest to fit
+    std::vector<size_t> order(m_entries.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    const std::vector<Entry> & entries = m_entries;
+    std::sort(order.begin(), order.end(), [&entries](size_t a, size_t b) {
+        const Region & ra = entries[a].region;
+        const Region & rb = entries[b].region;
+        const size_t maxA = ra.width > ra.height ? ra.width : ra.height;
+        const size_t maxB = rb.width > rb.height ? rb.width : rb.height;
+        if (maxA != maxB) {
+            return maxA > maxB;
+        }
+        if (ra.width * ra.height != rb.width * rb.height) {
+            return ra.width * ra.height > rb.width * rb.height;
+        }
+        return a < b;
+    });
+    std::vector<AtlasPage> pages;
+    for (size_t i = 0; i < order.size(); ++i) {
+        Region & region = m_entries[order[i]].region;
+        const size_t width = region.width + 2 * m_padding;
+        const size_t height = region.height + 2 * m_padding;
+        //try all open pages before starting a new one
+        size_t page = 0;
+        int index = -1;
+        for (; page < pages.size(); ++page) {
+            if ((index = pages[page].findPosition(width, height)) >= 0) {
+                break;
+            }
+        }
+        if (index < 0) {
+            pages.push_back(AtlasPage(m_maxWidth, m_maxHeight));
+            index = pages.back().findPosition(width, height);
+        }
+        const AtlasRect & freeRect = pages[page].freeRects[index];
+        const AtlasRect used(freeRect.x, freeRect.y, width, height);
+        pages[page].place(used);
+        region.page = page;
+        region.x = used.x + m_padding;
+        region.y = used.y + m_padding;
+    }
+    //allocate pages as small as possible
+    m_pages.clear();
+    for (size_t i = 0; i < pages.size(); ++i) {
+        size_t width = nextPowerOfTwo(pages[i].usedWidth);
+        size_t height = nextPowerOfTwo(pages[i].usedHeight);
+        width = width > m_maxWidth ? m_maxWidth : width;
+        height = height > m_maxHeight ? m_maxHeight : height;
+        m_pages.push_back(Image(width, height, m_formatType));
+        memset(m_pages.back().pixels(), 0, width * height * PixelInfo::pixelInfo(m_formatType).bytesPerPixel);
+    }
+}
+
+void TextureAtlas::extrude(Image & page, const Region & region) const
+{
+    const ImageView view = page.view();
+    const size_t bytesPerPixel = PixelInfo::pixelInfo(m_formatType).bytesPerPixel;
+    const size_t left = region.x - m_padding;
+    const size_t right = region.x + region.width;
+    //repeat the left and right column of every row
+    for (size_t y = region.y; y < region.y + region.height; ++y) {
+        uint8_t * row = view.row(y);
+        for (size_t x = left; x < region.x; ++x) {
+            memcpy(row + x * bytesPerPixel, row + region.x * bytesPerPixel, bytesPerPixel);
+        }
+        for (size_t x = right; x < right + m_padding; ++x) {
+            memcpy(row + x * bytesPerPixel, row + (right - 1) * bytesPerPixel, bytesPerPixel);
+        }
+    }
+    //then repeat the first and last row including the corners
+    const size_t rowBytes = (region.width + 2 * m_padding) * bytesPerPixel;
+    for (size_t y = region.y - m_padding; y < region.y; ++y) {
+        memcpy(view.row(y) + left * bytesPerPixel, view.row(region.y) + left * bytesPerPixel, rowBytes);
+    }
+    for (size_t y = region.y + region.height; y < region.y + region.height + m_padding; ++y) {
+        memcpy(view.row(y) + left * bytesPerPixel, view.row(region.y + region.height - 1) + left * bytesPerPixel, rowBytes);
+    }
+}
+
+void TextureAtlas::build()
+{
+    m_pages.clear();
+    if (m_entries.empty()) {
+        return;
+    }
+    //find the bounds of all images. every image is scanned independently
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int)m_entries.size(); ++i) {
+        trimEntry(m_entries[i]);
+    }
+    pack();
+    //copy images to their pages. regions including their padding do not overlap, so every image can be copied by a different thread
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int)m_entries.size(); ++i) {
+        Region & region = m_entries[i].region;
+        Image & page = m_pages[region.page];
+        const Image & image = m_entries[i].image;
+        convertFormat(page.view(region.x, region.y, region.width, region.height), image.view(region.trimX, region.trimY, region.width, region.height));
+        if (m_extrude && m_padding > 0) {
+            extrude(page, region);
+        }
+        region.u0 = (float)region.x / (float)page.width();
+        region.v0 = (float)region.y / (float)page.height();
+        region.u1 = (float)(region.x + region.width) / (float)page.width();
+        region.v1 = (float)(region.y + region.height) / (float)page.height();
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Image.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+/*!
+Packs many small images into a few big atlas pages, so they can be drawn from one texture without rebinding.
+Images are added by name, then build() packs them with the MaxRects algorithm and copies their pixels to the pages.
+Fully transparent borders can be trimmed before packing, which saves lots of space with sprites. Every image is surrounded by
+padding pixels, optionally filled by extruding its edge pixels, so linear filtering does not bleed in neighbouring images.
+Trimming, packing and copying run in parallel for large sets of images.
+Pages use the same orientation as their pixel data: row 0 is at v = 0.
+*/
+class TextureAtlas
+{
+public:
+    struct Region
+    {
+        size_t page; //!< Index of atlas page the image is on.
+        size_t x; //!< Left edge of the trimmed image in the page.
+        size_t y; //!< First row of the trimmed image in the page.
+        size_t width; //!< Width of the trimmed image.
+        size_t height; //!< Height of the trimmed image.
+        size_t trimX; //!< Left edge of the trimmed image in the original image.
+        size_t trimY; //!< First row of the trimmed image in the original image.
+        size_t sourceWidth; //!< Width of the original image.
+        size_t sourceHeight; //!< Height of the original image.
+        float u0; //!< Texture coordinates of the trimmed image in the page.
+        float v0;
+        float u1;
+        float v1;
+    };
+
+private:
+    struct Entry
+    {
+        std::string name;
+        Image image;
+        Region region;
+    };
+
+    size_t m_maxWidth;
+    size_t m_maxHeight;
+    size_t m_padding;
+    bool m_extrude;
+    bool m_trim;
+    PixelInfo::FormatType m_formatType;
+    std::vector<Entry> m_entries;
+    std::map<std::string, size_t> m_names; //!< Maps image name to index in m_entries.
+    std::vector<Image> m_pages;
+
+    void trimEntry(Entry & entry) const;
+    void pack();
+    void extrude(Image & page, const Region & region) const;
+
+public:
+    /*!
+    Constructor.
+    \param[in] maxWidth Maximum width of an atlas page.
+    \param[in] maxHeight Maximum height of an atlas page.
+    \param[in] formatType Pixel format of atlas pages. Palette and compressed formats are not supported.
+    \param[in] padding Number of pixels around every image.
+    \param[in] extrude Pass true to fill the padding with the edge pixels of the image, false to leave it transparent.
+    \param[in] trim Pass true to cut off fully transparent borders of images with an alpha channel.
+    \note Throws an ImageException if the format is not supported.
+    */
+    TextureAtlas(size_t maxWidth = 2048, size_t maxHeight = 2048, PixelInfo::FormatType formatType = PixelInfo::R8G8B8A8, size_t padding = 1, bool extrude = true, bool trim = true);
+
+    /*!
+    Add an image to the atlas. The image shares its pixels with the original, so this is cheap.
+    \param[in] name Name to look the image up with later.
+    \param[in] image Image to add.
+    \note Throws an ImageException if the name is already used, the image is empty or has a palette or compressed format,
+    or the image does not fit on a page.
+    */
+    void add(const std::string & name, const Image & image);
+
+    /*!
+    Pack all added images and copy them to the atlas pages. Previously built pages are discarded.
+    Pages are as small as possible, rounded up to a power of two.
+    */
+    void build();
+
+    /*!
+    Check if an image has been added to the atlas.
+    */
+    bool contains(const std::string & name) const;
+
+    /*!
+    Get the region of an image in the atlas.
+    \param[in] name Name the image was added with.
+    \return Returns the position and texture coordinates of the image. Only valid after build().
+    \note Throws an ImageException if there is no image with this name.
+    */
+    const Region & region(const std::string & name) const;
+
+    /*!
+    Get atlas pages. Only valid after build().
+    */
+    const std::vector<Image> & pages() const { return m_pages; }
+
+    size_t size() const { return m_entries.size(); }
+    PixelInfo::FormatType formatType() const { return m_formatType; }
+};